@@ -0,0 +1,305 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "buddy.h"
+
+#define BUDDY_LINKS(buddy, block) ((buddy_links_s *) ((buddy)->arena + ((size_t) (block) << BUDDY_MIN_ORDER)))
+
+/*
+ * Return: the smallest order whose blocks hold size bytes.
+ */
+unsigned int buddy_order_of(/* in */ size_t size) {
+    unsigned int order = 0;
+
+    while (((size_t) 1 << (BUDDY_MIN_ORDER + order)) < size) {
+        order++;
+    }
+    return order;
+}
+
+/*
+ * Pushes a block onto the free list of its order.
+ */
+void buddy_push(/* in-out */ buddy_p buddy, /* in */ uint32_t block, /* in */ unsigned int order) {
+    buddy_links_s * links = BUDDY_LINKS(buddy, block);
+
+    links->prev = BUDDY_NIL;
+    links->next = buddy->free_head[order];
+    if (links->next != BUDDY_NIL) {
+        BUDDY_LINKS(buddy, links->next)->prev = block;
+    }
+    buddy->free_head[order] = block;
+    buddy->nonempty |= 1u << order;
+    buddy->block_state[block] = order;
+}
+
+/*
+ * Unlinks a free block from the free list of its order.
+ */
+void buddy_unlink(/* in-out */ buddy_p buddy, /* in */ uint32_t block, /* in */ unsigned int order) {
+    buddy_links_s * links = BUDDY_LINKS(buddy, block);
+
+    if (links->prev != BUDDY_NIL) {
+        BUDDY_LINKS(buddy, links->prev)->next = links->next;
+    } else {
+        buddy->free_head[order] = links->next;
+        if (links->next == BUDDY_NIL) {
+            buddy->nonempty &= ~(1u << order);
+        }
+    }
+    if (links->next != BUDDY_NIL) {
+        BUDDY_LINKS(buddy, links->next)->prev = links->prev;
+    }
+    buddy->block_state[block] = BUDDY_IN_USE;
+}
+
+/*
+ * Maps an arena for the allocator. The mapping reserves no swap and pages are
+ * only backed when touched.
+ *
+ * Arguments: buddy: the allocator to set up.
+ *            arena_size: bytes of simulated memory, rounded down to a power of two.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int buddy_init(/* out */ buddy_p buddy, /* in */ size_t arena_size) {
+    unsigned int order;
+    uint32_t block;
+
+    buddy->max_order = 0;
+    while (buddy->max_order + 1 < BUDDY_MAX_ORDERS
+           && ((size_t) 1 << (BUDDY_MIN_ORDER + buddy->max_order + 1)) <= arena_size) {
+        buddy->max_order++;
+    }
+    buddy->arena_size = (size_t) 1 << (BUDDY_MIN_ORDER + buddy->max_order);
+
+    buddy->arena = mmap(NULL, buddy->arena_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (buddy->arena == MAP_FAILED) {
+        buddy->arena = NULL;
+        return 0;
+    }
+    buddy->block_state = malloc((size_t) 1 << buddy->max_order);
+    if (buddy->block_state == NULL) {
+        munmap(buddy->arena, buddy->arena_size);
+        buddy->arena = NULL;
+        return 0;
+    }
+
+    for (order = 0; order < BUDDY_MAX_ORDERS; order++) {
+        buddy->free_head[order] = BUDDY_NIL;
+    }
+    buddy->nonempty = 0;
+    buddy->stats = (buddy_stats_s) { 0 };
+    for (block = 0; block < (1u << buddy->max_order); block++) {
+        buddy->block_state[block] = BUDDY_IN_USE;
+    }
+
+    /* The whole arena starts out as one free block. */
+    buddy_push(buddy, 0, buddy->max_order);
+    buddy->free_bytes = buddy->arena_size;
+    return 1;
+}
+
+/*
+ * Unmaps the arena. Outstanding blocks become invalid.
+ *
+ * Arguments: buddy: the allocator.
+ */
+void buddy_destroy(/* in-out */ buddy_p buddy) {
+    if (buddy->arena != NULL) {
+        munmap(buddy->arena, buddy->arena_size);
+        free(buddy->block_state);
+        buddy->arena = NULL;
+        buddy->block_state = NULL;
+    }
+}
+
+/*
+ * Allocates a block of at least size bytes.
+ *
+ * Arguments: buddy: the allocator.
+ *            size: bytes needed.
+ * Return: the block, NULL if no free block is large enough.
+ */
+unsigned char * buddy_alloc(/* in-out */ buddy_p buddy, /* in */ size_t size) {
+    struct timespec start, end;
+    unsigned long long elapsed;
+    unsigned int order = buddy_order_of(size);
+    unsigned int found;
+    uint32_t block;
+    uint32_t candidates;
+    unsigned char * ret = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* The smallest order at or above the request that has a free block. */
+    candidates = order <= buddy->max_order ? buddy->nonempty >> order << order : 0;
+    if (candidates != 0) {
+        found = __builtin_ctz(candidates);
+        block = buddy->free_head[found];
+        buddy_unlink(buddy, block, found);
+
+        /* Split, keeping the lower half and freeing the upper one at each step. */
+        while (found > order) {
+            found--;
+            buddy_push(buddy, block + (1u << found), found);
+        }
+
+        buddy->free_bytes -= (size_t) 1 << (BUDDY_MIN_ORDER + order);
+        buddy->stats.allocs++;
+        buddy->stats.requested_bytes += size;
+        buddy->stats.allocated_bytes += (size_t) 1 << (BUDDY_MIN_ORDER + order);
+        ret = buddy->arena + ((size_t) block << BUDDY_MIN_ORDER);
+    } else {
+        buddy->stats.failures++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+    buddy->stats.latency_ns += elapsed;
+    if (elapsed > buddy->stats.latency_max_ns) {
+        buddy->stats.latency_max_ns = elapsed;
+    }
+
+    return ret;
+}
+
+/*
+ * Frees a block, merging it with its buddy as far as possible.
+ *
+ * Arguments: buddy: the allocator.
+ *            block: a block from buddy_alloc.
+ *            size: the size it was allocated with.
+ */
+void buddy_free(/* in-out */ buddy_p buddy, /* in */ unsigned char * block, /* in */ size_t size) {
+    unsigned int order = buddy_order_of(size);
+    uint32_t index = (block - buddy->arena) >> BUDDY_MIN_ORDER;
+    uint32_t mate;
+
+    buddy->free_bytes += (size_t) 1 << (BUDDY_MIN_ORDER + order);
+    buddy->stats.frees++;
+    buddy->stats.requested_bytes -= size;
+    buddy->stats.allocated_bytes -= (size_t) 1 << (BUDDY_MIN_ORDER + order);
+
+    while (order < buddy->max_order) {
+        mate = index ^ (1u << order);
+        if (buddy->block_state[mate] != order) {
+            break;
+        }
+        buddy_unlink(buddy, mate, order);
+        index &= ~(1u << order);
+        order++;
+    }
+    buddy_push(buddy, index, order);
+}
+
+/*
+ * Return: the size of the largest free block, 0 if memory is full.
+ */
+size_t buddy_largest_free(/* in */ buddy_p buddy) {
+    if (buddy->nonempty == 0) {
+        return 0;
+    }
+    return (size_t) 1 << (BUDDY_MIN_ORDER + 31 - __builtin_clz(buddy->nonempty));
+}
+
+/*
+ * External fragmentation: the share of free memory that is not in the largest
+ * free block, so cannot serve the largest request that free space would allow.
+ *
+ * Return: a value between 0 and 1, 0 when there is no free memory.
+ */
+double buddy_fragmentation(/* in */ buddy_p buddy) {
+    if (buddy->free_bytes == 0) {
+        return 0.0;
+    }
+    return 1.0 - (double) buddy_largest_free(buddy) / buddy->free_bytes;
+}
+
+/*
+ * Writes the allocator's free lists and statistics to a checkpoint. The arena
+ * contents are not saved; blocks are named by their index in the arena.
+ *
+ * Arguments: w: the checkpoint.
+ *            buddy: the allocator.
+ */
+void buddy_save(/* in-out */ ckpt_writer_p w, /* in */ buddy_p buddy) {
+    uint64_t arena_size = buddy->arena_size;
+    unsigned int order;
+    uint32_t block;
+    uint32_t count;
+
+    ckpt_put(w, &arena_size, sizeof(arena_size));
+    ckpt_put(w, &buddy->stats, sizeof(buddy->stats));
+
+    for (order = 0; order <= buddy->max_order; order++) {
+        count = 0;
+        for (block = buddy->free_head[order]; block != BUDDY_NIL; block = BUDDY_LINKS(buddy, block)->next) {
+            count++;
+        }
+        ckpt_put_u32(w, count);
+        for (block = buddy->free_head[order]; block != BUDDY_NIL; block = BUDDY_LINKS(buddy, block)->next) {
+            ckpt_put_u32(w, block);
+        }
+    }
+}
+
+/*
+ * Maps a fresh arena and restores the free lists, in their original order, from
+ * a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            buddy: the allocator to set up, not yet initialized.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int buddy_load(/* in-out */ ckpt_reader_p r, /* out */ buddy_p buddy) {
+    uint64_t arena_size;
+    buddy_stats_s stats;
+    unsigned int order;
+    uint32_t * blocks;
+    uint32_t count;
+    uint32_t i;
+
+    ckpt_read(r, &arena_size, sizeof(arena_size));
+    ckpt_read(r, &stats, sizeof(stats));
+    if (!r->ok || !buddy_init(buddy, arena_size) || buddy->arena_size != arena_size) {
+        r->ok = 0;
+        return 0;
+    }
+
+    /* Start from nothing free, then push each list back to front to keep its order. */
+    buddy_unlink(buddy, 0, buddy->max_order);
+    buddy->free_bytes = 0;
+    for (order = 0; order <= buddy->max_order && r->ok; order++) {
+        count = ckpt_get_u32(r);
+        if (count > (1u << (buddy->max_order - order))) {
+            r->ok = 0;
+            break;
+        }
+        blocks = malloc((count + 1) * sizeof(uint32_t));
+        if (blocks == NULL) {
+            r->ok = 0;
+            break;
+        }
+        ckpt_read(r, blocks, count * sizeof(uint32_t));
+        for (i = count; i > 0 && r->ok; i--) {
+            if (blocks[i - 1] >= (1u << buddy->max_order)) {
+                r->ok = 0;
+                break;
+            }
+            buddy_push(buddy, blocks[i - 1], order);
+            buddy->free_bytes += (size_t) 1 << (BUDDY_MIN_ORDER + order);
+        }
+        free(blocks);
+    }
+    buddy->stats = stats;
+
+    return r->ok;
+}
@@ -0,0 +1,123 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "checkpoint.h"
+
+#define BUDDY_MIN_ORDER 12 /* smallest block, 4 KB */
+#define BUDDY_MAX_ORDERS 32
+#define BUDDY_NIL 0xFFFFFFFFu
+#define BUDDY_IN_USE 0xFF /* block_state of a min block that does not start a free block */
+
+/*
+ * Links of a free block, kept in the first bytes of the block itself.
+ * Blocks are named by their index in BUDDY_MIN_ORDER units.
+ */
+typedef struct buddy_links {
+    uint32_t next;
+    uint32_t prev;
+} buddy_links_s;
+
+typedef struct buddy_stats {
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long failures;    // allocations refused for lack of a large enough block
+    size_t requested_bytes;         // live bytes asked for
+    size_t allocated_bytes;         // live bytes handed out, after rounding to a power of two
+    unsigned long long latency_ns;  // total time spent in buddy_alloc
+    unsigned long long latency_max_ns;
+} buddy_stats_s;
+
+/*
+ * A binary buddy allocator over one mapped arena. Order k blocks are
+ * 2^(BUDDY_MIN_ORDER + k) bytes; the arena is a single block of max_order.
+ */
+typedef struct buddy {
+    unsigned char * arena;
+    size_t arena_size;
+    unsigned int max_order;
+    uint32_t free_head[BUDDY_MAX_ORDERS]; // first free block of each order, BUDDY_NIL if none
+    uint32_t nonempty;                    // bit k set when order k has a free block
+    unsigned char * block_state;          // per min block: order of the free block starting there, or BUDDY_IN_USE
+    size_t free_bytes;
+    buddy_stats_s stats;
+} buddy_s;
+
+typedef buddy_s * buddy_p;
+
+/*
+ * Maps an arena for the allocator. The mapping reserves no swap and pages are
+ * only backed when touched.
+ *
+ * Arguments: buddy: the allocator to set up.
+ *            arena_size: bytes of simulated memory, rounded down to a power of two.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int buddy_init(/* out */ buddy_p buddy, /* in */ size_t arena_size);
+
+/*
+ * Unmaps the arena. Outstanding blocks become invalid.
+ *
+ * Arguments: buddy: the allocator.
+ */
+void buddy_destroy(/* in-out */ buddy_p buddy);
+
+/*
+ * Allocates a block of at least size bytes.
+ *
+ * Arguments: buddy: the allocator.
+ *            size: bytes needed.
+ * Return: the block, NULL if no free block is large enough.
+ */
+unsigned char * buddy_alloc(/* in-out */ buddy_p buddy, /* in */ size_t size);
+
+/*
+ * Frees a block, merging it with its buddy as far as possible.
+ *
+ * Arguments: buddy: the allocator.
+ *            block: a block from buddy_alloc.
+ *            size: the size it was allocated with.
+ */
+void buddy_free(/* in-out */ buddy_p buddy, /* in */ unsigned char * block, /* in */ size_t size);
+
+/*
+ * Return: the size of the largest free block, 0 if memory is full.
+ */
+size_t buddy_largest_free(/* in */ buddy_p buddy);
+
+/*
+ * External fragmentation: the share of free memory that is not in the largest
+ * free block, so cannot serve the largest request that free space would allow.
+ *
+ * Return: a value between 0 and 1, 0 when there is no free memory.
+ */
+double buddy_fragmentation(/* in */ buddy_p buddy);
+
+/*
+ * Writes the allocator's free lists and statistics to a checkpoint. The arena
+ * contents are not saved; blocks are named by their index in the arena.
+ *
+ * Arguments: w: the checkpoint.
+ *            buddy: the allocator.
+ */
+void buddy_save(/* in-out */ ckpt_writer_p w, /* in */ buddy_p buddy);
+
+/*
+ * Maps a fresh arena and restores the free lists, in their original order, from
+ * a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            buddy: the allocator to set up, not yet initialized.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int buddy_load(/* in-out */ ckpt_reader_p r, /* out */ buddy_p buddy);
+
+#endif
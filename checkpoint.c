@@ -0,0 +1,168 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+/*
+ * Creates a checkpoint file, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ * Return: a new writer, NULL on failure.
+ */
+ckpt_writer_p ckpt_writer_open(/* in */ const char * path) {
+    ckpt_writer_p w = malloc(sizeof(ckpt_writer_s));
+
+    if (w != NULL) {
+        w->file = fopen(path, "wb");
+        w->ok = 1;
+        if (w->file == NULL) {
+            free(w);
+            w = NULL;
+        }
+    }
+
+    return w;
+}
+
+/*
+ * Appends raw bytes.
+ *
+ * Arguments: w: the writer.
+ *            data: the bytes to write.
+ *            len: how many.
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int ckpt_put(/* in-out */ ckpt_writer_p w, /* in */ const void * data, /* in */ size_t len) {
+    if (w->ok && len > 0 && fwrite(data, len, 1, w->file) != 1) {
+        w->ok = 0;
+    }
+    return w->ok;
+}
+
+/*
+ * Appends a 32 bit value.
+ *
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int ckpt_put_u32(/* in-out */ ckpt_writer_p w, /* in */ uint32_t value) {
+    return ckpt_put(w, &value, sizeof(value));
+}
+
+/*
+ * Flushes and closes the file and frees the writer.
+ *
+ * Arguments: w: the writer.
+ * Return: 1 if the whole checkpoint was written, 0 otherwise.
+ */
+int ckpt_writer_close(/* in-out */ ckpt_writer_p w) {
+    int ok = w->ok;
+
+    ok = (fclose(w->file) == 0) && ok;
+    free(w);
+    return ok;
+}
+
+/*
+ * Maps a checkpoint file for reading.
+ *
+ * Arguments: path: the file to read.
+ * Return: a new reader, NULL if the file could not be mapped.
+ */
+ckpt_reader_p ckpt_reader_open(/* in */ const char * path) {
+    struct stat st;
+    ckpt_reader_p r = malloc(sizeof(ckpt_reader_s));
+
+    if (r == NULL) {
+        return NULL;
+    }
+
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0 || fstat(r->fd, &st) != 0 || st.st_size == 0) {
+        if (r->fd >= 0) {
+            close(r->fd);
+        }
+        free(r);
+        return NULL;
+    }
+
+    r->len = st.st_size;
+    r->map = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, r->fd, 0);
+    if (r->map == MAP_FAILED) {
+        close(r->fd);
+        free(r);
+        return NULL;
+    }
+    madvise((void *) r->map, r->len, MADV_WILLNEED);
+    r->pos = 0;
+    r->ok = 1;
+
+    return r;
+}
+
+/*
+ * Copies the next bytes out of the checkpoint.
+ *
+ * Arguments: r: the reader.
+ *            data: where to copy to.
+ *            len: how many bytes.
+ * Return: 1 if every read so far succeeded, 0 otherwise (data is then zeroed).
+ */
+int ckpt_read(/* in-out */ ckpt_reader_p r, /* out */ void * data, /* in */ size_t len) {
+    if (!r->ok || len > r->len - r->pos) {
+        r->ok = 0;
+        memset(data, 0, len);
+        return 0;
+    }
+    memcpy(data, r->map + r->pos, len);
+    r->pos += len;
+    return 1;
+}
+
+/*
+ * Reads a 32 bit value.
+ *
+ * Return: the value, 0 after an error.
+ */
+uint32_t ckpt_get_u32(/* in-out */ ckpt_reader_p r) {
+    uint32_t value;
+
+    ckpt_read(r, &value, sizeof(value));
+    return value;
+}
+
+/*
+ * Reads a section tag and checks it is the expected one.
+ *
+ * Return: 1 if it matched and no error happened so far, 0 otherwise.
+ */
+int ckpt_expect(/* in-out */ ckpt_reader_p r, /* in */ enum ckpt_section section) {
+    if (ckpt_get_u32(r) != (uint32_t) section) {
+        r->ok = 0;
+    }
+    return r->ok;
+}
+
+/*
+ * Unmaps the checkpoint and frees the reader.
+ *
+ * Arguments: r: the reader.
+ * Return: 1 if every read succeeded, 0 otherwise.
+ */
+int ckpt_reader_close(/* in-out */ ckpt_reader_p r) {
+    int ok = r->ok;
+
+    munmap((void *) r->map, r->len);
+    close(r->fd);
+    free(r);
+    return ok;
+}
@@ -0,0 +1,136 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CKPT_MAGIC 0x504B4353 /* "SCKP" */
+#define CKPT_VERSION 12
+
+/*
+ * A checkpoint is a header followed by tagged sections in this order. Nothing
+ * in it is a pointer: processes are named by pid, frames, tables and blocks by
+ * index, and memory by its offset in the arena, so a file can be restored into
+ * any process.
+ */
+enum ckpt_section {
+    CKPT_GLOBALS = 0x5EC10001,
+    CKPT_PROC_TABLE,
+    CKPT_BUDDY, // before the pcbs, whose images point into the arena
+    CKPT_PCBS,
+    CKPT_QUEUES,
+    CKPT_LOCKS,
+    CKPT_SYNC,
+    CKPT_IPC,
+    CKPT_VMEM,
+    CKPT_END,
+};
+
+typedef struct ckpt_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t iteration;   // cpu iteration the checkpoint was taken at
+    uint32_t pcb_size;    // sizeof(PCB_s), the layout must match to restore
+    uint32_t priorities;  // NUM_PRIORITIES
+} ckpt_header_s;
+
+/* Sequential writer. Errors are sticky: after one failure every call fails. */
+typedef struct ckpt_writer {
+    FILE * file;
+    int ok;
+} ckpt_writer_s;
+
+typedef ckpt_writer_s * ckpt_writer_p;
+
+/* Sequential reader over a mapped checkpoint. Errors are sticky. */
+typedef struct ckpt_reader {
+    int fd;
+    const unsigned char * map;
+    size_t len;
+    size_t pos;
+    int ok;
+} ckpt_reader_s;
+
+typedef ckpt_reader_s * ckpt_reader_p;
+
+/*
+ * Creates a checkpoint file, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ * Return: a new writer, NULL on failure.
+ */
+ckpt_writer_p ckpt_writer_open(/* in */ const char * path);
+
+/*
+ * Appends raw bytes.
+ *
+ * Arguments: w: the writer.
+ *            data: the bytes to write.
+ *            len: how many.
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int ckpt_put(/* in-out */ ckpt_writer_p w, /* in */ const void * data, /* in */ size_t len);
+
+/*
+ * Appends a 32 bit value.
+ *
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int ckpt_put_u32(/* in-out */ ckpt_writer_p w, /* in */ uint32_t value);
+
+/*
+ * Flushes and closes the file and frees the writer.
+ *
+ * Arguments: w: the writer.
+ * Return: 1 if the whole checkpoint was written, 0 otherwise.
+ */
+int ckpt_writer_close(/* in-out */ ckpt_writer_p w);
+
+/*
+ * Maps a checkpoint file for reading.
+ *
+ * Arguments: path: the file to read.
+ * Return: a new reader, NULL if the file could not be mapped.
+ */
+ckpt_reader_p ckpt_reader_open(/* in */ const char * path);
+
+/*
+ * Copies the next bytes out of the checkpoint.
+ *
+ * Arguments: r: the reader.
+ *            data: where to copy to.
+ *            len: how many bytes.
+ * Return: 1 if every read so far succeeded, 0 otherwise (data is then zeroed).
+ */
+int ckpt_read(/* in-out */ ckpt_reader_p r, /* out */ void * data, /* in */ size_t len);
+
+/*
+ * Reads a 32 bit value.
+ *
+ * Return: the value, 0 after an error.
+ */
+uint32_t ckpt_get_u32(/* in-out */ ckpt_reader_p r);
+
+/*
+ * Reads a section tag and checks it is the expected one.
+ *
+ * Return: 1 if it matched and no error happened so far, 0 otherwise.
+ */
+int ckpt_expect(/* in-out */ ckpt_reader_p r, /* in */ enum ckpt_section section);
+
+/*
+ * Unmaps the checkpoint and frees the reader.
+ *
+ * Arguments: r: the reader.
+ * Return: 1 if every read succeeded, 0 otherwise.
+ */
+int ckpt_reader_close(/* in-out */ ckpt_reader_p r);
+
+#endif
@@ -32,9 +32,9 @@ int cond_variable_wait(Lock_p lock, c_Variable_p var, PCB_p running_process) {
     q_enqueue(var->queue, running_process); 
 }
 
-c_Variable_p cond_variable_constructor() {
+c_Variable_p cond_variable_constructor(proc_table_p table) {
     c_Variable_p c_var = malloc(sizeof(cond_variable_s));
-    c_var->queue = q_create();
+    c_var->queue = q_create(table);
     return c_var;
 }
 
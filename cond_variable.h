@@ -13,7 +13,7 @@ typedef cond_variable_s * c_Variable_p;
 
 int cond_variable_signal(c_Variable_p var, PCB_p running_process, Lock_p prod_cons_lock, PQ_p ready_queue);
 int cond_variable_wait(Lock_p lock, c_Variable_p var, PCB_p running_process);
-c_Variable_p cond_variable_constructor();
+c_Variable_p cond_variable_constructor(proc_table_p table);
 void c_var_destructor(c_Variable_p var);
 
 #endif
@@ -3,17 +3,20 @@
  * Dakota Crane, Dino Hadzic, Tyler Stinson
  */
 
+#include <fcntl.h>
+#include <math.h>
 #include <pthread.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "pcb.h"
-#include "fifo_queue.h"
-#include "priority_queue.h"
-#include "mutex_lock.h"
-#include "cond_variable.h"
+#include "cpu_loop.h"
+#include "checkpoint.h"
+#include "monte_carlo.h"
 
 /* The number of proccesses (minus one) to generate on initialization. */
 #define NUM_PROCESSES 40
@@ -23,77 +26,71 @@
 #define S_MULTIPLE 8
 #define MIN_NUM_BEFORE_TERM 1
 #define RANDOM_NUM_BEFORE_TERM 30
-#define MIN_MAX_PC_VAL 20 /* Faster than a quantum! */
-#define MAX_PC_MODULO 400 /* But can be much longer than a quantum! */
-#define NUM_IO_DEVICES 2
 #define IO_DELAY_BASE 10
 #define IO_DELAY_MOD 100
+#define IO_RING_BATCH 2 /* queued ring requests a process submits at once */
+#define LOCK_SPIN_MAX 40 /* -k adaptive: longest a MUTEX process spins on a held lock */
 #define TIMER_SLEEP 10000000
 
+/* Virtual memory. Every instruction fetch touches page pc >> VM_PAGE_SHIFT. */
+#define VM_NUM_FRAMES 2048
+#define VM_TLB_ENTRIES 64
+#define VM_PAGE_SHIFT 3 /* 8 instructions per page */
+#define VM_POLICY VM_CLOCK /* or VM_AGING */
+#define VM_AGING_INTERVAL 100 /* cycles between aging ticks */
+#define PAGE_FAULT_DELAY 40 /* cycles the paging device takes per fault */
+#define VM_WRITE_EVERY 16 /* every 16th instruction also stores to its page */
+
+/* Fork and copy-on-write costs, in cycles of kernel work. */
+#define FORK_GENERATIONS 3 /* forks of a forking process, and of its children in turn */
+#define FORK_COST 40
+#define FORK_PTES_PER_CYCLE 8 /* page table entries a fork shares per cycle */
+#define COW_FAULT_COST 4
+#define COW_COPY_COST 30 /* copying the page, on top of the fault */
+
+/*
+ * Context switch cost: every dispatch stalls the cpu for SWITCH_FIXED_COST cycles
+ * plus up to CACHE_REFILL_COST cycles to rewarm the cache. The refill share grows
+ * with the cycles since the incoming process last ran and with the number of
+ * other processes dispatched in between.
+ */
+#define SWITCH_FIXED_COST 2
+#define CACHE_REFILL_COST 20
+#define CACHE_DECAY_CYCLES 200.0 /* cache warmth falls to 1/e after this many cycles away */
+#define CACHE_DECAY_SWITCHES 3.0 /* ... or after this many other processes have run */
+
+/* Simulated physical memory that process images are allocated from. */
+#define PHYS_MEM_BYTES (64 * 1024 * 1024)
+
+/* Cycles between updates of the shared memory statistics page, when one is published (-p). */
+#define STATS_PUBLISH_INTERVAL 1000
+#define DUMP_PREFIX "sim_state" /* -d: where SIGUSR1 state dumps go */
+
 
 #define NUM_TYPE_PROCS 4
 #define MAX_IO_PROCS 50
 #define MAX_INTENSIVE_PROCS 25
 #define MAX_MUTEX_PROCS 50
+#define MAX_FORKED_PROCS 100 /* live children of forks, counted apart from the caps above */
+
+/* Group sizes of the generated READER/WRITER, SEM and BARRIER processes. */
+#define RW_GROUP_READERS 3 /* plus one writer */
+#define SEM_GROUP_PROCS 4
+#define SEM_UNITS 2
+#define BARRIER_PARTIES 3
+
+/* Pipes and mailboxes of the generated SENDER and RECEIVER processes. */
+#define MAX_IPC_PROCS 100
+#define IPC_PIPE_CAPACITY 8 /* messages */
+#define IPC_MAILBOX_CAPACITY 32
+#define IPC_MAILBOX_SENDERS 3 /* a mailbox has one receiver */
+#define IPC_MSG_BYTES 4096 /* payload of a message, passed by reference */
+#define IPC_TRAP_COST 6 /* kernel cycles for a send or receive ... */
+#define IPC_MSG_COST 1 /* ... and for each message it moves */
 
-#define MAX_PROD_CONS_PROC_PAIRS 10
 #define DEADLOCK_CHECK_THRESHOLD 10 //how many context switches before checking for deadlock
 #define CREATE_DEADLOCK_TRUE 1 // change to 1 if you want deadlock
 
-int count_io_procs = 0;
-int count_comp_procs = 0;
-int count_mutex_procs = 0;
-int count_terminated = 0;
-
-int count_prod_cons_procs = 0;
-int prod_cons_globals[10][2]; // second dimension index 0 is counter incremented, index 1 is flip
-
-c_Variable_p prod_cons_cond_vars[10][2]; // second dimension index 0 is fill, index 1 is empty
-Lock_p prod_cons_locks[10];
-
-int curr_prod_cons_id = 0;
-
-int io_total = 0;
-int intensive_total = 0;
-int mutex_total = 0;
-
-proc_map_list_p list_of_locks;
-int deadlock_check_counter = 0;
-int deadlock_flag = -1;
-
-
-proc_map_list_p list_of_locks;
-
-/* Mutexes */
-pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
-
-pthread_cond_t timer_cond = PTHREAD_COND_INITIALIZER;
-pthread_cond_t cpu_cond = PTHREAD_COND_INITIALIZER;
-
-
-// used when an io device needs to wait on either another io device or the timer itself
-// when a timer or io device finished their routine, this should run
-pthread_cond_t io_cond = PTHREAD_COND_INITIALIZER;
-
-pthread_cond_t io_trap_cond = PTHREAD_COND_INITIALIZER;
-pthread_cond_t io_cond_1 = PTHREAD_COND_INITIALIZER;
-pthread_cond_t io_cond_2 = PTHREAD_COND_INITIALIZER;
-
-pthread_mutex_t timer_init_lock = PTHREAD_COND_INITIALIZER;
-pthread_mutex_t io_init_lock = PTHREAD_MUTEX_INITIALIZER;
-
-unsigned int * one = 0;
-unsigned int * two = 0;
-
-
-int program_executing;
-int initialized_cond = 0;
-int initialized_io = 0;
-
-pthread_t timer_thread;
-pthread_t io_thread_1;
-pthread_t io_thread_2;
 
 /* enum for various process states. */
 enum interrupt_type {
@@ -104,58 +101,101 @@ enum interrupt_type {
     TRAP_IO,
     INTERRUPT_COUNT,
     TRAP_PROD_CONS,
+    TRAP_PAGE_FAULT,
+    TRAP_SYNC,
+    TRAP_IPC,
 };
 
 /* FUNCTIONS */
 
 /* Handles the main execution loop */
-int cpu();
+int cpu(sim_p sim);
 
 /********************
  * INTERRUPTS
  ****************/
 
 /* Interrupt that happens every quantum. */
-void pseudo_time_interrupt();
+void pseudo_time_interrupt(sim_p sim);
 /* Interrupt that happens for IO. */
-void *io_interrupt(unsigned int * io_device);
+void *io_interrupt(void * arg);
+/* Completes the blocking IO request of a process. */
+void io_complete(sim_p sim, unsigned int io_device, PCB_p done_pcb);
+/* Makes a process whose IO request completed ready. */
+void io_ready(sim_p sim, PCB_p done_pcb);
+/* Makes every process the IO threads completed ready, without scheduling. */
+unsigned int take_io_completions(sim_p sim, enum replay_event kind);
+/* Makes every process the IO threads completed ready and schedules. */
+void drain_io_completions(sim_p sim);
+/* Queues a request on a lockstep IO device. */
+void io_device_submit(sim_p sim, unsigned int io_device, PCB_p pcb, uint16_t tag, uint8_t async);
+/* Starts the next request of an idle lockstep IO device. */
+void io_device_start(sim_p sim, unsigned int io_device);
+/* Completes the request a lockstep IO device was serving. */
+void io_device_done(sim_p sim, unsigned int io_device);
 
 /***************
  * Interrupt controllers: Basically, returns 1/0 if the interrupt happens.
  **************/
 
 /* Timer "thread" that checks if execution count == quantum size */
-void *timer();
+void *timer(void * arg);
 /* IO "thread" that checks if the IO timer has hit 0. */
-int io_check(unsigned int io_device);
+int io_check(sim_p sim, unsigned int io_device);
+/* Paging device that moves a process back to ready when its page-in finishes. */
+void paging_check(sim_p sim);
+/* Steps the timer and IO devices of a lockstep simulation. */
+void step_devices(sim_p sim);
+/* Services a timer interrupt the timer thread raised. */
+void take_timer_interrupt(sim_p sim);
+/* Takes the next event of a replay if it is due now. */
+int replay_take(sim_p sim, enum replay_event kind, uint32_t * pid);
+/* Does what an IO thread did for a replayed completion. */
+void replay_io_done(sim_p sim, uint32_t pid);
 
 /*****************
  * TRAPS
  ***************/
 
 /* Trap for termination. */
-void trap_terminate();
+void trap_terminate(sim_p sim);
 /* Trap for IO */
-void trap_io(unsigned int io_device);
+void trap_io(sim_p sim, unsigned int io_device);
 /* Tests if the running process should call an IO trap. */
-int test_io_trap();
-
-
-void prod_cons_trap();
+int test_io_trap(sim_p sim);
+/* IO trap of a process that uses IO rings. */
+void trap_io_ring(sim_p sim, unsigned int io_device);
+/* Submits what the running process queued on its IO rings. */
+void io_ring_enter(sim_p sim, PCB_p pcb);
+/* Blocks the running process until few enough of its ring requests are in flight. */
+void io_ring_wait(sim_p sim, unsigned int wait_for);
+/* Waits for every ring request of the running process at the end of its pass. */
+int io_ring_sync(sim_p sim);
+/* Trap for page faults. */
+int trap_page_fault(sim_p sim);
+void trap_fork(sim_p sim);
+
+
+void prod_cons_trap(sim_p sim);
+/* Trap for READER, WRITER, SEM and BARRIER processes. */
+void sync_trap(sim_p sim);
+/* Trap for SENDER and RECEIVER processes. */
+void ipc_trap(sim_p sim);
 
 /******************
  * PROCESS HANDLING
  *****************/
 /* Schedules items based on the given interrupt type. */
-void scheduler(enum interrupt_type type);
+void scheduler(sim_p sim, enum interrupt_type type);
 /* Dispatches a new process to run. */
-void dispatcher();
+void dispatcher(sim_p sim);
 /* Resets priorities of all processes to 0. */
-void handle_priority_reset();
-
-void lock_thread_by_priority(enum interrupt_type type);
+void handle_priority_reset(sim_p sim);
+/* Computes the cycles a switch to the given process costs. */
+unsigned int switch_cost(sim_p sim, PCB_p pcb);
 
-int exists(unsigned int check, unsigned int arr[], int size, PCB_p proc);
+/* Finds the lock map of a mutex process. */
+proc_to_lock_map_p find_lock_map(sim_p sim, PCB_p pcb);
 
 
 /******************
@@ -163,112 +203,807 @@ int exists(unsigned int check, unsigned int arr[], int size, PCB_p proc);
  ***************/
 
  /* Allocates all system resoucres. */
-void initialize_system();
+int initialize_system(sim_p sim);
+/* Starts the timer and IO device threads. */
+void start_devices(sim_p sim);
 /* Builds a table of minimum cpu */
-void build_quantum_times();
+void build_quantum_times(sim_p sim);
+/* Feeds the tuner a cycle and lets it adjust the quanta and S. */
+void tune_step(sim_p sim);
+/* Sums the busy and switch cycles of every priority. */
+void count_busy_cycles(sim_p sim, unsigned long long * busy, unsigned long long * switching);
 /* Generates NUM_PROCESSES PCBs. */
-void generate_pcbs();
+void generate_pcbs(sim_p sim);
+/* Generates a single random process, if its type is below its cap. */
+void generate_process(sim_p sim);
+/* Creates a process (or a pair for MUTEX and PROD) and queues it as new. */
+PCB_p spawn_procs(sim_p sim, enum proc_type type, const trace_record_s * rec);
+/* Creates a group of processes sharing a reader-writer lock, semaphore or barrier. */
+PCB_p spawn_sync_group(sim_p sim, enum proc_type type, const trace_record_s * rec);
+PCB_p spawn_ipc_group(sim_p sim, enum ipc_kind kind, const trace_record_s * rec);
+/* Creates processes for every trace record that has arrived. */
+void replay_trace_arrivals(sim_p sim);
 /* Makes a single PCB. */
-PCB_p make_pcb();
-/* Tests a process for privileged status in the current simulation. */
-int is_privileged(PCB_p pcb);
+PCB_p make_pcb(sim_p sim, enum proc_type type);
 /* Monitors for deadlock */
-int deadlock_monitor();
+int deadlock_monitor(sim_p sim);
 /* Prints the current state of the queues. */
-void print_queue_state();
-/* Prints the privileged processes. */
-void print_privileged_processes();
+void print_queue_state(sim_p sim);
 /* Print things when an event happens. */
-void print_on_event();
+void print_on_event(sim_p sim);
+/* Prints the state of simulated physical memory. */
+void print_memory_state(sim_p sim);
 /* Deallocates all system resoucres. */
-void deallocate_system();
-
-int exists_in_range(unsigned int base, unsigned int bound, unsigned int check);
-
-/* GLOBALS */
-
-/* A queue of new processes. */
-FIFOq_p new_queue;
-/* A queue of processes that are ready to run. */
-PQ_p ready_queue;
-/* All the processes that are zombies. */
-FIFOq_p zombie_queue;
-/* Array of IO device queues. */
-FIFOq_p io_queues[NUM_IO_DEVICES];
-/* Array of IO timers. */
-unsigned int io_queue_timers[NUM_IO_DEVICES];
-
-/* The currently running process. */
-PCB_p running_process;
-/* An array of the amount of cycles alloted to each priority. */
-unsigned int quantum_times[NUM_PRIORITIES];
-/* The number of cycles since we last reset the prioties. */
-unsigned int cpu_cycles_since_reset;
-/* The number of cycles that we reset the priority at. */
-unsigned int S;
-/* Downcounter for the timer device */
-unsigned int timer_downcounter;
-/* The number of instructions since the cpu started. */
-unsigned int current_iteration;
-/* CPU PC. */
-unsigned int cpu_pc;
-/* PC at the top of the system stack. */
-unsigned int sys_stack;
-
-int contains(unsigned int arr[], unsigned int num, int size);
-void unlock_and_release_waiting_procs(Lock_p lock);
-void lock_trap(Lock_p lock);
+void deallocate_system(sim_p sim);
+/* Runs one cpu iteration. */
+void sim_cycle(sim_p sim);
+void publish_stats(sim_p sim);
+/* Takes every queue lock, in lock order, so nothing moves. */
+void sim_lock_all(sim_p sim);
+/* Releases what sim_lock_all took. */
+void sim_unlock_all(sim_p sim);
+/* Prints the lock contention report. */
+void sim_lock_report(sim_p sim);
+/* Prints what the reader-writer locks, semaphores and barriers did. */
+void sync_report(sim_p sim);
+void ipc_report(sim_p sim);
+/* Asks every simulation to dump its state, on SIGUSR1. */
+void request_dump(int signo);
+/* Writes the whole simulation state to a checkpoint file. */
+int checkpoint_save(sim_p sim, const char * path);
+/* Rebuilds the simulation state from a checkpoint file. */
+int checkpoint_restore(sim_p sim, const char * path);
+
+
+void unlock_and_release_waiting_procs(sim_p sim, Lock_p lock);
+void release_waiting_procs(sim_p sim, FIFOq_p q, unsigned int max);
+void lock_trap(sim_p sim, Lock_p lock);
+int lock_contended(sim_p sim, Lock_p lock);
+void lock_acquired(sim_p sim, Lock_p lock);
+void lock_inherit(sim_p sim, Lock_p lock);
+void lock_disinherit(sim_p sim, Lock_p lock);
+
+volatile sig_atomic_t dump_requests;
 
 /* Main loop. */
-int main(void) {
-    list_of_locks = proc_map_list_constructor();
+int main(int argc, char * argv[]) {
+    int opt;
+    char * end;
+    sim_options_s options = { 0 };
+    unsigned int runs = 0, threads = 0;
+    int i;
+    sim_p sim;
+    struct sigaction action = { 0 };
+
+    options.seed = time(NULL);
+    options.verbose = 1;
+    options.io_depth = 1;
+    workload_gen_defaults(&options.config);
+
+    while ((opt = getopt(argc, argv, "t:g:s:c:r:m:p:li:k:w:nd:e:E:a:")) != -1) {
+        switch (opt) {
+        case 't':
+            options.trace_path = optarg;
+            break;
+        case 'g':
+            if (!workload_gen_parse(&options.config, optarg)) {
+                fprintf(stderr, "bad generator spec %s\n", optarg);
+                return 1;
+            }
+            options.generator_spec = optarg;
+            break;
+        case 's':
+            options.seed = strtoull(optarg, NULL, 10);
+            options.seed_given = 1;
+            break;
+        case 'c':
+            options.checkpoint_iteration = strtoul(optarg, &end, 10);
+            if (*end != ':' || end[1] == '\0') {
+                fprintf(stderr, "bad checkpoint spec %s, expected iteration:file\n", optarg);
+                return 1;
+            }
+            options.checkpoint_path = end + 1;
+            break;
+        case 'r':
+            options.restore_path = optarg;
+            break;
+        case 'p':
+            options.stats_name = optarg;
+            break;
+        case 'l':
+            options.lockstep = 1;
+            break;
+        case 'i':
+            end = strchr(optarg, ':');
+            if (end != NULL) {
+                *end++ = '\0';
+                options.io_depth = strtoul(end, &end, 10);
+            }
+            if (!io_policy_parse(optarg, &options.io_policy) || options.io_depth < 1
+                || options.io_depth > DISK_MAX_DEPTH || (end != NULL && *end != '\0')) {
+                fprintf(stderr, "bad IO scheduling spec, expected fifo|scan|deadline|priority[:depth], depth 1 to %u\n", DISK_MAX_DEPTH);
+                return 1;
+            }
+            options.io_policy_given = 1;
+            break;
+        case 'k':
+            if (!lock_mode_parse(optarg, &options.lock_mode)) {
+                fprintf(stderr, "bad mutex mode %s, expected block|adaptive\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':
+            if (!rw_mode_parse(optarg, &options.rw_mode)) {
+                fprintf(stderr, "bad reader-writer mode %s, expected readers|writers|exclusive\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            options.no_inherit = 1;
+            break;
+        case 'd':
+            options.dump_prefix = optarg;
+            break;
+        case 'e':
+            options.record_path = optarg;
+            break;
+        case 'E':
+            options.replay_path = optarg;
+            break;
+        case 'a':
+            if (!tune_parse(optarg, &options.tune_goal, &options.tune_target)) {
+                fprintf(stderr, "bad tuning goal %s, expected latency=cycles|overhead=percent\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            runs = strtoul(optarg, &end, 10);
+            if (*end == ':')
+                threads = strtoul(end + 1, &end, 10);
+            if (runs == 0 || *end != '\0') {
+                fprintf(stderr, "bad run spec %s, expected runs[:threads]\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t workload.trace] [-g key=value,...] [-s seed] "
+                    "[-c iteration:checkpoint] [-r checkpoint] [-m runs[:threads]] [-p stats-name] [-l] [-i policy[:depth]] [-k block|adaptive] [-w readers|writers|exclusive] [-n] [-d dump-prefix] [-e record-log] [-E replay-log] "
+                    "[-a latency=cycles|overhead=percent]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    program_executing = 1;
-    
-    initialize_system();
-
-    while (program_executing) { 
-        if (pthread_mutex_trylock(&timer_lock) == 0) { {
-            program_executing = cpu();
-            current_iteration++;
-            if (current_iteration > TEST_ITERATIONS)
-                program_executing = 0;
-            pthread_mutex_unlock(&timer_lock);
+    /* kill -USR1 dumps the state of every running simulation. */
+    action.sa_handler = request_dump;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    /* Lockstep runs depend only on their seed; only device threads need a log. */
+    if ((options.record_path != NULL || options.replay_path != NULL) && (options.lockstep || runs > 0)) {
+        fprintf(stderr, "-e and -E need device threads, lockstep runs (-l, -m) are reproducible from their seed\n");
+        return 1;
+    }
+
+    /* Monte-Carlo: many quiet lockstep runs, seeds counting up from the given one. */
+    if (runs > 0) {
+        if (options.checkpoint_path != NULL || options.stats_name != NULL) {
+            fprintf(stderr, "-c and -p cannot be combined with -m\n");
+            return 1;
+        }
+        i = mc_run(&options, runs, threads);
+        PROF_REPORT();
+        return i ? 0 : 1;
+    }
+
+    /* Only lockstep devices model a disk; device threads serve their queue in order. */
+    if (options.io_policy_given && !options.lockstep) {
+        fprintf(stderr, "-i needs lockstep devices, -l or -m\n");
+        return 1;
+    }
+
+    sim = sim_create(&options);
+    if (sim == NULL)
+        return 1;
+
+    sim_run(sim);
+    sim_report(sim);
+    sim_destroy(sim);
+    PROF_REPORT();
+
+    return 0;
+}
+
+/*
+ * Creates a simulation and sets up its machine, either fresh or from a
+ * checkpoint. Nothing runs until sim_run.
+ *
+ * Arguments: options: how to set it up.
+ * Return: the new simulation, NULL if it could not be set up.
+ */
+sim_p sim_create(const sim_options_s * options) {
+    static const char * io_lock_names[] = { "io 0", "io 1", "io 2", "io 3", "io 4", "io 5", "io 6", "io 7" };
+    sim_p sim = calloc(1, sizeof(sim_s));
+    unsigned int i;
+
+    if (sim == NULL)
+        return NULL;
+
+    sim->seed = options->seed;
+    sim->seed_given = options->seed_given;
+    sim->generator.config = options->config;
+    sim->generator_spec = options->generator_spec;
+    sim->checkpoint_path = options->checkpoint_path;
+    sim->checkpoint_iteration = options->checkpoint_iteration;
+    sim->restore_path = options->restore_path;
+    sim->verbose = options->verbose;
+    sim->lockstep = options->lockstep;
+    sim->stats_name = options->stats_name;
+    sim->io_policy = options->io_policy;
+    sim->io_depth = options->io_depth;
+    sim->io_policy_given = options->io_policy_given;
+    sim->lock_mode = options->lock_mode;
+    sim->rw_mode = options->rw_mode;
+    sim->inherit = !options->no_inherit;
+    sim->dump_prefix = options->dump_prefix != NULL ? options->dump_prefix : DUMP_PREFIX;
+    sim->dumps_taken = dump_requests;
+    sim->tune_goal = options->tune_goal;
+    sim->tune_target = options->tune_target;
+    sim->deadlock_flag = -1;
+
+    slock_init(&sim->registry_lock, "registry", LOCK_RANK_REGISTRY);
+    slock_init(&sim->new_lock, "new", LOCK_RANK_NEW);
+    slock_init(&sim->ready_lock, "ready", LOCK_RANK_READY);
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        slock_init(&sim->io_locks[i], io_lock_names[i], LOCK_RANK_IO + i);
+        pthread_cond_init(&sim->io_conds[i], NULL);
+    }
+    slock_init(&sim->zombie_lock, "zombie", LOCK_RANK_ZOMBIE);
+    slock_init(&sim->table_lock, "table", LOCK_RANK_TABLE);
+    inbox_init(&sim->io_done);
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        ioq_init(&sim->io_requests[i]);
+        disk_init(&sim->disks[i], sim->io_policy, sim->io_depth);
+    }
+
+    pt_init(&sim->process_table, &sim->phys_mem);
+    /* IO device threads follow queue links while the cpu may add processes. */
+    if (!sim->lockstep)
+        sim->process_table.grow_lock = &sim->table_lock;
+    sim->list_of_locks = proc_map_list_constructor();
+
+    if (options->trace_path != NULL) {
+        sim->workload_trace = trace_reader_open(options->trace_path);
+        if (sim->workload_trace == NULL) {
+            fprintf(stderr, "could not open workload trace %s\n", options->trace_path);
+            sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    if (options->replay_path != NULL) {
+        sim->replay = replay_reader_open(options->replay_path);
+        if (sim->replay == NULL) {
+            fprintf(stderr, "could not open replay log %s\n", options->replay_path);
+            sim_destroy(sim);
+            return NULL;
+        }
+        /* The log's seed, or the run would not make the decisions it holds. */
+        sim->seed = sim->replay->seed;
+    }
+
+    if (options->record_path != NULL) {
+        sim->record = replay_writer_open(options->record_path, sim->seed);
+        if (sim->record == NULL) {
+            fprintf(stderr, "could not create replay log %s\n", options->record_path);
+            sim_destroy(sim);
+            return NULL;
         }
     }
-    pthread_join(timer_thread, NULL);
-    pthread_cond_signal(&io_cond_1);
-    pthread_cond_signal(&io_cond_2);
-    pthread_join(io_thread_1, NULL);
-    pthread_join(io_thread_2, NULL);
 
-    deallocate_system();
+    if (sim->stats_name != NULL) {
+        sim->stats = stats_create(sim->stats_name);
+        if (sim->stats == NULL) {
+            fprintf(stderr, "could not publish statistics in shared memory %s\n", sim->stats_name);
+            sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    if (sim->restore_path == NULL && !buddy_init(&sim->phys_mem, PHYS_MEM_BYTES)) {
+        fprintf(stderr, "could not map %u bytes of simulated memory\n", PHYS_MEM_BYTES);
+        sim_destroy(sim);
+        return NULL;
+    }
+
+    if (!initialize_system(sim)) {
+        sim_destroy(sim);
+        return NULL;
+    }
+
+    return sim;
+}
+
+/*
+ * Runs a simulation until its iteration limit. Unless it is lockstep or a
+ * replay, this starts the timer and IO device threads and waits for them to
+ * finish.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_run(sim_p sim) {
+    unsigned int i;
+
+    __atomic_store_n(&sim->program_executing, 1, __ATOMIC_RELAXED);
+
+    if (sim->lockstep || sim->replay != NULL) {
+        while (__atomic_load_n(&sim->program_executing, __ATOMIC_RELAXED))
+            sim_cycle(sim);
+        if (sim->replay != NULL && !sim->replay->ok)
+            fprintf(stderr, "replay log is damaged after %llu events\n", (unsigned long long) sim->replay->events);
+        else if (sim->replay != NULL && !sim->replay_diverged && sim->replay->kind != REPLAY_END)
+            fprintf(stderr, "the run ended before its replay log, after %llu events\n",
+                    (unsigned long long) sim->replay->events);
+        if (sim->stats != NULL)
+            publish_stats(sim);
+        return;
+    }
+
+    start_devices(sim);
+
+    while (__atomic_load_n(&sim->program_executing, __ATOMIC_RELAXED))
+        sim_cycle(sim);
+
+    pthread_join(sim->timer_thread, NULL);
+    /* Under the lock, so a device cannot miss the end between its check and its wait. */
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        slock_acquire(&sim->io_locks[i]);
+        pthread_cond_signal(&sim->io_conds[i]);
+        slock_release(&sim->io_locks[i]);
+    }
+    for (i = 0; i < NUM_IO_DEVICES; i++)
+        pthread_join(sim->io_threads[i], NULL);
+
+    if (sim->record != NULL) {
+        i = sim->record->events;
+        if (replay_writer_close(sim->record))
+            fprintf(stderr, "replay log: %u events recorded\n", i);
+        else
+            fprintf(stderr, "could not write the replay log\n");
+        sim->record = NULL;
+    }
+
+    if (sim->stats != NULL)
+        publish_stats(sim);
+}
+
+/*
+ * Runs one cpu iteration, with the devices first if they are lockstep, or a
+ * timer interrupt first if the timer thread raised one.
+ */
+void sim_cycle(sim_p sim) {
+    unsigned int completed = 0;
+    int executing;
+
+    if (sim->lockstep)
+        step_devices(sim);
+    else
+        take_timer_interrupt(sim);
+
+    executing = cpu(sim);
+    sim->current_iteration++;
+    if (sim->current_iteration > TEST_ITERATIONS || sim->replay_diverged)
+        executing = 0;
+    __atomic_store_n(&sim->program_executing, executing, __ATOMIC_RELAXED);
+
+    if (sim->tune_goal != TUNE_OFF)
+        tune_step(sim);
+
+    if (sim->stats != NULL && sim->current_iteration % STATS_PUBLISH_INTERVAL == 0)
+        publish_stats(sim);
+
+    if (sim->checkpoint_path != NULL && sim->current_iteration == sim->checkpoint_iteration) {
+        /* Pcbs in flight between an IO queue and the inbox are in neither; hold the devices and take them. */
+        sim_lock_all(sim);
+        completed = take_io_completions(sim, REPLAY_IO_CHECKPOINT);
+        if (checkpoint_save(sim, sim->checkpoint_path))
+            SIM_LOG(sim, "EVENT: Checkpoint written to %s at iteration %u\n", sim->checkpoint_path, sim->current_iteration);
+        else
+            fprintf(stderr, "could not write checkpoint %s\n", sim->checkpoint_path);
+        sim_unlock_all(sim);
+        if (completed > 0)
+            scheduler(sim, INT_IO);
+    }
+
+    if (sim->dumps_taken != dump_requests) {
+        sim->dumps_taken = dump_requests;
+        sim_lock_all(sim);
+        sim_dump_state(sim);
+        sim_unlock_all(sim);
+    }
+}
+
+/*
+ * Takes every queue lock, in lock order, so no device thread moves a process
+ * while the cpu looks at all of them at once.
+ */
+void sim_lock_all(sim_p sim) {
+    unsigned int i;
+
+    slock_acquire(&sim->registry_lock);
+    slock_acquire(&sim->new_lock);
+    slock_acquire(&sim->ready_lock);
+    for (i = 0; i < NUM_IO_DEVICES; i++)
+        slock_acquire(&sim->io_locks[i]);
+    slock_acquire(&sim->zombie_lock);
+}
+
+/* Releases what sim_lock_all took, in reverse. */
+void sim_unlock_all(sim_p sim) {
+    unsigned int i;
+
+    slock_release(&sim->zombie_lock);
+    for (i = NUM_IO_DEVICES; i-- > 0; )
+        slock_release(&sim->io_locks[i]);
+    slock_release(&sim->ready_lock);
+    slock_release(&sim->new_lock);
+    slock_release(&sim->registry_lock);
+}
+
+/*
+ * Copies the current state into the shared statistics page. Readers never
+ * block this; they retry when they catch it mid-update.
+ */
+void publish_stats(sim_p sim) {
+    stats_page_p page = sim->stats;
+    unsigned int i;
+
+    stats_write_begin(page);
+
+    page->finished = !__atomic_load_n(&sim->program_executing, __ATOMIC_RELAXED);
+    page->iteration = sim->current_iteration;
+    page->context_switches = sim->dispatch_count;
+    page->page_faults = sim->vm->stats.faults;
+    page->tlb_hits = sim->vm->stats.tlb_hits;
+    page->tlb_misses = sim->vm->stats.tlb_misses;
+
+    page->running_pid = sim->running_process != NULL ? sim->running_process->pid : PT_NO_PID;
+    page->running_priority = sim->running_process != NULL ? sim->running_process->priority : 0;
+    page->deadlock = sim->deadlock_flag != -1;
+    page->num_io_devices = NUM_IO_DEVICES;
+
+    for (i = 0; i < NUM_PRIORITIES; i++)
+        page->ready_depth[i] = sim->ready_queue->queues[i]->size;
+    for (i = 0; i < NUM_IO_DEVICES && i < STATS_MAX_IO_DEVICES; i++)
+        page->io_depth[i] = sim->io_queues[i]->size;
+    page->new_depth = sim->new_queue->size;
+    page->paging_depth = sim->paging_queue->size;
+    page->zombie_depth = sim->zombie_queue->size;
+
+    page->io_procs = sim->count_io_procs;
+    page->intensive_procs = sim->count_comp_procs;
+    page->mutex_procs = sim->count_mutex_procs;
+    page->prod_cons_pairs = sim->count_prod_cons_procs;
+    page->created = sim->io_total + sim->intensive_total + sim->mutex_total + (sim->count_prod_cons_procs*2) + sim->sync_total
+        + sim->forks + sim->ipc_total;
+    page->terminated = sim->count_terminated;
+
+    page->free_bytes = sim->phys_mem.free_bytes;
+    page->arena_bytes = sim->phys_mem.arena_size;
+
+    stats_write_end(page);
+}
 
-    proc_map_list_destructor(list_of_locks);
+/*
+ * Collects the outcome of a finished run.
+ *
+ * Arguments: sim: the simulation.
+ *            results: where to store it.
+ */
+void sim_results(sim_p sim, sim_results_s * results) {
+    unsigned long long total_busy = 0, total_switch = 0, io_busy = 0, io_depth = 0, reads = 0, shared_reads = 0;
     int k;
 
-    for (k = 0; k < 10; k++) {
-	if (prod_cons_locks[k] != NULL) {
-	    lock_destructor(prod_cons_locks[k]);
-	    c_var_destructor(prod_cons_cond_vars[k][0]);
-	    c_var_destructor(prod_cons_cond_vars[k][1]);
-	}
+    for (k = 0; k < NUM_PRIORITIES; k++) {
+        total_busy += sim->busy_cycles[k];
+        total_switch += sim->switch_cycles[k];
+    }
+
+    results->cycles = sim->current_iteration;
+    results->created = sim->io_total + sim->intensive_total + sim->mutex_total + (sim->count_prod_cons_procs*2) + sim->sync_total
+        + sim->forks + sim->ipc_total;
+    results->terminated = sim->count_terminated;
+    results->context_switches = sim->dispatch_count;
+    results->utilization = sim->current_iteration > 0 ? (double) total_busy / sim->current_iteration : 0.0;
+    results->switch_loss = total_busy > 0 ? (double) total_switch / total_busy : 0.0;
+    results->tlb_hit_rate = (double) sim->vm->stats.tlb_hits / (sim->vm->stats.tlb_hits + sim->vm->stats.tlb_misses + 1);
+    results->page_faults = sim->vm->stats.faults;
+    results->admission_stalls = sim->admission_stalls;
+    results->fragmentation = buddy_fragmentation(&sim->phys_mem);
+    results->deadlocked = sim->deadlock_flag != -1;
+
+    for (k = 0; k < NUM_IO_DEVICES; k++) {
+        io_busy += sim->io_busy_cycles[k];
+        io_depth += sim->disks[k].depth_sum;
     }
+    results->io_utilization = sim->current_iteration > 0 ? (double) io_busy / NUM_IO_DEVICES / sim->current_iteration : 0.0;
+    /* Threaded devices are not timed; only their completions are counted. */
+    results->io_completed = sim->lockstep ? sim->io_completed[0] + sim->io_completed[1] : sim->io_done.pushes;
+    results->io_latency = sim->io_completed[0] + sim->io_completed[1] > 0
+        ? (double) (sim->io_latency[0] + sim->io_latency[1]) / (sim->io_completed[0] + sim->io_completed[1]) : 0.0;
+    results->io_latency_p50 = lat_hist_percentile(&sim->io_latency_hist, 0.50);
+    results->io_latency_p95 = lat_hist_percentile(&sim->io_latency_hist, 0.95);
+    results->io_latency_p99 = lat_hist_percentile(&sim->io_latency_hist, 0.99);
+    results->io_queue_depth = sim->current_iteration > 0 ? (double) io_depth / NUM_IO_DEVICES / sim->current_iteration : 0.0;
+    results->io_instructions = sim->io_instructions;
+    results->lock_blocks = sim->lock_blocks;
+    results->spin_cycles = sim->spin_cycles;
+    results->spin_success = sim->spin_acquired + sim->spin_failed > 0
+        ? (double) sim->spin_acquired / (sim->spin_acquired + sim->spin_failed) : 0.0;
+
+    results->sync_blocks = sim->sync_blocks;
+    for (k = 0; k < (int) sim->count_rw_groups; k++) {
+        reads += sim->rw_locks[k]->reads;
+        shared_reads += sim->rw_locks[k]->shared_reads;
+    }
+    results->shared_reads = reads > 0 ? (double) shared_reads / reads : 0.0;
+    results->inversions = sim->inversions;
+    results->inversion_cycles = sim->inversions > 0 ? (double) sim->inversion_cycles / sim->inversions : 0.0;
+    results->inversion_max = sim->inversion_max;
+    results->forks = sim->forks;
+    results->cow_copies = sim->vm->stats.cow_copies;
+    results->ipc_messages = sim->ipc.received;
+    results->ipc_latency = sim->ipc.received > 0 ? (double) sim->ipc.latency / sim->ipc.received : 0.0;
+    results->ipc_latency_p99 = lat_hist_percentile(&sim->ipc.latency_hist, 0.99);
+}
+
+/*
+ * Prints the end of run report.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_report(sim_p sim) {
+    unsigned long long total_busy = 0, total_switch = 0;
+    int k;
 
-    if (deadlock_flag == -1) {
+    for (k = 0; k < NUM_PRIORITIES; k++) {
+        total_busy += sim->busy_cycles[k];
+        total_switch += sim->switch_cycles[k];
+        if (sim->busy_cycles[k] > 0)
+            printf("Priority %d: %llu cycles, %.2f%% lost to context switches\n",
+                   k, sim->busy_cycles[k], 100.0 * sim->switch_cycles[k] / sim->busy_cycles[k]);
+    }
+    printf("Context switches: %u, %.2f%% of busy cpu time lost to switching\n",
+           sim->dispatch_count, total_busy > 0 ? 100.0 * total_switch / total_busy : 0.0);
+    if (sim->tune_goal != TUNE_OFF && sim->tuner.first.quantum_0 > 0)
+        printf("Tuning toward %s %g: %u adjustments, quanta %u..%u -> %u..%u, S %u -> %u, "
+               "ready wait %.1f -> %.1f cycles, switching %.2f%% -> %.2f%%, demoted %.1f%% -> %.1f%%\n",
+               tune_goal_names[sim->tune_goal], sim->tune_target, sim->tuner.adjustments,
+               sim->tuner.first.quantum_0, sim->tuner.first.quantum_top,
+               sim->quantum_times[0], sim->quantum_times[NUM_PRIORITIES - 1], sim->tuner.first.S, sim->S,
+               sim->tuner.first.ready_wait, sim->tuner.last.ready_wait,
+               100.0 * sim->tuner.first.switch_loss, 100.0 * sim->tuner.last.switch_loss,
+               100.0 * sim->tuner.first.demotion_rate, 100.0 * sim->tuner.last.demotion_rate);
+    if (sim->workload_trace != NULL && sim->workload_trace->rejected > 0)
+        printf("Workload trace: %llu malformed records skipped\n", (unsigned long long) sim->workload_trace->rejected);
+    printf("TLB hits: %llu, misses: %llu (%.2f%% hit rate), page faults: %llu, evictions: %llu, frames in use: %u of %u\n",
+           sim->vm->stats.tlb_hits, sim->vm->stats.tlb_misses,
+           100.0 * sim->vm->stats.tlb_hits / (sim->vm->stats.tlb_hits + sim->vm->stats.tlb_misses + 1),
+           sim->vm->stats.faults, sim->vm->stats.evictions, vm_frames_in_use(sim->vm), sim->vm->num_frames);
+    printf("Memory: %llu allocations (%llu refused), %llu stalled admissions, mean allocation %.0f ns (max %llu ns), "
+           "external fragmentation %.1f%%\n",
+           sim->phys_mem.stats.allocs, sim->phys_mem.stats.failures, sim->admission_stalls,
+           (double) sim->phys_mem.stats.latency_ns / (sim->phys_mem.stats.allocs + sim->phys_mem.stats.failures + 1),
+           sim->phys_mem.stats.latency_max_ns, 100.0 * buddy_fragmentation(&sim->phys_mem));
+    printf("Process table: %u slots for %u processes created, %u still registered\n",
+           sim->process_table.used, sim->io_total + sim->intensive_total + sim->mutex_total + (sim->count_prod_cons_procs*2) + sim->sync_total + (unsigned int) sim->forks
+           + sim->ipc_total, sim->process_table.live);
+
+    if (sim->deadlock_flag == -1) {
         printf("Run finished. No deadlock occurred during run\n");
     } else {
         printf("Run finished. Deadlock occurred at least once\n");
     }
-    printf("Num IO processes: %i\n", io_total);
-    printf("Num intensive processes: %i\n", intensive_total);
-    printf("Num mutual resource processes: %i\n", mutex_total);
-    printf("Num prod/con processes: %i\n", count_prod_cons_procs* 2);
+    printf("Num IO processes: %i\n", sim->io_total);
+    printf("Num intensive processes: %i\n", sim->intensive_total);
+    printf("Num mutual resource processes: %i\n", sim->mutex_total);
+    printf("Num prod/con processes: %i\n", sim->count_prod_cons_procs* 2);
+    printf("Num sync processes: %i\n", sim->sync_total);
+    printf("Num forked processes: %llu\n", sim->forks);
+    printf("Num sender/receiver processes: %i\n", sim->ipc_total);
+
+    printf("Total number of processes created: %u\n", sim->io_total + sim->intensive_total + (sim->mutex_total * 2) + (sim->count_prod_cons_procs*2) + sim->sync_total + (unsigned int) sim->forks + sim->ipc_total);
+    printf("Total number of processes terminated:%u\n", sim->count_terminated);
+    printf("PCB bytes per process: IO %zu, intensive %zu, mutex %zu, prod/cons %zu (hot header %zu)\n",
+           PCB_footprint(IO), PCB_footprint(INTENSIVE), PCB_footprint(MUTEX), PCB_footprint(PROD), sizeof(PCB_s));
+    printf("Trap matching: %s\n", trap_match_isa);
+    printf("IO processes retired %llu instructions\n", sim->io_instructions);
+    /* A block costs the blocked process a switch out and one back in; a spin costs the cycles spun. */
+    printf("Mutexes (%s): %llu attempts found the lock held, %llu blocked; %llu spins, %llu got the lock (%.1f%%), "
+           "%llu cycles spun against %.1f cycles per context switch\n",
+           lock_mode_names[sim->lock_mode], sim->lock_contended, sim->lock_blocks,
+           sim->spin_acquired + sim->spin_failed, sim->spin_acquired,
+           sim->spin_acquired + sim->spin_failed > 0 ? 100.0 * sim->spin_acquired / (sim->spin_acquired + sim->spin_failed) : 0.0,
+           sim->spin_cycles, sim->dispatch_count > 0 ? (double) total_switch / sim->dispatch_count : 0.0);
+    printf("Priority inversions (inheritance %s): %llu, lasting %.1f cycles on average (max %u); %llu holders raised\n",
+           sim->inherit ? "on" : "off", sim->inversions,
+           sim->inversions > 0 ? (double) sim->inversion_cycles / sim->inversions : 0.0, sim->inversion_max, sim->inheritances);
+    printf("Forks: %llu (%llu refused), %llu pages shared, %.1f kernel cycles per fork, deepest generation %u; "
+           "copy-on-write faults: %llu pages copied, %llu reused, %.1f kernel cycles per fault\n",
+           sim->forks, sim->forks_refused, sim->fork_pages, sim->forks > 0 ? (double) sim->fork_cycles / sim->forks : 0.0,
+           sim->fork_depth, sim->vm->stats.cow_copies, sim->vm->stats.cow_reuses,
+           sim->vm->stats.cow_copies + sim->vm->stats.cow_reuses > 0
+           ? (double) sim->cow_cycles / (sim->vm->stats.cow_copies + sim->vm->stats.cow_reuses) : 0.0);
+    sync_report(sim);
+    ipc_report(sim);
+    if (sim->lockstep) {
+        for (k = 0; k < NUM_IO_DEVICES; k++)
+            printf("IO device %d (%s, depth %u): busy %.2f%% of cycles, %.2f requests per 1000 cycles, "
+                   "mean queue depth %.2f (max %u), mean seek %.0f sectors\n",
+                   k, io_policy_names[sim->disks[k].policy], sim->disks[k].depth,
+                   sim->current_iteration > 0 ? 100.0 * sim->io_busy_cycles[k] / sim->current_iteration : 0.0,
+                   sim->current_iteration > 0 ? 1000.0 * sim->disks[k].served / sim->current_iteration : 0.0,
+                   sim->current_iteration > 0 ? (double) sim->disks[k].depth_sum / sim->current_iteration : 0.0,
+                   sim->disks[k].max_depth,
+                   sim->disks[k].served > 0 ? (double) sim->disks[k].seek_sectors / sim->disks[k].served : 0.0);
+        printf("IO latency: p50 %u, p90 %u, p99 %u, max %u cycles\n",
+               lat_hist_percentile(&sim->io_latency_hist, 0.50), lat_hist_percentile(&sim->io_latency_hist, 0.90),
+               lat_hist_percentile(&sim->io_latency_hist, 0.99), sim->io_latency_hist.max);
+        printf("IO requests: %llu blocking (mean latency %.1f cycles), %llu asynchronous (mean latency %.1f cycles); "
+               "%llu submitted through rings, %llu ring waits\n",
+               sim->io_completed[0], sim->io_completed[0] > 0 ? (double) sim->io_latency[0] / sim->io_completed[0] : 0.0,
+               sim->io_completed[1], sim->io_completed[1] > 0 ? (double) sim->io_latency[1] / sim->io_completed[1] : 0.0,
+               sim->ring_submits, sim->ring_waits);
+    } else {
+        printf("IO completions: %llu, handed to the cpu in %llu batches\n", sim->io_done.pushes, sim->io_done.takes);
+        sim_lock_report(sim);
+    }
+}
+
+/*
+ * Prints what the reader-writer locks, semaphores and barriers did, one line
+ * for each kind there is a group of.
+ */
+void sync_report(sim_p sim) {
+    unsigned long long reads = 0, shared_reads = 0, writes = 0, read_blocks = 0, write_blocks = 0;
+    unsigned long long waits = 0, sem_blocks = 0, generations = 0;
+    unsigned int max_readers = 0, i;
+
+    for (i = 0; i < sim->count_rw_groups; i++) {
+        reads += sim->rw_locks[i]->reads;
+        shared_reads += sim->rw_locks[i]->shared_reads;
+        writes += sim->rw_locks[i]->writes;
+        read_blocks += sim->rw_locks[i]->read_blocks;
+        write_blocks += sim->rw_locks[i]->write_blocks;
+        if (sim->rw_locks[i]->max_readers > max_readers)
+            max_readers = sim->rw_locks[i]->max_readers;
+    }
+    for (i = 0; i < sim->count_sem_groups; i++) {
+        waits += sim->semaphores[i]->waits;
+        sem_blocks += sim->semaphores[i]->blocks;
+    }
+    for (i = 0; i < sim->count_barrier_groups; i++)
+        generations += sim->barriers[i]->generations;
+
+    if (sim->count_rw_groups > 0)
+        printf("Reader-writer locks (%u, mode %s): %llu reads, %llu (%.1f%%) alongside other readers, "
+               "up to %u readers at once; %llu writes; %llu reader and %llu writer blocks\n",
+               sim->count_rw_groups, rw_mode_names[sim->rw_mode], reads, shared_reads,
+               reads > 0 ? 100.0 * shared_reads / reads : 0.0, max_readers, writes, read_blocks, write_blocks);
+    if (sim->count_sem_groups > 0)
+        printf("Semaphores (%u, %u units each): %llu units taken, %llu blocks\n",
+               sim->count_sem_groups, SEM_UNITS, waits, sem_blocks);
+    if (sim->count_barrier_groups > 0)
+        printf("Barriers (%u, %u parties each): opened %llu times\n",
+               sim->count_barrier_groups, BARRIER_PARTIES, generations);
+}
+
+/*
+ * Prints what the pipes and mailboxes carried, if there are any.
+ */
+void ipc_report(sim_p sim) {
+    unsigned long long send_blocks = 0, receive_blocks = 0;
+    unsigned int counts[IPC_KIND_COUNT] = { 0 }, i;
+
+    if (sim->ipc.count == 0)
+        return;
+    for (i = 0; i < sim->ipc.count; i++) {
+        counts[sim->ipc.channels[i]->kind]++;
+        send_blocks += sim->ipc.channels[i]->send_blocks;
+        receive_blocks += sim->ipc.channels[i]->receive_blocks;
+    }
+    printf("IPC (%u pipes, %u mailboxes, batches of %u): %llu messages, %llu KB passed by reference; "
+           "latency mean %.1f, p50 %u, p99 %u, max %u cycles; %llu sender and %llu receiver blocks; "
+           "%.1f kernel cycles per message\n",
+           counts[IPC_PIPE], counts[IPC_MAILBOX], sim->generator.config.ipc_batch, sim->ipc.received,
+           sim->ipc.bytes / 1024, sim->ipc.received > 0 ? (double) sim->ipc.latency / sim->ipc.received : 0.0,
+           lat_hist_percentile(&sim->ipc.latency_hist, 0.50), lat_hist_percentile(&sim->ipc.latency_hist, 0.99),
+           sim->ipc.latency_hist.max, send_blocks, receive_blocks,
+           sim->ipc.received > 0 ? (double) sim->ipc_cycles / sim->ipc.received : 0.0);
+}
+
+/*
+ * Prints how often each lock was taken and waited for, in lock order.
+ */
+void sim_lock_report(sim_p sim) {
+    sim_lock_p locks[LOCK_RANK_COUNT];
+    unsigned int n = 0, i;
+
+    locks[n++] = &sim->registry_lock;
+    locks[n++] = &sim->new_lock;
+    locks[n++] = &sim->ready_lock;
+    for (i = 0; i < NUM_IO_DEVICES; i++)
+        locks[n++] = &sim->io_locks[i];
+    locks[n++] = &sim->zombie_lock;
+    locks[n++] = &sim->table_lock;
+    slock_report(stdout, locks, n);
+}
+
+/*
+ * Frees a simulation and every process still in it.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_destroy(sim_p sim) {
+    uint32_t i;
+    int k;
+
+    if (sim->ready_queue != NULL)
+        deallocate_system(sim);
+
+    proc_map_list_destructor(sim->list_of_locks);
+
+    for (k = 0; k < MAX_PROD_CONS_PROC_PAIRS; k++) {
+	if (sim->prod_cons_locks[k] != NULL) {
+	    lock_destructor(sim->prod_cons_locks[k]);
+	    c_var_destructor(sim->prod_cons_cond_vars[k][0]);
+	    c_var_destructor(sim->prod_cons_cond_vars[k][1]);
+	}
+    }
+
+    for (k = 0; k < MAX_SYNC_GROUPS; k++) {
+        if (sim->rw_locks[k] != NULL)
+            rw_lock_destroy(sim->rw_locks[k]);
+        if (sim->semaphores[k] != NULL)
+            semaphore_destroy(sim->semaphores[k]);
+        if (sim->barriers[k] != NULL)
+            barrier_destroy(sim->barriers[k]);
+    }
+
+    ipc_destroy(&sim->ipc);
+    free(sim->dump_writer);
+    if (sim->record != NULL)
+        replay_writer_close(sim->record);
+    if (sim->replay != NULL)
+        replay_reader_close(sim->replay);
+
+    /* Processes that were in no queue, e.g. blocked on a prod/cons lock. */
+    for (i = 0; i < sim->process_table.used; i++) {
+        if (PT_SLOT(&sim->process_table, i).pcb != NULL)
+            PCB_destroy(&sim->process_table, PT_SLOT(&sim->process_table, i).pcb);
+    }
 
-    printf("Total number of processes created: %u\n", io_total + intensive_total + (mutex_total * 2) + (count_prod_cons_procs*2));
-    printf("Total number of processes terminated:%u\n", count_terminated);
+    if (sim->vm != NULL)
+        vm_destroy(sim->vm);
+    buddy_destroy(&sim->phys_mem);
+    pt_destroy(&sim->process_table);
 
-    return program_executing;
+    if (sim->stats != NULL)
+        stats_close(sim->stats, sim->stats_name);
+
+    if (sim->workload_trace != NULL)
+        trace_reader_close(sim->workload_trace);
+
+    slock_destroy(&sim->registry_lock);
+    slock_destroy(&sim->new_lock);
+    slock_destroy(&sim->ready_lock);
+    for (k = 0; k < NUM_IO_DEVICES; k++) {
+        slock_destroy(&sim->io_locks[k]);
+        pthread_cond_destroy(&sim->io_conds[k]);
+    }
+    slock_destroy(&sim->zombie_lock);
+    slock_destroy(&sim->table_lock);
+    free(sim);
 }
 
 /*
@@ -276,26 +1011,79 @@ int main(void) {
  *
  * Generates PCBs, 'runs' the program, then interrupts via the timer interrupt.
  */
-int cpu() {
+int cpu(sim_p sim) {
+    PROF_SCOPE(PROF_CPU);
     int i;
+    unsigned int traps;
+    enum vm_result access;
     /* Count of CPU instructions since last call to S. */
-    cpu_cycles_since_reset++;
+    sim->cpu_cycles_since_reset++;
+
+    /* Admit replayed or generated processes as they arrive. */
+    if (sim->workload_trace != NULL) {
+        replay_trace_arrivals(sim);
+    } else {
+        i = workload_gen_arrivals(&sim->generator, sim->current_iteration);
+        while (i-- > 0)
+            generate_process(sim);
+    }
+
+    paging_check(sim);
+    vm_tick(sim->vm);
+    if (!sim->lockstep)
+        drain_io_completions(sim);
+
+    if (sim->running_process != NULL) {
+        sim->busy_cycles[sim->running_process->priority]++;
+        /* Still paying for the context switch: no instruction runs this cycle. */
+        if (sim->switch_stall > 0) {
+            sim->switch_stall--;
+            sim->switch_cycles[sim->running_process->priority]++;
+            return 1;
+        }
+        /* Waiting on the kernel, for a fork or a page copy. */
+        if (sim->kernel_stall > 0) {
+            sim->kernel_stall--;
+            return 1;
+        }
+        sim->running_process->last_ran = sim->current_iteration;
+        if (sim->running_process->proc_type == IO)
+            sim->io_instructions++;
+    }
 
     /* Increase the cpu_pc variable to simulate execution. */
-    if (running_process != NULL) {
+    if (sim->running_process != NULL) {
         /* Increase PC: */
         /* We increase these by one; the proc's PC will reflect the one-increment-per-instruction
          * when the proc's PC is updated during context switching */
 
-        cpu_pc += 1;
-        if (cpu_pc > running_process->max_pc) {
-            cpu_pc = 0;
-            running_process->term_count++;
+        sim->cpu_pc += 1;
+        if (sim->cpu_pc > sim->running_process->max_pc) {
+            sim->cpu_pc = 0;
+            sim->running_process->term_count++;
+        }
+
+        /*
+         * Fetch the instruction, which may store to its page. A page fault
+         * blocks the process and ends the cycle; a store to a page shared
+         * with a fork relative costs kernel time for the copy.
+         */
+        access = vm_access(sim->vm, sim->running_process, sim->cpu_pc >> VM_PAGE_SHIFT,
+                           sim->cpu_pc % VM_WRITE_EVERY == VM_WRITE_EVERY - 1);
+        if (access == VM_FAULT && trap_page_fault(sim)) {
+            return 1;
+        }
+        if (access == VM_COW_FAULT) {
+            i = COW_FAULT_COST;
+            if (vm_cow_fault(sim->vm, sim->running_process, sim->cpu_pc >> VM_PAGE_SHIFT))
+                i += COW_COPY_COST;
+            sim->kernel_stall += i;
+            sim->cow_cycles += i;
         }
 
-	if (deadlock_check_counter >= DEADLOCK_CHECK_THRESHOLD) {
-	    deadlock_monitor();
-	    deadlock_check_counter = 0;
+	if (sim->deadlock_check_counter >= DEADLOCK_CHECK_THRESHOLD) {
+	    deadlock_monitor(sim);
+	    sim->deadlock_check_counter = 0;
 	}
 
     }
@@ -303,164 +1091,198 @@ int cpu() {
     // consider different kinds of procs!
 
     /* IO TRAP: Check for IO trap */
-    if (running_process != NULL) {
-	switch (running_process->proc_type) {
+    if (sim->running_process != NULL) {
+	switch (sim->running_process->proc_type) {
 	case INTENSIVE: 
 	    break;
 	case MUTEX:
-	    if (contains(running_process->lock_1, cpu_pc, 4) == 1) {
-		proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
+	    traps = trap_match(PCB_MUTEX(sim->running_process)->traps, MUTEX_TRAP_GROUPS, sim->cpu_pc);
+	    if (traps & TRAP_BIT(MUTEX_TRAP_LOCK_1)) {
+		proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
 		PCB_p lockedproc = map->lock_1->current_proc;
 		if (lockedproc != NULL) {
-		    printf("lock 1 has process before lock attempt = %u, running procces=%u\n", lockedproc->pid, running_process->pid);
+		    SIM_LOG(sim, "lock 1 has process before lock attempt = %u, running procces=%u\n", lockedproc->pid, sim->running_process->pid);
 		}
 		//if (lockedproc != NULL)
 		    //printf("lock 1 has process pid=%u, running proc pid=%u\n", lockedproc->pid, running_process->pid);
-		int attempt = lock(map->lock_1, running_process);
+		if (lockedproc != NULL && lock_contended(sim, map->lock_1))
+		    break;
+		int attempt = lock(map->lock_1, sim->running_process);
 		if (attempt == 0) {
+		    lock_acquired(sim, map->lock_1);
 	    	    //printf("LOCK 1 proc pid: %u - pc: %u \n", running_process->pid, cpu_pc);
-	    	    printf("PID %u: requested lock on mutex 1 - succeeded\n", running_process->pid);
+	    	    SIM_LOG(sim, "PID %u: requested lock on mutex 1 - succeeded\n", sim->running_process->pid);
 		} else {
 		    //printf("sleeping lock 1, pid %u\n", running_process->pid);
-		    printf("PID %u: requested lock on mutex 1 - blocked by PID %u\n", running_process->pid, lockedproc->pid);
+		    SIM_LOG(sim, "PID %u: requested lock on mutex 1 - blocked by PID %u\n", sim->running_process->pid, lockedproc->pid);
 		    
-		    lock_trap(map->lock_1);
+		    lock_trap(sim, map->lock_1);
 		}
-	    } else if (contains(running_process->lock_2, cpu_pc, 4) == 1) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_LOCK_2)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
 		PCB_p lockedproc = map->lock_2->current_proc;
-	    	int attempt = lock(map->lock_2, running_process);
+		if (lockedproc != NULL && lock_contended(sim, map->lock_2))
+		    break;
+	    	int attempt = lock(map->lock_2, sim->running_process);
 	    	if (attempt == 0) {
-	    	    printf("PID %u: requested lock on mutex 2 - succeeded\n", running_process->pid);
+		    lock_acquired(sim, map->lock_2);
+	    	    SIM_LOG(sim, "PID %u: requested lock on mutex 2 - succeeded\n", sim->running_process->pid);
 	    	} else {
-		    printf("PID %u: requested lock on mutex 2 - blocked by PID %u\n", running_process->pid, lockedproc->pid);
-	    	    lock_trap(map->lock_2);
+		    SIM_LOG(sim, "PID %u: requested lock on mutex 2 - blocked by PID %u\n", sim->running_process->pid, lockedproc->pid);
+	    	    lock_trap(sim, map->lock_2);
 	    	}
-	    } else if (contains(running_process->unlock_1, cpu_pc, 4) == 1) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	if (map->proc != NULL && map->proc == running_process) {
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_UNLOCK_1)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	if (map->proc != NULL && map->proc == sim->running_process) {
+	    	    lock_note_released(map->lock_1, sim->current_iteration);
 	    	    release_lock(map->lock_1);
-	    	    unlock_and_release_waiting_procs(map->lock_1);
-	    	    printf("UNLOCK 1 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    unlock_and_release_waiting_procs(sim, map->lock_1);
+	    	    SIM_LOG(sim, "UNLOCK 1 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("this shouldn't happen 1\n");
+	    	    SIM_LOG(sim, "this shouldn't happen 1\n");
 	    	}
-	    } else if (contains(running_process->unlock_2, cpu_pc, 4) == 1) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	if (map->proc != NULL && map->proc == running_process) {
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_UNLOCK_2)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	if (map->proc != NULL && map->proc == sim->running_process) {
+	    	    lock_note_released(map->lock_2, sim->current_iteration);
 	    	    release_lock(map->lock_2);
-	    	    unlock_and_release_waiting_procs(map->lock_2);
-	    	    printf("UNLOCK 2 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    unlock_and_release_waiting_procs(sim, map->lock_2);
+	    	    SIM_LOG(sim, "UNLOCK 2 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("this shouldn't happen 2\n");
+	    	    SIM_LOG(sim, "this shouldn't happen 2\n");
 	    	}
-	    } else if (contains(running_process->trylock_1, cpu_pc, 4)) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	int attempt = try_lock(map->lock_1, running_process);
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_TRYLOCK_1)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	int attempt = try_lock(map->lock_1, sim->running_process);
 	    	if (attempt == 0) {
-	    	    printf("TRY LOCK 1 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    lock_note_acquired(map->lock_1, sim->current_iteration);
+	    	    SIM_LOG(sim, "TRY LOCK 1 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("FAILED TRY LOCK 1 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    SIM_LOG(sim, "FAILED TRY LOCK 1 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 		}
-	    } else if (contains(running_process->trylock_2, cpu_pc, 4)) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	int attempt = try_lock(map->lock_2, running_process);
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_TRYLOCK_2)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	int attempt = try_lock(map->lock_2, sim->running_process);
 	    	if (attempt == 0) {
-	    	    printf("TRY LOCK 2 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    lock_note_acquired(map->lock_2, sim->current_iteration);
+	    	    SIM_LOG(sim, "TRY LOCK 2 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("FAILED TRY LOCK 2 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    SIM_LOG(sim, "FAILED TRY LOCK 2 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 		}
-	    } else if (contains(running_process->try_unlock_1, cpu_pc, 4)) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	if (map->proc == running_process) {
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_TRY_UNLOCK_1)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	if (map->proc == sim->running_process) {
+	    	    lock_note_released(map->lock_1, sim->current_iteration);
 	    	    release_lock(map->lock_1);
-	    	    unlock_and_release_waiting_procs(map->lock_1);
-	    	    printf("TRY UNLOCK 1 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    unlock_and_release_waiting_procs(sim, map->lock_1);
+	    	    SIM_LOG(sim, "TRY UNLOCK 1 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("this shouldn't happen 1\n");
+	    	    SIM_LOG(sim, "this shouldn't happen 1\n");
 	    	}
 
-	    } else if (contains(running_process->try_unlock_2, cpu_pc, 4)) {
-	    	proc_to_lock_map_p map = search_list_for_pcb(list_of_locks, running_process);
-	    	if (map->proc == running_process) {
+	    } else if (traps & TRAP_BIT(MUTEX_TRAP_TRY_UNLOCK_2)) {
+	    	proc_to_lock_map_p map = find_lock_map(sim, sim->running_process);
+	    	if (map->proc == sim->running_process) {
+	    	    lock_note_released(map->lock_2, sim->current_iteration);
 	    	    release_lock(map->lock_2);
-	    	    unlock_and_release_waiting_procs(map->lock_2);
-	    	    printf("TRY UNLOCK 2 proc pid  - %u - pc: %u \n", running_process->pid, cpu_pc);
+	    	    unlock_and_release_waiting_procs(sim, map->lock_2);
+	    	    SIM_LOG(sim, "TRY UNLOCK 2 proc pid  - %u - pc: %u \n", sim->running_process->pid, sim->cpu_pc);
 	    	} else {
-	    	    printf("this shouldn't happen 2\n");
+	    	    SIM_LOG(sim, "this shouldn't happen 2\n");
 	    	}
 	    }
         break;
+	case READER:
+	case WRITER:
+	case SEM:
+	case BARRIER:
+	    sync_trap(sim);
+	    break;
+	case SENDER:
+	case RECEIVER:
+	    ipc_trap(sim);
+	    break;
 	case PROD:
-	    if (running_process != NULL && running_process->proc_type == PROD) {
-		if (contains(running_process->prod_cons_lock, cpu_pc + 1, 4) == 1) {
-		    int check = lock(prod_cons_locks[running_process->prod_cons_id], running_process); 
+	    if (sim->running_process != NULL && sim->running_process->proc_type == PROD) {
+		if (trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc + 1)) {
+		    int check = lock(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id], sim->running_process); 
 		    if (check == 1) {
-			lock_trap(NULL);
+			lock_trap(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
 			break;
 		    }
 		    
-		} else if (running_process != NULL && contains(running_process->prod_cons_lock, cpu_pc, 4) == 1) {
+		} else if (sim->running_process != NULL && trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc)) {
 		    
-		    if (prod_cons_globals[running_process->prod_cons_id][1] == 1) {
-			cond_variable_wait(prod_cons_locks[running_process->prod_cons_id], 
-					   prod_cons_cond_vars[running_process->prod_cons_id][1], running_process); // wait for the read
-			printf("PID %u requested condition wait on cond %u with mutex %u\n", running_process->pid, 
-				running_process->prod_cons_id, running_process->prod_cons_id);
-			unlock_and_release_waiting_procs(prod_cons_locks[running_process->prod_cons_id]);
-			prod_cons_trap();
+		    if (sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1] == 1) {
+			cond_variable_wait(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id], 
+					   sim->prod_cons_cond_vars[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1], sim->running_process); // wait for the read
+			SIM_LOG(sim, "PID %u requested condition wait on cond %u with mutex %u\n", sim->running_process->pid, 
+				PCB_PROD_CONS(sim->running_process)->prod_cons_id, PCB_PROD_CONS(sim->running_process)->prod_cons_id);
+			unlock_and_release_waiting_procs(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
+			prod_cons_trap(sim);
 		    } else {
-			prod_cons_globals[running_process->prod_cons_id][0] += 1;
-			prod_cons_globals[running_process->prod_cons_id][1] = 1;
-			cond_variable_signal(prod_cons_cond_vars[running_process->prod_cons_id][0], running_process,
-					     prod_cons_locks[running_process->prod_cons_id], ready_queue); // signal that it was incremented
-			printf("PID %u sent signal on cond %u\n", running_process->pid, running_process->prod_cons_id);
+			sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][0] += 1;
+			sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1] = 1;
+			slock_acquire(&sim->ready_lock);
+			cond_variable_signal(sim->prod_cons_cond_vars[PCB_PROD_CONS(sim->running_process)->prod_cons_id][0], sim->running_process,
+					     sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id], sim->ready_queue); // signal that it was incremented
+			slock_release(&sim->ready_lock);
+			SIM_LOG(sim, "PID %u sent signal on cond %u\n", sim->running_process->pid, PCB_PROD_CONS(sim->running_process)->prod_cons_id);
 			
-			printf("Producer pid %u incremented variable: %i \n", running_process->pid,
-			       prod_cons_globals[running_process->prod_cons_id][0]);
+			SIM_LOG(sim, "Producer pid %u incremented variable: %i \n", sim->running_process->pid,
+			       sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][0]);
 		    }
 		    
-		} else if (contains(running_process->prod_cons_lock, cpu_pc - 1, 4) == 1) {
-		    release_lock(prod_cons_locks[running_process->prod_cons_id]);
-		    unlock_and_release_waiting_procs(prod_cons_locks[running_process->prod_cons_id]);
+		} else if (trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc - 1)) {
+		    release_lock(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
+		    unlock_and_release_waiting_procs(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
 		}
 	    }
 	case CONS:
-	    if (running_process != NULL && running_process->proc_type == CONS) {
-		if (contains(running_process->prod_cons_lock, cpu_pc + 1, 4) == 1) {
-		    int check = lock(prod_cons_locks[running_process->prod_cons_id], running_process); 
+	    if (sim->running_process != NULL && sim->running_process->proc_type == CONS) {
+		if (trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc + 1)) {
+		    int check = lock(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id], sim->running_process); 
 		    if (check == 1) {
-			lock_trap(NULL);
+			lock_trap(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
 			break;
 		    }
 		    
-		} else if (running_process != NULL && contains(running_process->prod_cons_lock, cpu_pc, 4) == 1) {
-		    if (prod_cons_globals[running_process->prod_cons_id][1] == 0) {
-			cond_variable_wait(prod_cons_locks[running_process->prod_cons_id],
-					   prod_cons_cond_vars[running_process->prod_cons_id][0], running_process); // wait for the increment
-			printf("PID %u requested condition wait on cond %u with mutex %u\n", running_process->pid, 
-				running_process->prod_cons_id, running_process->prod_cons_id);
-			unlock_and_release_waiting_procs(prod_cons_locks[running_process->prod_cons_id]);
-			prod_cons_trap();
+		} else if (sim->running_process != NULL && trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc)) {
+		    if (sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1] == 0) {
+			cond_variable_wait(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id],
+					   sim->prod_cons_cond_vars[PCB_PROD_CONS(sim->running_process)->prod_cons_id][0], sim->running_process); // wait for the increment
+			SIM_LOG(sim, "PID %u requested condition wait on cond %u with mutex %u\n", sim->running_process->pid, 
+				PCB_PROD_CONS(sim->running_process)->prod_cons_id, PCB_PROD_CONS(sim->running_process)->prod_cons_id);
+			unlock_and_release_waiting_procs(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
+			prod_cons_trap(sim);
 		    } else {
-			printf("Consumer pid %u read variable: %i \n", running_process->pid, 
-			       prod_cons_globals[running_process->prod_cons_id][0]);
-			prod_cons_globals[running_process->prod_cons_id][1] = 0;
-			cond_variable_signal(prod_cons_cond_vars[running_process->prod_cons_id][1], running_process, 
-					     prod_cons_locks[running_process->prod_cons_id], ready_queue); // signal that it was read 
-			printf("PID %u sent signal on cond %u\n", running_process->pid, running_process->prod_cons_id);
+			SIM_LOG(sim, "Consumer pid %u read variable: %i \n", sim->running_process->pid, 
+			       sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][0]);
+			sim->prod_cons_globals[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1] = 0;
+			slock_acquire(&sim->ready_lock);
+			cond_variable_signal(sim->prod_cons_cond_vars[PCB_PROD_CONS(sim->running_process)->prod_cons_id][1], sim->running_process, 
+					     sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id], sim->ready_queue); // signal that it was read 
+			slock_release(&sim->ready_lock);
+			SIM_LOG(sim, "PID %u sent signal on cond %u\n", sim->running_process->pid, PCB_PROD_CONS(sim->running_process)->prod_cons_id);
 		    }
-		} else if (contains(running_process->prod_cons_lock, cpu_pc - 1, 4) == 1) {
-		    release_lock(prod_cons_locks[running_process->prod_cons_id]);
-		    unlock_and_release_waiting_procs(prod_cons_locks[running_process->prod_cons_id]);
+		} else if (trap_match(PCB_PROD_CONS(sim->running_process)->prod_cons_lock, 1, sim->cpu_pc - 1)) {
+		    release_lock(sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
+		    unlock_and_release_waiting_procs(sim, sim->prod_cons_locks[PCB_PROD_CONS(sim->running_process)->prod_cons_id]);
 		}
 	    }
 	case IO:
-	    i = test_io_trap();
+	    /* A process using IO rings waits for all its requests at the end of every pass. */
+	    if (sim->cpu_pc == 0 && sim->running_process != NULL && sim->running_process->proc_type == IO
+	        && PCB_IO_RING(sim->running_process)->enabled && io_ring_sync(sim))
+	    	break;
+	    i = test_io_trap(sim);
 	    if (i) {
 	    	i--;
-	    	printf("EVENT: IO Trap Called for PID %u on IO Device %u\n", running_process->pid, i);
-	    	trap_io(i);
+	    	SIM_LOG(sim, "EVENT: IO Trap Called for PID %u on IO Device %u\n", sim->running_process->pid, i);
+	    	if (sim->running_process->proc_type == IO && PCB_IO_RING(sim->running_process)->enabled)
+	    	    trap_io_ring(sim, i);
+	    	else
+	    	    trap_io(sim, i);
 	    }
 	    break;
 	default:
@@ -468,634 +1290,1262 @@ int cpu() {
 	}
     }
 
+    /* FORK TRAP: a forking process forks at the end of each pass it carries on past. */
+    if (sim->running_process != NULL && sim->cpu_pc == 0 && sim->running_process->forks_left > 0
+        && (sim->running_process->terminate == 0 || sim->running_process->term_count < sim->running_process->terminate)) {
+        trap_fork(sim);
+    }
+
     /* TERMINATE TRAP: If the process has been running too long, zombify. */
-    if (running_process != NULL && running_process->terminate != 0 && running_process->term_count >= running_process->terminate) {
-        printf("EVENT: Terminate Trap Called for PID %u\n", running_process->pid);
-        print_on_event();
-        trap_terminate();
+    if (sim->running_process != NULL && sim->running_process->terminate != 0 && sim->running_process->term_count >= sim->running_process->terminate) {
+        SIM_LOG(sim, "EVENT: Terminate Trap Called for PID %u\n", sim->running_process->pid);
+        print_on_event(sim);
+        trap_terminate(sim);
     }
 
     /*
      * Idle process
      */
-    if (running_process == NULL) {
-        scheduler(INT_NEW);
+    if (sim->running_process == NULL) {
+        scheduler(sim, INT_NEW);
     }
 
     return 1;
 }
 
-int contains(unsigned int arr[], unsigned int num, int arr_size) {
-    int i;
-    for (i = 0; i < 4; i++) {
-	if (arr[i] == num) {
-	    return 1;
-	}
-    }
-    return 0;
-}
-
 /*
  * Pseudo-Time Interrupt Service Routine.
  * Interrupts the running process, then calls the scheduler.
  */
-void pseudo_time_interrupt() {
+void pseudo_time_interrupt(sim_p sim) {
     /* If the process isn't halted, set it to interrupted. */
-    if (running_process != NULL && running_process->state != STATE_HALT) {
-        PCB_assign_state(running_process, STATE_INT);
-        running_process->context->pc = cpu_pc;
+    if (sim->running_process != NULL && sim->running_process->state != STATE_HALT) {
+        PCB_assign_state(sim->running_process, STATE_INT);
+        sim->running_process->pc = sim->cpu_pc;
     }
 
     /* Call scheduler. */
-    scheduler(INT_TIME);
+    scheduler(sim, INT_TIME);
 }
 
 /*
  * Interrupt that happens for IO.
  */
-void *io_interrupt(unsigned int * io_device) {
-    for (;;) {
+void *io_interrupt(void * arg) {
+    sim_device_s * device = arg;
+    sim_p sim = device->sim;
+    unsigned int io_device = device->id;
+    PCB_p done_pcb;
+    /* Only the service time jitter; each device has its own stream. */
+    sim_rng_s jitter;
+    rng_seed(&jitter, sim->seed + io_device + 1);
 
-        PCB_p done_pcb;
+    for (;;) {
 
-	pthread_mutex_lock(&io_lock);
-        if (program_executing == 0 && q_is_empty(io_queues[*io_device])) {
-	    pthread_mutex_unlock(&io_lock);
+	slock_acquire(&sim->io_locks[io_device]);
+        if (!__atomic_load_n(&sim->program_executing, __ATOMIC_RELAXED) && q_is_empty(sim->io_queues[io_device])) {
+	    slock_release(&sim->io_locks[io_device]);
 	    break;
 	}
 
         
-        if (q_is_empty(io_queues[*io_device])) {
-	    //pthread_cond_wait(&io_cond, &io_lock);
-            if (*io_device == 0) {
-                pthread_cond_wait(&io_cond_1, &io_lock);
-            } else {
-                pthread_cond_wait(&io_cond_2, &io_lock);
-            }
+        if (q_is_empty(sim->io_queues[io_device])) {
+            pthread_cond_wait(&sim->io_conds[io_device], &sim->io_locks[io_device].mutex);
         } else {
+            /* Service the request without holding up the cpu queueing more. */
             struct timespec s;
-            s.tv_nsec = (rand() % 1000) + 1;
-            nanosleep(NULL, &s);
+            s.tv_sec = 0;
+            s.tv_nsec = rng_below(&jitter, 1000) + 1;
+            slock_release(&sim->io_locks[io_device]);
+            nanosleep(&s, NULL);
+            slock_acquire(&sim->io_locks[io_device]);
         }
 
-	// mutex global thread lock
-        pthread_mutex_lock(&timer_lock);
-
-	// lock
-	// raise flag
-	pthread_mutex_lock(&io_init_lock);
-	initialized_io = 1;
-	pthread_mutex_unlock(&io_init_lock);
-	// unlock
-
-	// service on wake up
-	done_pcb = q_dequeue(io_queues[*io_device]);
-	if (done_pcb != NULL) {
-	    /* Increment its PC by 1 to prevent it from going back into IO immediately. */
-	    done_pcb->context->pc++;
-	    PCB_assign_state(done_pcb, STATE_READY);
-	    pq_enqueue(ready_queue, done_pcb);
-
-	    printf("PID %u ready\n", done_pcb->pid);
-	    scheduler(INT_IO);
-	}
-
-	// lock
-	// lower flag
-	// unlock
-	pthread_mutex_lock(&io_init_lock);
-	initialized_io = 0;
-	pthread_mutex_unlock(&io_init_lock);
-
-
-	// release thread mutex
-        pthread_mutex_unlock(&timer_lock);
-
-	// release IO specific mutex
-	pthread_mutex_unlock(&io_lock);
-
-	// signal to io
-	pthread_cond_signal(&io_cond);
-
-	// signal to standard thread!
-	// pthread_cond_signal(&timer_cond);
-
+	// service on wake up: the cpu makes it ready at its next cycle
+	slock_acquire(&sim->table_lock);
+	done_pcb = q_dequeue(sim->io_queues[io_device]);
+	slock_release(&sim->table_lock);
+	slock_release(&sim->io_locks[io_device]);
 
+	if (done_pcb != NULL)
+	    inbox_push(&sim->io_done, done_pcb);
     }
+    return NULL;
 }
 
 /*
- * Determines whether it is time to fire the time interrupt or not.
+ * Completes the blocking request of a process waiting in an IO device queue,
+ * for lockstep devices, which need not serve the queue in order.
  */
-void *timer() {
-    for (;;){
-        struct timespec timersleep;
-        timersleep.tv_nsec = TIMER_SLEEP;
-        nanosleep(0, &timersleep);
-
-        pthread_mutex_lock(&timer_init_lock);
-        initialized_cond = 1;
-        pthread_mutex_unlock(&timer_init_lock);
-
-        pthread_mutex_lock(&timer_lock);
-        
-        //set flag to denote timer has started
+void io_complete(sim_p sim, unsigned int io_device, PCB_p done_pcb) {
+    if (done_pcb != NULL && q_remove(sim->io_queues[io_device], done_pcb)) {
+        io_ready(sim, done_pcb);
+        scheduler(sim, INT_IO);
+    }
+}
 
-        printf("EVENT: Timer Interrupt\n");
-        print_on_event();
+/* Makes a process whose IO request completed ready. */
+void io_ready(sim_p sim, PCB_p done_pcb) {
+    /* Increment its PC by 1 to prevent it from going back into IO immediately. */
+    done_pcb->pc++;
+    PCB_assign_state(done_pcb, STATE_READY);
+    slock_acquire(&sim->ready_lock);
+    pq_enqueue(sim->ready_queue, done_pcb);
+    slock_release(&sim->ready_lock);
 
-        pseudo_time_interrupt();
-        
-        //unset flag
+    SIM_LOG(sim, "PID %u ready\n", done_pcb->pid);
+}
 
-        pthread_mutex_lock(&timer_init_lock);
-        initialized_cond = 0;
-        pthread_mutex_unlock(&timer_init_lock);
+/*
+ * Makes every process the IO threads completed since the last call ready, in
+ * completion order. A replay first completes what the log says the threads
+ * had by this point; a recording logs what was taken.
+ *
+ * Arguments: kind: where the cpu takes them, for the log.
+ * Returns how many there were.
+ */
+unsigned int take_io_completions(sim_p sim, enum replay_event kind) {
+    PCB_p done_pcb, next;
+    unsigned int count = 0;
+    uint32_t pid;
+
+    if (sim->replay != NULL)
+        while (replay_take(sim, kind, &pid))
+            replay_io_done(sim, pid);
+
+    for (done_pcb = inbox_take(&sim->io_done); done_pcb != NULL; done_pcb = next) {
+        next = done_pcb->inbox_next;
+        done_pcb->inbox_next = NULL;
+        if (sim->record != NULL)
+            replay_write(sim->record, kind, sim->current_iteration, done_pcb->pid);
+        io_ready(sim, done_pcb);
+        count++;
+    }
+    return count;
+}
 
+/*
+ * Makes every process the IO threads completed ready, then runs the scheduler
+ * once for all of them. The common nothing-completed case is one load.
+ */
+void drain_io_completions(sim_p sim) {
+    if ((sim->replay != NULL || !inbox_is_empty(&sim->io_done)) && take_io_completions(sim, REPLAY_IO) > 0)
+        scheduler(sim, INT_IO);
+}
 
-        pthread_mutex_unlock(&timer_lock);
+/*
+ * Queues a request on a lockstep IO device, the same way for blocking traps
+ * and ring requests, and starts it if the device is idle.
+ *
+ * Arguments: pcb: the process the request is for.
+ *            tag: its ring tag, 0 for a blocking trap.
+ *            async: 1 if it came through the process's rings.
+ */
+void io_device_submit(sim_p sim, unsigned int io_device, PCB_p pcb, uint16_t tag, uint8_t async) {
+    io_request_s request;
+
+    request.handle = pt_handle_of(&sim->process_table, pcb);
+    request.submitted = sim->current_iteration;
+    request.sector = disk_sector(pcb->pid, &sim->generator.rng);
+    request.tag = tag;
+    request.async = async;
+    request.priority = pcb->priority;
+
+    if (!ioq_push(&sim->io_requests[io_device], &request))
+        fprintf(stderr, "out of memory queueing an IO request for PID %u\n", pcb->pid);
+    io_device_start(sim, io_device);
+}
 
-        pthread_cond_broadcast(&timer_cond); // broadcast to io dev
+/*
+ * Starts the next request of a lockstep IO device, if it is idle and has one;
+ * its downcounter runs for the request's service time.
+ */
+void io_device_start(sim_p sim, unsigned int io_device) {
+    uint32_t cycles = disk_start(&sim->disks[io_device], &sim->io_requests[io_device],
+                                 sim->current_iteration, &sim->generator.rng);
 
-        if (program_executing == 0) break;
-        
-    }
+    if (cycles > 0)
+        sim->io_queue_timers[io_device] = cycles;
 }
 
-/* IO "thread" that checks if the IO timer has hit 0. */
-int io_check(unsigned int io_device) {
-    if (!q_is_empty(io_queues[io_device])) {
-        io_queue_timers[io_device]--;
-        if (io_queue_timers[io_device] == 0)
-            return 1;
+/*
+ * Completes the request a lockstep IO device was serving. A blocking request
+ * readies its process; a ring request posts a completion, and only wakes its
+ * process if it is waiting for it.
+ */
+void io_device_done(sim_p sim, unsigned int io_device) {
+    io_request_s request;
+    io_ring_p ring;
+    PCB_p pcb;
+    uint32_t latency;
+
+    disk_finish(&sim->disks[io_device], &request);
+    latency = sim->current_iteration - request.submitted;
+    sim->io_completed[request.async]++;
+    sim->io_latency[request.async] += latency;
+    lat_hist_add(&sim->io_latency_hist, latency);
+
+    /* A process never ends with requests in flight, but a stale handle is dropped. */
+    pcb = pt_lookup(&sim->process_table, request.handle);
+    if (!request.async) {
+        io_complete(sim, io_device, pcb);
+        return;
+    }
+    if (pcb == NULL)
+        return;
+    ring = PCB_IO_RING(pcb);
+    io_ring_complete(ring, request.tag, io_device, latency);
+    SIM_LOG(sim, "PID %u: IO request %u on device %u completed\n", pcb->pid, request.tag, io_device);
+
+    if (ring->waiting && ring->in_flight <= ring->wait_for) {
+        ring->waiting = 0;
+        PCB_assign_state(pcb, STATE_READY);
+        slock_acquire(&sim->ready_lock);
+        pq_enqueue(sim->ready_queue, pcb);
+        slock_release(&sim->ready_lock);
+        SIM_LOG(sim, "PID %u ready\n", pcb->pid);
+        scheduler(sim, INT_IO);
     }
-    return 0;
 }
 
 /*
- * IO Trap
- * Pre: The running_process must not be NULL.
+ * Timer thread: raises a timer interrupt every TIMER_SLEEP nanoseconds. The
+ * cpu services it at the start of its next cycle, so the timer takes no lock.
  */
-void trap_io(unsigned int io_device) {
-
-    // critical section
-    // io/timer cannot actually happen in this section as the lock is acquired at this point
-    
-    running_process->state = STATE_BLOCKED;
-    q_enqueue(io_queues[io_device], running_process);
-    io_queue_timers[io_device] = quantum_times[running_process->priority] + IO_DELAY_BASE + rand() % IO_DELAY_MOD;
-    running_process->context->pc = cpu_pc;
-    running_process = NULL;
-    print_on_event();
-
-    // after this section check if another thread should take over
-    //lock_thread_by_priority(TRAP_IO);
-    printf("%d the io device # \n", io_device);
+void *timer(void * arg) {
+    sim_p sim = arg;
+    struct timespec timersleep = { 0, TIMER_SLEEP };
 
-    scheduler(TRAP_IO);
-
-    if (io_device == 0) {
-        pthread_cond_signal(&io_cond_1);
-    } else {
-        pthread_cond_signal(&io_cond_2);
+    while (__atomic_load_n(&sim->program_executing, __ATOMIC_RELAXED)) {
+        nanosleep(&timersleep, NULL);
+        __atomic_store_n(&sim->timer_pending, 1, __ATOMIC_RELAXED);
     }
+    return NULL;
 }
 
 /*
- * Tests if the running process should call an IO trap.
- * Returns 1 if IO set 1, 2 if IO set 2.
+ * Services a timer interrupt the timer thread raised, or the log says it had;
+ * the common case is one load.
  */
-int test_io_trap() {
-    int i;
-    if (running_process != NULL) {
-        for (i = 0; i < NUM_IO_TRAPS; i++) {
-            if (running_process->io_1_traps[i] == cpu_pc) {
-                return 1;
-            } else if (running_process->io_2_traps[i] == cpu_pc) {
-                return 2;
-	    }
-        }
+void take_timer_interrupt(sim_p sim) {
+    if (sim->replay != NULL ? replay_take(sim, REPLAY_TIMER, NULL)
+        : __atomic_load_n(&sim->timer_pending, __ATOMIC_RELAXED)
+          && __atomic_exchange_n(&sim->timer_pending, 0, __ATOMIC_RELAXED)) {
+        if (sim->record != NULL)
+            replay_write(sim->record, REPLAY_TIMER, sim->current_iteration, 0);
+        SIM_LOG(sim, "EVENT: Timer Interrupt\n");
+        print_on_event(sim);
+        pseudo_time_interrupt(sim);
     }
-    return 0;
 }
 
-
 /*
- * Trap for termination.
- * Pre: The running_process must not be NULL.
+ * Takes the next event of a replay if it is of the given kind and due at
+ * this iteration. An event the run has gone past means it no longer follows
+ * the log, and it is stopped.
+ *
+ * Arguments: kind: the event the caller is at.
+ *            pid: where to store the process of an IO event, may be NULL.
+ * Return: 1 if an event was taken, 0 otherwise.
  */
-void trap_terminate() {
-    
-    switch (running_process->proc_type) { 
+int replay_take(sim_p sim, enum replay_event kind, uint32_t * pid) {
+    replay_reader_p r = sim->replay;
+
+    if (r->kind == REPLAY_END || sim->replay_diverged)
+        return 0;
+    if (r->iteration < sim->current_iteration) {
+        fprintf(stderr, "replay diverged from its log at iteration %u, event %llu\n",
+                sim->current_iteration, (unsigned long long) r->events);
+        sim->replay_diverged = 1;
+        return 0;
+    }
+    if (r->iteration > sim->current_iteration || r->kind != kind)
+        return 0;
+    if (pid != NULL)
+        *pid = r->pid;
+    replay_reader_next(r);
+    return 1;
+}
+
+/*
+ * Does what an IO thread did for a completion in the log: takes the process
+ * off its device queue and pushes it to the inbox. A replay has no device
+ * threads, so the queue locks are not needed, and may be held already.
+ */
+void replay_io_done(sim_p sim, uint32_t pid) {
+    PCB_p pcb = pt_lookup_pid(&sim->process_table, pid);
+    unsigned int i;
+
+    for (i = 0; pcb != NULL && i < NUM_IO_DEVICES; i++) {
+        if (q_remove(sim->io_queues[i], pcb)) {
+            inbox_push(&sim->io_done, pcb);
+            return;
+        }
+    }
+    fprintf(stderr, "replay diverged from its log at iteration %u: PID %u is not waiting for IO\n",
+            sim->current_iteration, pid);
+    sim->replay_diverged = 1;
+}
+
+/* IO "thread" that checks if the IO timer has hit 0. */
+int io_check(sim_p sim, unsigned int io_device) {
+    if (sim->disks[io_device].busy) {
+        sim->io_queue_timers[io_device]--;
+        if (sim->io_queue_timers[io_device] == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Paging device that moves a process back to ready when its page-in finishes. */
+void paging_check(sim_p sim) {
+    PCB_p paged;
+
+    if (!q_is_empty(sim->paging_queue) && --sim->paging_timer == 0) {
+        paged = q_dequeue(sim->paging_queue);
+        PCB_assign_state(paged, STATE_READY);
+        slock_acquire(&sim->ready_lock);
+        pq_enqueue(sim->ready_queue, paged);
+        slock_release(&sim->ready_lock);
+        sim->paging_timer = PAGE_FAULT_DELAY;
+    }
+}
+
+/*
+ * Lockstep devices, stepped once per cpu iteration instead of running on their
+ * own threads, so a run depends only on its seed. The timer interrupts the
+ * running process when its quantum is used up; an IO device completes the
+ * request it is serving when its downcounter reaches zero and starts the next.
+ */
+void step_devices(sim_p sim) {
+    unsigned int i;
+
+    /* The quantum starts once the context switch has been paid for. */
+    if (sim->running_process != NULL && sim->switch_stall == 0
+        && sim->timer_downcounter > 0 && --sim->timer_downcounter == 0) {
+        SIM_LOG(sim, "EVENT: Timer Interrupt\n");
+        print_on_event(sim);
+        pseudo_time_interrupt(sim);
+    }
+
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        disk_tick(&sim->disks[i], &sim->io_requests[i]);
+        if (sim->disks[i].busy)
+            sim->io_busy_cycles[i]++;
+        if (io_check(sim, i)) {
+            io_device_done(sim, i);
+            io_device_start(sim, i);
+        }
+    }
+}
+
+/*
+ * IO Trap
+ * Pre: The running_process must not be NULL.
+ */
+void trap_io(sim_p sim, unsigned int io_device) {
+
+    sim->running_process->state = STATE_BLOCKED;
+    slock_acquire(&sim->io_locks[io_device]);
+    q_enqueue(sim->io_queues[io_device], sim->running_process);
+    pthread_cond_signal(&sim->io_conds[io_device]);
+    slock_release(&sim->io_locks[io_device]);
+    if (sim->lockstep)
+        io_device_submit(sim, io_device, sim->running_process, 0, 0);
+    else
+        sim->io_queue_timers[io_device] = sim->quantum_times[sim->running_process->priority] + IO_DELAY_BASE + rng_below(&sim->generator.rng, IO_DELAY_MOD);
+    sim->running_process->pc = sim->cpu_pc;
+    sim->running_process = NULL;
+    print_on_event(sim);
+
+    SIM_LOG(sim, "%d the io device # \n", io_device);
+
+    scheduler(sim, TRAP_IO);
+}
+
+/*
+ * Page fault trap. The page is mapped at once, evicting another if memory is
+ * full, and the process waits in the paging queue while the page "loads".
+ * Pre: The running_process must not be NULL.
+ * Returns 1 if the process was blocked, 0 if the page could not be mapped.
+ */
+int trap_page_fault(sim_p sim) {
+    if (vm_fault_in(sim->vm, sim->running_process, sim->cpu_pc >> VM_PAGE_SHIFT) == VM_NO_FRAME) {
+        SIM_LOG(sim, "EVENT: No memory for page tables of PID %u\n", sim->running_process->pid);
+        return 0;
+    }
+
+    sim->running_process->state = STATE_BLOCKED;
+    /* Back up so the faulting instruction runs again once the page is in. */
+    sim->running_process->pc = sim->cpu_pc - 1;
+    if (q_is_empty(sim->paging_queue))
+        sim->paging_timer = PAGE_FAULT_DELAY;
+    q_enqueue(sim->paging_queue, sim->running_process);
+    sim->running_process = NULL;
+
+    scheduler(sim, TRAP_PAGE_FAULT);
+    return 1;
+}
+
+/*
+ * Fork trap. The running process is cloned and the clone shares its pages
+ * copy-on-write; the clone is made ready and the parent carries on once the
+ * kernel has shared its page tables. Both fork again at their next pass ends
+ * while forks_left lasts, so a process grows a tree of 2^FORK_GENERATIONS.
+ * Pre: The running_process must not be NULL and must be IO or INTENSIVE.
+ */
+void trap_fork(sim_p sim) {
+    PCB_p parent = sim->running_process;
+    PCB_p child;
+    uint32_t shared;
+
+    parent->forks_left--;
+    parent->pc = sim->cpu_pc;
+    if (sim->count_forked_procs >= MAX_FORKED_PROCS) {
+        sim->forks_refused++;
+        return;
+    }
+
+    child = PCB_fork(&sim->process_table, parent);
+    if (child == NULL) {
+        sim->forks_refused++;
+        return;
+    }
+    shared = vm_fork(sim->vm, parent, child);
+    if (shared == VM_NO_FRAME) {
+        SIM_LOG(sim, "EVENT: No memory for page tables of a child of PID %u\n", parent->pid);
+        vm_release(sim->vm, child);
+        PCB_destroy(&sim->process_table, child);
+        sim->forks_refused++;
+        return;
+    }
+
+    sim->count_forked_procs++;
+    sim->forks++;
+    sim->fork_pages += shared;
+    PCB_COLD(parent)->children++;
+    if (PCB_COLD(child)->generation > sim->fork_depth)
+        sim->fork_depth = PCB_COLD(child)->generation;
+    SIM_LOG(sim, "EVENT: PID %u forked PID %u, sharing %u pages\n", parent->pid, child->pid, shared);
+
+    slock_acquire(&sim->ready_lock);
+    pq_enqueue(sim->ready_queue, child);
+    slock_release(&sim->ready_lock);
+
+    sim->kernel_stall += FORK_COST + shared / FORK_PTES_PER_CYCLE;
+    sim->fork_cycles += FORK_COST + shared / FORK_PTES_PER_CYCLE;
+}
+
+/*
+ * Tests if the running process should call an IO trap.
+ * Returns 1 if IO set 1, 2 if IO set 2.
+ */
+int test_io_trap(sim_p sim) {
+    unsigned int traps;
+    /* Only IO and prod/cons pcbs carry traps; the case above may have dispatched another type. */
+    if (sim->running_process != NULL && (sim->running_process->proc_type == IO
+        || sim->running_process->proc_type == PROD || sim->running_process->proc_type == CONS)) {
+        traps = trap_match(PCB_IO_TRAPS(sim->running_process)->traps, IO_TRAP_GROUPS, sim->cpu_pc);
+        if (traps & TRAP_BIT(IO_TRAP_1)) {
+            return 1;
+        } else if (traps & TRAP_BIT(IO_TRAP_2)) {
+            return 2;
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * IO trap of a process that uses IO rings: reaps its completions, then queues
+ * the request and keeps running. Queued requests go to the devices in batches
+ * of IO_RING_BATCH. Only when every ring entry is taken does the process
+ * block, until one completes, and then runs the trap again.
+ * Pre: The running_process must not be NULL and must have rings enabled.
+ */
+void trap_io_ring(sim_p sim, unsigned int io_device) {
+    io_ring_p ring = PCB_IO_RING(sim->running_process);
+    io_cqe_s cqe;
+
+    while (io_ring_reap(ring, &cqe))
+        SIM_LOG(sim, "PID %u: reaped IO request %u from device %u after %u cycles\n",
+                sim->running_process->pid, cqe.tag, cqe.device, cqe.latency);
+
+    if (!io_ring_has_room(ring)) {
+        io_ring_enter(sim, sim->running_process);
+        io_ring_wait(sim, IO_RING_ENTRIES - 1);
+        return;
+    }
+
+    io_ring_submit(ring, io_device);
+    if (IO_RING_SQ_PENDING(ring) >= IO_RING_BATCH)
+        io_ring_enter(sim, sim->running_process);
+}
+
+/*
+ * Submits every request a process queued on its rings to the devices.
+ */
+void io_ring_enter(sim_p sim, PCB_p pcb) {
+    io_sqe_s sqe;
+
+    while (io_ring_take(PCB_IO_RING(pcb), &sqe)) {
+        io_device_submit(sim, sqe.device, pcb, sqe.tag, 1);
+        sim->ring_submits++;
+    }
+}
+
+/*
+ * Blocks the running process until no more than wait_for of its ring requests
+ * are in flight. It is in no queue while it waits; the device that completes
+ * the request it waits for makes it ready, and it runs the current
+ * instruction again.
+ * Pre: The running_process must not be NULL and must have more than wait_for requests in flight.
+ */
+void io_ring_wait(sim_p sim, unsigned int wait_for) {
+    io_ring_p ring = PCB_IO_RING(sim->running_process);
+
+    ring->waiting = 1;
+    ring->wait_for = wait_for;
+    sim->ring_waits++;
+    SIM_LOG(sim, "PID %u: waiting for %u IO requests in flight\n", sim->running_process->pid, ring->in_flight - wait_for);
+
+    sim->running_process->state = STATE_BLOCKED;
+    sim->running_process->pc = sim->cpu_pc - 1;
+    sim->running_process = NULL;
+    scheduler(sim, TRAP_IO);
+}
+
+/*
+ * End of a pass of a process that uses IO rings: submits what is queued and
+ * waits until every request has completed, so a process never terminates
+ * with requests outstanding.
+ * Pre: The running_process must not be NULL and must have rings enabled.
+ * Returns 1 if the process was blocked.
+ */
+int io_ring_sync(sim_p sim) {
+    io_ring_p ring = PCB_IO_RING(sim->running_process);
+    io_cqe_s cqe;
+
+    while (io_ring_reap(ring, &cqe))
+        ;
+    io_ring_enter(sim, sim->running_process);
+    if (ring->in_flight == 0)
+        return 0;
+    io_ring_wait(sim, 0);
+    return 1;
+}
+
+/*
+ * Trap for termination.
+ * Pre: The running_process must not be NULL.
+ */
+void trap_terminate(sim_p sim) {
+    
+    switch (sim->running_process->proc_type) { 
     case 0: // IO case
-	count_io_procs--;
+	if (PCB_COLD(sim->running_process)->generation == 0)
+	    sim->count_io_procs--;
 	break;
     case 1: // computations case
-	count_comp_procs--;
+	if (PCB_COLD(sim->running_process)->generation == 0)
+	    sim->count_comp_procs--;
 	break;
     default:
 	return;
     }
-
-    running_process->state = STATE_TERMINATED;
-    running_process->termination_time = time(NULL);
-    q_enqueue(zombie_queue, running_process);
-    running_process = NULL;
-    count_terminated++;
-    scheduler(INT_TERMINATE);
+    if (PCB_COLD(sim->running_process)->generation > 0)
+        sim->count_forked_procs--;
+
+    sim->running_process->state = STATE_TERMINATED;
+    PCB_COLD(sim->running_process)->termination_time = time(NULL);
+    slock_acquire(&sim->zombie_lock);
+    q_enqueue(sim->zombie_queue, sim->running_process);
+    slock_release(&sim->zombie_lock);
+    sim->running_process = NULL;
+    sim->count_terminated++;
+    scheduler(sim, INT_TERMINATE);
 }
 
 /*
  * The scheduler.
  */
-void scheduler(enum interrupt_type type) {
+void scheduler(sim_p sim, enum interrupt_type type) {
+    PROF_SCOPE(PROF_SCHEDULER);
     /* Both values initialized later for speed purposes. */
     PCB_p new_process;
     PCB_p zombie_cleanup;
     PCB_p done_pcb;
 
-    // The idea behind calling lock_thread_by_priority is to defer to a thread 
-    // with higher priority.
-    // Each block of code in the scheduler is a critical section.
-    // After each critical section, give a chance for an interrupt by checking
-    // for a signal sent by either a timer or by the io device
-
-    lock_thread_by_priority(type);
+    // Each block of code in the scheduler is a critical section on the
+    // queues it touches, taken in lock order; see cpu_loop.h.
 
     /* If more than S cycles have elapsed, reset all processes to highest priority */
-    if (cpu_cycles_since_reset >= S) {
-        handle_priority_reset();
+    if (sim->cpu_cycles_since_reset >= sim->S) {
+        handle_priority_reset(sim);
         /* Set to 0, because subtraction is slower. */
-        cpu_cycles_since_reset = 0;
-        /* SIMULATION - Add PCBs when S happens */
-        generate_pcbs();
-        printf("EVENT: Priorities Reset\n");
-        print_on_event();
+        sim->cpu_cycles_since_reset = 0;
+        /* SIMULATION - Add PCBs when S happens, unless arrivals come from a trace or the generator */
+        if (sim->workload_trace == NULL && sim->generator.config.arrival == ARRIVAL_LEGACY)
+            generate_pcbs(sim);
+        SIM_LOG(sim, "EVENT: Priorities Reset\n");
+        print_on_event(sim);
+        print_memory_state(sim);
     }
     
-    lock_thread_by_priority(type);
-    
     /*
      * Handle new processes -> ready queue.
      * Running this before the dispatcher
      * to have a higher chance
      * of having a process ready.
      */
-    while (!q_is_empty(new_queue)) {
-        new_process = q_dequeue(new_queue);
-        if (new_process != NULL) {
-            PCB_assign_state(new_process, STATE_READY);
-            pq_enqueue(ready_queue, new_process);
+    slock_acquire(&sim->new_lock);
+    slock_acquire(&sim->ready_lock);
+    while (!q_is_empty(sim->new_queue)) {
+        new_process = q_peek(sim->new_queue);
+        /* Admission: a process needs its image in memory. Arrivals wait in order until the head fits. */
+        if (PCB_COLD(new_process)->mem == NULL) {
+            if (buddy_largest_free(&sim->phys_mem) < PCB_COLD(new_process)->size
+                || (PCB_COLD(new_process)->mem = buddy_alloc(&sim->phys_mem, PCB_COLD(new_process)->size)) == NULL) {
+                sim->admission_stalls++;
+                break;
+            }
         }
+        q_dequeue(sim->new_queue);
+        PCB_assign_state(new_process, STATE_READY);
+        pq_enqueue(sim->ready_queue, new_process);
     }
-    
-    
-    lock_thread_by_priority(type);
+    slock_release(&sim->ready_lock);
+    slock_release(&sim->new_lock);
 
 
     /* Handle interrupts. */
-    if (running_process != NULL) {
+    if (sim->running_process != NULL) {
         /* If timer interrupt */
         if (type == INT_TIME) {
-            PCB_assign_state(running_process, STATE_READY);
-            PCB_assign_priority(running_process, running_process->priority + 1);
-            pq_enqueue(ready_queue, running_process);
-            printf("EVENT: PID %u ran out of time - moved to ready queue.\n", running_process->pid);
-            running_process = NULL;
+            PCB_assign_state(sim->running_process, STATE_READY);
+            /* A process running at an inherited priority is demoted under it. */
+            if (sim->running_process->base_priority == PCB_NOT_INHERITED)
+                PCB_assign_priority(sim->running_process, sim->running_process->priority + 1);
+            else if (sim->running_process->base_priority < NUM_PRIORITIES - 1)
+                sim->running_process->base_priority++;
+            slock_acquire(&sim->ready_lock);
+            pq_enqueue(sim->ready_queue, sim->running_process);
+            slock_release(&sim->ready_lock);
+            SIM_LOG(sim, "EVENT: PID %u ran out of time - moved to ready queue.\n", sim->running_process->pid);
+            if (sim->tune_goal != TUNE_OFF)
+                tune_release(&sim->tuner, sim->current_iteration, 1);
+            sim->running_process = NULL;
         }
     }
-    
-    lock_thread_by_priority(type);
 
 
-    if (running_process == NULL) {
-        dispatcher();
+    if (sim->running_process == NULL) {
+        /* Unless its quantum ran out above, the last process gave up the cpu. */
+        if (sim->tune_goal != TUNE_OFF)
+            tune_release(&sim->tuner, sim->current_iteration, 0);
+        dispatcher(sim);
     }
-    
-    lock_thread_by_priority(type);
 
     /* Handle clearing the zombie queue. */
-    if (zombie_queue->size >= 4) {
-        while (!q_is_empty(zombie_queue)) {
-            zombie_cleanup = q_dequeue(zombie_queue);
-            PCB_destroy(zombie_cleanup);
+    if (sim->zombie_queue->size >= 4) {
+        slock_acquire(&sim->zombie_lock);
+        while (!q_is_empty(sim->zombie_queue)) {
+            zombie_cleanup = q_dequeue(sim->zombie_queue);
+            vm_release(sim->vm, zombie_cleanup);
+            PCB_destroy(&sim->process_table, zombie_cleanup);
         }
-        printf("EVENT: Zombie queue emptied\n");
-        print_on_event();
-    }
-}
-
-void lock_thread_by_priority(enum interrupt_type type) {
-
-    // timer interrupt waits for no thread!
-    if (type != INT_TIME) {
-	
-	//acquire lock
-
-	// need to make this non blocking otherwise thread will wait too long
-	while (pthread_mutex_trylock(&timer_init_lock) == 1) {
-	    while (initialized_cond == 1) {
-		pthread_mutex_unlock(&timer_lock);
-		pthread_cond_wait(&timer_cond, &timer_init_lock);
-		pthread_mutex_lock(&timer_lock);
-	    }
-	}
-	//pthread_mutex_lock(&timer_init_lock);
-	pthread_mutex_unlock(&timer_init_lock);
-
-	// need to order io_int -> io_trap
-	// acquire io_lock
-	// checkcond... sleep if need be
-	// release io_lock
-
-	// this block forces the trap routine to defer to the io threads
-	if (type == TRAP_IO) {
-	    while(pthread_mutex_trylock(&io_init_lock) == 1) {
-		while (initialized_io == 1) {
-		    pthread_mutex_unlock(&timer_lock);
-		    pthread_cond_wait(&io_cond, &io_init_lock);
-		    pthread_mutex_lock(&timer_lock);
-		}
-	    }
-	    pthread_mutex_unlock(&io_init_lock);
-	}
+        slock_release(&sim->zombie_lock);
+        SIM_LOG(sim, "EVENT: Zombie queue emptied\n");
+        print_on_event(sim);
     }
 }
 
 /*
  * Dispatches a new process from the ready queue.
  */
-void dispatcher() {
+void dispatcher(sim_p sim) {
+    PROF_SCOPE(PROF_DISPATCHER);
     PCB_p dispatch_process = NULL;
-    dispatch_process = pq_dequeue(ready_queue);
+    slock_acquire(&sim->ready_lock);
+    dispatch_process = pq_dequeue(sim->ready_queue);
+    slock_release(&sim->ready_lock);
 
     if (dispatch_process != NULL) {
         /* Push the process we want to dispatch onto the stack. */
-        sys_stack = dispatch_process->context->pc;
-        running_process = dispatch_process;
-        PCB_assign_state(running_process, STATE_RUNNING);
-        printf("EVENT: Dispatch - PID %u is now running\n", running_process->pid);
-        print_on_event();
+        sim->sys_stack = dispatch_process->pc;
+        sim->running_process = dispatch_process;
+        PCB_assign_state(sim->running_process, STATE_RUNNING);
+        SIM_LOG(sim, "EVENT: Dispatch - PID %u is now running\n", sim->running_process->pid);
+        print_on_event(sim);
         /* This is simulating popping the top of the SysStack into the CPU PC. */
-        cpu_pc = sys_stack;
+        sim->cpu_pc = sim->sys_stack;
+        /* The switch itself costs cycles before the process makes progress. */
+        sim->dispatch_count++;
+        sim->switch_stall = switch_cost(sim, sim->running_process);
+        sim->kernel_stall = 0;
+        sim->running_process->last_dispatch = sim->dispatch_count;
         /* Set the timer's downcounter to the quantum size of the newly-running proc */
-        //timer_downcounter = quantum_times[running_process->priority];
-	deadlock_check_counter++;
+        sim->timer_downcounter = sim->quantum_times[sim->running_process->priority];
+        if (sim->tune_goal != TUNE_OFF)
+            tune_dispatch(&sim->tuner, sim->current_iteration + sim->switch_stall);
+	sim->deadlock_check_counter++;
     }
 }
 
 /*
- * Resets priotities of all processes to priority 0, to help prevent starvation.
+ * Computes the cycles a switch to the given process costs: the fixed overhead,
+ * plus the share of the cache refill that has gone cold since the process last
+ * ran. A process that has never run pays the full refill.
+ * Pre: dispatch_count already counts this dispatch.
  */
-void handle_priority_reset() {
-    PCB_p dequeued_proc;
-    int i;
-
-    if (running_process != NULL)
-        running_process->priority = 0;
+unsigned int switch_cost(sim_p sim, PCB_p pcb) {
+    double warmth = 0.0;
+    unsigned int others;
+
+    if (pcb->last_dispatch != 0) {
+        others = sim->dispatch_count - pcb->last_dispatch - 1;
+        warmth = exp(-(double) (sim->current_iteration - pcb->last_ran) / CACHE_DECAY_CYCLES
+                     - others / CACHE_DECAY_SWITCHES);
+    }
+    return SWITCH_FIXED_COST + (unsigned int) (CACHE_REFILL_COST * (1.0 - warmth) + 0.5);
+}
 
-    /* Starts at 1, because all in queue 0 are already priority 0. */
-    for (i = 1; i < NUM_PRIORITIES; i++) {
-        while (!q_is_empty(ready_queue->queues[i])) {
-            dequeued_proc = q_dequeue(ready_queue->queues[i]);
-            if (dequeued_proc != NULL) {
-                PCB_assign_priority(dequeued_proc, 0);
-                pq_enqueue(ready_queue, dequeued_proc);
-            }
-        }
+/*
+ * Resets priotities of all processes to priority 0, to help prevent starvation.
+ * The ready queue boost is O(1) in the number of ready processes.
+ */
+void handle_priority_reset(sim_p sim) {
+    PROF_SCOPE(PROF_PRIORITY_RESET);
+    if (sim->running_process != NULL) {
+        sim->running_process->priority = 0;
+        if (sim->running_process->base_priority != PCB_NOT_INHERITED)
+            sim->running_process->base_priority = 0;
     }
+
+    slock_acquire(&sim->ready_lock);
+    pq_boost(sim->ready_queue);
+    slock_release(&sim->ready_lock);
 }
 
 
 /*
  * Initializes all system variables.
  */
-void initialize_system() {
+int initialize_system(sim_p sim) {
     int i;
+    unsigned long long busy, switching;
+    struct timespec start, end;
+
+    if (sim->restore_path != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!checkpoint_restore(sim, sim->restore_path)) {
+            fprintf(stderr, "could not restore checkpoint %s\n", sim->restore_path);
+            return 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        SIM_LOG(sim, "Restored %s at iteration %u in %.2f ms\n", sim->restore_path, sim->current_iteration,
+               (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+        /* What-if runs: a new seed or generator spec diverges from the saved run. */
+        if (sim->generator_spec != NULL)
+            workload_gen_parse(&sim->generator.config, sim->generator_spec);
+        if (sim->seed_given)
+            rng_seed(&sim->generator.rng, sim->seed);
+        if (sim->io_policy_given) {
+            for (i = 0; i < NUM_IO_DEVICES; i++)
+                disk_configure(&sim->disks[i], sim->io_policy, sim->io_depth);
+        }
+        /* A run that was not tuning starts tuning from the quanta it had. */
+        if (sim->tune_goal != TUNE_OFF && !sim->tuner.initialized) {
+            count_busy_cycles(sim, &busy, &switching);
+            tune_init(&sim->tuner, sim->quantum_times, sim->S, sim->current_iteration, busy, switching);
+        }
+
+        return 1;
+    }
+
     /* Seed the RNG. */
-    srand(time(NULL));
+    workload_gen_start(&sim->generator, sim->seed);
 
     /* Make the queues: */
-    ready_queue = pq_create();
-    zombie_queue = q_create();
-    new_queue = q_create();
+    sim->ready_queue = pq_create(&sim->process_table);
+    sim->zombie_queue = q_create(&sim->process_table);
+    sim->new_queue = q_create(&sim->process_table);
 
     for (i = 0; i < NUM_IO_DEVICES; i++) {
-        io_queues[i] = q_create();
-        io_queue_timers[i] = 0;
+        sim->io_queues[i] = q_create(&sim->process_table);
+        sim->io_queue_timers[i] = 0;
     }
+    sim->paging_queue = q_create(&sim->process_table);
+    sim->paging_timer = 0;
+    sim->vm = vm_create(VM_NUM_FRAMES, VM_TLB_ENTRIES, VM_POLICY, VM_AGING_INTERVAL);
+    if (sim->vm == NULL)
+        return 0;
 
-    build_quantum_times();
+    build_quantum_times(sim);
+    if (sim->tune_goal != TUNE_OFF)
+        tune_init(&sim->tuner, sim->quantum_times, sim->S, 0, 0, 0);
 
-    running_process = NULL;
+    sim->running_process = NULL;
 
-    current_iteration = 0;
-    cpu_pc = 0;
-    sys_stack = 0;
-    cpu_cycles_since_reset = 0;
+    sim->current_iteration = 0;
+    sim->cpu_pc = 0;
+    sim->sys_stack = 0;
+    sim->cpu_cycles_since_reset = 0;
 
     /* Allocate new PCBs and push to new_procceses */
-    generate_pcbs();
+    if (sim->workload_trace == NULL && sim->generator.config.arrival == ARRIVAL_LEGACY)
+        generate_pcbs(sim);
+
+    return 1;
+}
 
-    pthread_create(&timer_thread, NULL, timer, NULL); // TODO: move to right place
+/*
+ * Starts the timer and IO device threads.
+ */
+void start_devices(sim_p sim) {
+    unsigned int i;
 
+    pthread_create(&sim->timer_thread, NULL, timer, sim);
 
-    // init io threads... 
-    one = malloc(sizeof(unsigned int));
-    *one = 0;
-    pthread_create(&io_thread_1, NULL, io_interrupt, (void *) one);
-    two = malloc(sizeof(unsigned int));
-    *two = 1;
-    pthread_create(&io_thread_2, NULL, io_interrupt, (void *) two);
 
+    // init io threads... 
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        sim->devices[i].sim = sim;
+        sim->devices[i].id = i;
+        pthread_create(&sim->io_threads[i], NULL, io_interrupt, &sim->devices[i]);
+    }
 }
 
 /*
  * Builds a table of cpu cycle times alloted to each quantum.
  */
-void build_quantum_times() {
+void build_quantum_times(sim_p sim) {
     int i;
     for (i = 0; i < NUM_PRIORITIES; i++) {
-        quantum_times[i] = PRIORITY_ZERO_TIME + PER_PRIORITY_TIME_INCREASE * i;
+        sim->quantum_times[i] = PRIORITY_ZERO_TIME + PER_PRIORITY_TIME_INCREASE * i;
     }
 
-    S = quantum_times[NUM_PRIORITIES/2] * S_MULTIPLE;
+    sim->S = sim->quantum_times[NUM_PRIORITIES/2] * S_MULTIPLE;
+}
+
+/*
+ * Feeds the tuner the ready queue of this cycle and, at the end of an
+ * interval, lets it rebuild the quanta and S. A running process keeps its
+ * quantum; the next dispatch gets the new one.
+ */
+void tune_step(sim_p sim) {
+    tuner_p t = &sim->tuner;
+    unsigned long long busy, switching;
+
+    slock_acquire(&sim->ready_lock);
+    t->ready_area += pq_size(sim->ready_queue);
+    slock_release(&sim->ready_lock);
+
+    if (sim->current_iteration - t->started < TUNE_INTERVAL)
+        return;
+    count_busy_cycles(sim, &busy, &switching);
+    if (tune_adjust(t, sim->tune_goal, sim->tune_target, sim->current_iteration, busy, switching,
+                    sim->quantum_times, &sim->S))
+        SIM_LOG(sim, "EVENT: Tuned - ready wait %.1f cycles, %.2f%% switching, %.1f%% demoted, burst %.1f "
+                "-> quanta %u..%u, S %u\n", t->latest.ready_wait, 100.0 * t->latest.switch_loss,
+                100.0 * t->latest.demotion_rate, t->burst, sim->quantum_times[0],
+                sim->quantum_times[NUM_PRIORITIES - 1], sim->S);
+}
+
+/*
+ * Sums the busy and switch cycles of every priority.
+ */
+void count_busy_cycles(sim_p sim, unsigned long long * busy, unsigned long long * switching) {
+    int k;
+
+    *busy = 0;
+    *switching = 0;
+    for (k = 0; k < NUM_PRIORITIES; k++) {
+        *busy += sim->busy_cycles[k];
+        *switching += sim->switch_cycles[k];
+    }
 }
 
 /*
  * Generates PCBs for populating the new_queue.
  */
-void generate_pcbs() {
-    int i;
-    int num_to_make, lottery;
-    PCB_p new_pcb = NULL;
+void generate_pcbs(sim_p sim) {
+    PROF_SCOPE(PROF_GENERATE_PCBS);
+    unsigned int i, num_to_make;
 
-    num_to_make = rand() % NUM_PROCESSES;
+    num_to_make = rng_below(&sim->generator.rng, NUM_PROCESSES);
 
     for (i = 0; i < num_to_make; i++) {
-    	Lock_p lock_1;
-    	Lock_p lock_2;
-            /*
-             * Randomly decide if one process will be not terminate or not.
-             */
-    	lottery = rand() % 1000;
-    	int type = rand() % NUM_TYPE_PROCS;
-    	switch (type) {
-    	case 0: //IO CASE
-    	    if (count_io_procs < MAX_IO_PROCS) {
-    		io_total++;
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->proc_type = IO;
-    	    	count_io_procs++;
-    	    	if (lottery <= 5) {
-    	    	    new_pcb->terminate = 0;
-    	    	}
-    	    	q_enqueue(new_queue, new_pcb);
-    	    }
+        generate_process(sim);
+    }
+}
+
+/*
+ * Generates a single process of a random type, unless that type is at its cap.
+ */
+void generate_process(sim_p sim) {
+    int lottery, type;
+    PCB_p new_pcb = NULL;
+
+    /*
+     * Randomly decide if one process will be not terminate or not.
+     */
+    lottery = rng_below(&sim->generator.rng, 1000);
+    /* Sync groups draw only when asked for, so other workloads keep their random stream. */
+    if (sim->generator.config.sync_share > 0.0
+        && rng_below(&sim->generator.rng, 100) < sim->generator.config.sync_share) {
+        static const enum proc_type kinds[] = { READER, SEM, BARRIER };
+        spawn_sync_group(sim, kinds[rng_below(&sim->generator.rng, 3)], NULL);
+        return;
+    }
+    if (sim->generator.config.ipc_share > 0.0
+        && rng_below(&sim->generator.rng, 100) < sim->generator.config.ipc_share) {
+        spawn_ipc_group(sim, rng_below(&sim->generator.rng, IPC_KIND_COUNT), NULL);
+        return;
+    }
+    type = rng_below(&sim->generator.rng, NUM_TYPE_PROCS);
+    switch (type) {
+    case 0: //IO CASE
+        if (sim->count_io_procs < MAX_IO_PROCS) {
+            new_pcb = spawn_procs(sim, IO, NULL);
+            if (new_pcb != NULL && lottery <= 5) {
+                new_pcb->terminate = 0;
+            }
+        }
+        break;
+    case 1: // computations case
+        if (sim->count_comp_procs < MAX_INTENSIVE_PROCS) {
+            new_pcb = spawn_procs(sim, INTENSIVE, NULL);
+            if (new_pcb != NULL && lottery <= 5) {
+                new_pcb->terminate = 0;
+            }
+        }
+        break;
+    case 2: // mutex case
+        if (sim->count_mutex_procs < MAX_MUTEX_PROCS) {
+            spawn_procs(sim, MUTEX, NULL);
+            break;
+        }
+    case 3: // prod/consumer proc
+        if (sim->count_prod_cons_procs < MAX_PROD_CONS_PROC_PAIRS) { 
+            spawn_procs(sim, PROD, NULL);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Creates a process of the given type and queues it on the new_queue.
+ * MUTEX creates a pair sharing two locks, PROD creates a producer/consumer pair.
+ *
+ * Arguments: type: the type of process to create.
+ *            rec: a trace record to apply to the new processes, NULL to keep the
+ *                 randomly generated values.
+ * Return: the first process created, NULL if none was created.
+ */
+PCB_p spawn_procs(sim_p sim, enum proc_type type, const trace_record_s * rec) {
+    PCB_p new_pcb = NULL;
+    PCB_p first_pcb = NULL;
+    Lock_p lock_1;
+    Lock_p lock_2;
+
+    switch (type) {
+    case IO:
+    	new_pcb = make_pcb(sim, IO);
+    	if (new_pcb == NULL) break;
+    	sim->io_total++;
+    	sim->count_io_procs++;
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	first_pcb = new_pcb;
+    	break;
+    case INTENSIVE:
+    	new_pcb = make_pcb(sim, INTENSIVE);
+    	if (new_pcb == NULL) break;
+    	sim->intensive_total++;
+    	sim->count_comp_procs++;
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	first_pcb = new_pcb;
+    	break;
+    case MUTEX:
+    	/* Both processes first, so a failure leaves no half-built pair behind. */
+    	first_pcb = make_pcb(sim, MUTEX);
+    	if (first_pcb == NULL) break;
+    	new_pcb = make_pcb(sim, MUTEX);
+    	if (new_pcb == NULL) {
+    	    PCB_destroy(&sim->process_table, first_pcb);
+    	    first_pcb = NULL;
     	    break;
-    	case 1: // computations case
-    	    if (count_comp_procs < MAX_INTENSIVE_PROCS) {
-    		intensive_total++;
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->proc_type = INTENSIVE;
-    	    	count_comp_procs++;
-    	    	if (lottery <= 5) {
-    	    	    new_pcb->terminate = 0;
-    	    	}
-    	    	q_enqueue(new_queue, new_pcb);
-    	    }
+    	}
+    	lock_1 = lock_constructor(&sim->process_table);
+    	lock_2 = lock_constructor(&sim->process_table);
+    	sim->mutex_total += 2;
+    	sim->count_mutex_procs += 2;
+
+    	if (rec != NULL) trace_record_apply(rec, first_pcb);
+    	first_pcb->terminate = 0;
+    	proc_to_lock_map_p new_map_1 = proc_map_constructor(lock_1, lock_2, first_pcb);
+    	slock_acquire(&sim->registry_lock);
+    	proc_map_list_add(sim->list_of_locks, new_map_1);
+    	slock_release(&sim->registry_lock);
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, first_pcb);
+    	slock_release(&sim->new_lock);
+
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	new_pcb->terminate = 0;
+    	proc_to_lock_map_p new_map_2;
+    	if (CREATE_DEADLOCK_TRUE == 0) {
+    	    new_map_2 = proc_map_constructor(lock_1, lock_2, new_pcb);
+    	} else {
+    	    new_map_2 = proc_map_constructor(lock_2, lock_1, new_pcb);
+    	}
+    	slock_acquire(&sim->registry_lock);
+    	proc_map_list_add(sim->list_of_locks, new_map_2);
+    	slock_release(&sim->registry_lock);
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	break;
+    case PROD:
+    case CONS:
+    	/* Every prod/cons pair needs its own slot in the prod_cons arrays. */
+    	if (sim->count_prod_cons_procs >= MAX_PROD_CONS_PROC_PAIRS) break;
+    	/* Both processes first, so a failure leaves no half-built pair behind. */
+    	first_pcb = make_pcb(sim, PROD);
+    	if (first_pcb == NULL) break;
+    	new_pcb = make_pcb(sim, CONS);
+    	if (new_pcb == NULL) {
+    	    PCB_destroy(&sim->process_table, first_pcb);
+    	    first_pcb = NULL;
     	    break;
-    	case 2: // mutex case
-    	    if (count_mutex_procs < MAX_MUTEX_PROCS) {
-    		lock_1 = lock_constructor();
-    	    	lock_2 = lock_constructor();
-    	    	mutex_total += 2;
-    		count_mutex_procs += 2;
-
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->terminate = 0;
-    	    	if (new_pcb == NULL) break;
-    	    	proc_to_lock_map_p new_map_1 = proc_map_constructor(lock_1, lock_2, new_pcb);
-    	    	proc_map_list_add(list_of_locks, new_map_1);
-    	    	new_pcb->proc_type = MUTEX;
-    	    	q_enqueue(new_queue, new_pcb);
-
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->terminate = 0;
-
-    	    	if (new_pcb == NULL) break;
-    	    	proc_to_lock_map_p new_map_2;
-    	    	if (CREATE_DEADLOCK_TRUE == 0) {
-    	    	    new_map_2 = proc_map_constructor(lock_1, lock_2, new_pcb);
-    	    	} else {
-    	    	    new_map_2 = proc_map_constructor(lock_2, lock_1, new_pcb);
-    	    	}
-    	    	proc_map_list_add(list_of_locks, new_map_2);
-    	    	new_pcb->proc_type = MUTEX;
-    	    	q_enqueue(new_queue, new_pcb);
-    	    	break;
-
-    	    }
-    	case 3: // prod/consumer proc
-    	    if (count_prod_cons_procs < MAX_PROD_CONS_PROC_PAIRS) { 
-                    // its a prod 
-                    //c_Variable_p empty, fill; // used for prod/cons problem
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->proc_type = PROD;
-    	    	new_pcb->prod_cons_id = count_prod_cons_procs;
-    	    	prod_cons_cond_vars[count_prod_cons_procs][0] = cond_variable_constructor();
-    	    	prod_cons_cond_vars[count_prod_cons_procs][1] = cond_variable_constructor();
-    	    	prod_cons_locks[count_prod_cons_procs] = lock_constructor();
-    	    	q_enqueue(new_queue, new_pcb);
-    	    	// its a cons
-    	    	new_pcb = make_pcb();
-    	    	new_pcb->proc_type = CONS;
-    	    	new_pcb->prod_cons_id = count_prod_cons_procs;
-    	    	count_prod_cons_procs++;
-    	    	q_enqueue(new_queue, new_pcb);
-    	    }
+    	}
+    	sim->prod_cons_cond_vars[sim->count_prod_cons_procs][0] = cond_variable_constructor(&sim->process_table);
+    	sim->prod_cons_cond_vars[sim->count_prod_cons_procs][1] = cond_variable_constructor(&sim->process_table);
+    	sim->prod_cons_locks[sim->count_prod_cons_procs] = lock_constructor(&sim->process_table);
+
+    	if (rec != NULL) trace_record_apply(rec, first_pcb);
+    	PCB_PROD_CONS(first_pcb)->prod_cons_id = sim->count_prod_cons_procs;
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	PCB_PROD_CONS(new_pcb)->prod_cons_id = sim->count_prod_cons_procs;
+    	sim->count_prod_cons_procs++;
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, first_pcb);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	break;
+    case READER:
+    case WRITER:
+    case SEM:
+    case BARRIER:
+    	first_pcb = spawn_sync_group(sim, type, rec);
+    	break;
+    case SENDER:
+    case RECEIVER:
+    	first_pcb = spawn_ipc_group(sim, IPC_PIPE, rec);
+    	break;
+    default:
+    	break;
+    }
+
+    return first_pcb;
+}
+
+/*
+ * Creates a group of processes sharing a new primitive: RW_GROUP_READERS
+ * readers and a writer for READER or WRITER, SEM_GROUP_PROCS processes
+ * sharing SEM_UNITS units for SEM, or BARRIER_PARTIES parties for BARRIER.
+ * Like MUTEX pairs, members never terminate, so a barrier never waits for a
+ * party that is gone.
+ *
+ * Arguments: type: the kind of group.
+ *            rec: a trace record to apply to every member, NULL to keep the
+ *                 randomly generated values.
+ * Return: the first process created, NULL if none was, e.g. when the kind
+ *         already has MAX_SYNC_GROUPS groups.
+ */
+PCB_p spawn_sync_group(sim_p sim, enum proc_type type, const trace_record_s * rec) {
+    PCB_p first_pcb = NULL;
+    PCB_p new_pcb;
+    unsigned int id, size, i;
+
+    switch (type) {
+    case READER:
+    case WRITER:
+    	id = sim->count_rw_groups;
+    	size = RW_GROUP_READERS + 1;
+    	if (id >= MAX_SYNC_GROUPS || (sim->rw_locks[id] = rw_lock_create(&sim->process_table, sim->rw_mode)) == NULL)
+    	    return NULL;
+    	sim->count_rw_groups++;
+    	break;
+    case SEM:
+    	id = sim->count_sem_groups;
+    	size = SEM_GROUP_PROCS;
+    	if (id >= MAX_SYNC_GROUPS || (sim->semaphores[id] = semaphore_create(&sim->process_table, SEM_UNITS)) == NULL)
+    	    return NULL;
+    	sim->count_sem_groups++;
+    	break;
+    case BARRIER:
+    	id = sim->count_barrier_groups;
+    	size = BARRIER_PARTIES;
+    	if (id >= MAX_SYNC_GROUPS || (sim->barriers[id] = barrier_create(&sim->process_table, BARRIER_PARTIES)) == NULL)
+    	    return NULL;
+    	sim->count_barrier_groups++;
+    	break;
+    default:
+    	return NULL;
+    }
+
+    for (i = 0; i < size; i++) {
+    	if (type == READER || type == WRITER)
+    	    new_pcb = make_pcb(sim, i < RW_GROUP_READERS ? READER : WRITER);
+    	else
+    	    new_pcb = make_pcb(sim, type);
+    	if (new_pcb == NULL)
     	    break;
-    	default:
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	new_pcb->terminate = 0;
+    	PCB_SYNC(new_pcb)->sync_id = id;
+    	sync_fit_traps(new_pcb);
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	if (first_pcb == NULL)
+    	    first_pcb = new_pcb;
+    }
+
+    /* A barrier opens for the parties there are. */
+    if (type == BARRIER && i > 0)
+    	sim->barriers[id]->parties = i;
+    sim->sync_total += i;
+    return first_pcb;
+}
+
+/*
+ * Creates a receiver and its senders around a new channel: one sender for
+ * a pipe, IPC_MAILBOX_SENDERS for a mailbox. Like the sync groups, members
+ * never terminate, so a receiver never waits on a sender that is gone.
+ *
+ * Arguments: kind: pipe or mailbox.
+ *            rec: a trace record to apply to every member, NULL to keep the
+ *                 randomly generated values.
+ * Return: the receiver, NULL if none was created, e.g. at MAX_IPC_PROCS.
+ */
+PCB_p spawn_ipc_group(sim_p sim, enum ipc_kind kind, const trace_record_s * rec) {
+    PCB_p first_pcb = NULL;
+    PCB_p new_pcb;
+    unsigned int size = kind == IPC_PIPE ? 2 : IPC_MAILBOX_SENDERS + 1;
+    uint32_t id;
+    unsigned int i;
+
+    if (sim->count_ipc_procs + size > MAX_IPC_PROCS)
+        return NULL;
+    id = ipc_channel_create(&sim->ipc, &sim->process_table, kind,
+                            kind == IPC_PIPE ? IPC_PIPE_CAPACITY : IPC_MAILBOX_CAPACITY);
+    if (id == UINT32_MAX)
+        return NULL;
+
+    for (i = 0; i < size; i++) {
+    	new_pcb = make_pcb(sim, i == 0 ? RECEIVER : SENDER);
+    	if (new_pcb == NULL)
     	    break;
-    	}
+    	if (rec != NULL) trace_record_apply(rec, new_pcb);
+    	new_pcb->terminate = 0;
+    	PCB_IPC(new_pcb)->channel = id;
+    	PCB_IPC(new_pcb)->batch = sim->generator.config.ipc_batch;
+    	slock_acquire(&sim->new_lock);
+    	q_enqueue(sim->new_queue, new_pcb);
+    	slock_release(&sim->new_lock);
+    	if (first_pcb == NULL)
+    	    first_pcb = new_pcb;
     }
+
+    sim->count_ipc_procs += i;
+    sim->ipc_total += i;
+    return first_pcb;
 }
 
 /*
- * Makes a new PCB and returns it.
+ * Creates processes for every trace record that has arrived by the current iteration.
  */
-PCB_p make_pcb() {
-    int i;
-    PCB_p my_pcb = PCB_create();
+void replay_trace_arrivals(sim_p sim) {
+    const trace_record_s * rec;
+
+    while ((rec = trace_reader_next(sim->workload_trace, sim->current_iteration)) != NULL) {
+        spawn_procs(sim, (enum proc_type) rec->type, rec);
+    }
+}
+
+/*
+ * Makes a new PCB of the given type and returns it, NULL if it could not be
+ * allocated or registered.
+ */
+PCB_p make_pcb(sim_p sim, enum proc_type type) {
+    PCB_p my_pcb = PCB_create(type);
+
+    /* A full process table that cannot grow refuses the process. */
+    if (my_pcb != NULL && !PCB_assign_PID(&sim->process_table, my_pcb)) {
+        free(my_pcb);
+        my_pcb = NULL;
+    }
 
     if (my_pcb != NULL) {
-        PCB_assign_PID(my_pcb);
         PCB_assign_priority(my_pcb, 0);
-        /* Assigns parent for testing purposes. */
-        PCB_assign_parent(my_pcb, my_pcb->pid-1);
+        /* Generated processes have no parent; forked ones get theirs from PCB_fork. */
+        PCB_assign_parent(my_pcb, PT_NO_PID);
 
         time_t current_time = time(NULL);
-        my_pcb->creation_time = current_time;
+        PCB_COLD(my_pcb)->creation_time = current_time;
         /* Set the max_pc.. */
-        my_pcb->max_pc = MIN_MAX_PC_VAL + (rand() % MAX_PC_MODULO);
+        my_pcb->max_pc = workload_gen_max_pc(&sim->generator);
+        /* Load the image; if memory is full, admission retries in the scheduler. */
+        PCB_COLD(my_pcb)->size = workload_gen_size(&sim->generator);
+        PCB_COLD(my_pcb)->mem = buddy_alloc(&sim->phys_mem, PCB_COLD(my_pcb)->size);
         /* Start the PC at some value < max_pc for testing. */
-        my_pcb->context->pc = 0;
+        my_pcb->pc = 0;
         /*
          * Set the number of runs before termination to a random number between
          * MIN_NUM_BEFORE_TERM and MIN_NUM_BEFORE_TERM + RANDOM_NUM_BEFORE_TERM + 1
          */
-        my_pcb->terminate = MIN_NUM_BEFORE_TERM + rand() % RANDOM_NUM_BEFORE_TERM;
-
-	i = 0;
-	while (i < NUM_IO_TRAPS) {
-	    unsigned int first = rand() % (my_pcb->max_pc/NUM_IO_TRAPS);
-	    unsigned int second = rand() % (my_pcb->max_pc/NUM_IO_TRAPS);
-
-	    my_pcb->io_1_traps[i] = first;
-	    my_pcb->io_2_traps[i] = second;
-            /* If we're past the first io trap, add the previous value to this one. */
-            if (i > 0) {
-                my_pcb->io_1_traps[i] = my_pcb->io_1_traps[i] + my_pcb->io_1_traps[i-1];
-                my_pcb->io_2_traps[i] = my_pcb->io_2_traps[i] + my_pcb->io_2_traps[i-1];
-            }
-
-	    if (exists(my_pcb->io_2_traps[i], my_pcb->io_1_traps, i, my_pcb) == 1 &&
-		exists(my_pcb->io_1_traps[i], my_pcb->io_2_traps, i, my_pcb) == 1) {
-	    } else {
-		i++;
-	    }
-        }
+        my_pcb->terminate = MIN_NUM_BEFORE_TERM + rng_below(&sim->generator.rng, RANDOM_NUM_BEFORE_TERM);
+
+        /* Sorted IO trap pcs outside the lock regions, drawn without rejection. */
+        if (type == IO || type == PROD || type == CONS)
+            workload_gen_place_traps(&sim->generator, my_pcb);
+
+        /* Only lockstep devices serve IO rings; a share of 0 or 100 draws nothing. */
+        if (type == IO && sim->lockstep && sim->generator.config.async_share > 0.0)
+            PCB_IO_RING(my_pcb)->enabled = sim->generator.config.async_share >= 100.0
+                || rng_below(&sim->generator.rng, 100) < sim->generator.config.async_share;
+
+        /* Likewise for forking processes. */
+        if ((type == IO || type == INTENSIVE) && sim->generator.config.fork_share > 0.0
+            && (sim->generator.config.fork_share >= 100.0
+                || rng_below(&sim->generator.rng, 100) < sim->generator.config.fork_share))
+            my_pcb->forks_left = FORK_GENERATIONS;
     }
     return my_pcb;
 }
 
-int exists(unsigned int check, unsigned int arr[], int size, PCB_p proc) {
-    int i;
-    for (i = 0; i < 4; i++) {
-	if (exists_in_range(proc->lock_1[i], proc->unlock_1[i], check) == 1 ||
-	    exists_in_range(proc->trylock_1[i], proc->try_unlock_1[i], check) == 1 ||
-	    exists_in_range(proc->prod_cons_lock[i]-1, proc->prod_cons_lock[i]+1, check) ==1) {
-	    return 1;
-	}
-    }
-
-    if (contains(arr, check, size) == 1) return 1;
-
-    return 0;
-}
-
-int exists_in_range(unsigned int base, unsigned int bound, unsigned int check) {
-    return check >= base && check <= bound;
-}
-
 
 
 /*
  * Checks for deadlock
  */
-int deadlock_monitor() {
-    proc_node_p currnode = list_of_locks->head;
+int deadlock_monitor(sim_p sim) {
+    PROF_SCOPE(PROF_DEADLOCK_MONITOR);
+    proc_node_p currnode;
     int sequential_check = 0;
+    slock_acquire(&sim->registry_lock);
+    currnode = sim->list_of_locks->head;
     while (currnode != NULL) {
 	if (sequential_check != 0) { // used to avoid double-reporting deadlock on the second proc in pair
 	    sequential_check = 0;
@@ -1113,9 +2563,10 @@ int deadlock_monitor() {
 	    } else { 
 	       if ((currlock1->current_proc == mutproc1 && q_peek(currlock2->waiting_procs) == mutproc1) // if proc has lock 1 and is waiting on lock 2,
 	    	   || (q_peek(currlock1->waiting_procs) == mutproc1 && currlock2->current_proc == mutproc1)) { // or if it has lock 2 and is waiting on 1
-	           printf("Deadlock detected on processes PID%u and PID%u\n", mutproc1->pid, mutproc1->pid + 1);
+	           /* Pairs are added back to back; pids are reused, so the partner is the next map, not pid + 1. */
+	           SIM_LOG(sim, "Deadlock detected on processes PID%u and PID%u\n", mutproc1->pid, currnode->next->map->proc->pid);
 	           currnode = currnode->next;
-		       deadlock_flag=1;
+		       sim->deadlock_flag=1;
 		      continue;
 	       } else {
 	           currnode = currnode->next;
@@ -1124,6 +2575,7 @@ int deadlock_monitor() {
 	    }
 	}
     }
+    slock_release(&sim->registry_lock);
     return 0;
 }
 
@@ -1131,79 +2583,896 @@ int deadlock_monitor() {
 /*
  * Prints the current state of the queues:
  */
-void print_queue_state() {
+void print_queue_state(sim_p sim) {
     unsigned int i;
     for (i = 0; i < NUM_PRIORITIES; i++) {
-        printf("Q%u: %u\t- Quantum Size: %u\n", i, ready_queue->queues[i]->size, quantum_times[i]);
+        SIM_LOG(sim, "Q%u: %u\t- Quantum Size: %u\n", i, sim->ready_queue->queues[i]->size, sim->quantum_times[i]);
     }
 
+    /* The device threads dequeue concurrently. */
     for (i = 0; i < NUM_IO_DEVICES; i++) {
-        if (!q_is_empty(io_queues[i])) {
-            printf("IO Device %u queue contains %u PCBs.\n", i, io_queues[i]->size); 
-            printf("Head of IO device %u queue: PID%u \n", i, q_peek(io_queues[i])->pid);
+        slock_acquire(&sim->io_locks[i]);
+        if (!q_is_empty(sim->io_queues[i])) {
+            SIM_LOG(sim, "IO Device %u queue contains %u PCBs.\n", i, sim->io_queues[i]->size); 
+            SIM_LOG(sim, "Head of IO device %u queue: PID%u \n", i, q_peek(sim->io_queues[i])->pid);
         }
+        slock_release(&sim->io_locks[i]);
     }
+    if (!q_is_empty(sim->paging_queue)) {
+        SIM_LOG(sim, "Paging queue contains %u PCBs.\n", sim->paging_queue->size);
+    }
+}
+
+/*
+ * Prints the state of simulated physical memory.
+ */
+void print_memory_state(sim_p sim) {
+    SIM_LOG(sim, "MEMORY: %zu KB free of %zu KB, largest free block %zu KB, external fragmentation %.1f%%, "
+           "%u processes waiting for memory, mean allocation %.0f ns\n",
+           sim->phys_mem.free_bytes / 1024, sim->phys_mem.arena_size / 1024, buddy_largest_free(&sim->phys_mem) / 1024,
+           100.0 * buddy_fragmentation(&sim->phys_mem), sim->new_queue->size,
+           (double) sim->phys_mem.stats.latency_ns / (sim->phys_mem.stats.allocs + sim->phys_mem.stats.failures + 1));
 }
 
 /*
  * Prints everything needed on an event.
  */
-void print_on_event() {
-    if (running_process != NULL) {
-        printf("Running: PID %u, PRIORITY %u, PC %u\n", running_process->pid, running_process->priority, running_process->context->pc);
+void print_on_event(sim_p sim) {
+    if (sim->running_process != NULL) {
+        SIM_LOG(sim, "Running: PID %u, PRIORITY %u, PC %u\n", sim->running_process->pid, sim->running_process->priority, sim->running_process->pc);
     }
-    if (deadlock_flag == -1) {
-	printf("No deadlock found\n");
+    if (sim->deadlock_flag == -1) {
+	SIM_LOG(sim, "No deadlock found\n");
     }
 
-    printf("Current Iteration: %u\n", current_iteration);
-    print_queue_state();
+    SIM_LOG(sim, "Current Iteration: %u\n", sim->current_iteration);
+    print_queue_state(sim);
 
-    printf("\n");
+    SIM_LOG(sim, "\n");
 }
 
 /*
  * Cleans up all system variables.
  */
-void deallocate_system() {
+void deallocate_system(sim_p sim) {
     int i;
 
     /* Cleanup: */
-    pq_destroy(ready_queue);
-    q_destroy(zombie_queue);
-    q_destroy(new_queue);
+    pq_destroy(sim->ready_queue);
+    q_destroy(sim->zombie_queue);
+    q_destroy(sim->new_queue);
 
     for (i = 0; i < NUM_IO_DEVICES; i++) {
-        q_destroy(io_queues[i]);
-        io_queue_timers[i] = 0;
+        q_destroy(sim->io_queues[i]);
+        ioq_destroy(&sim->io_requests[i]);
+        sim->io_queue_timers[i] = 0;
+    }
+    q_destroy(sim->paging_queue);
+
+    if (sim->running_process != NULL)
+        PCB_destroy(&sim->process_table, sim->running_process);
+}
+
+/*
+ * Blocks the running process, which is waiting in lock's queue, to run the
+ * lock instruction again once it is woken.
+ */
+void lock_trap(sim_p sim, Lock_p lock) {
+    lock_inherit(sim, lock);
+    sim->running_process->pc = sim->cpu_pc - 1;
+    sim->running_process->state = STATE_BLOCKED;
+    sim->running_process = NULL;
+    scheduler(sim, TRAP_IO);
+}
+
+/*
+ * A MUTEX process found the lock it wants held. Under -k adaptive it spins
+ * instead of blocking, retrying the lock instruction every cycle, for up to
+ * about one mean hold of the lock and at most LOCK_SPIN_MAX cycles. A spin
+ * carries on across preemption, so on this single cpu it mostly pays off
+ * when the holder runs and releases while the spinner waits to be
+ * redispatched. A lock held longer than LOCK_SPIN_MAX on average is not worth
+ * spinning on and blocks at once; one never released yet gets the full spin.
+ * Pre: The running_process must not be NULL, and lock is held.
+ * Return: 1 if the process spins this cycle, 0 if it must block.
+ */
+int lock_contended(sim_p sim, Lock_p lock) {
+    unsigned int * spun = &PCB_MUTEX(sim->running_process)->spun;
+
+    if (*spun == 0)
+        sim->lock_contended++;
+    if (sim->lock_mode == LOCK_MODE_ADAPTIVE && lock->current_proc != sim->running_process
+        && *spun < lock_spin_budget(lock, LOCK_SPIN_MAX)) {
+        (*spun)++;
+        sim->spin_cycles++;
+        sim->cpu_pc--;
+        return 1;
+    }
+    if (*spun > 0)
+        sim->spin_failed++;
+    *spun = 0;
+    sim->lock_blocks++;
+    return 0;
+}
+
+/*
+ * The running process just took lock: starts timing the hold, and ends its
+ * spin if it was spinning.
+ */
+void lock_acquired(sim_p sim, Lock_p lock) {
+    unsigned int * spun = &PCB_MUTEX(sim->running_process)->spun;
+
+    lock_note_acquired(lock, sim->current_iteration);
+    if (*spun > 0) {
+        sim->spin_acquired++;
+        *spun = 0;
     }
+}
 
-    if (running_process != NULL)
-        PCB_destroy(running_process);
-    free(one);
-    free(two);
+/*
+ * The running process is about to block on lock. If it outranks the holder a
+ * priority inversion starts, and unless -n the holder inherits its priority
+ * so that processes of middle priority cannot keep it from releasing. The
+ * holder keeps its own priority in base_priority until it lets go.
+ * Pre: The running_process must not be NULL.
+ */
+void lock_inherit(sim_p sim, Lock_p lock) {
+    PCB_p holder = lock->current_proc;
+    int raised = 0;
+
+    if (holder == NULL || holder == sim->running_process)
+        return;
+    slock_acquire(&sim->ready_lock);
+    if (sim->running_process->priority < pq_priority(sim->ready_queue, holder)) {
+        lock_note_inverted(lock, sim->current_iteration);
+        if (sim->inherit) {
+            if (holder->base_priority == PCB_NOT_INHERITED)
+                holder->base_priority = holder->priority;
+            pq_raise(sim->ready_queue, holder, sim->running_process->priority);
+            raised = 1;
+        }
+    }
+    slock_release(&sim->ready_lock);
+    if (raised) {
+        sim->inheritances++;
+        SIM_LOG(sim, "PID %u inherits priority %u from PID %u\n", holder->pid, holder->priority, sim->running_process->pid);
+    }
+}
 
+/*
+ * The running process let go of lock: ends the lock's inversion, and drops
+ * the priority it inherited once it holds no other lock that is waited for.
+ */
+void lock_disinherit(sim_p sim, Lock_p lock) {
+    PCB_p pcb = sim->running_process;
+    proc_to_lock_map_p map;
+    unsigned int cycles;
+
+    if (lock->inverted) {
+        cycles = lock_note_uninverted(lock, sim->current_iteration);
+        sim->inversions++;
+        sim->inversion_cycles += cycles;
+        if (cycles > sim->inversion_max)
+            sim->inversion_max = cycles;
+    }
+    if (pcb == NULL || pcb->base_priority == PCB_NOT_INHERITED)
+        return;
+    if (pcb->proc_type == MUTEX) {
+        map = find_lock_map(sim, pcb);
+        if (map != NULL && ((map->lock_1->current_proc == pcb && !q_is_empty(map->lock_1->waiting_procs))
+                            || (map->lock_2->current_proc == pcb && !q_is_empty(map->lock_2->waiting_procs))))
+            return;
+    }
+    SIM_LOG(sim, "PID %u returns from priority %u to %u\n", pcb->pid, pcb->priority, pcb->base_priority);
+    PCB_assign_priority(pcb, pcb->base_priority);
+    pcb->base_priority = PCB_NOT_INHERITED;
 }
 
-void lock_trap(Lock_p lock) {
-    running_process->context->pc = cpu_pc - 1;
-    running_process->state = STATE_BLOCKED;
-    running_process = NULL;
-    scheduler(TRAP_IO);
+/*
+ * The running process released lock: wakes everything waiting for it.
+ */
+void unlock_and_release_waiting_procs(sim_p sim, Lock_p lock) {
+    lock_disinherit(sim, lock);
+    release_waiting_procs(sim, lock->waiting_procs, UINT_MAX);
 }
 
-void unlock_and_release_waiting_procs(Lock_p lock) {
-    FIFOq_p q = lock->waiting_procs;
-    while (q->size > 0) {
+/*
+ * Makes up to max of the oldest processes waiting in q ready.
+ */
+void release_waiting_procs(sim_p sim, FIFOq_p q, unsigned int max) {
+    slock_acquire(&sim->ready_lock);
+    while (q->size > 0 && max-- > 0) {
 	PCB_p proc = q_dequeue(q);
 	proc->state = STATE_READY;
-	pq_enqueue(ready_queue, proc);
+	pq_enqueue(sim->ready_queue, proc);
+    }
+    slock_release(&sim->ready_lock);
+}
+
+/*
+ * Runs the trap of a READER, WRITER, SEM or BARRIER process at the current
+ * pc, if there is one. A process that must wait blocks in the primitive's
+ * queue; readers, writers and semaphore waiters run the trap again once
+ * woken, while barrier parties carry on past the barrier.
+ * Pre: The running_process must not be NULL and be of one of those types.
+ */
+void sync_trap(sim_p sim) {
+    PCB_p pcb = sim->running_process;
+    unsigned int id = PCB_SYNC(pcb)->sync_id;
+    unsigned int traps = trap_match(PCB_SYNC(pcb)->traps, SYNC_TRAP_GROUPS, sim->cpu_pc);
+    int wait;
+
+    if (traps & TRAP_BIT(SYNC_TRAP_ACQUIRE)) {
+        switch (pcb->proc_type) {
+        case READER:
+            wait = rw_read_lock(sim->rw_locks[id], pcb);
+            break;
+        case WRITER:
+            wait = rw_write_lock(sim->rw_locks[id], pcb);
+            break;
+        case SEM:
+            wait = semaphore_wait(sim->semaphores[id], pcb);
+            break;
+        default:
+            if (barrier_arrive(sim->barriers[id], pcb)) {
+                SIM_LOG(sim, "PID %u: opened barrier %u\n", pcb->pid, id);
+                release_waiting_procs(sim, sim->barriers[id]->waiting, UINT_MAX);
+                return;
+            }
+            SIM_LOG(sim, "PID %u: waiting at barrier %u\n", pcb->pid, id);
+            sim->sync_blocks++;
+            pcb->pc = sim->cpu_pc;
+            pcb->state = STATE_BLOCKED;
+            sim->running_process = NULL;
+            scheduler(sim, TRAP_SYNC);
+            return;
+        }
+        if (wait) {
+            SIM_LOG(sim, "PID %u: blocked on %s %u\n", pcb->pid, pcb->proc_type == SEM ? "semaphore" : "rw lock", id);
+            sim->sync_blocks++;
+            pcb->pc = sim->cpu_pc - 1;
+            pcb->state = STATE_BLOCKED;
+            sim->running_process = NULL;
+            scheduler(sim, TRAP_SYNC);
+        }
+    } else if (traps & TRAP_BIT(SYNC_TRAP_RELEASE)) {
+        if (pcb->proc_type == SEM) {
+            if (semaphore_post(sim->semaphores[id]))
+                release_waiting_procs(sim, sim->semaphores[id]->waiting, 1);
+            return;
+        }
+        switch (rw_unlock(sim->rw_locks[id], pcb)) {
+        case RW_WAKE_WRITER:
+            release_waiting_procs(sim, sim->rw_locks[id]->waiting_writers, 1);
+            break;
+        case RW_WAKE_READERS:
+            release_waiting_procs(sim, sim->rw_locks[id]->waiting_readers, UINT_MAX);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/*
+ * Runs the transfer of a SENDER or RECEIVER process at the current pc, if
+ * there is one: a batch of messages is sent or received by reference, and
+ * the processes waiting on the other end are woken, as many senders as
+ * messages were taken. A process that moves nothing blocks on the channel
+ * and runs the transfer again once woken. The call and each message cost
+ * kernel time; the payloads cost nothing, as they are never copied.
+ * Pre: The running_process must not be NULL and be of one of those types.
+ */
+void ipc_trap(sim_p sim) {
+    PCB_p pcb = sim->running_process;
+    ipc_payload_s * payload = PCB_IPC(pcb);
+    ipc_channel_p channel = sim->ipc.channels[payload->channel];
+    uint32_t moved;
+
+    if (!trap_match(payload->transfer, 1, sim->cpu_pc))
+        return;
+
+    if (pcb->proc_type == SENDER) {
+        moved = ipc_send(&sim->ipc, payload->channel, pcb, payload->batch, IPC_MSG_BYTES, sim->current_iteration);
+        if (moved > 0)
+            release_waiting_procs(sim, channel->waiting_receivers, UINT_MAX);
+    } else {
+        moved = ipc_receive(&sim->ipc, payload->channel, pcb, payload->batch, sim->current_iteration);
+        if (moved > 0)
+            release_waiting_procs(sim, channel->waiting_senders, moved);
+    }
+
+    if (moved == 0) {
+        SIM_LOG(sim, "PID %u: blocked %s %s %u\n", pcb->pid, pcb->proc_type == SENDER ? "sending to" : "receiving from",
+                ipc_kind_names[channel->kind], payload->channel);
+        pcb->pc = sim->cpu_pc - 1;
+        pcb->state = STATE_BLOCKED;
+        sim->running_process = NULL;
+        scheduler(sim, TRAP_IPC);
+        return;
+    }
+    sim->kernel_stall += IPC_TRAP_COST + moved * IPC_MSG_COST;
+    sim->ipc_cycles += IPC_TRAP_COST + moved * IPC_MSG_COST;
+}
+
+/*
+ * Finds the lock map of a mutex process.
+ * Returns NULL if the process has none.
+ */
+proc_to_lock_map_p find_lock_map(sim_p sim, PCB_p pcb) {
+    proc_to_lock_map_p map;
+
+    slock_acquire(&sim->registry_lock);
+    map = search_list_for_pcb(sim->list_of_locks, pcb);
+    slock_release(&sim->registry_lock);
+    return map;
+}
+
+void prod_cons_trap(sim_p sim) {
+    sim->running_process->pc = sim->cpu_pc - 1;
+    sim->running_process->state = STATE_BLOCKED;
+    sim->running_process = NULL;
+    scheduler(sim, TRAP_PROD_CONS);
+}
+
+/*
+ * Moves the scalar globals between memory and a checkpoint: written when w is
+ * given, read back when r is.
+ */
+void checkpoint_globals(sim_p sim, ckpt_writer_p w, ckpt_reader_p r) {
+    uint64_t trace_next = sim->workload_trace != NULL ? sim->workload_trace->next : 0;
+    int lockstep = sim->lockstep;
+
+#define CKPT_VAR(var) (w != NULL ? ckpt_put(w, &(var), sizeof(var)) : ckpt_read(r, &(var), sizeof(var)))
+    CKPT_VAR(sim->count_io_procs);
+    CKPT_VAR(sim->count_comp_procs);
+    CKPT_VAR(sim->count_forked_procs);
+    CKPT_VAR(sim->count_mutex_procs);
+    CKPT_VAR(sim->count_terminated);
+    CKPT_VAR(sim->count_prod_cons_procs);
+    CKPT_VAR(sim->prod_cons_globals);
+    CKPT_VAR(sim->curr_prod_cons_id);
+    CKPT_VAR(sim->io_total);
+    CKPT_VAR(sim->intensive_total);
+    CKPT_VAR(sim->mutex_total);
+    CKPT_VAR(sim->deadlock_check_counter);
+    CKPT_VAR(sim->deadlock_flag);
+
+    CKPT_VAR(sim->io_queue_timers);
+    CKPT_VAR(sim->paging_timer);
+    CKPT_VAR(sim->admission_stalls);
+    CKPT_VAR(sim->switch_stall);
+    CKPT_VAR(sim->kernel_stall);
+    CKPT_VAR(sim->dispatch_count);
+    CKPT_VAR(sim->busy_cycles);
+    CKPT_VAR(sim->switch_cycles);
+    CKPT_VAR(sim->io_busy_cycles);
+    CKPT_VAR(sim->io_completed);
+    CKPT_VAR(sim->io_latency);
+    CKPT_VAR(sim->ring_submits);
+    CKPT_VAR(sim->ring_waits);
+    CKPT_VAR(sim->io_instructions);
+    CKPT_VAR(sim->lock_contended);
+    CKPT_VAR(sim->spin_acquired);
+    CKPT_VAR(sim->spin_failed);
+    CKPT_VAR(sim->spin_cycles);
+    CKPT_VAR(sim->lock_blocks);
+    CKPT_VAR(sim->sync_blocks);
+    CKPT_VAR(sim->sync_total);
+    CKPT_VAR(sim->count_ipc_procs);
+    CKPT_VAR(sim->ipc_total);
+    CKPT_VAR(sim->ipc_cycles);
+    CKPT_VAR(sim->inversions);
+    CKPT_VAR(sim->inversion_cycles);
+    CKPT_VAR(sim->inversion_max);
+    CKPT_VAR(sim->inheritances);
+    CKPT_VAR(sim->forks);
+    CKPT_VAR(sim->forks_refused);
+    CKPT_VAR(sim->fork_pages);
+    CKPT_VAR(sim->fork_depth);
+    CKPT_VAR(sim->fork_cycles);
+    CKPT_VAR(sim->cow_cycles);
+    CKPT_VAR(sim->disks);
+    CKPT_VAR(sim->io_latency_hist);
+
+    CKPT_VAR(sim->quantum_times);
+    CKPT_VAR(sim->cpu_cycles_since_reset);
+    CKPT_VAR(sim->S);
+    CKPT_VAR(sim->tuner);
+    CKPT_VAR(sim->timer_downcounter);
+    CKPT_VAR(sim->current_iteration);
+    CKPT_VAR(sim->cpu_pc);
+    CKPT_VAR(sim->sys_stack);
+
+    CKPT_VAR(sim->generator);
+    CKPT_VAR(trace_next);
+    CKPT_VAR(lockstep);
+#undef CKPT_VAR
+
+    /* IO ring requests are only served by lockstep devices, so a run restores in the mode it was saved in. */
+    if (r != NULL && r->ok && lockstep != sim->lockstep) {
+        fprintf(stderr, "checkpoint was written by a %s run\n", lockstep ? "lockstep (-l)" : "threaded");
+        r->ok = 0;
+    }
+
+    /* A restored run replays the same trace only if it was given again with -t. */
+    if (r != NULL && sim->workload_trace != NULL && trace_next <= sim->workload_trace->count)
+        sim->workload_trace->next = trace_next;
+}
+
+/*
+ * Return: the index of lock in locks, or count if it is not there.
+ */
+uint32_t checkpoint_lock_index(Lock_p locks[], uint32_t count, Lock_p lock) {
+    uint32_t i;
+
+    for (i = 0; i < count && locks[i] != lock; i++)
+        ;
+    return i;
+}
+
+/*
+ * SIGUSR1 handler: asks every running simulation for a state dump, which
+ * each takes at the end of its current cycle.
+ */
+void request_dump(int signo) {
+    (void) signo;
+    dump_requests++;
+}
+
+/*
+ * Writes a mutex or prod/cons lock: its holder and waiters.
+ */
+void dump_lock(json_writer_p w, Lock_p lock) {
+    json_pid(w, "holder", lock->current_proc);
+    json_uint(w, "acquired_at", lock->acquired_at);
+    json_bool(w, "inverted", lock->inverted);
+    json_queue(w, "waiting", lock->waiting_procs);
+}
+
+/*
+ * Writes the scheduler state as JSON to <dump_prefix>.<seed>.<iteration>.json.
+ * Must be called from the cpu thread under sim_lock_all, so no device thread
+ * moves a process while the queues are walked. Mutex locks are shared by a
+ * pair of processes and listed once, under the first map that has them.
+ *
+ * Arguments: sim: the simulation.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int sim_dump_state(sim_p sim) {
+    char path[PATH_MAX];
+    json_writer_p w = sim->dump_writer;
+    proc_node_p node, prev;
+    ipc_channel_p channel;
+    Lock_p lock;
+    uint32_t i, j;
+    int fd, k, ok;
+
+    if (w == NULL && (w = sim->dump_writer = malloc(sizeof(json_writer_s))) == NULL)
+        return 0;
+    snprintf(path, sizeof(path), "%s.%llu.%u.json", sim->dump_prefix, sim->seed, sim->current_iteration);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "could not write state dump %s\n", path);
+        return 0;
+    }
+
+    json_open(w, fd);
+    json_begin_object(w, NULL);
+    json_uint(w, "iteration", sim->current_iteration);
+    json_uint(w, "seed", sim->seed);
+    json_bool(w, "lockstep", sim->lockstep);
+
+    json_begin_object(w, "cpu");
+    json_pid(w, "running", sim->running_process);
+    json_uint(w, "pc", sim->cpu_pc);
+    json_uint(w, "timer", sim->timer_downcounter);
+    json_uint(w, "switch_stall", sim->switch_stall);
+    json_uint(w, "kernel_stall", sim->kernel_stall);
+    json_uint(w, "dispatches", sim->dispatch_count);
+    json_uint(w, "cycles_since_reset", sim->cpu_cycles_since_reset);
+    json_uint(w, "S", sim->S);
+    json_begin_array(w, "quantum_times");
+    for (i = 0; i < NUM_PRIORITIES; i++)
+        json_uint(w, NULL, sim->quantum_times[i]);
+    json_end_array(w);
+    json_end_object(w);
+
+    json_begin_object(w, "queues");
+    json_queue(w, "new", sim->new_queue);
+    json_uint(w, "boost_epoch", sim->ready_queue->boost_epoch);
+    json_pq(w, "ready", sim->ready_queue);
+    json_queue(w, "zombie", sim->zombie_queue);
+    json_queue(w, "paging", sim->paging_queue);
+    json_end_object(w);
+
+    json_begin_array(w, "processes");
+    for (i = 0; i < sim->process_table.used; i++)
+        if (PT_SLOT(&sim->process_table, i).pcb != NULL)
+            json_pcb(w, NULL, PT_SLOT(&sim->process_table, i).pcb);
+    json_end_array(w);
+
+    json_begin_array(w, "mutexes");
+    for (node = sim->list_of_locks->head; node != NULL; node = node->next) {
+        for (k = 0; k < 2; k++) {
+            lock = k == 0 ? node->map->lock_1 : node->map->lock_2;
+            if (lock == NULL)
+                continue;
+            for (prev = sim->list_of_locks->head; prev != node; prev = prev->next)
+                if (prev->map->lock_1 == lock || prev->map->lock_2 == lock)
+                    break;
+            if (prev != node)
+                continue;
+            json_begin_object(w, NULL);
+            json_uint(w, "owner", node->map->proc->pid);
+            json_uint(w, "lock", k + 1);
+            dump_lock(w, lock);
+            json_end_object(w);
+        }
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "prod_cons");
+    for (k = 0; k < MAX_PROD_CONS_PROC_PAIRS; k++) {
+        if (sim->prod_cons_locks[k] == NULL)
+            continue;
+        json_begin_object(w, NULL);
+        json_uint(w, "id", k);
+        json_uint(w, "counter", sim->prod_cons_globals[k][0]);
+        json_uint(w, "flip", sim->prod_cons_globals[k][1]);
+        dump_lock(w, sim->prod_cons_locks[k]);
+        json_queue(w, "fill", sim->prod_cons_cond_vars[k][0]->queue);
+        json_queue(w, "empty", sim->prod_cons_cond_vars[k][1]->queue);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "rw_locks");
+    for (k = 0; k < MAX_SYNC_GROUPS; k++) {
+        if (sim->rw_locks[k] == NULL)
+            continue;
+        json_begin_object(w, NULL);
+        json_uint(w, "id", k);
+        json_string(w, "mode", rw_mode_names[sim->rw_locks[k]->mode]);
+        json_uint(w, "readers", sim->rw_locks[k]->readers);
+        json_pid(w, "writer", sim->rw_locks[k]->writer);
+        json_queue(w, "waiting_readers", sim->rw_locks[k]->waiting_readers);
+        json_queue(w, "waiting_writers", sim->rw_locks[k]->waiting_writers);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "semaphores");
+    for (k = 0; k < MAX_SYNC_GROUPS; k++) {
+        if (sim->semaphores[k] == NULL)
+            continue;
+        json_begin_object(w, NULL);
+        json_uint(w, "id", k);
+        json_uint(w, "count", sim->semaphores[k]->count);
+        json_uint(w, "initial", sim->semaphores[k]->initial);
+        json_queue(w, "waiting", sim->semaphores[k]->waiting);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "barriers");
+    for (k = 0; k < MAX_SYNC_GROUPS; k++) {
+        if (sim->barriers[k] == NULL)
+            continue;
+        json_begin_object(w, NULL);
+        json_uint(w, "id", k);
+        json_uint(w, "parties", sim->barriers[k]->parties);
+        json_uint(w, "arrived", sim->barriers[k]->arrived);
+        json_queue(w, "waiting", sim->barriers[k]->waiting);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "channels");
+    for (i = 0; i < sim->ipc.count; i++) {
+        channel = sim->ipc.channels[i];
+        json_begin_object(w, NULL);
+        json_uint(w, "id", i);
+        json_string(w, "kind", ipc_kind_names[channel->kind]);
+        json_uint(w, "capacity", channel->capacity);
+        json_uint(w, "queued", channel->queued);
+        json_queue(w, "waiting_senders", channel->waiting_senders);
+        json_queue(w, "waiting_receivers", channel->waiting_receivers);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_array(w, "io_devices");
+    for (i = 0; i < NUM_IO_DEVICES; i++) {
+        json_begin_object(w, NULL);
+        json_uint(w, "id", i);
+        json_queue(w, "blocked", sim->io_queues[i]);
+        if (sim->lockstep) {
+            json_string(w, "policy", io_policy_names[sim->disks[i].policy]);
+            json_uint(w, "head", sim->disks[i].head);
+            if (sim->disks[i].busy)
+                json_uint(w, "active", PT_HANDLE_INDEX(sim->disks[i].active.handle));
+            else
+                json_null(w, "active");
+            json_begin_array(w, "device_queue");
+            for (j = 0; j < sim->disks[i].queued; j++)
+                json_uint(w, NULL, PT_HANDLE_INDEX(sim->disks[i].queue[j].handle));
+            json_end_array(w);
+            json_begin_array(w, "requests");
+            for (j = 0; j < sim->io_requests[i].size; j++)
+                json_uint(w, NULL, PT_HANDLE_INDEX(IOQ_AT(&sim->io_requests[i], j)->handle));
+            json_end_array(w);
+        } else {
+            json_uint(w, "timer", sim->io_queue_timers[i]);
+        }
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_begin_object(w, "memory");
+    json_uint(w, "arena_bytes", sim->phys_mem.arena_size);
+    json_uint(w, "free_bytes", sim->phys_mem.free_bytes);
+    json_uint(w, "frames", sim->vm->num_frames);
+    json_uint(w, "free_frames", sim->vm->free_frames);
+    json_uint(w, "page_faults", sim->vm->stats.faults);
+    json_end_object(w);
+
+    json_end_object(w);
+    ok = json_close(w);
+    if (close(fd) != 0)
+        ok = 0;
+    if (ok)
+        fprintf(stderr, "state dump written to %s\n", path);
+    else
+        fprintf(stderr, "could not write state dump %s\n", path);
+    return ok;
+}
+
+/*
+ * Writes the whole simulation state to a checkpoint. Must be called under
+ * sim_lock_all, with the IO completion inbox empty, so no device thread is in
+ * the middle of an update.
+ *
+ * Arguments: path: the file to write.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int checkpoint_save(sim_p sim, const char * path) {
+    ckpt_writer_p w = ckpt_writer_open(path);
+    ckpt_header_s header;
+    proc_node_p node;
+    Lock_p * locks;
+    uint32_t num_locks = 0, num_maps = 0, i;
+    int k;
+
+    if (w == NULL)
+        return 0;
+
+    header.magic = CKPT_MAGIC;
+    header.version = CKPT_VERSION;
+    header.iteration = sim->current_iteration;
+    header.pcb_size = sizeof(PCB_s);
+    header.priorities = NUM_PRIORITIES;
+    ckpt_put(w, &header, sizeof(header));
+
+    ckpt_put_u32(w, CKPT_GLOBALS);
+    checkpoint_globals(sim, w, NULL);
+
+    ckpt_put_u32(w, CKPT_PROC_TABLE);
+    pt_save(w, &sim->process_table);
+
+    ckpt_put_u32(w, CKPT_BUDDY);
+    buddy_save(w, &sim->phys_mem);
+
+    ckpt_put_u32(w, CKPT_PCBS);
+    ckpt_put_u32(w, sim->process_table.live);
+    for (i = 0; i < sim->process_table.used; i++) {
+        if (PT_SLOT(&sim->process_table, i).pcb != NULL)
+            PCB_save(w, &sim->process_table, PT_SLOT(&sim->process_table, i).pcb);
+    }
+
+    ckpt_put_u32(w, CKPT_QUEUES);
+    q_save(w, sim->new_queue);
+    q_save(w, sim->zombie_queue);
+    for (k = 0; k < NUM_IO_DEVICES; k++)
+        q_save(w, sim->io_queues[k]);
+    for (k = 0; k < NUM_IO_DEVICES; k++)
+        ioq_save(w, &sim->io_requests[k]);
+    q_save(w, sim->paging_queue);
+    pq_save(w, sim->ready_queue);
+    ckpt_put_u32(w, sim->running_process != NULL ? sim->running_process->pid : PT_NO_PID);
+
+    /* Locks are shared between maps, so they are numbered once and maps refer to them by number. */
+    ckpt_put_u32(w, CKPT_LOCKS);
+    for (node = sim->list_of_locks->head; node != NULL; node = node->next)
+        num_maps++;
+    locks = malloc(sizeof(Lock_p) * (2 * num_maps + MAX_PROD_CONS_PROC_PAIRS + 1));
+    if (locks == NULL) {
+        ckpt_writer_close(w);
+        return 0;
+    }
+    for (node = sim->list_of_locks->head; node != NULL; node = node->next) {
+        if (checkpoint_lock_index(locks, num_locks, node->map->lock_1) == num_locks)
+            locks[num_locks++] = node->map->lock_1;
+        if (checkpoint_lock_index(locks, num_locks, node->map->lock_2) == num_locks)
+            locks[num_locks++] = node->map->lock_2;
     }
+    for (k = 0; k < MAX_PROD_CONS_PROC_PAIRS; k++) {
+        if (sim->prod_cons_locks[k] != NULL)
+            locks[num_locks++] = sim->prod_cons_locks[k];
+    }
+
+    ckpt_put_u32(w, num_locks);
+    for (i = 0; i < num_locks; i++) {
+        ckpt_put_u32(w, locks[i]->current_proc != NULL ? locks[i]->current_proc->pid : PT_NO_PID);
+        ckpt_put_u32(w, locks[i]->acquired_at);
+        ckpt_put_u32(w, locks[i]->hold_avg8);
+        ckpt_put_u32(w, locks[i]->inverted);
+        ckpt_put_u32(w, locks[i]->inverted_at);
+        q_save(w, locks[i]->waiting_procs);
+    }
+    ckpt_put_u32(w, num_maps);
+    for (node = sim->list_of_locks->head; node != NULL; node = node->next) {
+        ckpt_put_u32(w, checkpoint_lock_index(locks, num_locks, node->map->lock_1));
+        ckpt_put_u32(w, checkpoint_lock_index(locks, num_locks, node->map->lock_2));
+        ckpt_put_u32(w, node->map->proc->pid);
+    }
+    for (k = 0; k < MAX_PROD_CONS_PROC_PAIRS; k++) {
+        if (sim->prod_cons_locks[k] == NULL) {
+            ckpt_put_u32(w, PT_NIL);
+        } else {
+            ckpt_put_u32(w, checkpoint_lock_index(locks, num_locks, sim->prod_cons_locks[k]));
+            q_save(w, sim->prod_cons_cond_vars[k][0]->queue);
+            q_save(w, sim->prod_cons_cond_vars[k][1]->queue);
+        }
+    }
+    free(locks);
+
+    ckpt_put_u32(w, CKPT_SYNC);
+    ckpt_put_u32(w, sim->count_rw_groups);
+    for (i = 0; i < sim->count_rw_groups; i++)
+        rw_lock_save(w, sim->rw_locks[i]);
+    ckpt_put_u32(w, sim->count_sem_groups);
+    for (i = 0; i < sim->count_sem_groups; i++)
+        semaphore_save(w, sim->semaphores[i]);
+    ckpt_put_u32(w, sim->count_barrier_groups);
+    for (i = 0; i < sim->count_barrier_groups; i++)
+        barrier_save(w, sim->barriers[i]);
+
+    ckpt_put_u32(w, CKPT_IPC);
+    ipc_save(w, &sim->ipc);
+
+    ckpt_put_u32(w, CKPT_VMEM);
+    vm_save(w, sim->vm);
+
+    ckpt_put_u32(w, CKPT_END);
+    return ckpt_writer_close(w);
 }
 
-void prod_cons_trap() {
-    running_process->context->pc = cpu_pc - 1;
-    running_process->state = STATE_BLOCKED;
-    running_process = NULL;
-    scheduler(TRAP_PROD_CONS);
+/*
+ * Rebuilds the simulation state from a checkpoint, in place of the usual setup.
+ *
+ * Arguments: path: the file to read.
+ * Return: 1 if successful, 0 if the file is missing, damaged, or from a build
+ *         with a different PCB layout.
+ */
+int checkpoint_restore(sim_p sim, const char * path) {
+    ckpt_reader_p r = ckpt_reader_open(path);
+    ckpt_header_s header;
+    Lock_p * locks = NULL;
+    uint32_t num_locks, num_maps, count, i, l1, l2, pid;
+    int k;
+
+    if (r == NULL)
+        return 0;
+
+    ckpt_read(r, &header, sizeof(header));
+    if (header.magic != CKPT_MAGIC || header.version != CKPT_VERSION
+        || header.pcb_size != sizeof(PCB_s) || header.priorities != NUM_PRIORITIES) {
+        ckpt_reader_close(r);
+        return 0;
+    }
+
+    if (ckpt_expect(r, CKPT_GLOBALS))
+        checkpoint_globals(sim, NULL, r);
+
+    if (ckpt_expect(r, CKPT_PROC_TABLE))
+        pt_load(r, &sim->process_table);
+
+    buddy_destroy(&sim->phys_mem);
+    if (ckpt_expect(r, CKPT_BUDDY))
+        buddy_load(r, &sim->phys_mem);
+
+    if (ckpt_expect(r, CKPT_PCBS)) {
+        count = ckpt_get_u32(r);
+        for (i = 0; i < count && r->ok; i++)
+            PCB_load(r, &sim->process_table);
+    }
+
+    sim->ready_queue = pq_create(&sim->process_table);
+    sim->zombie_queue = q_create(&sim->process_table);
+    sim->new_queue = q_create(&sim->process_table);
+    for (k = 0; k < NUM_IO_DEVICES; k++)
+        sim->io_queues[k] = q_create(&sim->process_table);
+    sim->paging_queue = q_create(&sim->process_table);
+    if (ckpt_expect(r, CKPT_QUEUES)) {
+        q_load(r, sim->new_queue);
+        q_load(r, sim->zombie_queue);
+        for (k = 0; k < NUM_IO_DEVICES; k++)
+            q_load(r, sim->io_queues[k]);
+        for (k = 0; k < NUM_IO_DEVICES; k++)
+            ioq_load(r, &sim->io_requests[k]);
+        q_load(r, sim->paging_queue);
+        pq_load(r, sim->ready_queue);
+        sim->running_process = pt_lookup_pid(&sim->process_table, ckpt_get_u32(r));
+    }
+
+    if (ckpt_expect(r, CKPT_LOCKS)) {
+        num_locks = ckpt_get_u32(r);
+        if (num_locks > sim->process_table.used + MAX_PROD_CONS_PROC_PAIRS
+            || (locks = malloc(sizeof(Lock_p) * (num_locks + 1))) == NULL)
+            r->ok = 0;
+        for (i = 0; r->ok && i < num_locks; i++) {
+            locks[i] = lock_constructor(&sim->process_table);
+            locks[i]->current_proc = pt_lookup_pid(&sim->process_table, ckpt_get_u32(r));
+            locks[i]->acquired_at = ckpt_get_u32(r);
+            locks[i]->hold_avg8 = ckpt_get_u32(r);
+            locks[i]->inverted = ckpt_get_u32(r);
+            locks[i]->inverted_at = ckpt_get_u32(r);
+            q_load(r, locks[i]->waiting_procs);
+        }
+        num_maps = ckpt_get_u32(r);
+        for (i = 0; r->ok && i < num_maps; i++) {
+            l1 = ckpt_get_u32(r);
+            l2 = ckpt_get_u32(r);
+            pid = ckpt_get_u32(r);
+            if (l1 >= num_locks || l2 >= num_locks || pt_lookup_pid(&sim->process_table, pid) == NULL) {
+                r->ok = 0;
+                break;
+            }
+            proc_map_list_add(sim->list_of_locks, proc_map_constructor(locks[l1], locks[l2], pt_lookup_pid(&sim->process_table, pid)));
+        }
+        for (k = 0; r->ok && k < MAX_PROD_CONS_PROC_PAIRS; k++) {
+            l1 = ckpt_get_u32(r);
+            if (l1 == PT_NIL)
+                continue;
+            if (l1 >= num_locks) {
+                r->ok = 0;
+                break;
+            }
+            sim->prod_cons_locks[k] = locks[l1];
+            sim->prod_cons_cond_vars[k][0] = cond_variable_constructor(&sim->process_table);
+            sim->prod_cons_cond_vars[k][1] = cond_variable_constructor(&sim->process_table);
+            q_load(r, sim->prod_cons_cond_vars[k][0]->queue);
+            q_load(r, sim->prod_cons_cond_vars[k][1]->queue);
+        }
+        free(locks);
+    }
+
+    /* Groups are numbered by sync_id, so each kind is restored in order. */
+    if (ckpt_expect(r, CKPT_SYNC)) {
+        sim->count_rw_groups = ckpt_get_u32(r);
+        for (i = 0; r->ok && i < sim->count_rw_groups; i++) {
+            if (i >= MAX_SYNC_GROUPS || (sim->rw_locks[i] = rw_lock_load(r, &sim->process_table, sim->rw_mode)) == NULL)
+                r->ok = 0;
+        }
+        sim->count_sem_groups = ckpt_get_u32(r);
+        for (i = 0; r->ok && i < sim->count_sem_groups; i++) {
+            if (i >= MAX_SYNC_GROUPS || (sim->semaphores[i] = semaphore_load(r, &sim->process_table)) == NULL)
+                r->ok = 0;
+        }
+        sim->count_barrier_groups = ckpt_get_u32(r);
+        for (i = 0; r->ok && i < sim->count_barrier_groups; i++) {
+            if (i >= MAX_SYNC_GROUPS || (sim->barriers[i] = barrier_load(r, &sim->process_table)) == NULL)
+                r->ok = 0;
+        }
+    }
+
+    if (ckpt_expect(r, CKPT_IPC) && !ipc_load(r, &sim->ipc, &sim->process_table))
+        r->ok = 0;
+
+    if (ckpt_expect(r, CKPT_VMEM))
+        sim->vm = vm_load(r);
+
+    ckpt_expect(r, CKPT_END);
+    return ckpt_reader_close(r) && sim->vm != NULL;
 }
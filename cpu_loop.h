@@ -0,0 +1,410 @@
+/*
+ * TCSS 422 Scheduler Simulation
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ */
+
+#ifndef CPU_LOOP_H
+#define CPU_LOOP_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "pcb.h"
+#include "fifo_queue.h"
+#include "proc_table.h"
+#include "priority_queue.h"
+#include "mutex_lock.h"
+#include "cond_variable.h"
+#include "sync_prims.h"
+#include "ipc.h"
+#include "workload_trace.h"
+#include "workload_gen.h"
+#include "vmem.h"
+#include "buddy.h"
+#include "sim_stats.h"
+#include "mpsc_inbox.h"
+#include "io_ring.h"
+#include "io_sched.h"
+#include "sim_lock.h"
+#include "sim_profile.h"
+#include "json_writer.h"
+#include "replay_log.h"
+#include "quantum_tune.h"
+
+#define NUM_IO_DEVICES 2
+#define MAX_PROD_CONS_PROC_PAIRS 10
+#define MAX_SYNC_GROUPS 10 // of each kind: reader-writer, semaphore and barrier
+
+/* Event output, printed only by a verbose simulation. */
+#define SIM_LOG(sim, ...) do { if ((sim)->verbose) { PROF_SCOPE(PROF_PRINT); printf(__VA_ARGS__); } } while (0)
+
+/* How to set up a simulation. */
+typedef struct sim_options {
+    unsigned long long seed;
+    int seed_given;                  // reseed the generator after a restore
+    workload_gen_config_s config;
+    const char * generator_spec;     // applied again on top of a restored generator, may be NULL
+    const char * trace_path;         // workload to replay, NULL to generate one
+    const char * checkpoint_path;    // where to write a checkpoint, NULL for never
+    unsigned int checkpoint_iteration;
+    const char * restore_path;       // checkpoint to start from, NULL for a fresh system
+    int verbose;                     // print every event
+    int lockstep;                    // step the timer and IO devices from the cpu loop instead of threads
+    const char * stats_name;         // shared memory object to publish live statistics in, may be NULL
+    enum io_policy io_policy;        // how lockstep IO devices order their requests
+    unsigned int io_depth;           // requests a lockstep IO device takes at once
+    int io_policy_given;             // apply the policy to a restored run as well
+    enum lock_mode lock_mode;        // what a MUTEX process does when its lock is held
+    enum rw_mode rw_mode;            // who reader-writer locks let in first
+    int no_inherit;                  // leave lock holders at their own priority
+    const char * dump_prefix;        // state dumps go to <prefix>.<seed>.<iteration>.json
+    const char * record_path;        // log the device threads' decisions here, NULL for none
+    const char * replay_path;        // replay a logged run instead of starting device threads, NULL for none
+    enum tune_goal tune_goal;        // what to tune the quanta and S toward, TUNE_OFF to keep them
+    double tune_target;
+} sim_options_s;
+
+typedef struct sim sim_s;
+typedef sim_s * sim_p;
+
+/*
+ * Lock order. A thread holding one of these locks only takes locks further
+ * down the list, so no two threads can wait for each other:
+ *
+ *   registry_lock  list_of_locks, the mutex pairs' lock maps
+ *   new_lock       new_queue
+ *   ready_lock     ready_queue
+ *   io_locks[d]    io_queues[d] and its wakeup io_conds[d], in device order
+ *   zombie_lock    zombie_queue
+ *   table_lock     the process table's slot array while it grows
+ *
+ * The running process, the cpu registers, the paging queue and the counters
+ * belong to the cpu thread and take no lock. The timer thread only raises
+ * timer_pending and IO device threads only take their own queue's lock, the
+ * table lock while they follow queue links, and push to io_done; neither
+ * waits for the cpu loop.
+ */
+enum lock_rank {
+    LOCK_RANK_REGISTRY,
+    LOCK_RANK_NEW,
+    LOCK_RANK_READY,
+    LOCK_RANK_IO,
+    LOCK_RANK_ZOMBIE = LOCK_RANK_IO + NUM_IO_DEVICES,
+    LOCK_RANK_TABLE,
+    LOCK_RANK_COUNT,
+};
+
+/* What an IO device thread is started with. */
+typedef struct sim_device {
+    sim_p sim;
+    unsigned int id;
+} sim_device_s;
+
+/*
+ * One simulated machine. Everything a run touches lives here, so any number of
+ * simulations can run side by side in one process.
+ */
+struct sim {
+    /* Process counts, by type, and the totals ever created. */
+    int count_io_procs;
+    int count_comp_procs;
+    int count_mutex_procs;
+    int count_terminated;
+    int count_prod_cons_procs;
+    int count_forked_procs;
+    int curr_prod_cons_id;
+    int io_total;
+    int intensive_total;
+    int mutex_total;
+
+    int prod_cons_globals[MAX_PROD_CONS_PROC_PAIRS][2]; // second dimension index 0 is counter incremented, index 1 is flip
+    c_Variable_p prod_cons_cond_vars[MAX_PROD_CONS_PROC_PAIRS][2]; // second dimension index 0 is fill, index 1 is empty
+    Lock_p prod_cons_locks[MAX_PROD_CONS_PROC_PAIRS];
+
+    /* The primitives of the READER/WRITER, SEM and BARRIER groups, by sync_id. */
+    rw_lock_p rw_locks[MAX_SYNC_GROUPS];
+    semaphore_p semaphores[MAX_SYNC_GROUPS];
+    barrier_p barriers[MAX_SYNC_GROUPS];
+    unsigned int count_rw_groups;
+    unsigned int count_sem_groups;
+    unsigned int count_barrier_groups;
+    int sync_total;
+
+    /* The pipes and mailboxes of the SENDER and RECEIVER groups, by channel. */
+    ipc_s ipc;
+    int count_ipc_procs;
+    int ipc_total;
+
+    proc_map_list_p list_of_locks;
+    int deadlock_check_counter;
+    int deadlock_flag;
+
+    /* Locks, in lock order; see above. */
+    sim_lock_s registry_lock;
+    sim_lock_s new_lock;
+    sim_lock_s ready_lock;
+    sim_lock_s io_locks[NUM_IO_DEVICES];
+    sim_lock_s zombie_lock;
+    sim_lock_s table_lock;
+    /* Signalled when a request is queued on an IO device, or the run ends. */
+    pthread_cond_t io_conds[NUM_IO_DEVICES];
+    /* Raised by the timer thread, taken by the cpu at the start of its next cycle. */
+    int timer_pending;
+
+    /* Cleared by the cpu when the run ends; the device threads read it, so every access is atomic. */
+    int program_executing;
+
+    pthread_t timer_thread;
+    pthread_t io_threads[NUM_IO_DEVICES];
+    sim_device_s devices[NUM_IO_DEVICES];
+
+    /* Every pcb of this simulation is registered here. */
+    proc_table_s process_table;
+    /* Simulated physical memory that process images are allocated from. */
+    buddy_s phys_mem;
+
+    /* A queue of new processes. */
+    FIFOq_p new_queue;
+    /* A queue of processes that are ready to run. */
+    PQ_p ready_queue;
+    /* All the processes that are zombies. */
+    FIFOq_p zombie_queue;
+    /* Array of IO device queues. */
+    FIFOq_p io_queues[NUM_IO_DEVICES];
+    /* Array of IO timers. */
+    unsigned int io_queue_timers[NUM_IO_DEVICES];
+    /* Requests the IO device threads have completed, for the cpu to make ready. */
+    mpsc_inbox_s io_done;
+    /*
+     * Lockstep devices only: the requests waiting for each device, in arrival
+     * order, both blocking traps (whose processes also wait in io_queues) and
+     * requests submitted through IO rings. The disk's policy picks from them.
+     */
+    io_request_queue_s io_requests[NUM_IO_DEVICES];
+    disk_s disks[NUM_IO_DEVICES];
+    /* Lockstep IO latency, submission to completion, over every device. */
+    lat_hist_s io_latency_hist;
+    /* Lockstep IO accounting, per device and split by blocking and asynchronous requests. */
+    unsigned long long io_busy_cycles[NUM_IO_DEVICES];
+    unsigned long long io_completed[2];
+    unsigned long long io_latency[2];
+    /* Requests submitted through IO rings, and times a process blocked waiting on its ring. */
+    unsigned long long ring_submits;
+    unsigned long long ring_waits;
+    /* Instructions retired by IO processes. */
+    unsigned long long io_instructions;
+    /*
+     * MUTEX lock attempts that found the lock held, counting a spin and the
+     * retries within it once; of those, spins that ended holding the lock and
+     * spins that gave up and blocked; cycles spent spinning; and blocks.
+     */
+    unsigned long long lock_contended;
+    unsigned long long spin_acquired;
+    unsigned long long spin_failed;
+    unsigned long long spin_cycles;
+    unsigned long long lock_blocks;
+    /* Times a READER, WRITER, SEM or BARRIER process blocked. */
+    unsigned long long sync_blocks;
+    /*
+     * Priority inversions on MUTEX and prod/cons locks: from a process
+     * blocking behind a holder of lower priority until the holder releases,
+     * their total and longest cycles, and holders raised by inheritance.
+     */
+    unsigned long long inversions;
+    unsigned long long inversion_cycles;
+    unsigned int inversion_max;
+    unsigned long long inheritances;
+    /*
+     * Forks, and those refused at a process cap or for want of page tables;
+     * the pages forks shared, the deepest generation of children, and the
+     * kernel cycles charged to forks and to copy-on-write faults.
+     */
+    unsigned long long forks;
+    unsigned long long forks_refused;
+    unsigned long long fork_pages;
+    unsigned int fork_depth;
+    unsigned long long fork_cycles;
+    unsigned long long cow_cycles;
+    /* Kernel cycles charged to sends and receives. */
+    unsigned long long ipc_cycles;
+    /* Processes waiting for a page to be loaded. */
+    FIFOq_p paging_queue;
+    /* Downcounter for the page-in at the head of the paging queue. */
+    unsigned int paging_timer;
+    /* Simulated virtual memory. */
+    vmem_p vm;
+    /* Stall cycles left before the running process executes, after a context switch. */
+    unsigned int switch_stall;
+    /* Cycles of kernel work, a fork or a page copy, the running process waits for. */
+    unsigned int kernel_stall;
+    /* Dispatches so far, used to tell how many other processes ran in between. */
+    unsigned int dispatch_count;
+    /* Cycles spent running a process of each priority, switch stalls included. */
+    unsigned long long busy_cycles[NUM_PRIORITIES];
+    /* Cycles lost to context switching, by priority of the incoming process. */
+    unsigned long long switch_cycles[NUM_PRIORITIES];
+    /* Scheduler passes in which the head of the new queue did not fit in memory. */
+    unsigned long long admission_stalls;
+
+    /* The currently running process. */
+    PCB_p running_process;
+    /* An array of the amount of cycles alloted to each priority. */
+    unsigned int quantum_times[NUM_PRIORITIES];
+    /* The number of cycles since we last reset the prioties. */
+    unsigned int cpu_cycles_since_reset;
+    /* The number of cycles that we reset the priority at. */
+    unsigned int S;
+    /* Downcounter for the timer device */
+    unsigned int timer_downcounter;
+    /* The number of instructions since the cpu started. */
+    unsigned int current_iteration;
+    /* CPU PC. */
+    unsigned int cpu_pc;
+    /* PC at the top of the system stack. */
+    unsigned int sys_stack;
+    /* Workload being replayed, NULL when processes are generated randomly. */
+    trace_reader_p workload_trace;
+    /* Generator for random processes and their arrival times. */
+    workload_gen_s generator;
+
+    /* Seed for the generator and the IO devices. */
+    unsigned long long seed;
+    /* Set when a seed was given, so a restored run is reseeded. */
+    int seed_given;
+    /* Generator spec, applied on top of a restored generator as well. */
+    const char * generator_spec;
+    /* Where and when to write a checkpoint, NULL for never. */
+    const char * checkpoint_path;
+    unsigned int checkpoint_iteration;
+    /* Checkpoint to start from instead of a fresh system, NULL for none. */
+    const char * restore_path;
+    /* IO policy and depth, applied on top of a restored run if given. */
+    enum io_policy io_policy;
+    unsigned int io_depth;
+    int io_policy_given;
+    /* What a MUTEX process does when its lock is held. */
+    enum lock_mode lock_mode;
+    /* Who new reader-writer locks let in first. */
+    enum rw_mode rw_mode;
+    /* 1 if a lock holder inherits the priority of a higher priority waiter. */
+    int inherit;
+
+    int verbose;
+    int lockstep;
+
+    /* Live statistics for outside readers, NULL when not published. */
+    stats_page_p stats;
+    const char * stats_name;
+
+    /* State dumps: the file prefix, the writer, kept for the next one, and the requests served. */
+    const char * dump_prefix;
+    json_writer_p dump_writer;
+    sig_atomic_t dumps_taken;
+
+    /*
+     * Record or replay of what the timer and IO device threads decided, NULL
+     * if neither. A replay runs no device threads; a run that stops following
+     * its log is ended.
+     */
+    replay_writer_p record;
+    replay_reader_p replay;
+    int replay_diverged;
+
+    /* Online tuning of the quanta and S, and the goal it steers toward. */
+    enum tune_goal tune_goal;
+    double tune_target;
+    tuner_s tuner;
+};
+
+/* Bumped for every state dump asked for, by SIGUSR1; each simulation dumps once per bump. */
+extern volatile sig_atomic_t dump_requests;
+
+/* The outcome of a finished run. */
+typedef struct sim_results {
+    unsigned int cycles;
+    unsigned int created;
+    unsigned int terminated;
+    unsigned int context_switches;
+    double utilization;      // share of cycles a process was running
+    double switch_loss;      // share of busy cycles lost to context switches
+    double tlb_hit_rate;
+    unsigned long long page_faults;
+    unsigned long long admission_stalls;
+    double fragmentation;    // external fragmentation of physical memory at the end
+    int deadlocked;          // 1 if a deadlock was detected at least once
+    double io_utilization;   // share of cycles the IO devices were busy, averaged over devices
+    unsigned long long io_completed;    // IO requests served, blocking and asynchronous
+    double io_latency;       // mean cycles from reaching a device to completion
+    double io_latency_p50;
+    double io_latency_p95;
+    double io_latency_p99;
+    double io_queue_depth;   // mean requests outstanding per device
+    unsigned long long io_instructions; // instructions retired by IO processes
+    unsigned long long lock_blocks;     // times a MUTEX process blocked on a held lock
+    unsigned long long spin_cycles;     // cycles MUTEX processes spent spinning
+    double spin_success;     // share of spins that ended holding the lock
+    unsigned long long sync_blocks;     // times a READER, WRITER, SEM or BARRIER process blocked
+    double shared_reads;     // share of read acquisitions made alongside other readers
+    unsigned long long inversions;      // times a lock holder kept a higher priority process waiting
+    double inversion_cycles; // mean cycles an inversion lasted
+    unsigned int inversion_max;
+    unsigned long long forks;
+    unsigned long long cow_copies;      // pages copied on a write to a page shared by a fork
+    unsigned long long ipc_messages;    // messages received through pipes and mailboxes
+    double ipc_latency;      // mean cycles from send to receive
+    double ipc_latency_p99;
+} sim_results_s;
+
+/*
+ * Creates a simulation and sets up its machine, either fresh or from a
+ * checkpoint. Nothing runs until sim_run.
+ *
+ * Arguments: options: how to set it up.
+ * Return: the new simulation, NULL if it could not be set up.
+ */
+sim_p sim_create(/* in */ const sim_options_s * options);
+
+/*
+ * Runs a simulation until its iteration limit. Unless it is lockstep, this
+ * starts the timer and IO device threads and waits for them to finish.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_run(/* in-out */ sim_p sim);
+
+/*
+ * Collects the outcome of a finished run.
+ *
+ * Arguments: sim: the simulation.
+ *            results: where to store it.
+ */
+void sim_results(/* in */ sim_p sim, /* out */ sim_results_s * results);
+
+/*
+ * Prints the end of run report.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_report(/* in */ sim_p sim);
+
+/*
+ * Writes the scheduler state as JSON to <dump_prefix>.<seed>.<iteration>.json:
+ * the queues, every process, the locks and other primitives, the IO devices
+ * and memory. Only reads the simulation, and allocates nothing after the
+ * first dump, so a run that dumps goes on exactly as one that does not.
+ * Must be called from the cpu thread.
+ *
+ * Arguments: sim: the simulation.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int sim_dump_state(/* in */ sim_p sim);
+
+/*
+ * Frees a simulation and every process still in it.
+ *
+ * Arguments: sim: the simulation.
+ */
+void sim_destroy(/* in-out */ sim_p sim);
+
+#endif
@@ -17,15 +17,17 @@
 /*
  * Create a new FIFO Queue.
  *
+ * Arguments: table: the process table of the pcbs it will hold.
  * Return: a pointer to a new FIFO queue, NULL if unsuccessful.
  */
-FIFOq_p q_create() {
+FIFOq_p q_create(/* in */ proc_table_p table) {
     FIFOq_p new_queue = malloc(sizeof(FIFOq_s));
 
     if (new_queue != NULL) {
-        new_queue->first_node = NULL;
-        new_queue->last_node = NULL;
+        new_queue->first = PT_NIL;
+        new_queue->last = PT_NIL;
         new_queue->size = 0;
+        new_queue->table = table;
     }
 
     return new_queue;
@@ -38,14 +40,13 @@ FIFOq_p q_create() {
  * This will also free all PCBs, to prevent any leaks. Do not use on a non empty queue if processing is still going to occur on a pcb.
  */
 void q_destroy(/* in-out */ FIFOq_p FIFOq) {
-    Node_p iter = FIFOq->first_node;
-    Node_p curr = NULL;
+    uint32_t iter = FIFOq->first;
+    uint32_t curr;
 
-    while (iter != NULL) {
+    while (iter != PT_NIL) {
         curr = iter;
-        iter = iter->next;
-        PCB_destroy(curr->pcb);
-        free(curr);
+        iter = PT_SLOT(FIFOq->table, iter).next;
+        PCB_destroy(FIFOq->table, PT_SLOT(FIFOq->table, curr).pcb);
     }
     free(FIFOq);
 }
@@ -57,7 +58,7 @@ void q_destroy(/* in-out */ FIFOq_p FIFOq) {
  * Return: 1 if empty, 0 otherwise.
  */
 char q_is_empty(/* in */ FIFOq_p FIFOq) {
-    return (FIFOq->first_node == NULL);
+    return (FIFOq->first == PT_NIL);
 }
 
 /*
@@ -68,24 +69,27 @@ char q_is_empty(/* in */ FIFOq_p FIFOq) {
  * Return: 1 if successful, 0 if unsuccessful.
  */
 int q_enqueue(/* in */ FIFOq_p FIFOq, /* in */ PCB_p pcb) {
-    Node_p new_node = malloc(sizeof(Node_s));
-
-    if (new_node != NULL) {
-        new_node->pcb = pcb;
-        new_node->next = NULL;
-
-        if (FIFOq->last_node != NULL) {
-            FIFOq->last_node->next = new_node;
-            FIFOq->last_node = new_node;
-        } else {
-            FIFOq->first_node = new_node;
-            FIFOq->last_node = new_node;
-        }
+    uint32_t index;
+
+    if (pcb == NULL || PT_SLOT(FIFOq->table, pcb->pid).queued) {
+        return 0;
+    }
 
-        FIFOq->size++;
+    index = pcb->pid;
+    PT_SLOT(FIFOq->table, index).next = PT_NIL;
+    PT_SLOT(FIFOq->table, index).queued = 1;
+
+    if (FIFOq->last != PT_NIL) {
+        PT_SLOT(FIFOq->table, FIFOq->last).next = index;
+        FIFOq->last = index;
+    } else {
+        FIFOq->first = index;
+        FIFOq->last = index;
     }
 
-    return new_node != NULL;
+    FIFOq->size++;
+
+    return 1;
 }
 
 /*
@@ -96,26 +100,86 @@ int q_enqueue(/* in */ FIFOq_p FIFOq, /* in */ PCB_p pcb) {
  */
 PCB_p q_dequeue(/* in-out */ FIFOq_p FIFOq) {
     PCB_p ret_pcb = NULL;
-    Node_p ret_node = FIFOq->first_node;
+    uint32_t ret_index = FIFOq->first;
 
-    if (ret_node != NULL) {
-        FIFOq->first_node = ret_node->next;
+    if (ret_index != PT_NIL) {
+        FIFOq->first = PT_SLOT(FIFOq->table, ret_index).next;
 
         FIFOq->size--;
 
-        /* If the user has dequeued the final node, set the last node to null. */
-        if (FIFOq->first_node == NULL) {
-            FIFOq->last_node = NULL;
+        /* If the user has dequeued the final node, set the last node to nil. */
+        if (FIFOq->first == PT_NIL) {
+            FIFOq->last = PT_NIL;
         }
 
-        ret_pcb = ret_node->pcb;
-
-        free(ret_node);
+        ret_pcb = PT_SLOT(FIFOq->table, ret_index).pcb;
+        PT_SLOT(FIFOq->table, ret_index).queued = 0;
     }
 
     return ret_pcb;
 }
 
+/*
+ * Removes a pcb from anywhere in the queue, keeping the others in order.
+ * Walks the queue, so it is O(n).
+ *
+ * Arguments: FIFOq: the queue to remove from.
+ *            pcb: the PCB to remove.
+ * Return: 1 if it was removed, 0 if it was not in this queue.
+ */
+int q_remove(/* in-out */ FIFOq_p FIFOq, /* in */ PCB_p pcb) {
+    uint32_t prev = PT_NIL;
+    uint32_t iter = FIFOq->first;
+
+    while (iter != PT_NIL && iter != pcb->pid) {
+        prev = iter;
+        iter = PT_SLOT(FIFOq->table, iter).next;
+    }
+    if (iter == PT_NIL) {
+        return 0;
+    }
+
+    if (prev == PT_NIL) {
+        FIFOq->first = PT_SLOT(FIFOq->table, iter).next;
+    } else {
+        PT_SLOT(FIFOq->table, prev).next = PT_SLOT(FIFOq->table, iter).next;
+    }
+    if (FIFOq->last == iter) {
+        FIFOq->last = prev;
+    }
+
+    FIFOq->size--;
+    PT_SLOT(FIFOq->table, iter).queued = 0;
+
+    return 1;
+}
+
+/*
+ * Moves every node of src onto the back of dest in O(1), leaving src empty.
+ * Node order is preserved, so the result is the same as dequeuing each node
+ * from src and enqueuing it to dest. Both queues must share a process table.
+ *
+ * Arguments: dest: the queue to append to.
+ *            src: the queue to take the nodes from.
+ */
+void q_splice(/* in-out */ FIFOq_p dest, /* in-out */ FIFOq_p src) {
+    if (src->first == PT_NIL) {
+        return;
+    }
+
+    if (dest->last != PT_NIL) {
+        PT_SLOT(dest->table, dest->last).next = src->first;
+    } else {
+        dest->first = src->first;
+    }
+    dest->last = src->last;
+    dest->size += src->size;
+
+    src->first = PT_NIL;
+    src->last = PT_NIL;
+    src->size = 0;
+}
+
 /*
  * Peeks at the front of the FIFO queue.
  *
@@ -124,10 +188,9 @@ PCB_p q_dequeue(/* in-out */ FIFOq_p FIFOq) {
  */
 PCB_p q_peek(/* in */ FIFOq_p FIFOq) {
     PCB_p ret_pcb = NULL;
-    Node_p ret_node = FIFOq->first_node;
 
-    if (ret_node != NULL) {
-        ret_pcb = ret_node->pcb;
+    if (FIFOq->first != PT_NIL) {
+        ret_pcb = PT_SLOT(FIFOq->table, FIFOq->first).pcb;
     }
 
     return ret_pcb;
@@ -142,7 +205,7 @@ PCB_p q_peek(/* in */ FIFOq_p FIFOq) {
  * freeing consumed memory.
  */
 char * q_to_string(/* in */ FIFOq_p FIFOq, /* in */ char display_back) {
-    Node_p iter = FIFOq->first_node;
+    uint32_t iter = FIFOq->first;
 
     unsigned int buff_len = 1000;
     unsigned int cpos = 0;
@@ -156,14 +219,14 @@ char * q_to_string(/* in */ FIFOq_p FIFOq, /* in */ char display_back) {
         cpos += sprintf(ret_str, "Q:Count=%u: ", FIFOq->size);
 
         /* While we have nodes to iterate through: */
-        while (iter != NULL) {
+        while (iter != PT_NIL) {
             /* Make sure we have enough capacity to sprintf. */
             str_resize = resize_block_if_needed(ret_str, cpos + PROCESS_QUEUE_DISPLAY_LENGTH, &buff_len);
             if (str_resize != NULL) {
                 /* If it succeeded, we need to shift to the (possibly same) pointer location. */
                 ret_str = str_resize;
-                cpos += sprintf(ret_str + cpos, "P%u-", iter->pcb->pid);
-                if (iter->next != NULL) {
+                cpos += sprintf(ret_str + cpos, "P%u-", iter);
+                if (PT_SLOT(FIFOq->table, iter).next != PT_NIL) {
                     cpos += sprintf(ret_str + cpos, ">");
                 } else {
                     cpos += sprintf(ret_str + cpos, "*");
@@ -172,14 +235,14 @@ char * q_to_string(/* in */ FIFOq_p FIFOq, /* in */ char display_back) {
                 /* If it failed, might as well end the loop. */
                 break;
             }
-            iter = iter->next;
+            iter = PT_SLOT(FIFOq->table, iter).next;
         }
 
         /* Write the last PCB to our string: */
-        if (FIFOq->last_node != NULL && display_back == 1) {
+        if (FIFOq->last != PT_NIL && display_back == 1) {
             /* There is enough space in PROCESS_QUEUE_DISPLAY_LENGTH to allow for this addition without any additional change */
             cpos += sprintf(ret_str + cpos, " : ");
-            char * PCB_string = PCB_to_string(FIFOq->last_node->pcb);
+            char * PCB_string = PCB_to_string(PT_SLOT(FIFOq->table, FIFOq->last).pcb);
 
             if (PCB_string != NULL) {
                 pcb_str_len = strlen(PCB_string);
@@ -227,3 +290,34 @@ void * resize_block_if_needed(/* in */ void * in_ptr, /* in */ unsigned int end_
 
 #undef PROCESS_QUEUE_DISPLAY_LENGTH
 #undef POST_OUTPUT_BUFFER
+
+/*
+ * Writes a queue to a checkpoint. The links themselves live in the process table.
+ *
+ * Arguments: w: the checkpoint.
+ *            FIFOq: the queue to write.
+ */
+void q_save(/* in-out */ ckpt_writer_p w, /* in */ FIFOq_p FIFOq) {
+    ckpt_put_u32(w, FIFOq->first);
+    ckpt_put_u32(w, FIFOq->last);
+    ckpt_put_u32(w, FIFOq->size);
+}
+
+/*
+ * Reads a queue back from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            FIFOq: the queue to overwrite.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int q_load(/* in-out */ ckpt_reader_p r, /* out */ FIFOq_p FIFOq) {
+    FIFOq->first = ckpt_get_u32(r);
+    FIFOq->last = ckpt_get_u32(r);
+    FIFOq->size = ckpt_get_u32(r);
+    if (!r->ok) {
+        FIFOq->first = PT_NIL;
+        FIFOq->last = PT_NIL;
+        FIFOq->size = 0;
+    }
+    return r->ok;
+}
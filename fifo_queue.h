@@ -8,21 +8,20 @@
 #define FIFO_QUEUE_H
 
 #include "pcb.h"
+#include "proc_table.h"
 
-/* A node used in a fifo queue to store data, and the next node. */
-typedef struct node {
-    struct node * next;
-    PCB_p         pcb;
-} Node_s;
-
-typedef Node_s * Node_p;
-
-/* A fifo queue, which stores size and pointers to the first and last nodes. */
+/*
+ * A fifo queue, which stores size and the process table indices of the first and
+ * last pcbs. The queue is intrusive: each pcb's link lives in its process table
+ * slot, so enqueue and dequeue never allocate and a pcb can be in at most one
+ * queue at a time.
+ */
 typedef struct fifo_queue {
-    Node_p first_node;
-    Node_p last_node;
+    uint32_t first;
+    uint32_t last;
 
     unsigned int size;
+    proc_table_p table; // the table holding the links
 } FIFOq_s;
 
 typedef FIFOq_s * FIFOq_p;
@@ -30,9 +29,10 @@ typedef FIFOq_s * FIFOq_p;
 /*
  * Create a new FIFO Queue.
  *
+ * Arguments: table: the process table of the pcbs it will hold.
  * Return: a pointer to a new FIFO queue, NULL if unsuccessful.
  */
-FIFOq_p q_create();
+FIFOq_p q_create(/* in */ proc_table_p table);
 
 /*
  * Destroy a FIFO queue and all of its internal nodes.
@@ -54,8 +54,8 @@ char q_is_empty(/* in */ FIFOq_p FIFOq);
  * Attempts to enqueue the provided pcb.
  *
  * Arguments: FIFOq: the queue to enqueue to.
- *            pcb: the PCB to enqueue.
- * Return: 1 if successful, 0 if unsuccessful.
+ *            pcb: the PCB to enqueue, registered in the process table.
+ * Return: 1 if successful, 0 if the pcb is NULL or already in a queue.
  */
 int q_enqueue(/* in */ FIFOq_p FIFOq, /* in */ PCB_p pcb);
 
@@ -67,6 +67,26 @@ int q_enqueue(/* in */ FIFOq_p FIFOq, /* in */ PCB_p pcb);
  */
 PCB_p q_dequeue(/* in-out */ FIFOq_p FIFOq);
 
+/*
+ * Removes a pcb from anywhere in the queue, keeping the others in order.
+ * Walks the queue, so it is O(n).
+ *
+ * Arguments: FIFOq: the queue to remove from.
+ *            pcb: the PCB to remove.
+ * Return: 1 if it was removed, 0 if it was not in this queue.
+ */
+int q_remove(/* in-out */ FIFOq_p FIFOq, /* in */ PCB_p pcb);
+
+/*
+ * Moves every node of src onto the back of dest in O(1), leaving src empty.
+ * Node order is preserved, so the result is the same as dequeuing each node
+ * from src and enqueuing it to dest. Both queues must share a process table.
+ *
+ * Arguments: dest: the queue to append to.
+ *            src: the queue to take the nodes from.
+ */
+void q_splice(/* in-out */ FIFOq_p dest, /* in-out */ FIFOq_p src);
+
 /*
  * Peeks at the front of the FIFO queue.
  *
@@ -85,6 +105,23 @@ PCB_p q_peek(/* in */ FIFOq_p FIFOq);
  */
 char * q_to_string(/* in */ FIFOq_p FIFOq, /* in */ char display_back);
 
+/*
+ * Writes a queue to a checkpoint. The links themselves live in the process table.
+ *
+ * Arguments: w: the checkpoint.
+ *            FIFOq: the queue to write.
+ */
+void q_save(/* in-out */ ckpt_writer_p w, /* in */ FIFOq_p FIFOq);
+
+/*
+ * Reads a queue back from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            FIFOq: the queue to overwrite.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int q_load(/* in-out */ ckpt_reader_p r, /* out */ FIFOq_p FIFOq);
+
 /*
  * Helper function that resizes a malloced block of memory if the requested
  *   ending position would exceed the block's capacity.
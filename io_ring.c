@@ -0,0 +1,199 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+
+#include "io_ring.h"
+
+#define IOQ_INITIAL_CAPACITY 16
+
+/*
+ * Return: 1 if another request can be queued, counting queued, in flight and unreaped ones.
+ */
+int io_ring_has_room(/* in */ io_ring_p ring) {
+    return IO_RING_SQ_PENDING(ring) + ring->in_flight + IO_RING_CQ_READY(ring) < IO_RING_ENTRIES;
+}
+
+/*
+ * Process side: queues a request.
+ * Pre: io_ring_has_room.
+ *
+ * Arguments: ring: the rings.
+ *            device: the device it is for.
+ */
+void io_ring_submit(/* in-out */ io_ring_p ring, /* in */ unsigned int device) {
+    io_sqe_p sqe = &ring->sq[ring->sq_tail & IO_RING_MASK];
+
+    sqe->tag = ring->next_tag++;
+    sqe->device = device;
+    ring->sq_tail++;
+}
+
+/*
+ * Kernel side: takes the oldest queued request and counts it in flight.
+ *
+ * Arguments: ring: the rings.
+ *            sqe: where to store it.
+ * Return: 1 if there was one, 0 if the submission ring is empty.
+ */
+int io_ring_take(/* in-out */ io_ring_p ring, /* out */ io_sqe_s * sqe) {
+    if (IO_RING_SQ_PENDING(ring) == 0)
+        return 0;
+    *sqe = ring->sq[ring->sq_head & IO_RING_MASK];
+    ring->sq_head++;
+    ring->in_flight++;
+    return 1;
+}
+
+/*
+ * Device side: posts the completion of an in flight request.
+ *
+ * Arguments: ring: the rings.
+ *            tag: the request's tag.
+ *            device: the device that served it.
+ *            latency: cycles from submission to completion.
+ */
+void io_ring_complete(/* in-out */ io_ring_p ring, /* in */ uint16_t tag, /* in */ unsigned int device, /* in */ uint32_t latency) {
+    io_cqe_s * cqe = &ring->cq[ring->cq_tail & IO_RING_MASK];
+
+    cqe->tag = tag;
+    cqe->device = device;
+    cqe->latency = latency;
+    ring->cq_tail++;
+    ring->in_flight--;
+}
+
+/*
+ * Process side: takes the oldest completion.
+ *
+ * Arguments: ring: the rings.
+ *            cqe: where to store it.
+ * Return: 1 if there was one, 0 if the completion ring is empty.
+ */
+int io_ring_reap(/* in-out */ io_ring_p ring, /* out */ io_cqe_s * cqe) {
+    if (IO_RING_CQ_READY(ring) == 0)
+        return 0;
+    *cqe = ring->cq[ring->cq_head & IO_RING_MASK];
+    ring->cq_head++;
+    return 1;
+}
+
+/*
+ * Sets up an empty queue.
+ *
+ * Arguments: queue: the queue.
+ */
+void ioq_init(/* out */ io_request_queue_p queue) {
+    queue->entries = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+    queue->size = 0;
+}
+
+/*
+ * Frees a queue's storage.
+ *
+ * Arguments: queue: the queue.
+ */
+void ioq_destroy(/* in-out */ io_request_queue_p queue) {
+    free(queue->entries);
+    ioq_init(queue);
+}
+
+/*
+ * Appends a request, growing the queue if it is full.
+ *
+ * Arguments: queue: the queue.
+ *            request: the request.
+ * Return: 1 if successful, 0 if out of memory.
+ */
+int ioq_push(/* in-out */ io_request_queue_p queue, /* in */ const io_request_s * request) {
+    if (queue->size == queue->capacity) {
+        uint32_t capacity = queue->capacity ? queue->capacity * 2 : IOQ_INITIAL_CAPACITY;
+        io_request_s * entries = malloc(capacity * sizeof(io_request_s));
+        uint32_t i;
+
+        if (entries == NULL)
+            return 0;
+        /* Unwrap the old entries to the front of the new array. */
+        for (i = 0; i < queue->size; i++)
+            entries[i] = queue->entries[(queue->head + i) & (queue->capacity - 1)];
+        free(queue->entries);
+        queue->entries = entries;
+        queue->capacity = capacity;
+        queue->head = 0;
+    }
+
+    queue->entries[(queue->head + queue->size) & (queue->capacity - 1)] = *request;
+    queue->size++;
+    return 1;
+}
+
+/*
+ * Removes the oldest request.
+ *
+ * Arguments: queue: the queue.
+ *            request: where to store it.
+ * Return: 1 if there was one, 0 if the queue is empty.
+ */
+int ioq_pop(/* in-out */ io_request_queue_p queue, /* out */ io_request_s * request) {
+    if (queue->size == 0)
+        return 0;
+    *request = queue->entries[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->size--;
+    return 1;
+}
+
+/*
+ * Removes any request, keeping the others in arrival order. The requests
+ * older than it shift by one, so removing near the head is cheapest.
+ *
+ * Arguments: queue: the queue.
+ *            index: which, 0 for the oldest; must be below the size.
+ *            request: where to store it.
+ */
+void ioq_remove(/* in-out */ io_request_queue_p queue, /* in */ uint32_t index, /* out */ io_request_s * request) {
+    uint32_t i;
+
+    *request = *IOQ_AT(queue, index);
+    for (i = index; i > 0; i--)
+        *IOQ_AT(queue, i) = *IOQ_AT(queue, i - 1);
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->size--;
+}
+
+/*
+ * Writes a queue's requests, oldest first, to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            queue: the queue.
+ */
+void ioq_save(/* in-out */ ckpt_writer_p w, /* in */ io_request_queue_p queue) {
+    uint32_t i;
+
+    ckpt_put_u32(w, queue->size);
+    for (i = 0; i < queue->size; i++)
+        ckpt_put(w, IOQ_AT(queue, i), sizeof(io_request_s));
+}
+
+/*
+ * Reads requests back from a checkpoint onto an empty queue.
+ *
+ * Arguments: r: the checkpoint.
+ *            queue: the queue.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int ioq_load(/* in-out */ ckpt_reader_p r, /* in-out */ io_request_queue_p queue) {
+    uint32_t count = ckpt_get_u32(r), i;
+    io_request_s request;
+
+    for (i = 0; i < count && r->ok; i++) {
+        if (!ckpt_read(r, &request, sizeof(request)) || !ioq_push(queue, &request))
+            return 0;
+    }
+    return r->ok;
+}
@@ -0,0 +1,190 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <stdint.h>
+
+#include "checkpoint.h"
+
+#define IO_RING_ENTRIES 4 // per ring, a power of two
+#define IO_RING_MASK (IO_RING_ENTRIES - 1)
+
+/* A request the process queued: which device, and a tag to match its completion. */
+typedef struct io_sqe {
+    uint16_t tag;
+    uint8_t device;
+    uint8_t pad;
+} io_sqe_s;
+
+typedef io_sqe_s * io_sqe_p;
+
+/* A finished request: its tag and device, and how many cycles it took. */
+typedef struct io_cqe {
+    uint16_t tag;
+    uint8_t device;
+    uint8_t pad;
+    uint32_t latency;
+} io_cqe_s;
+
+/*
+ * Submission and completion rings of one process, after io_uring. The process
+ * queues requests on the submission ring and carries on running; the kernel
+ * takes them to the devices when the process enters it, and devices post to
+ * the completion ring when they finish, without waking the process. The
+ * process blocks only when it waits for completions, or when every entry is
+ * in use. Indices run freely and are masked, so head == tail means empty.
+ *
+ * At most IO_RING_ENTRIES requests are queued, in flight or completed but not
+ * yet reaped at once, so the completion ring can never overflow.
+ */
+typedef struct io_ring {
+    uint16_t sq_head;   // next entry the kernel takes
+    uint16_t sq_tail;   // next entry the process fills
+    uint16_t cq_head;   // next completion the process reaps
+    uint16_t cq_tail;   // next completion a device posts
+    uint16_t in_flight; // taken by the kernel, not yet completed
+    uint16_t next_tag;
+    uint8_t enabled;    // the process uses the rings instead of blocking IO traps
+    uint8_t waiting;    // blocked until in_flight drops to wait_for
+    uint8_t wait_for;
+    uint8_t pad;
+    io_sqe_s sq[IO_RING_ENTRIES];
+    io_cqe_s cq[IO_RING_ENTRIES];
+} io_ring_s;
+
+typedef io_ring_s * io_ring_p;
+
+/* Requests queued on the submission ring. */
+#define IO_RING_SQ_PENDING(ring) ((uint16_t) ((ring)->sq_tail - (ring)->sq_head))
+/* Completions waiting on the completion ring. */
+#define IO_RING_CQ_READY(ring) ((uint16_t) ((ring)->cq_tail - (ring)->cq_head))
+
+/*
+ * Return: 1 if another request can be queued, counting queued, in flight and unreaped ones.
+ */
+int io_ring_has_room(/* in */ io_ring_p ring);
+
+/*
+ * Process side: queues a request.
+ * Pre: io_ring_has_room.
+ *
+ * Arguments: ring: the rings.
+ *            device: the device it is for.
+ */
+void io_ring_submit(/* in-out */ io_ring_p ring, /* in */ unsigned int device);
+
+/*
+ * Kernel side: takes the oldest queued request and counts it in flight.
+ *
+ * Arguments: ring: the rings.
+ *            sqe: where to store it.
+ * Return: 1 if there was one, 0 if the submission ring is empty.
+ */
+int io_ring_take(/* in-out */ io_ring_p ring, /* out */ io_sqe_s * sqe);
+
+/*
+ * Device side: posts the completion of an in flight request.
+ *
+ * Arguments: ring: the rings.
+ *            tag: the request's tag.
+ *            device: the device that served it.
+ *            latency: cycles from submission to completion.
+ */
+void io_ring_complete(/* in-out */ io_ring_p ring, /* in */ uint16_t tag, /* in */ unsigned int device, /* in */ uint32_t latency);
+
+/*
+ * Process side: takes the oldest completion.
+ *
+ * Arguments: ring: the rings.
+ *            cqe: where to store it.
+ * Return: 1 if there was one, 0 if the completion ring is empty.
+ */
+int io_ring_reap(/* in-out */ io_ring_p ring, /* out */ io_cqe_s * cqe);
+
+/* A request a device has queued; blocking IO traps queue them too. */
+typedef struct io_request {
+    uint32_t handle;    // pt_handle_t of the process
+    uint32_t submitted; // cpu iteration it reached the device
+    uint32_t sector;    // where on the device it reads or writes
+    uint16_t tag;       // ring tag, async requests only
+    uint8_t async;      // 1 if from a ring, 0 for a process blocked in the IO queue
+    uint8_t priority;   // of the process when it submitted
+} io_request_s;
+
+/* A growable circular queue of device requests. */
+typedef struct io_request_queue {
+    io_request_s * entries;
+    uint32_t capacity;  // a power of two, or 0
+    uint32_t head;
+    uint32_t size;
+} io_request_queue_s;
+
+typedef io_request_queue_s * io_request_queue_p;
+
+/* The i-th oldest request of a non-empty queue, i below its size. */
+#define IOQ_AT(queue, i) (&(queue)->entries[((queue)->head + (i)) & ((queue)->capacity - 1)])
+
+/*
+ * Sets up an empty queue.
+ *
+ * Arguments: queue: the queue.
+ */
+void ioq_init(/* out */ io_request_queue_p queue);
+
+/*
+ * Frees a queue's storage.
+ *
+ * Arguments: queue: the queue.
+ */
+void ioq_destroy(/* in-out */ io_request_queue_p queue);
+
+/*
+ * Appends a request, growing the queue if it is full.
+ *
+ * Arguments: queue: the queue.
+ *            request: the request.
+ * Return: 1 if successful, 0 if out of memory.
+ */
+int ioq_push(/* in-out */ io_request_queue_p queue, /* in */ const io_request_s * request);
+
+/*
+ * Removes the oldest request.
+ *
+ * Arguments: queue: the queue.
+ *            request: where to store it.
+ * Return: 1 if there was one, 0 if the queue is empty.
+ */
+int ioq_pop(/* in-out */ io_request_queue_p queue, /* out */ io_request_s * request);
+
+/*
+ * Removes any request, keeping the others in arrival order.
+ *
+ * Arguments: queue: the queue.
+ *            index: which, 0 for the oldest; must be below the size.
+ *            request: where to store it.
+ */
+void ioq_remove(/* in-out */ io_request_queue_p queue, /* in */ uint32_t index, /* out */ io_request_s * request);
+
+/*
+ * Writes a queue's requests, oldest first, to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            queue: the queue.
+ */
+void ioq_save(/* in-out */ ckpt_writer_p w, /* in */ io_request_queue_p queue);
+
+/*
+ * Reads requests back from a checkpoint onto an empty queue.
+ *
+ * Arguments: r: the checkpoint.
+ *            queue: the queue.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int ioq_load(/* in-out */ ckpt_reader_p r, /* in-out */ io_request_queue_p queue);
+
+#endif
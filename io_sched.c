@@ -0,0 +1,243 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "io_sched.h"
+
+/* Sectors between two positions. */
+#define DISK_DISTANCE(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+
+const char * io_policy_names[IO_POLICY_COUNT] = { "fifo", "scan", "deadline", "priority" };
+
+/*
+ * Parses a policy name.
+ *
+ * Arguments: name: fifo, scan, deadline or priority.
+ *            policy: where to store it.
+ * Return: 1 if successful, 0 if the name is unknown.
+ */
+int io_policy_parse(/* in */ const char * name, /* out */ enum io_policy * policy) {
+    int i;
+
+    for (i = 0; i < IO_POLICY_COUNT; i++) {
+        if (strcmp(name, io_policy_names[i]) == 0) {
+            *policy = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Sets up an idle disk with its head at sector 0.
+ *
+ * Arguments: disk: the disk.
+ *            policy: how waiting requests are ordered.
+ *            depth: how many requests the device takes at once, clamped to 1 to DISK_MAX_DEPTH.
+ */
+void disk_init(/* out */ disk_p disk, /* in */ enum io_policy policy, /* in */ uint32_t depth) {
+    memset(disk, 0, sizeof(disk_s));
+    disk->direction = 1;
+    disk_configure(disk, policy, depth);
+}
+
+/*
+ * Changes the policy and depth of a disk, keeping what it holds. A disk
+ * holding more than the new depth takes nothing until it is below it.
+ */
+void disk_configure(/* in-out */ disk_p disk, /* in */ enum io_policy policy, /* in */ uint32_t depth) {
+    disk->policy = policy;
+    disk->depth = depth < 1 ? 1 : depth > DISK_MAX_DEPTH ? DISK_MAX_DEPTH : depth;
+}
+
+/*
+ * Picks a sector for a request of a process, within its region of the disk.
+ * Regions are spread over the disk by a multiplicative hash of the pid.
+ *
+ * Arguments: pid: the process.
+ *            rng: the generator to draw from.
+ */
+uint32_t disk_sector(/* in */ uint32_t pid, /* in-out */ sim_rng_p rng) {
+    uint32_t region = (pid * 2654435761u) % (DISK_SECTORS / DISK_REGION_SECTORS);
+
+    return region * DISK_REGION_SECTORS + rng_below(rng, DISK_REGION_SECTORS);
+}
+
+/*
+ * Sweep order: the nearest request at or beyond the head in the given
+ * direction, the oldest on a tie.
+ * Return: its index in waiting, or waiting->size if there is none.
+ */
+uint32_t disk_sweep(/* in */ io_request_queue_p waiting, /* in */ uint32_t head, /* in */ int32_t direction) {
+    uint32_t best = waiting->size, best_distance = UINT32_MAX, sector, i;
+
+    for (i = 0; i < waiting->size; i++) {
+        sector = IOQ_AT(waiting, i)->sector;
+        if (direction > 0 ? sector < head : sector > head)
+            continue;
+        if ((direction > 0 ? sector - head : head - sector) < best_distance) {
+            best = i;
+            best_distance = direction > 0 ? sector - head : head - sector;
+        }
+    }
+    return best;
+}
+
+/*
+ * Applies the disk's policy to the waiting requests.
+ * Pre: waiting is not empty.
+ * Return: the index of the request to hand to the device next.
+ */
+uint32_t disk_pick(/* in-out */ disk_p disk, /* in */ io_request_queue_p waiting, /* in */ uint32_t now) {
+    uint32_t best = 0, i;
+
+    switch (disk->policy) {
+    case IO_POLICY_SCAN:
+        best = disk_sweep(waiting, disk->head, disk->direction);
+        if (best == waiting->size) {
+            disk->direction = -disk->direction;
+            best = disk_sweep(waiting, disk->head, disk->direction);
+        }
+        break;
+    case IO_POLICY_DEADLINE:
+        /* The oldest request is first in line; once it expires it goes next. */
+        if (now - IOQ_AT(waiting, 0)->submitted >= IO_DEADLINE_CYCLES)
+            break;
+        best = disk_sweep(waiting, disk->head, 1);
+        if (best == waiting->size)
+            best = disk_sweep(waiting, 0, 1);
+        break;
+    case IO_POLICY_PRIORITY:
+        for (i = 1; i < waiting->size; i++) {
+            if (IOQ_AT(waiting, i)->priority < IOQ_AT(waiting, best)->priority)
+                best = i;
+        }
+        break;
+    default:
+        break;
+    }
+    return best;
+}
+
+/*
+ * Starts serving the next request, if the disk is idle and one is waiting.
+ * The device first takes requests in policy order until it holds depth of
+ * them, then serves the one nearest its head.
+ *
+ * Arguments: disk: the disk.
+ *            waiting: the requests waiting for it, in arrival order.
+ *            now: the current cpu iteration.
+ *            rng: the generator the rotational delay is drawn from.
+ * Return: the cycles the request takes, 0 if nothing was started.
+ */
+uint32_t disk_start(/* in-out */ disk_p disk, /* in-out */ io_request_queue_p waiting,
+                    /* in */ uint32_t now, /* in-out */ sim_rng_p rng) {
+    uint32_t best = 0, distance, i, cycles;
+
+    if (disk->busy)
+        return 0;
+
+    while (disk->queued < disk->depth && waiting->size > 0)
+        ioq_remove(waiting, disk_pick(disk, waiting, now), &disk->queue[disk->queued++]);
+    if (disk->queued == 0)
+        return 0;
+
+    for (i = 1; i < disk->queued; i++) {
+        if (DISK_DISTANCE(disk->queue[i].sector, disk->head) < DISK_DISTANCE(disk->queue[best].sector, disk->head))
+            best = i;
+    }
+    disk->active = disk->queue[best];
+    memmove(&disk->queue[best], &disk->queue[best + 1], (disk->queued - best - 1) * sizeof(io_request_s));
+    disk->queued--;
+
+    distance = DISK_DISTANCE(disk->active.sector, disk->head);
+    cycles = DISK_TRANSFER + rng_below(rng, DISK_ROTATION);
+    if (distance > 0)
+        cycles += DISK_SEEK_MIN + (uint32_t) ((DISK_SEEK_MAX - DISK_SEEK_MIN) * sqrt((double) distance / DISK_SECTORS));
+
+    disk->head = disk->active.sector;
+    disk->seek_sectors += distance;
+    disk->busy = 1;
+    return cycles;
+}
+
+/*
+ * Finishes the request being served.
+ * Pre: the disk is busy.
+ *
+ * Arguments: disk: the disk.
+ *            request: where to store the finished request.
+ */
+void disk_finish(/* in-out */ disk_p disk, /* out */ io_request_s * request) {
+    *request = disk->active;
+    disk->busy = 0;
+    disk->served++;
+}
+
+/*
+ * Accounts for one cycle of queue depth: everything waiting, held by the
+ * device or being served.
+ *
+ * Arguments: disk: the disk.
+ *            waiting: the requests waiting for it.
+ */
+void disk_tick(/* in-out */ disk_p disk, /* in */ io_request_queue_p waiting) {
+    uint32_t depth = waiting->size + disk->queued + disk->busy;
+
+    disk->depth_sum += depth;
+    if (depth > disk->max_depth)
+        disk->max_depth = depth;
+}
+
+/*
+ * Return: the histogram bucket of a value.
+ */
+unsigned int lat_hist_bucket(/* in */ uint32_t value) {
+    unsigned int e;
+
+    if (value < 16)
+        return value;
+    e = 31 - __builtin_clz(value);
+    return 16 + (e - 4) * 8 + ((value >> (e - 3)) & 7);
+}
+
+/*
+ * Records a latency.
+ */
+void lat_hist_add(/* in-out */ lat_hist_p hist, /* in */ uint32_t value) {
+    hist->counts[lat_hist_bucket(value)]++;
+    hist->total++;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+/*
+ * Return: the smallest bucket bound at or below which a share p (0 to 1) of
+ *         the values lie, 0 if empty. Bounds are within 1/8 of the value.
+ */
+uint32_t lat_hist_percentile(/* in */ lat_hist_p hist, /* in */ double p) {
+    unsigned long long rank = (unsigned long long) ceil(p * hist->total), seen = 0;
+    unsigned long long bound;
+    unsigned int i;
+
+    if (hist->total == 0)
+        return 0;
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank)
+            break;
+    }
+    if (i < 16)
+        return i;
+    /* Top of bucket i: (9 + sub) << (e - 3), less one. */
+    bound = ((9ULL + (i - 16) % 8) << (4 + (i - 16) / 8 - 3)) - 1;
+    return bound < hist->max ? (uint32_t) bound : hist->max;
+}
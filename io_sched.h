@@ -0,0 +1,147 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef IO_SCHED_H
+#define IO_SCHED_H
+
+#include <stdint.h>
+
+#include "io_ring.h"
+#include "sim_random.h"
+
+/* Block device geometry and timing, in cpu cycles. */
+#define DISK_SECTORS (1u << 20)
+#define DISK_REGION_SECTORS 4096 // a process's requests fall in its own region, like a file
+#define DISK_SEEK_MIN 8          // one track
+#define DISK_SEEK_MAX 80         // full stroke
+#define DISK_ROTATION 40         // one revolution; the rotational delay is uniform below it
+#define DISK_TRANSFER 4
+#define DISK_MAX_DEPTH 32        // most requests a device takes at once (NCQ)
+
+/* Deadline policy: a request waiting this long is served before any other. */
+#define IO_DEADLINE_CYCLES 500
+
+/* How the operating system orders the requests waiting for a device. */
+enum io_policy {
+    IO_POLICY_FIFO,      // arrival order
+    IO_POLICY_SCAN,      // elevator: sweep across the sectors, reversing at the last request
+    IO_POLICY_DEADLINE,  // one-way sweep, but expired requests first, oldest first
+    IO_POLICY_PRIORITY,  // highest process priority first, then arrival order
+    IO_POLICY_COUNT,
+};
+
+extern const char * io_policy_names[IO_POLICY_COUNT];
+
+/*
+ * A disk. Requests wait in the operating system's queue until the policy
+ * hands them to the device, which holds up to depth of them and always
+ * serves the one closest to its head. With a depth of 1 the policy alone
+ * decides the order.
+ *
+ * Service time is the seek, growing with the square root of the distance,
+ * plus a random rotational delay and the transfer. The layout has no
+ * pointers, so it is checkpointed as it is.
+ */
+typedef struct disk {
+    enum io_policy policy;
+    uint32_t depth;           // 1 to DISK_MAX_DEPTH
+    uint32_t head;            // sector under the head
+    int32_t direction;        // SCAN: 1 sweeping up, -1 down
+    uint32_t busy;            // 1 while active is being served
+    io_request_s active;
+    uint32_t queued;          // requests the device holds besides active
+    io_request_s queue[DISK_MAX_DEPTH];
+
+    unsigned long long served;
+    unsigned long long seek_sectors; // total head movement
+    unsigned long long depth_sum;    // outstanding requests, summed over cycles
+    uint32_t max_depth;
+} disk_s;
+
+typedef disk_s * disk_p;
+
+/* Latency histogram, log-linear: exact below 16, then 8 buckets per power of two. */
+#define LAT_HIST_BUCKETS 256
+
+typedef struct lat_hist {
+    unsigned long long counts[LAT_HIST_BUCKETS];
+    unsigned long long total;
+    uint32_t max;
+} lat_hist_s;
+
+typedef lat_hist_s * lat_hist_p;
+
+/*
+ * Parses a policy name.
+ *
+ * Arguments: name: fifo, scan, deadline or priority.
+ *            policy: where to store it.
+ * Return: 1 if successful, 0 if the name is unknown.
+ */
+int io_policy_parse(/* in */ const char * name, /* out */ enum io_policy * policy);
+
+/*
+ * Sets up an idle disk with its head at sector 0.
+ *
+ * Arguments: disk: the disk.
+ *            policy: how waiting requests are ordered.
+ *            depth: how many requests the device takes at once, clamped to 1 to DISK_MAX_DEPTH.
+ */
+void disk_init(/* out */ disk_p disk, /* in */ enum io_policy policy, /* in */ uint32_t depth);
+
+/*
+ * Changes the policy and depth of a disk, keeping what it holds.
+ */
+void disk_configure(/* in-out */ disk_p disk, /* in */ enum io_policy policy, /* in */ uint32_t depth);
+
+/*
+ * Picks a sector for a request of a process, within its region of the disk.
+ *
+ * Arguments: pid: the process.
+ *            rng: the generator to draw from.
+ */
+uint32_t disk_sector(/* in */ uint32_t pid, /* in-out */ sim_rng_p rng);
+
+/*
+ * Starts serving the next request, if the disk is idle and one is waiting.
+ *
+ * Arguments: disk: the disk.
+ *            waiting: the requests waiting for it, in arrival order.
+ *            now: the current cpu iteration.
+ *            rng: the generator the rotational delay is drawn from.
+ * Return: the cycles the request takes, 0 if nothing was started.
+ */
+uint32_t disk_start(/* in-out */ disk_p disk, /* in-out */ io_request_queue_p waiting,
+                    /* in */ uint32_t now, /* in-out */ sim_rng_p rng);
+
+/*
+ * Finishes the request being served.
+ * Pre: the disk is busy.
+ *
+ * Arguments: disk: the disk.
+ *            request: where to store the finished request.
+ */
+void disk_finish(/* in-out */ disk_p disk, /* out */ io_request_s * request);
+
+/*
+ * Accounts for one cycle of queue depth.
+ *
+ * Arguments: disk: the disk.
+ *            waiting: the requests waiting for it.
+ */
+void disk_tick(/* in-out */ disk_p disk, /* in */ io_request_queue_p waiting);
+
+/*
+ * Records a latency.
+ */
+void lat_hist_add(/* in-out */ lat_hist_p hist, /* in */ uint32_t value);
+
+/*
+ * Return: the smallest bucket bound at or below which a share p (0 to 1) of the values lie, 0 if empty.
+ */
+uint32_t lat_hist_percentile(/* in */ lat_hist_p hist, /* in */ double p);
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ipc.h"
+
+#define IPC_INITIAL_CHANNELS 16
+#define IPC_INITIAL_MSGS 64
+
+const char * ipc_kind_names[IPC_KIND_COUNT] = { "pipe", "mailbox" };
+
+/*
+ * Frees every channel and the pool, leaving the ipc empty.
+ */
+void ipc_destroy(/* in-out */ ipc_p ipc) {
+    uint32_t i;
+
+    for (i = 0; i < ipc->count; i++) {
+        q_destroy(ipc->channels[i]->waiting_senders);
+        q_destroy(ipc->channels[i]->waiting_receivers);
+        free(ipc->channels[i]);
+    }
+    free(ipc->channels);
+    free(ipc->msgs);
+    memset(ipc, 0, sizeof(ipc_s));
+}
+
+/*
+ * Creates an empty channel.
+ *
+ * Arguments: ipc: the channels.
+ *            table: the process table of the processes that will wait on it.
+ *            kind: pipe or mailbox.
+ *            capacity: messages it holds before a sender blocks, at least 1.
+ * Return: the channel's index, UINT32_MAX if out of memory.
+ */
+uint32_t ipc_channel_create(/* in-out */ ipc_p ipc, /* in */ proc_table_p table,
+                            /* in */ enum ipc_kind kind, /* in */ uint32_t capacity) {
+    ipc_channel_p channel;
+    ipc_channel_p * channels;
+    uint32_t grown;
+
+    if (ipc->count == ipc->capacity) {
+        grown = ipc->capacity ? ipc->capacity * 2 : IPC_INITIAL_CHANNELS;
+        channels = realloc(ipc->channels, grown * sizeof(ipc_channel_p));
+        if (channels == NULL)
+            return UINT32_MAX;
+        ipc->channels = channels;
+        ipc->capacity = grown;
+    }
+
+    channel = calloc(1, sizeof(ipc_channel_s));
+    if (channel == NULL)
+        return UINT32_MAX;
+    channel->kind = kind;
+    channel->capacity = capacity;
+    channel->waiting_senders = q_create(table);
+    channel->waiting_receivers = q_create(table);
+    if (channel->waiting_senders == NULL || channel->waiting_receivers == NULL) {
+        if (channel->waiting_senders != NULL)
+            q_destroy(channel->waiting_senders);
+        if (channel->waiting_receivers != NULL)
+            q_destroy(channel->waiting_receivers);
+        free(channel);
+        return UINT32_MAX;
+    }
+
+    ipc->channels[ipc->count] = channel;
+    return ipc->count++;
+}
+
+/*
+ * Takes a buffer from the pool, growing it if none is free.
+ * Return: the buffer, 0 if out of memory.
+ */
+uint32_t ipc_msg_alloc(/* in-out */ ipc_p ipc) {
+    ipc_msg_s * msgs;
+    uint32_t grown, first, msg, i;
+
+    if (ipc->free_msgs == 0) {
+        grown = ipc->msg_capacity ? ipc->msg_capacity * 2 : IPC_INITIAL_MSGS;
+        msgs = realloc(ipc->msgs, grown * sizeof(ipc_msg_s));
+        if (msgs == NULL)
+            return 0;
+        /* Chain the new buffers, lowest first; buffer 0 is never handed out. */
+        first = ipc->msg_capacity ? ipc->msg_capacity : 1;
+        for (i = grown; i-- > first;) {
+            msgs[i].next = ipc->free_msgs;
+            ipc->free_msgs = i;
+        }
+        ipc->msgs = msgs;
+        ipc->msg_capacity = grown;
+    }
+
+    msg = ipc->free_msgs;
+    ipc->free_msgs = ipc->msgs[msg].next;
+    return msg;
+}
+
+/*
+ * Queues a message at the tail of a channel, which takes ownership of it.
+ */
+void ipc_append(/* in-out */ ipc_p ipc, /* in-out */ ipc_channel_p channel, /* in */ uint32_t msg) {
+    ipc->msgs[msg].next = 0;
+    if (channel->head == 0)
+        channel->head = msg;
+    else
+        ipc->msgs[channel->tail].next = msg;
+    channel->tail = msg;
+    channel->queued++;
+}
+
+/*
+ * Sends up to count messages, as many as the channel has room for, or
+ * queues the process if it has none. Running out of buffers counts as no
+ * room.
+ *
+ * Arguments: ipc: the channels.
+ *            channel: the channel's index.
+ *            pcb: the sender.
+ *            count: messages in the batch.
+ *            bytes: payload of each.
+ *            now: the current cpu iteration.
+ * Return: the messages sent, 0 if the process was queued.
+ */
+uint32_t ipc_send(/* in-out */ ipc_p ipc, /* in */ uint32_t channel, /* in */ PCB_p pcb,
+                  /* in */ uint32_t count, /* in */ uint32_t bytes, /* in */ uint32_t now) {
+    ipc_channel_p ch = ipc->channels[channel];
+    uint32_t sent = 0, msg;
+
+    while (sent < count && ch->queued < ch->capacity && (msg = ipc_msg_alloc(ipc)) != 0) {
+        ipc->msgs[msg].sender = pcb->pid;
+        ipc->msgs[msg].sent_at = now;
+        ipc->msgs[msg].bytes = bytes;
+        ipc_append(ipc, ch, msg);
+        sent++;
+    }
+
+    if (sent == 0) {
+        ch->send_blocks++;
+        q_enqueue(ch->waiting_senders, pcb);
+    }
+    ch->sent += sent;
+    return sent;
+}
+
+/*
+ * Receives up to max messages, oldest first, or queues the process if
+ * there are none. The receiver is done with each buffer as soon as it has
+ * it, so the buffers go straight back to the pool.
+ *
+ * Arguments: ipc: the channels.
+ *            channel: the channel's index.
+ *            pcb: the receiver.
+ *            max: the most messages to take.
+ *            now: the current cpu iteration.
+ * Return: the messages received, 0 if the process was queued.
+ */
+uint32_t ipc_receive(/* in-out */ ipc_p ipc, /* in */ uint32_t channel, /* in */ PCB_p pcb,
+                     /* in */ uint32_t max, /* in */ uint32_t now) {
+    ipc_channel_p ch = ipc->channels[channel];
+    uint32_t received = 0, msg;
+
+    while (received < max && ch->head != 0) {
+        msg = ch->head;
+        ch->head = ipc->msgs[msg].next;
+        ch->queued--;
+
+        ipc->bytes += ipc->msgs[msg].bytes;
+        ipc->latency += now - ipc->msgs[msg].sent_at;
+        lat_hist_add(&ipc->latency_hist, now - ipc->msgs[msg].sent_at);
+
+        ipc->msgs[msg].next = ipc->free_msgs;
+        ipc->free_msgs = msg;
+        received++;
+    }
+
+    if (received == 0) {
+        ch->receive_blocks++;
+        q_enqueue(ch->waiting_receivers, pcb);
+    }
+    ipc->received += received;
+    return received;
+}
+
+/*
+ * Writes every channel, its messages and queues included, to a checkpoint.
+ * Messages are written by value, as buffers are renumbered on restore.
+ */
+void ipc_save(/* in-out */ ckpt_writer_p w, /* in */ ipc_p ipc) {
+    ipc_channel_p ch;
+    uint32_t i, msg;
+
+    ckpt_put_u32(w, ipc->count);
+    for (i = 0; i < ipc->count; i++) {
+        ch = ipc->channels[i];
+        ckpt_put_u32(w, ch->kind);
+        ckpt_put_u32(w, ch->capacity);
+        ckpt_put_u32(w, ch->queued);
+        for (msg = ch->head; msg != 0; msg = ipc->msgs[msg].next) {
+            ckpt_put_u32(w, ipc->msgs[msg].sender);
+            ckpt_put_u32(w, ipc->msgs[msg].sent_at);
+            ckpt_put_u32(w, ipc->msgs[msg].bytes);
+        }
+        ckpt_put(w, &ch->sent, sizeof(ch->sent));
+        ckpt_put(w, &ch->send_blocks, sizeof(ch->send_blocks));
+        ckpt_put(w, &ch->receive_blocks, sizeof(ch->receive_blocks));
+        q_save(w, ch->waiting_senders);
+        q_save(w, ch->waiting_receivers);
+    }
+    ckpt_put(w, &ipc->received, sizeof(ipc->received));
+    ckpt_put(w, &ipc->bytes, sizeof(ipc->bytes));
+    ckpt_put(w, &ipc->latency, sizeof(ipc->latency));
+    ckpt_put(w, &ipc->latency_hist, sizeof(ipc->latency_hist));
+}
+
+/*
+ * Reads the channels back from a checkpoint into an empty ipc, once the pcbs
+ * are restored.
+ *
+ * Return: 1 if successful, 0 if the record is damaged or out of memory.
+ */
+int ipc_load(/* in-out */ ckpt_reader_p r, /* out */ ipc_p ipc, /* in */ proc_table_p table) {
+    uint32_t count = ckpt_get_u32(r), i, j, kind, capacity, queued, msg;
+    ipc_channel_p ch;
+
+    for (i = 0; i < count && r->ok; i++) {
+        kind = ckpt_get_u32(r);
+        capacity = ckpt_get_u32(r);
+        queued = ckpt_get_u32(r);
+        if (!r->ok || kind >= IPC_KIND_COUNT || capacity == 0 || queued > capacity
+            || ipc_channel_create(ipc, table, kind, capacity) == UINT32_MAX)
+            return 0;
+        ch = ipc->channels[i];
+        for (j = 0; j < queued; j++) {
+            if ((msg = ipc_msg_alloc(ipc)) == 0)
+                return 0;
+            ipc->msgs[msg].sender = ckpt_get_u32(r);
+            ipc->msgs[msg].sent_at = ckpt_get_u32(r);
+            ipc->msgs[msg].bytes = ckpt_get_u32(r);
+            ipc_append(ipc, ch, msg);
+        }
+        ckpt_read(r, &ch->sent, sizeof(ch->sent));
+        ckpt_read(r, &ch->send_blocks, sizeof(ch->send_blocks));
+        ckpt_read(r, &ch->receive_blocks, sizeof(ch->receive_blocks));
+        q_load(r, ch->waiting_senders);
+        q_load(r, ch->waiting_receivers);
+    }
+    ckpt_read(r, &ipc->received, sizeof(ipc->received));
+    ckpt_read(r, &ipc->bytes, sizeof(ipc->bytes));
+    ckpt_read(r, &ipc->latency, sizeof(ipc->latency));
+    ckpt_read(r, &ipc->latency_hist, sizeof(ipc->latency_hist));
+    return r->ok;
+}
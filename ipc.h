@@ -0,0 +1,140 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+
+#include "checkpoint.h"
+#include "fifo_queue.h"
+#include "io_sched.h"
+#include "pcb.h"
+
+/*
+ * Pipes and mailboxes for SENDER and RECEIVER processes. A message is a
+ * buffer handed on by reference: the sender takes one from the pool, the
+ * channel holds it, and the receiver owns it once it takes it, so payloads
+ * are never copied. Like the other primitives, a channel only keeps the
+ * processes that wait on it in its queues: the caller blocks a process that
+ * is queued and makes ready the ones a transfer lets through, which run
+ * their trap again.
+ */
+
+enum ipc_kind {
+    IPC_PIPE,    // one sender, one receiver
+    IPC_MAILBOX, // any number of senders, one receiver
+    IPC_KIND_COUNT,
+};
+
+extern const char * ipc_kind_names[IPC_KIND_COUNT];
+
+/* A message buffer, named by its index in the pool; 0 is none. */
+typedef struct ipc_msg {
+    uint32_t next;     // next message in its channel, or next free buffer
+    uint32_t sender;   // pid
+    uint32_t sent_at;  // cpu iteration it was sent at
+    uint32_t bytes;    // payload size
+} ipc_msg_s;
+
+/* A bounded queue of messages, oldest first, linked through the pool. */
+typedef struct ipc_channel {
+    enum ipc_kind kind;
+    uint32_t capacity;         // messages it holds before a sender blocks
+    uint32_t head;             // oldest message, 0 if empty
+    uint32_t tail;
+    uint32_t queued;
+    FIFOq_p waiting_senders;
+    FIFOq_p waiting_receivers;
+
+    unsigned long long sent;
+    unsigned long long send_blocks;
+    unsigned long long receive_blocks;
+} ipc_channel_s;
+
+typedef ipc_channel_s * ipc_channel_p;
+
+/*
+ * The channels of a simulation, named by their index, and the buffer pool
+ * they share. Both grow by doubling, so channels can be had by the
+ * thousand. A zeroed ipc_s is empty.
+ */
+typedef struct ipc {
+    ipc_channel_p * channels;
+    uint32_t count;
+    uint32_t capacity;
+    ipc_msg_s * msgs;
+    uint32_t msg_capacity;     // buffers in the pool, the unused 0 included
+    uint32_t free_msgs;        // first free buffer, 0 if the pool must grow
+
+    unsigned long long received;
+    unsigned long long bytes;        // payload passed by reference
+    unsigned long long latency;      // cycles from send to receive, summed
+    lat_hist_s latency_hist;
+} ipc_s;
+
+typedef ipc_s * ipc_p;
+
+/*
+ * Frees every channel and the pool, leaving the ipc empty.
+ */
+void ipc_destroy(/* in-out */ ipc_p ipc);
+
+/*
+ * Creates an empty channel.
+ *
+ * Arguments: ipc: the channels.
+ *            table: the process table of the processes that will wait on it.
+ *            kind: pipe or mailbox.
+ *            capacity: messages it holds before a sender blocks, at least 1.
+ * Return: the channel's index, UINT32_MAX if out of memory.
+ */
+uint32_t ipc_channel_create(/* in-out */ ipc_p ipc, /* in */ proc_table_p table,
+                            /* in */ enum ipc_kind kind, /* in */ uint32_t capacity);
+
+/*
+ * Sends up to count messages, as many as the channel has room for, or
+ * queues the process if it has none.
+ *
+ * Arguments: ipc: the channels.
+ *            channel: the channel's index.
+ *            pcb: the sender.
+ *            count: messages in the batch.
+ *            bytes: payload of each.
+ *            now: the current cpu iteration.
+ * Return: the messages sent, 0 if the process was queued.
+ */
+uint32_t ipc_send(/* in-out */ ipc_p ipc, /* in */ uint32_t channel, /* in */ PCB_p pcb,
+                  /* in */ uint32_t count, /* in */ uint32_t bytes, /* in */ uint32_t now);
+
+/*
+ * Receives up to max messages, oldest first, or queues the process if
+ * there are none.
+ *
+ * Arguments: ipc: the channels.
+ *            channel: the channel's index.
+ *            pcb: the receiver.
+ *            max: the most messages to take.
+ *            now: the current cpu iteration.
+ * Return: the messages received, 0 if the process was queued.
+ */
+uint32_t ipc_receive(/* in-out */ ipc_p ipc, /* in */ uint32_t channel, /* in */ PCB_p pcb,
+                     /* in */ uint32_t max, /* in */ uint32_t now);
+
+/*
+ * Writes every channel, its messages and queues included, to a checkpoint.
+ */
+void ipc_save(/* in-out */ ckpt_writer_p w, /* in */ ipc_p ipc);
+
+/*
+ * Reads the channels back from a checkpoint into an empty ipc, once the pcbs
+ * are restored.
+ *
+ * Return: 1 if successful, 0 if the record is damaged or out of memory.
+ */
+int ipc_load(/* in-out */ ckpt_reader_p r, /* out */ ipc_p ipc, /* in */ proc_table_p table);
+
+#endif
@@ -0,0 +1,333 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "json_writer.h"
+#include "proc_table.h"
+
+/*
+ * Writes the buffer out and empties it. A failed write drops the rest of the
+ * document.
+ */
+void json_flush(/* in-out */ json_writer_p w) {
+    size_t done = 0;
+    ssize_t n;
+
+    while (w->ok && done < w->len) {
+        n = write(w->fd, w->buf + done, w->len - done);
+        if (n <= 0)
+            w->ok = 0;
+        else
+            done += n;
+    }
+    w->len = 0;
+}
+
+/*
+ * Appends raw bytes to the document.
+ */
+void json_put(/* in-out */ json_writer_p w, /* in */ const char * bytes, /* in */ size_t count) {
+    size_t chunk;
+
+    while (count > 0) {
+        if (w->len == JSON_BUFFER_SIZE)
+            json_flush(w);
+        chunk = JSON_BUFFER_SIZE - w->len;
+        if (chunk > count)
+            chunk = count;
+        memcpy(w->buf + w->len, bytes, chunk);
+        w->len += chunk;
+        bytes += chunk;
+        count -= chunk;
+    }
+}
+
+void json_put_char(/* in-out */ json_writer_p w, /* in */ char c) {
+    if (w->len == JSON_BUFFER_SIZE)
+        json_flush(w);
+    w->buf[w->len++] = c;
+}
+
+/*
+ * Appends a quoted string, escaping what JSON requires.
+ */
+void json_put_string(/* in-out */ json_writer_p w, /* in */ const char * s) {
+    static const char hex[] = "0123456789abcdef";
+    char escape[6] = { '\\', 'u', '0', '0' };
+
+    json_put_char(w, '"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            json_put_char(w, '\\');
+            json_put_char(w, *s);
+        } else if ((unsigned char) *s < 0x20) {
+            escape[4] = hex[(unsigned char) *s >> 4];
+            escape[5] = hex[*s & 0xf];
+            json_put(w, escape, sizeof(escape));
+        } else {
+            json_put_char(w, *s);
+        }
+    }
+    json_put_char(w, '"');
+}
+
+/*
+ * Starts a member: the comma after the one before it, then its key.
+ */
+void json_member(/* in-out */ json_writer_p w, /* in */ const char * key) {
+    uint64_t bit = 1ull << (w->depth < JSON_MAX_DEPTH ? w->depth : JSON_MAX_DEPTH - 1);
+
+    if (w->started & bit)
+        json_put_char(w, ',');
+    w->started |= bit;
+    if (key != NULL) {
+        json_put_string(w, key);
+        json_put_char(w, ':');
+    }
+}
+
+/*
+ * Starts a document on a file descriptor.
+ *
+ * Arguments: w: the writer.
+ *            fd: where to write, open for writing.
+ */
+void json_open(/* out */ json_writer_p w, /* in */ int fd) {
+    w->fd = fd;
+    w->ok = 1;
+    w->depth = 0;
+    w->started = 0;
+    w->len = 0;
+}
+
+/*
+ * Writes out what is buffered and ends the document with a newline. The
+ * descriptor is left open.
+ *
+ * Return: 1 if everything was written, 0 otherwise.
+ */
+int json_close(/* in-out */ json_writer_p w) {
+    json_put_char(w, '\n');
+    json_flush(w);
+    return w->ok;
+}
+
+void json_begin(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ char open) {
+    json_member(w, key);
+    json_put_char(w, open);
+    w->depth++;
+    if (w->depth < JSON_MAX_DEPTH)
+        w->started &= ~(1ull << w->depth);
+}
+
+void json_end(/* in-out */ json_writer_p w, /* in */ char close) {
+    w->depth--;
+    json_put_char(w, close);
+}
+
+/*
+ * Open and close an object or an array.
+ *
+ * Arguments: key: its key in the enclosing object, NULL in an array or at the top.
+ */
+void json_begin_object(/* in-out */ json_writer_p w, /* in */ const char * key) {
+    json_begin(w, key, '{');
+}
+
+void json_end_object(/* in-out */ json_writer_p w) {
+    json_end(w, '}');
+}
+
+void json_begin_array(/* in-out */ json_writer_p w, /* in */ const char * key) {
+    json_begin(w, key, '[');
+}
+
+void json_end_array(/* in-out */ json_writer_p w) {
+    json_end(w, ']');
+}
+
+/*
+ * Writes an unsigned integer, converted by hand to stay clear of stdio.
+ */
+void json_uint(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ unsigned long long value) {
+    char digits[20];
+    int i = sizeof(digits);
+
+    json_member(w, key);
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    json_put(w, digits + i, sizeof(digits) - i);
+}
+
+/*
+ * Writes a number with six significant digits, null if it is not finite.
+ */
+void json_double(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ double value) {
+    char text[32];
+    int len;
+
+    if (!isfinite(value)) {
+        json_null(w, key);
+        return;
+    }
+    json_member(w, key);
+    len = snprintf(text, sizeof(text), "%.6g", value);
+    json_put(w, text, len);
+}
+
+void json_bool(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ int value) {
+    json_member(w, key);
+    if (value)
+        json_put(w, "true", 4);
+    else
+        json_put(w, "false", 5);
+}
+
+void json_null(/* in-out */ json_writer_p w, /* in */ const char * key) {
+    json_member(w, key);
+    json_put(w, "null", 4);
+}
+
+void json_string(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ const char * value) {
+    json_member(w, key);
+    json_put_string(w, value);
+}
+
+/*
+ * Writes a pid, or null for a pcb that is NULL.
+ */
+void json_pid(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PCB_p pcb) {
+    if (pcb == NULL)
+        json_null(w, key);
+    else
+        json_uint(w, key, pcb->pid);
+}
+
+/*
+ * Writes the pcs of one trap group.
+ */
+void json_traps(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ const unsigned int * traps) {
+    int i;
+
+    json_begin_array(w, key);
+    for (i = 0; i < TRAP_GROUP_SIZE; i++) {
+        if (traps[i] == (unsigned int) -1)
+            json_null(w, NULL);
+        else
+            json_uint(w, NULL, traps[i]);
+    }
+    json_end_array(w);
+}
+
+/*
+ * Writes a pcb as an object: its hot header, parent and type payload.
+ */
+void json_pcb(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PCB_p pcb) {
+    PCB_cold_p cold = PCB_COLD(pcb);
+    io_ring_p ring;
+
+    json_begin_object(w, key);
+    json_uint(w, "pid", pcb->pid);
+    json_string(w, "type", pcb->proc_type < PROC_TYPE_COUNT ? proc_type_names[pcb->proc_type] : "?");
+    json_string(w, "state", pcb->state < STATE_COUNT ? state_names[pcb->state] : "?");
+    json_uint(w, "priority", pcb->priority);
+    if (pcb->base_priority == PCB_NOT_INHERITED)
+        json_null(w, "base_priority");
+    else
+        json_uint(w, "base_priority", pcb->base_priority);
+    json_uint(w, "pc", pcb->pc);
+    json_uint(w, "max_pc", pcb->max_pc);
+    json_uint(w, "terminate", pcb->terminate);
+    json_uint(w, "term_count", pcb->term_count);
+    json_uint(w, "channel_no", pcb->channel_no);
+    json_uint(w, "page_table", pcb->page_table);
+    json_uint(w, "last_ran", pcb->last_ran);
+    json_uint(w, "forks_left", pcb->forks_left);
+    if (cold->parent == PT_NO_PID)
+        json_null(w, "parent");
+    else
+        json_uint(w, "parent", cold->parent);
+    json_uint(w, "children", cold->children);
+    json_uint(w, "generation", cold->generation);
+
+    switch (pcb->proc_type) {
+    case IO:
+        ring = PCB_IO_RING(pcb);
+        json_traps(w, "io_1", PCB_IO_TRAPS(pcb)->io_1_traps);
+        json_traps(w, "io_2", PCB_IO_TRAPS(pcb)->io_2_traps);
+        if (ring->enabled) {
+            json_begin_object(w, "ring");
+            json_uint(w, "submitted", (uint16_t) (ring->sq_tail - ring->sq_head));
+            json_uint(w, "in_flight", ring->in_flight);
+            json_uint(w, "completed", (uint16_t) (ring->cq_tail - ring->cq_head));
+            json_bool(w, "waiting", ring->waiting);
+            json_end_object(w);
+        }
+        break;
+    case MUTEX:
+        json_traps(w, "lock_1", PCB_MUTEX(pcb)->lock_1);
+        json_traps(w, "lock_2", PCB_MUTEX(pcb)->lock_2);
+        json_traps(w, "trylock_1", PCB_MUTEX(pcb)->trylock_1);
+        json_traps(w, "trylock_2", PCB_MUTEX(pcb)->trylock_2);
+        json_uint(w, "spun", PCB_MUTEX(pcb)->spun);
+        break;
+    case PROD:
+    case CONS:
+        json_traps(w, "io_1", PCB_PROD_CONS(pcb)->io_1_traps);
+        json_traps(w, "io_2", PCB_PROD_CONS(pcb)->io_2_traps);
+        json_traps(w, "lock", PCB_PROD_CONS(pcb)->prod_cons_lock);
+        json_uint(w, "prod_cons_id", PCB_PROD_CONS(pcb)->prod_cons_id);
+        break;
+    case READER:
+    case WRITER:
+    case SEM:
+    case BARRIER:
+        json_traps(w, "acquire", PCB_SYNC(pcb)->acquire);
+        json_traps(w, "release", PCB_SYNC(pcb)->release);
+        json_uint(w, "sync_id", PCB_SYNC(pcb)->sync_id);
+        break;
+    case SENDER:
+    case RECEIVER:
+        json_traps(w, "transfer", PCB_IPC(pcb)->transfer);
+        json_uint(w, "channel", PCB_IPC(pcb)->channel);
+        json_uint(w, "batch", PCB_IPC(pcb)->batch);
+        break;
+    default:
+        break;
+    }
+    json_end_object(w);
+}
+
+/*
+ * Writes the pids of a queue, front first, following the links in its
+ * process table.
+ */
+void json_queue(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ FIFOq_p queue) {
+    uint32_t iter;
+
+    json_begin_array(w, key);
+    for (iter = queue->first; iter != PT_NIL; iter = PT_SLOT(queue->table, iter).next)
+        json_uint(w, NULL, PT_SLOT(queue->table, iter).pcb->pid);
+    json_end_array(w);
+}
+
+/*
+ * Writes a priority queue as an array of its bins, highest priority first.
+ */
+void json_pq(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PQ_p pq) {
+    int i;
+
+    json_begin_array(w, key);
+    for (i = 0; i < NUM_PRIORITIES; i++)
+        json_queue(w, NULL, pq->queues[i]);
+    json_end_array(w);
+}
@@ -0,0 +1,95 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+
+#include "fifo_queue.h"
+#include "pcb.h"
+#include "priority_queue.h"
+
+#define JSON_BUFFER_SIZE (64 * 1024)
+#define JSON_MAX_DEPTH 64
+
+/*
+ * Streaming JSON writer. Output collects in a fixed buffer that is written
+ * to a file descriptor whenever it fills, so a dump of any size allocates
+ * nothing and the writer can be kept and reused for the next one. Members
+ * are given with their key inside an object and with a NULL key inside an
+ * array; commas are placed by the writer. Errors are sticky.
+ */
+typedef struct json_writer {
+    int fd;
+    int ok;
+    unsigned int depth;
+    uint64_t started;      // bit d: the container at depth d has a member already
+    size_t len;
+    char buf[JSON_BUFFER_SIZE];
+} json_writer_s;
+
+typedef json_writer_s * json_writer_p;
+
+/*
+ * Starts a document on a file descriptor.
+ *
+ * Arguments: w: the writer.
+ *            fd: where to write, open for writing.
+ */
+void json_open(/* out */ json_writer_p w, /* in */ int fd);
+
+/*
+ * Writes out what is buffered and ends the document with a newline. The
+ * descriptor is left open.
+ *
+ * Return: 1 if everything was written, 0 otherwise.
+ */
+int json_close(/* in-out */ json_writer_p w);
+
+/*
+ * Open and close an object or an array.
+ *
+ * Arguments: key: its key in the enclosing object, NULL in an array or at the top.
+ */
+void json_begin_object(/* in-out */ json_writer_p w, /* in */ const char * key);
+void json_end_object(/* in-out */ json_writer_p w);
+void json_begin_array(/* in-out */ json_writer_p w, /* in */ const char * key);
+void json_end_array(/* in-out */ json_writer_p w);
+
+/*
+ * Write a member.
+ *
+ * Arguments: key: its key in the enclosing object, NULL in an array.
+ */
+void json_uint(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ unsigned long long value);
+void json_double(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ double value);
+void json_bool(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ int value);
+void json_null(/* in-out */ json_writer_p w, /* in */ const char * key);
+void json_string(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ const char * value);
+
+/*
+ * Writes a pid, or null for a pcb that is NULL.
+ */
+void json_pid(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PCB_p pcb);
+
+/*
+ * Writes a pcb as an object: its hot header, parent and type payload.
+ */
+void json_pcb(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PCB_p pcb);
+
+/*
+ * Writes the pids of a queue, front first, following the links in its
+ * process table.
+ */
+void json_queue(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ FIFOq_p queue);
+
+/*
+ * Writes a priority queue as an array of its bins, highest priority first.
+ */
+void json_pq(/* in-out */ json_writer_p w, /* in */ const char * key, /* in */ PQ_p pq);
+
+#endif
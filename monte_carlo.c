@@ -0,0 +1,308 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "monte_carlo.h"
+
+/* Two sided 95% quantiles of Student's t for 1 to 30 degrees of freedom. */
+#define MC_T_TABLE_SIZE 30
+const double mc_t95[MC_T_TABLE_SIZE] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+/* Metric names and whether they are shares printed as percentages. */
+const char * mc_metric_names[MC_METRIC_COUNT] = {
+    "processes created",
+    "processes terminated",
+    "context switches",
+    "cpu utilization %",
+    "switch loss %",
+    "TLB hit rate %",
+    "page faults",
+    "stalled admissions",
+    "fragmentation %",
+    "runs deadlocked %",
+    "IO device busy %",
+    "IO requests done",
+    "IO latency (cycles)",
+    "IO latency p50",
+    "IO latency p95",
+    "IO latency p99",
+    "IO queue depth",
+    "IO proc instructions",
+    "mutex blocks",
+    "mutex spin cycles",
+    "spin success %",
+    "sync blocks",
+    "shared reads %",
+    "priority inversions",
+    "inversion cycles",
+    "inversion max",
+    "forks",
+    "COW copies",
+    "IPC messages",
+    "IPC latency (cycles)",
+    "IPC latency p99",
+};
+const int mc_metric_percent[MC_METRIC_COUNT] = { 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/* Work shared by the pool: runs are handed out in order, results stored by run. */
+typedef struct mc_pool {
+    const sim_options_s * options;
+    unsigned int runs;
+    unsigned int next;     // next run to hand out
+    pthread_mutex_t lock;  // guards next
+    sim_results_s * results;
+    char * completed;      // 1 once the run's results are in
+} mc_pool_s;
+
+typedef mc_pool_s * mc_pool_p;
+
+/*
+ * Adds one observation.
+ *
+ * Arguments: stat: the statistic.
+ *            value: the observation.
+ */
+void mc_stat_add(/* in-out */ mc_stat_p stat, /* in */ double value) {
+    double delta = value - stat->mean;
+
+    if (stat->n == 0 || value < stat->min) {
+        stat->min = value;
+    }
+    if (stat->n == 0 || value > stat->max) {
+        stat->max = value;
+    }
+    stat->n++;
+    stat->mean += delta / stat->n;
+    stat->m2 += delta * (value - stat->mean);
+}
+
+/*
+ * Return: the sample standard deviation, 0 for fewer than two observations.
+ */
+double mc_stat_stddev(/* in */ mc_stat_p stat) {
+    return stat->n < 2 ? 0.0 : sqrt(stat->m2 / (stat->n - 1));
+}
+
+/*
+ * Half width of the 95% confidence interval of the mean, from Student's t.
+ *
+ * Return: the half width, 0 for fewer than two observations.
+ */
+double mc_stat_ci95(/* in */ mc_stat_p stat) {
+    unsigned long df = stat->n - 1;
+    double t;
+
+    if (stat->n < 2) {
+        return 0.0;
+    }
+    /* Past the table t approaches the normal quantile, within 0.1% by this fit. */
+    t = df <= MC_T_TABLE_SIZE ? mc_t95[df - 1] : 1.960 + 2.5 / df;
+    return t * mc_stat_stddev(stat) / sqrt(stat->n);
+}
+
+/*
+ * Return: the value of a metric in the results of a run.
+ */
+double mc_metric_value(/* in */ const sim_results_s * results, /* in */ enum mc_metric metric) {
+    switch (metric) {
+    case MC_CREATED:
+        return results->created;
+    case MC_TERMINATED:
+        return results->terminated;
+    case MC_CONTEXT_SWITCHES:
+        return results->context_switches;
+    case MC_UTILIZATION:
+        return results->utilization;
+    case MC_SWITCH_LOSS:
+        return results->switch_loss;
+    case MC_TLB_HIT_RATE:
+        return results->tlb_hit_rate;
+    case MC_PAGE_FAULTS:
+        return results->page_faults;
+    case MC_ADMISSION_STALLS:
+        return results->admission_stalls;
+    case MC_FRAGMENTATION:
+        return results->fragmentation;
+    case MC_DEADLOCKED:
+        return results->deadlocked;
+    case MC_IO_UTILIZATION:
+        return results->io_utilization;
+    case MC_IO_COMPLETED:
+        return results->io_completed;
+    case MC_IO_LATENCY:
+        return results->io_latency;
+    case MC_IO_LATENCY_P50:
+        return results->io_latency_p50;
+    case MC_IO_LATENCY_P95:
+        return results->io_latency_p95;
+    case MC_IO_LATENCY_P99:
+        return results->io_latency_p99;
+    case MC_IO_QUEUE_DEPTH:
+        return results->io_queue_depth;
+    case MC_IO_INSTRUCTIONS:
+        return results->io_instructions;
+    case MC_LOCK_BLOCKS:
+        return results->lock_blocks;
+    case MC_SPIN_CYCLES:
+        return results->spin_cycles;
+    case MC_SPIN_SUCCESS:
+        return results->spin_success;
+    case MC_SYNC_BLOCKS:
+        return results->sync_blocks;
+    case MC_SHARED_READS:
+        return results->shared_reads;
+    case MC_INVERSIONS:
+        return results->inversions;
+    case MC_INVERSION_CYCLES:
+        return results->inversion_cycles;
+    case MC_INVERSION_MAX:
+        return results->inversion_max;
+    case MC_FORKS:
+        return results->forks;
+    case MC_COW_COPIES:
+        return results->cow_copies;
+    case MC_IPC_MESSAGES:
+        return results->ipc_messages;
+    case MC_IPC_LATENCY:
+        return results->ipc_latency;
+    case MC_IPC_LATENCY_P99:
+        return results->ipc_latency_p99;
+    default:
+        return 0.0;
+    }
+}
+
+/*
+ * Pool thread: takes runs until none are left. Each run is a separate
+ * simulation, so nothing but the run counter is shared.
+ */
+void * mc_worker(/* in-out */ void * arg) {
+    mc_pool_p pool = arg;
+    sim_options_s options = *pool->options;
+    unsigned int run;
+    sim_p sim;
+
+    options.verbose = 0;
+    options.lockstep = 1;
+    options.seed_given = 1;
+    options.stats_name = NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        run = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (run >= pool->runs) {
+            break;
+        }
+
+        options.seed = pool->options->seed + run;
+        sim = sim_create(&options);
+        if (sim != NULL) {
+            sim_run(sim);
+            sim_results(sim, &pool->results[run]);
+            sim_destroy(sim);
+            pool->completed[run] = 1;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Runs independent lockstep simulations on a pool of threads, run i seeded with
+ * options->seed + i, and prints the mean and confidence interval of every
+ * metric. The summary does not depend on the number of threads.
+ *
+ * Arguments: options: how to set up each run; seed, verbose and lockstep are overridden.
+ *            runs: how many runs.
+ *            threads: pool size, 0 for one per online cpu.
+ * Return: 1 if every run completed, 0 otherwise.
+ */
+int mc_run(/* in */ const sim_options_s * options, /* in */ unsigned int runs, /* in */ unsigned int threads) {
+    mc_pool_s pool;
+    mc_stat_s stats[MC_METRIC_COUNT] = { { 0 } };
+    pthread_t * workers;
+    struct timespec start, end;
+    double elapsed, scale;
+    unsigned int i, failed = 0;
+    int m;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+    if (threads > runs) {
+        threads = runs;
+    }
+
+    pool.options = options;
+    pool.runs = runs;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pool.results = calloc(runs, sizeof(sim_results_s));
+    pool.completed = calloc(runs, 1);
+    workers = malloc(sizeof(pthread_t) * threads);
+    if (pool.results == NULL || pool.completed == NULL || workers == NULL) {
+        fprintf(stderr, "out of memory for %u runs\n", runs);
+        free(pool.results);
+        free(pool.completed);
+        free(workers);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, mc_worker, &pool);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    /* Reduce in run order, so the summary is the same for any pool size. */
+    for (i = 0; i < runs; i++) {
+        if (!pool.completed[i]) {
+            failed++;
+            continue;
+        }
+        for (m = 0; m < MC_METRIC_COUNT; m++) {
+            mc_stat_add(&stats[m], mc_metric_value(&pool.results[i], m));
+        }
+    }
+
+    printf("Monte-Carlo: %u runs (seeds %llu to %llu) on %u threads in %.2f s, %.1f runs/s\n",
+           runs, options->seed, options->seed + runs - 1, threads, elapsed, runs / elapsed);
+    printf("IO scheduling: %s, device queue depth %u\n", io_policy_names[options->io_policy], options->io_depth);
+    printf("Mutexes: %s, reader-writer locks: %s, priority inheritance: %s\n", lock_mode_names[options->lock_mode],
+           rw_mode_names[options->rw_mode], options->no_inherit ? "off" : "on");
+    if (failed > 0) {
+        printf("%u runs could not be set up and are left out\n", failed);
+    }
+    printf("%-22s %12s %12s %12s %12s %12s\n", "metric", "mean", "95% CI +/-", "stddev", "min", "max");
+    for (m = 0; m < MC_METRIC_COUNT; m++) {
+        scale = mc_metric_percent[m] ? 100.0 : 1.0;
+        printf("%-22s %12.3f %12.3f %12.3f %12.3f %12.3f\n", mc_metric_names[m],
+               scale * stats[m].mean, scale * mc_stat_ci95(&stats[m]), scale * mc_stat_stddev(&stats[m]),
+               scale * stats[m].min, scale * stats[m].max);
+    }
+
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.results);
+    free(pool.completed);
+    free(workers);
+    return failed == 0;
+}
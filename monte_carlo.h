@@ -0,0 +1,96 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include "cpu_loop.h"
+
+/* What is measured of every run. */
+enum mc_metric {
+    MC_CREATED,
+    MC_TERMINATED,
+    MC_CONTEXT_SWITCHES,
+    MC_UTILIZATION,
+    MC_SWITCH_LOSS,
+    MC_TLB_HIT_RATE,
+    MC_PAGE_FAULTS,
+    MC_ADMISSION_STALLS,
+    MC_FRAGMENTATION,
+    MC_DEADLOCKED,
+    MC_IO_UTILIZATION,
+    MC_IO_COMPLETED,
+    MC_IO_LATENCY,
+    MC_IO_LATENCY_P50,
+    MC_IO_LATENCY_P95,
+    MC_IO_LATENCY_P99,
+    MC_IO_QUEUE_DEPTH,
+    MC_IO_INSTRUCTIONS,
+    MC_LOCK_BLOCKS,
+    MC_SPIN_CYCLES,
+    MC_SPIN_SUCCESS,
+    MC_SYNC_BLOCKS,
+    MC_SHARED_READS,
+    MC_INVERSIONS,
+    MC_INVERSION_CYCLES,
+    MC_INVERSION_MAX,
+    MC_FORKS,
+    MC_COW_COPIES,
+    MC_IPC_MESSAGES,
+    MC_IPC_LATENCY,
+    MC_IPC_LATENCY_P99,
+    MC_METRIC_COUNT,
+};
+
+/* Running mean and variance of one metric, updated one run at a time (Welford). */
+typedef struct mc_stat {
+    unsigned long n;
+    double mean;
+    double m2;   // sum of squared differences from the mean
+    double min;
+    double max;
+} mc_stat_s;
+
+typedef mc_stat_s * mc_stat_p;
+
+/*
+ * Adds one observation.
+ *
+ * Arguments: stat: the statistic.
+ *            value: the observation.
+ */
+void mc_stat_add(/* in-out */ mc_stat_p stat, /* in */ double value);
+
+/*
+ * Return: the sample standard deviation, 0 for fewer than two observations.
+ */
+double mc_stat_stddev(/* in */ mc_stat_p stat);
+
+/*
+ * Half width of the 95% confidence interval of the mean, from Student's t.
+ *
+ * Return: the half width, 0 for fewer than two observations.
+ */
+double mc_stat_ci95(/* in */ mc_stat_p stat);
+
+/*
+ * Return: the value of a metric in the results of a run.
+ */
+double mc_metric_value(/* in */ const sim_results_s * results, /* in */ enum mc_metric metric);
+
+/*
+ * Runs independent lockstep simulations on a pool of threads, run i seeded with
+ * options->seed + i, and prints the mean and confidence interval of every
+ * metric. The summary does not depend on the number of threads.
+ *
+ * Arguments: options: how to set up each run; seed, verbose and lockstep are overridden.
+ *            runs: how many runs.
+ *            threads: pool size, 0 for one per online cpu.
+ * Return: 1 if every run completed, 0 otherwise.
+ */
+int mc_run(/* in */ const sim_options_s * options, /* in */ unsigned int runs, /* in */ unsigned int threads);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stddef.h>
+
+#include "mpsc_inbox.h"
+
+/*
+ * Sets up an empty inbox.
+ *
+ * Arguments: inbox: the inbox.
+ */
+void inbox_init(/* out */ mpsc_inbox_p inbox) {
+    inbox->head = NULL;
+    inbox->pushes = 0;
+    inbox->takes = 0;
+}
+
+/*
+ * Adds a pcb. Safe to call from any number of threads at once.
+ *
+ * Arguments: inbox: the inbox.
+ *            pcb: the pcb, which must not be in any queue or inbox.
+ */
+void inbox_push(/* in-out */ mpsc_inbox_p inbox, /* in */ PCB_p pcb) {
+    PCB_p head = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+
+    /* Release, so the consumer sees the link and everything written to the pcb before. */
+    do {
+        pcb->inbox_next = head;
+    } while (!__atomic_compare_exchange_n(&inbox->head, &head, pcb, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&inbox->pushes, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Removes everything pushed so far. Only one thread may take.
+ *
+ * Arguments: inbox: the inbox.
+ * Return: the first pushed pcb, linked through inbox_next in push order, NULL if empty.
+ */
+PCB_p inbox_take(/* in-out */ mpsc_inbox_p inbox) {
+    PCB_p list = __atomic_exchange_n(&inbox->head, NULL, __ATOMIC_ACQUIRE);
+    PCB_p ordered = NULL, next;
+
+    if (list != NULL)
+        inbox->takes++;
+
+    /* The list is newest first; reverse it so completions are handled in order. */
+    while (list != NULL) {
+        next = list->inbox_next;
+        list->inbox_next = ordered;
+        ordered = list;
+        list = next;
+    }
+    return ordered;
+}
+
+/*
+ * Return: 1 if nothing is waiting, a cheap check before inbox_take.
+ */
+int inbox_is_empty(/* in */ mpsc_inbox_p inbox) {
+    return __atomic_load_n(&inbox->head, __ATOMIC_RELAXED) == NULL;
+}
@@ -0,0 +1,55 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef MPSC_INBOX_H
+#define MPSC_INBOX_H
+
+#include "pcb.h"
+
+/*
+ * A lock-free multi-producer, single-consumer list of pcbs. Any thread pushes
+ * with one compare and swap; the one consumer takes everything at once with
+ * one exchange. Because the consumer never pops single entries, a pushed pcb
+ * cannot be recycled under a producer and there is no ABA problem. The link
+ * lives in the pcb (inbox_next), so pushing never allocates.
+ */
+typedef struct mpsc_inbox {
+    PCB_p head;                  // most recently pushed pcb, NULL when empty
+    unsigned long long pushes;   // pcbs pushed so far
+    unsigned long long takes;    // non-empty takes so far, consumer only
+} mpsc_inbox_s;
+
+typedef mpsc_inbox_s * mpsc_inbox_p;
+
+/*
+ * Sets up an empty inbox.
+ *
+ * Arguments: inbox: the inbox.
+ */
+void inbox_init(/* out */ mpsc_inbox_p inbox);
+
+/*
+ * Adds a pcb. Safe to call from any number of threads at once.
+ *
+ * Arguments: inbox: the inbox.
+ *            pcb: the pcb, which must not be in any queue or inbox.
+ */
+void inbox_push(/* in-out */ mpsc_inbox_p inbox, /* in */ PCB_p pcb);
+
+/*
+ * Removes everything pushed so far. Only one thread may take.
+ *
+ * Arguments: inbox: the inbox.
+ * Return: the first pushed pcb, linked through inbox_next in push order, NULL if empty.
+ */
+PCB_p inbox_take(/* in-out */ mpsc_inbox_p inbox);
+
+/*
+ * Return: 1 if nothing is waiting, a cheap check before inbox_take.
+ */
+int inbox_is_empty(/* in */ mpsc_inbox_p inbox);
+
+#endif
@@ -3,15 +3,21 @@
 #include "mutex_lock.h"
 #include "pcb.h"
 #include <stdio.h>
+#include <string.h>
 
 
 //// Dakota Crane, Dino Hadzic, Tyler Stinson
 
+const char * lock_mode_names[LOCK_MODE_COUNT] = { "block", "adaptive" };
 
-Lock_p lock_constructor() {
+Lock_p lock_constructor(proc_table_p table) {
     Lock_p lock = malloc(sizeof(Lock_s));
     lock->current_proc = NULL;
-    lock->waiting_procs = q_create();
+    lock->waiting_procs = q_create(table);
+    lock->acquired_at = 0;
+    lock->hold_avg8 = 0;
+    lock->inverted = 0;
+    lock->inverted_at = 0;
     return lock;
 }
 
@@ -104,3 +110,53 @@ void lock_destructor(Lock_p lock) {
     q_destroy(lock->waiting_procs);
     free(lock);
 }
+
+// stamps the start of a hold, so its length can be measured on release
+void lock_note_acquired(Lock_p lock, unsigned int now) {
+    lock->acquired_at = now;
+}
+
+// folds the hold ending now into the average, weighting it 1/8
+void lock_note_released(Lock_p lock, unsigned int now) {
+    unsigned int hold = now - lock->acquired_at;
+    lock->hold_avg8 = lock->hold_avg8 - lock->hold_avg8 / 8 + hold;
+}
+
+// cycles a waiter may spin before blocking: about one mean hold, since the
+// holder should be done by then; none for a lock usually held longer than max,
+// and max for a lock never released yet
+unsigned int lock_spin_budget(Lock_p lock, unsigned int max) {
+    unsigned int avg = lock->hold_avg8 / 8;
+    if (lock->hold_avg8 == 0)
+        return max;
+    return avg <= max ? avg : 0;
+}
+
+// notes a process of higher priority than the holder blocking on the lock,
+// starting an inversion unless one is already under way
+void lock_note_inverted(Lock_p lock, unsigned int now) {
+    if (!lock->inverted) {
+        lock->inverted = 1;
+        lock->inverted_at = now;
+    }
+}
+
+// ends the lock's inversion, if any, on release; returns how long it lasted
+unsigned int lock_note_uninverted(Lock_p lock, unsigned int now) {
+    if (!lock->inverted)
+        return 0;
+    lock->inverted = 0;
+    return now - lock->inverted_at;
+}
+
+// sets mode from its name; returns 0 if the name is unknown
+int lock_mode_parse(const char * name, enum lock_mode * mode) {
+    int i;
+    for (i = 0; i < LOCK_MODE_COUNT; i++) {
+        if (strcmp(name, lock_mode_names[i]) == 0) {
+            *mode = i;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -5,9 +5,23 @@
 
 #ifndef MUTEX_LOCK_H
 #define MUTEX_LOCK_H
+
+/* What a process does when the lock it wants is held. */
+enum lock_mode {
+    LOCK_MODE_BLOCK,     // wait in waiting_procs at once
+    LOCK_MODE_ADAPTIVE,  // spin for up to the lock's mean hold time first, then wait
+    LOCK_MODE_COUNT,
+};
+
+extern const char * lock_mode_names[LOCK_MODE_COUNT];
+
 typedef struct Lock {
     PCB_p current_proc;
     FIFOq_p waiting_procs;
+    unsigned int acquired_at; // cpu iteration current_proc took it
+    unsigned int hold_avg8;   // moving average of hold times in cycles, times 8
+    unsigned int inverted;    // 1 while a process of higher priority than the holder waits for it
+    unsigned int inverted_at; // cpu iteration the first such process blocked
 } Lock_s;
 
 typedef Lock_s * Lock_p;
@@ -39,11 +53,17 @@ proc_map_list_p proc_map_list_constructor();
 void proc_map_list_add(proc_map_list_p proc_map, proc_to_lock_map_p);
 void proc_map_list_destructor(proc_map_list_p proc_map);
 void proc_map_destructor(proc_map_list_p proc_map);
-Lock_p lock_constructor();
+Lock_p lock_constructor(proc_table_p table);
 proc_to_lock_map_p proc_map_constructor(Lock_p lock_1, Lock_p lock_2, PCB_p proc);
 int lock(Lock_p lock, PCB_p proc);
 int release_lock(Lock_p lock);
 int try_lock(Lock_p lock, PCB_p proc);
 void lock_destructor(Lock_p lock);
+void lock_note_acquired(Lock_p lock, unsigned int now);
+void lock_note_released(Lock_p lock, unsigned int now);
+unsigned int lock_spin_budget(Lock_p lock, unsigned int max);
+void lock_note_inverted(Lock_p lock, unsigned int now);
+unsigned int lock_note_uninverted(Lock_p lock, unsigned int now);
+int lock_mode_parse(const char * name, enum lock_mode * mode);
 proc_to_lock_map_p search_list_for_pcb(proc_map_list_p list, PCB_p proc);
 #endif
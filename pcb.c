@@ -4,127 +4,271 @@
  */
 
 #include"pcb.h"
+#include"proc_table.h"
+#include"buddy.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
 
-int global_largest_PID = 0;
+/*
+ * Default lock layout for MUTEX processes, one column per lock region.
+ */
+static const unsigned int default_lock_1[NUM_LOCKS] = {5, 18, 200, 500};
+static const unsigned int default_lock_2[NUM_LOCKS] = {6, 19, 201, 501};
+static const unsigned int default_unlock_2[NUM_LOCKS] = {14, 30, 250, 570};
+static const unsigned int default_unlock_1[NUM_LOCKS] = {15, 31, 251, 571};
+static const unsigned int default_trylock_1[NUM_LOCKS] = {33, 50, 280, 300};
+static const unsigned int default_trylock_2[NUM_LOCKS] = {34, 51, 281, 301};
+static const unsigned int default_try_unlock_2[NUM_LOCKS] = {35, 52, 282, 302};
+static const unsigned int default_try_unlock_1[NUM_LOCKS] = {36, 54, 283, 303};
+
+const char * proc_type_names[PROC_TYPE_COUNT] = {
+    "io", "intensive", "mutex", "prod", "cons", "reader", "writer", "sem", "barrier", "sender", "receiver"
+};
+const char * state_names[STATE_COUNT] = {
+    "new", "ready", "running", "interrupted", "waiting", "blocked", "halted", "terminated"
+};
+
+/*
+ * Default critical sections for PROD and CONS processes.
+ */
+static const unsigned int default_prod_cons_lock[NUM_LOCKS] = {69, 160, 251, 299};
+
+/*
+ * Default critical sections for READER, WRITER and SEM processes; BARRIER
+ * processes arrive at the acquire pcs.
+ */
+static const unsigned int default_sync_acquire[NUM_LOCKS] = {10, 40, 200, 500};
+static const unsigned int default_sync_release[NUM_LOCKS] = {30, 60, 250, 570};
+
+/* Default transfer points for SENDER and RECEIVER processes. */
+static const unsigned int default_ipc_transfer[NUM_LOCKS] = {25, 75, 150, 350};
+
+/*
+ * Size of the cold part for a given type, payload included.
+ */
+size_t cold_size(enum proc_type type) {
+    size_t size = offsetof(PCB_cold_s, payload);
+
+    switch (type) {
+    case IO:
+        size += sizeof(io_payload_s);
+        break;
+    case MUTEX:
+        size += sizeof(mutex_payload_s);
+        break;
+    case PROD:
+    case CONS:
+        size += sizeof(prod_cons_payload_s);
+        break;
+    case READER:
+    case WRITER:
+    case SEM:
+    case BARRIER:
+        size += sizeof(sync_payload_s);
+        break;
+    case SENDER:
+    case RECEIVER:
+        size += sizeof(ipc_payload_s);
+        break;
+    default:
+        break;
+    }
+    return size;
+}
 
 /*
  * Helper function to iniialize PCB data.
  */
-void initialize_data(/* in-out */ PCB_p pcb) {
-  pcb->pid = 0;
+void initialize_data(/* in-out */ PCB_p pcb, /* in */ enum proc_type type) {
+  PCB_cold_p cold = PCB_COLD(pcb);
+  int i;
+
+  pcb->pid = PT_NO_PID;
   pcb->priority = 0;
-  pcb->size = 0;
+  pcb->base_priority = PCB_NOT_INHERITED;
+  pcb->forks_left = 0;
   pcb->channel_no = 0;
   pcb->state = STATE_NEW;
+  pcb->proc_type = type;
+  pcb->pc = 0;
 
   pcb->max_pc = 0;
-  pcb->creation_time = 0;
-  pcb->termination_time = 0;
   pcb->terminate = 0;
   pcb->term_count = 0;
+  pcb->boost_epoch = 0;
+  pcb->page_table = 0;
+  pcb->last_ran = 0;
+  pcb->last_dispatch = 0;
+  pcb->inbox_next = NULL;
+
+  cold->parent = PT_NO_PID;
+  cold->children = 0;
+  cold->generation = 0;
+  cold->size = 0;
+  cold->mem = NULL;
+  cold->creation_time = 0;
+  cold->termination_time = 0;
+
+  memset(&cold->context, 0, sizeof(CPU_context_s));
 
-  pcb->mem = NULL;
-
-  pcb->context->pc = 0;
-  pcb->context->ir = 0;
-  pcb->context->r0 = 0;
-  pcb->context->r1 = 0;
-  pcb->context->r2 = 0;
-  pcb->context->r3 = 0;
-  pcb->context->r4 = 0;
-  pcb->context->r5 = 0;
-  pcb->context->r6 = 0;
-  pcb->context->r7 = 0;
-
-  pcb->lock_1[0] = 5;
-  pcb->lock_1[1] = 18;
-  pcb->lock_1[2] = 200;
-  pcb->lock_1[3] = 500;
-
-  pcb->lock_2[0] = 6;
-  pcb->lock_2[1] = 19;
-  pcb->lock_2[2] = 201;
-  pcb->lock_2[3] = 501;
-
-  pcb->unlock_2[0] = 14;
-  pcb->unlock_2[1] = 30;
-  pcb->unlock_2[2] = 250;
-  pcb->unlock_2[3] = 570;
-
-  pcb->unlock_1[0] = 15; 
-  pcb->unlock_1[1] = 31;
-  pcb->unlock_1[2] = 251;
-  pcb->unlock_1[3] = 571;
-
-  pcb->trylock_1[0] = 33;
-  pcb->trylock_1[1] = 50;
-  pcb->trylock_1[2] = 280;
-  pcb->trylock_1[3] = 300;
-
-  pcb->trylock_2[0] = 34;
-  pcb->trylock_2[1] = 51;
-  pcb->trylock_2[2] = 281;
-  pcb->trylock_2[3] = 301;
-
-  pcb->try_unlock_2[0] = 35;
-  pcb->try_unlock_2[1] = 52;
-  pcb->try_unlock_2[2] = 282;
-  pcb->try_unlock_2[3] = 302;
-
-  pcb->try_unlock_1[0] = 36;
-  pcb->try_unlock_1[1] = 54;
-
-  pcb->prod_cons_lock[0] = 69;
-  pcb->prod_cons_lock[1] = 160;
-  pcb->prod_cons_lock[2] = 251;
-  pcb->prod_cons_lock[3] = 299;
-
-  pcb->try_unlock_1[2] = 283;
-  pcb->try_unlock_1[3] = 303;
+  switch (type) {
+  case IO:
+    /* Never reached until the generator places them. */
+    for (i = 0; i < NUM_IO_TRAPS; i++) {
+      cold->payload.io.io_1_traps[i] = (unsigned int) -1;
+      cold->payload.io.io_2_traps[i] = (unsigned int) -1;
+    }
+    memset(&cold->payload.io.ring, 0, sizeof(io_ring_s));
+    break;
+  case MUTEX:
+    memcpy(cold->payload.mutex.lock_1, default_lock_1, sizeof(default_lock_1));
+    memcpy(cold->payload.mutex.lock_2, default_lock_2, sizeof(default_lock_2));
+    memcpy(cold->payload.mutex.unlock_2, default_unlock_2, sizeof(default_unlock_2));
+    memcpy(cold->payload.mutex.unlock_1, default_unlock_1, sizeof(default_unlock_1));
+    memcpy(cold->payload.mutex.trylock_1, default_trylock_1, sizeof(default_trylock_1));
+    memcpy(cold->payload.mutex.trylock_2, default_trylock_2, sizeof(default_trylock_2));
+    memcpy(cold->payload.mutex.try_unlock_2, default_try_unlock_2, sizeof(default_try_unlock_2));
+    memcpy(cold->payload.mutex.try_unlock_1, default_try_unlock_1, sizeof(default_try_unlock_1));
+    cold->payload.mutex.spun = 0;
+    break;
+  case PROD:
+  case CONS:
+    for (i = 0; i < NUM_IO_TRAPS; i++) {
+      cold->payload.prod_cons.io_1_traps[i] = (unsigned int) -1;
+      cold->payload.prod_cons.io_2_traps[i] = (unsigned int) -1;
+    }
+    cold->payload.prod_cons.prod_cons_id = 0;
+    memcpy(cold->payload.prod_cons.prod_cons_lock, default_prod_cons_lock, sizeof(default_prod_cons_lock));
+    break;
+  case READER:
+  case WRITER:
+  case SEM:
+    memcpy(cold->payload.sync.acquire, default_sync_acquire, sizeof(default_sync_acquire));
+    memcpy(cold->payload.sync.release, default_sync_release, sizeof(default_sync_release));
+    cold->payload.sync.sync_id = 0;
+    break;
+  case BARRIER:
+    memcpy(cold->payload.sync.acquire, default_sync_acquire, sizeof(default_sync_acquire));
+    for (i = 0; i < NUM_LOCKS; i++)
+      cold->payload.sync.release[i] = (unsigned int) -1;
+    cold->payload.sync.sync_id = 0;
+    break;
+  case SENDER:
+  case RECEIVER:
+    memcpy(cold->payload.ipc.transfer, default_ipc_transfer, sizeof(default_ipc_transfer));
+    cold->payload.ipc.channel = 0;
+    cold->payload.ipc.batch = 1;
+    break;
+  default:
+    break;
+  }
 }
 
 /*
- * Allocate a PCB and a context for that PCB.
+ * Allocate a PCB of the given type: a cache-line-aligned hot header followed by
+ * a cold part sized for the type's payload, in a single allocation.
  *
- * Return: NULL if context or PCB allocation failed, the new pointer otherwise.
+ * Arguments: type: the type of process, fixes the payload.
+ * Return: NULL if allocation failed, the new pointer otherwise.
  */
-PCB_p PCB_create() {
-    PCB_p new_pcb = malloc(sizeof(PCB_s));
+PCB_p PCB_create(/* in */ enum proc_type type) {
+    PCB_p new_pcb = aligned_alloc(PCB_HOT_SIZE, PCB_footprint(type));
     if (new_pcb != NULL) {
-        new_pcb->context = malloc(sizeof(CPU_context_s));
-
-	// is anything beyond the for and necessary here? Wouldn't we run into a stack overflow if this fasiled
-        if (new_pcb->context != NULL && new_pcb->io_1_traps != NULL && new_pcb->io_2_traps != NULL && new_pcb->lock_1 != NULL && new_pcb->lock_2 != NULL && new_pcb->unlock_1 != NULL && new_pcb->unlock_2 != NULL) {
-          initialize_data(new_pcb);
-        } else {
-            free(new_pcb);
-            new_pcb = NULL;
-        }
+        initialize_data(new_pcb, type);
     }
     return new_pcb;
 }
 
 /*
- * Frees a PCB and its context.
+ * Frees a PCB, unregistering it and returning its image to the table's memory.
  *
- * Arguments: pcb: the pcb to free.
+ * Arguments: table: the process table it is registered in.
+ *            pcb: the pcb to free.
  */
-void PCB_destroy(/* in-out */ PCB_p pcb) {
-  free(pcb->context);
+void PCB_destroy(/* in-out */ proc_table_p table, /* in-out */ PCB_p pcb) {
+  if (pt_lookup_pid(table, pcb->pid) == pcb) {
+    pt_remove(table, pcb->pid);
+  }
+  if (PCB_COLD(pcb)->mem != NULL) {
+    buddy_free(table->images, PCB_COLD(pcb)->mem, PCB_COLD(pcb)->size);
+  }
   free(pcb);
 }
 
 /*
- * Assigns intial process ID to the process.
+ * Clones a process under a new pid: its context, pc and trap schedule. The
+ * child is READY, has no page table and no image of its own, and has its
+ * own empty IO rings.
  *
- * Arguments: pcb: the pcb to modify.
+ * Arguments: table: the process table to register the child in.
+ *            parent: the process to clone, with its pc up to date.
+ * Return: the child, NULL if allocation failed or the table could not grow.
  */
-void PCB_assign_PID(/* in */ PCB_p the_PCB) {
-    the_PCB->pid = global_largest_PID;
-    global_largest_PID++;
+PCB_p PCB_fork(/* in-out */ proc_table_p table, /* in-out */ PCB_p parent) {
+    PCB_p child = aligned_alloc(PCB_HOT_SIZE, PCB_footprint(parent->proc_type));
+    PCB_cold_p cold;
+    unsigned char enabled;
+
+    if (child == NULL) {
+        return NULL;
+    }
+    memcpy(child, parent, PCB_footprint(parent->proc_type));
+    cold = PCB_COLD(child);
+
+    child->state = STATE_READY;
+    /* An inherited priority stays with the lock holder. */
+    if (child->base_priority != PCB_NOT_INHERITED) {
+        child->priority = child->base_priority;
+        child->base_priority = PCB_NOT_INHERITED;
+    }
+    child->page_table = 0;
+    child->last_dispatch = 0;
+    child->inbox_next = NULL;
+
+    cold->parent = parent->pid;
+    cold->children = 0;
+    cold->generation++;
+    cold->mem = NULL;
+    cold->creation_time = time(NULL);
+    cold->termination_time = 0;
+    if (child->proc_type == IO) {
+        enabled = cold->payload.io.ring.enabled;
+        memset(&cold->payload.io.ring, 0, sizeof(io_ring_s));
+        cold->payload.io.ring.enabled = enabled;
+    }
+
+    if (!PCB_assign_PID(table, child)) {
+        free(child);
+        return NULL;
+    }
+    return child;
+}
+
+/*
+ * Calculates the number of bytes a PCB of the given type occupies.
+ *
+ * Arguments: type: the type of process.
+ * Return: the size of the single PCB allocation for that type.
+ */
+size_t PCB_footprint(/* in */ enum proc_type type) {
+    size_t size = sizeof(PCB_s) + cold_size(type);
+    /* aligned_alloc needs a multiple of the alignment. */
+    return (size + PCB_HOT_SIZE - 1) / PCB_HOT_SIZE * PCB_HOT_SIZE;
+}
+
+/*
+ * Assigns intial process ID to the process. The pid is the process's slot in
+ * the process table, so pids of terminated processes are reused.
+ *
+ * Arguments: table: the process table to register in.
+ *            pcb: the pcb to modify.
+ * Return: 1 on success, 0 if the table is full and could not grow; the pid is
+ *         then PT_NO_PID.
+ */
+int PCB_assign_PID(/* in-out */ proc_table_p table, /* in */ PCB_p the_PCB) {
+    the_PCB->pid = pt_insert(table, the_PCB);
+    return the_PCB->pid != PT_NO_PID;
 }
 
 /*
@@ -144,7 +288,7 @@ void PCB_assign_state(/* in-out */ PCB_p the_pcb, /* in */ enum state_type the_s
  *            pid: the parent PID for this process.
  */
 void PCB_assign_parent(PCB_p the_pcb, int the_pid) {
-    the_pcb->parent = the_pid;
+    PCB_COLD(the_pcb)->parent = the_pid;
 }
 
 /*
@@ -170,20 +314,21 @@ char * PCB_to_string(/* in */ PCB_p the_pcb) {
     /* Oversized buffer for creating the initial version of the string. */
     char temp_buf[1000];
     unsigned int cpos = 0;
+    PCB_cold_p cold = PCB_COLD(the_pcb);
 
     cpos += sprintf(temp_buf, "contents: PID: 0x%X, Priority: 0x%X, state: %u, "
             "memloc: %p size: %u channel: %X ",
             the_pcb->pid, the_pcb->priority, the_pcb->state,
-            the_pcb->mem, the_pcb->size, the_pcb->channel_no);
+            cold->mem, cold->size, the_pcb->channel_no);
 
     /* Append the context: */
     sprintf(temp_buf + cpos, "PC: 0x%04X, IR: %04X, "
             "r0: %04X, r1: %04X, r2: %04X, r3: %04X, r4: %04X, "
             "r5: %04X, r6: %04X, r7: %04X",
-            the_pcb->context->pc, the_pcb->context->ir, the_pcb->context->r0,
-            the_pcb->context->r1, the_pcb->context->r2, the_pcb->context->r3,
-            the_pcb->context->r4, the_pcb->context->r5, the_pcb->context->r6,
-            the_pcb->context->r7);
+            the_pcb->pc, cold->context.ir, cold->context.r0,
+            cold->context.r1, cold->context.r2, cold->context.r3,
+            cold->context.r4, cold->context.r5, cold->context.r6,
+            cold->context.r7);
 
     /* A string that can be returned and -not- go out of scope. */
     char * ret_val = malloc(sizeof(char) * (strlen(temp_buf) + 1));
@@ -195,3 +340,57 @@ char * PCB_to_string(/* in */ PCB_p the_pcb) {
 
     return ret_val;
 }
+
+/*
+ * Writes a PCB to a checkpoint. The image is stored as its offset in
+ * simulated physical memory.
+ *
+ * Arguments: w: the checkpoint.
+ *            table: the process table, whose memory holds the image.
+ *            pcb: the pcb to write.
+ */
+void PCB_save(/* in-out */ ckpt_writer_p w, /* in */ proc_table_p table, /* in */ PCB_p pcb) {
+    PCB_s copy[8]; // large enough for every type's footprint
+    size_t size = PCB_footprint(pcb->proc_type);
+    uint64_t mem = PCB_COLD(pcb)->mem == NULL ? UINT64_MAX : (uint64_t) (PCB_COLD(pcb)->mem - table->images->arena);
+
+    /* Blank the pointers so nothing address dependent reaches the file. */
+    memcpy(copy, pcb, size);
+    PCB_COLD(copy)->mem = NULL;
+    copy->inbox_next = NULL;
+
+    ckpt_put_u32(w, pcb->proc_type);
+    ckpt_put(w, &mem, sizeof(mem));
+    ckpt_put(w, copy, size);
+}
+
+/*
+ * Reads a PCB back from a checkpoint and puts it in its process table slot.
+ * The process table and simulated memory must already be restored.
+ *
+ * Arguments: r: the checkpoint.
+ *            table: the process table to put it in.
+ * Return: the new pcb, NULL if the record is damaged or out of memory.
+ */
+PCB_p PCB_load(/* in-out */ ckpt_reader_p r, /* in-out */ proc_table_p table) {
+    enum proc_type type = ckpt_get_u32(r);
+    uint64_t mem;
+    PCB_p pcb;
+
+    ckpt_read(r, &mem, sizeof(mem));
+    if (!r->ok || type >= PROC_TYPE_COUNT || (pcb = PCB_create(type)) == NULL) {
+        r->ok = 0;
+        return NULL;
+    }
+
+    if (!ckpt_read(r, pcb, PCB_footprint(type)) || pcb->proc_type != type
+        || pt_lookup_pid(table, pcb->pid) != NULL || pcb->pid >= table->used) {
+        r->ok = 0;
+        free(pcb);
+        return NULL;
+    }
+    PCB_COLD(pcb)->mem = mem == UINT64_MAX ? NULL : table->images->arena + mem;
+    PT_SLOT(table, pcb->pid).pcb = pcb;
+
+    return pcb;
+}
@@ -3,8 +3,13 @@
  * Dakota Crane, Dino Hadzic, Tyler Stinson
  * TCSS 422.
  */
+#include <stddef.h>
 #include <time.h>
 
+#include "checkpoint.h"
+#include "io_ring.h"
+#include "trap_match.h"
+
 #ifndef PCB_H  /* Include guard */
 #define PCB_H
 
@@ -13,12 +18,10 @@
 
 
 #define NUM_LOCKS 4
-#define NUM_WAIT 4
 
 
-/* The CPU state, values named as in the LC-3 processor. */
+/* The CPU state, values named as in the LC-3 processor. The pc lives in the PCB hot header. */
 typedef struct cpu_context {
-    unsigned int pc;
     unsigned int ir;
     unsigned int psr;
     unsigned int r0;
@@ -39,6 +42,13 @@ enum proc_type {
     MUTEX,
     PROD,
     CONS,
+    READER, // READER to WRITER share a reader-writer lock in groups
+    WRITER,
+    SEM,    // share a counting semaphore in groups
+    BARRIER, // meet at a barrier in groups
+    SENDER, // send on a pipe or mailbox to a RECEIVER
+    RECEIVER,
+    PROC_TYPE_COUNT,
 };
 /* enum for various process states. */
 enum state_type {
@@ -60,81 +70,243 @@ enum state_type {
     STATE_TERMINATED,
 };
 
-/* Process Control Block - Contains info required for executing processes. */
+#define STATE_COUNT (STATE_TERMINATED + 1)
+
+extern const char * proc_type_names[PROC_TYPE_COUNT];
+extern const char * state_names[STATE_COUNT];
+
+#define PCB_HOT_SIZE 64 // one cache line
+
+/*
+ * Process Control Block - hot header.
+ * Everything the scheduler, dispatcher and cpu loop touch on every cycle, in one
+ * cache line. The type-specific cold part follows it in the same allocation,
+ * see PCB_COLD().
+ */
 typedef struct pcb {
     unsigned int pid; // process identification
     enum state_type state; // process state (running, waiting, etc.)
-    unsigned int parent; // parent process pid
-    unsigned char priority; // 0 is highest – 15 is lowest.
-    unsigned char * mem; // start of process in memory
-    unsigned int size; // number of bytes in process
-    unsigned char channel_no; // which I/O device or service Q
-    // if process is blocked, which queue it is in
-    CPU_context_p context; // set of cpu registers
+    enum proc_type proc_type; // selects the payload in the cold part
+    unsigned int pc; // saved program counter
     unsigned int max_pc; // max number of instructions to process before reset
-    time_t creation_time; // system time of process creation
-    time_t termination_time; // system of of process termination, if relevant
     unsigned int terminate; // control field - how many runs until proc terminates
     unsigned int term_count; // counter - how many times has proc passed max_pc value
+    unsigned int boost_epoch; // ready queue boost epoch when this proc was last enqueued
+    unsigned int page_table; // root of the proc's page table in vmem, 0 if nothing is mapped
+    unsigned int last_ran; // cpu iteration this proc last executed an instruction
+    unsigned int last_dispatch; // dispatch number of its last dispatch, 0 if never dispatched
+    struct pcb * inbox_next; // link while in an IO completion inbox
+    unsigned char priority; // 0 is highest – 15 is lowest.
+    unsigned char channel_no; // which I/O device or service Q
+    // if process is blocked, which queue it is in
+    unsigned char base_priority; // own priority while it runs at one inherited through a lock, else PCB_NOT_INHERITED
+    unsigned char forks_left; // forks it makes, one at the end of each coming pass
+} __attribute__((aligned(PCB_HOT_SIZE))) PCB_s;
 
+#define PCB_NOT_INHERITED 0xff
 
-    unsigned int prod_cons_id;
-
-    unsigned int io_1_traps[NUM_IO_TRAPS];
-    unsigned int io_2_traps[NUM_IO_TRAPS];
-
-
-    enum proc_type proc_type;
+/*
+ * Trap pcs of each type are packed into one array, a group of four per action,
+ * so trap_match() checks them all at once; traps views the named groups.
+ * Group numbers follow the member order.
+ */
+enum io_trap_group {
+    IO_TRAP_1,
+    IO_TRAP_2,
+    IO_TRAP_GROUPS,
+};
 
-    unsigned int lock_1[4];
-    unsigned int lock_2[4];
+enum mutex_trap_group {
+    MUTEX_TRAP_LOCK_1,
+    MUTEX_TRAP_LOCK_2,
+    MUTEX_TRAP_UNLOCK_2,
+    MUTEX_TRAP_UNLOCK_1,
+    MUTEX_TRAP_TRYLOCK_1,
+    MUTEX_TRAP_TRYLOCK_2,
+    MUTEX_TRAP_TRY_UNLOCK_1,
+    MUTEX_TRAP_TRY_UNLOCK_2,
+    MUTEX_TRAP_GROUPS,
+};
 
+enum prod_cons_trap_group {
+    PROD_CONS_TRAP_IO_1,
+    PROD_CONS_TRAP_IO_2,
+    PROD_CONS_TRAP_LOCK,
+    PROD_CONS_TRAP_GROUPS,
+};
 
-    // unlock always needs to follow lock or trylock...
-    // does that mean we need an unlock for each lock and trylock?
-    unsigned int unlock_2[4];
-    unsigned int unlock_1[4];
+enum sync_trap_group {
+    SYNC_TRAP_ACQUIRE, // read or write lock, semaphore wait, barrier arrival
+    SYNC_TRAP_RELEASE, // unlock or semaphore post; unused by BARRIER
+    SYNC_TRAP_GROUPS,
+};
 
-    // what does this case look like?
-    // spinlock, but pc wouldnt move if this were the case
-    // just a goto statement depending on whether or not the proc can acquire the lock
+/*
+ * Trap pcs for IO processes; prod/cons payloads start with the same layout.
+ * The rings follow the traps and exist for IO processes only.
+ */
+typedef struct io_payload {
+    union {
+        struct {
+            unsigned int io_1_traps[NUM_IO_TRAPS];
+            unsigned int io_2_traps[NUM_IO_TRAPS];
+        };
+        unsigned int traps[IO_TRAP_GROUPS * TRAP_GROUP_SIZE];
+    };
+
+    io_ring_s ring; // asynchronous IO, used when ring.enabled
+} __attribute__((aligned(TRAP_VECTOR_ALIGN))) io_payload_s;
+
+/* Trap pcs for MUTEX processes. */
+typedef struct mutex_payload {
+    union {
+        struct {
+            unsigned int lock_1[NUM_LOCKS];
+            unsigned int lock_2[NUM_LOCKS];
+
+            // unlock always needs to follow lock or trylock...
+            unsigned int unlock_2[NUM_LOCKS];
+            unsigned int unlock_1[NUM_LOCKS];
+
+            // just a goto statement depending on whether or not the proc can acquire the lock
+            unsigned int trylock_1[NUM_LOCKS];
+            unsigned int trylock_2[NUM_LOCKS];
+
+            unsigned int try_unlock_1[NUM_LOCKS];
+            unsigned int try_unlock_2[NUM_LOCKS];
+        };
+        unsigned int traps[MUTEX_TRAP_GROUPS * TRAP_GROUP_SIZE];
+    };
+
+    unsigned int spun; // cycles spent spinning on the held lock it wants, 0 when not spinning
+} __attribute__((aligned(TRAP_VECTOR_ALIGN))) mutex_payload_s;
+
+/* PROD and CONS processes do IO as well as using their pair's lock. */
+typedef struct prod_cons_payload {
+    union {
+        struct {
+            unsigned int io_1_traps[NUM_IO_TRAPS];
+            unsigned int io_2_traps[NUM_IO_TRAPS];
+            unsigned int prod_cons_lock[NUM_LOCKS];
+        };
+        unsigned int traps[PROD_CONS_TRAP_GROUPS * TRAP_GROUP_SIZE];
+    };
 
-    unsigned int trylock_1[4];
-    unsigned int trylock_2[4];
+    unsigned int prod_cons_id;
+} __attribute__((aligned(TRAP_VECTOR_ALIGN))) prod_cons_payload_s;
 
-    unsigned int try_unlock_1[4];
-    unsigned int try_unlock_2[4];
+/*
+ * READER, WRITER, SEM and BARRIER processes: critical sections from each
+ * acquire pc to the release pc in the same column, or barrier arrivals.
+ */
+typedef struct sync_payload {
+    union {
+        struct {
+            unsigned int acquire[NUM_LOCKS];
+            unsigned int release[NUM_LOCKS];
+        };
+        unsigned int traps[SYNC_TRAP_GROUPS * TRAP_GROUP_SIZE];
+    };
+
+    unsigned int sync_id; // which of the simulation's primitives of its kind it uses
+} __attribute__((aligned(TRAP_VECTOR_ALIGN))) sync_payload_s;
+
+/* SENDER and RECEIVER processes: each transfer pc sends or receives a batch of messages. */
+typedef struct ipc_payload {
+    unsigned int transfer[NUM_LOCKS];
+
+    unsigned int channel; // index of its pipe or mailbox among the simulation's channels
+    unsigned int batch; // most messages a transfer moves
+} __attribute__((aligned(TRAP_VECTOR_ALIGN))) ipc_payload_s;
+
+_Static_assert(NUM_IO_TRAPS == TRAP_GROUP_SIZE && NUM_LOCKS == TRAP_GROUP_SIZE,
+               "trap arrays must be whole trap_match groups");
+_Static_assert(MUTEX_TRAP_GROUPS <= TRAP_MAX_GROUPS, "too many trap groups");
+
+/* Process Control Block - cold part, only read on creation, traps and printing. */
+typedef struct pcb_cold {
+    unsigned int parent; // parent process pid, PT_NO_PID if it was not forked
+    unsigned int children; // processes it forked
+    unsigned int generation; // forks between it and a generated process, 0 for one
+    unsigned int size; // number of bytes in process
+    unsigned char * mem; // start of process in memory
+    time_t creation_time; // system time of process creation
+    time_t termination_time; // system of of process termination, if relevant
+    CPU_context_s context; // set of cpu registers
+
+    /* Tagged by the hot header's proc_type; INTENSIVE has no payload. */
+    union {
+        io_payload_s io; // IO, and the io traps of PROD and CONS
+        mutex_payload_s mutex; // MUTEX
+        prod_cons_payload_s prod_cons; // PROD and CONS
+        sync_payload_s sync; // READER, WRITER, SEM and BARRIER
+        ipc_payload_s ipc; // SENDER and RECEIVER
+    } payload;
+} PCB_cold_s;
+
+typedef PCB_cold_s * PCB_cold_p;
+
+/* The cold part of a pcb, directly after its hot header. */
+#define PCB_COLD(pcb) ((PCB_cold_p) ((pcb) + 1))
+/* Payload accessors; only valid for the proc_types noted in PCB_cold_s. */
+#define PCB_IO_TRAPS(pcb) (&PCB_COLD(pcb)->payload.io)
+#define PCB_IO_RING(pcb) (&PCB_COLD(pcb)->payload.io.ring)
+#define PCB_MUTEX(pcb) (&PCB_COLD(pcb)->payload.mutex)
+#define PCB_PROD_CONS(pcb) (&PCB_COLD(pcb)->payload.prod_cons)
+#define PCB_SYNC(pcb) (&PCB_COLD(pcb)->payload.sync)
+#define PCB_IPC(pcb) (&PCB_COLD(pcb)->payload.ipc)
 
-    unsigned int prod_cons_lock[4];
-    // other items to be added as needed.
+typedef PCB_s * PCB_p;
 
-    unsigned int wait[NUM_WAIT];
-    unsigned int signal[NUM_WAIT];
+/* Defined in proc_table.h, which needs the pcb types first. */
+struct proc_table;
 
-} PCB_s;
+/*
+ * Allocate a PCB of the given type: a cache-line-aligned hot header followed by
+ * a cold part sized for the type's payload, in a single allocation.
+ *
+ * Arguments: type: the type of process, fixes the payload.
+ * Return: NULL if allocation failed, the new pointer otherwise.
+ */
+PCB_p PCB_create(/* in */ enum proc_type type);
 
-typedef PCB_s * PCB_p;
+/*
+ * Frees a PCB, unregistering it and returning its image to the table's memory.
+ *
+ * Arguments: table: the process table it is registered in.
+ *            pcb: the pcb to free.
+ */
+void PCB_destroy(/* in-out */ struct proc_table * table, /* in-out */ PCB_p pcb);
 
 /*
- * Allocate a PCB and a context for that PCB.
+ * Clones a process under a new pid: its context, pc and trap schedule. The
+ * child is READY, has no page table and no image of its own, and has its
+ * own empty IO rings.
  *
- * Return: NULL if context or PCB allocation failed, the new pointer otherwise.
+ * Arguments: table: the process table to register the child in.
+ *            parent: the process to clone, with its pc up to date.
+ * Return: the child, NULL if allocation failed or the table could not grow.
  */
-PCB_p PCB_create();
+PCB_p PCB_fork(/* in-out */ struct proc_table * table, /* in-out */ PCB_p parent);
 
 /*
- * Frees a PCB and its context.
+ * Calculates the number of bytes a PCB of the given type occupies.
  *
- * Arguments: pcb: the pcb to free.
+ * Arguments: type: the type of process.
+ * Return: the size of the single PCB allocation for that type.
  */
-void PCB_destroy(/* in-out */ PCB_p pcb);
+size_t PCB_footprint(/* in */ enum proc_type type);
 
 /*
- * Assigns intial process ID to the process.
+ * Assigns intial process ID to the process. The pid is the process's slot in
+ * the process table, so pids of terminated processes are reused.
  *
- * Arguments: pcb: the pcb to modify.
+ * Arguments: table: the process table to register in.
+ *            pcb: the pcb to modify.
+ * Return: 1 on success, 0 if the table is full and could not grow; the pid is
+ *         then PT_NO_PID.
  */
-void PCB_assign_PID(/* in */ PCB_p pcb);
+int PCB_assign_PID(/* in-out */ struct proc_table * table, /* in */ PCB_p pcb);
 
 /*
  * Sets the state of the process to the provided state.
@@ -168,4 +340,24 @@ void PCB_assign_priority(/* in */ PCB_p pcb, /* in */ unsigned int priority);
  */
 char * PCB_to_string(/* in */ PCB_p pcb);
 
+/*
+ * Writes a PCB to a checkpoint. The image is stored as its offset in
+ * simulated physical memory.
+ *
+ * Arguments: w: the checkpoint.
+ *            table: the process table, whose memory holds the image.
+ *            pcb: the pcb to write.
+ */
+void PCB_save(/* in-out */ ckpt_writer_p w, /* in */ struct proc_table * table, /* in */ PCB_p pcb);
+
+/*
+ * Reads a PCB back from a checkpoint and puts it in its process table slot.
+ * The process table and simulated memory must already be restored.
+ *
+ * Arguments: r: the checkpoint.
+ *            table: the process table to put it in.
+ * Return: the new pcb, NULL if the record is damaged or out of memory.
+ */
+PCB_p PCB_load(/* in-out */ ckpt_reader_p r, /* in-out */ struct proc_table * table);
+
 #endif
@@ -15,20 +15,22 @@
 /*
  * Creates a priority queue.
  *
+ * Arguments: table: the process table of the pcbs it will hold.
  * Return: A new priority queue on success, NULL on failure.
  */
-PQ_p pq_create() {
+PQ_p pq_create(proc_table_p table) {
     int i, failed = -1;
     PQ_p new_pq = malloc(sizeof(PQ_s));
 
     if (new_pq != NULL) {
         for (i = 0; i < NUM_PRIORITIES; i++) {
-            new_pq->queues[i] = q_create();
+            new_pq->queues[i] = q_create(table);
             if (new_pq->queues[i] == NULL) {
                 failed = i;
                 break;
             }
         }
+        new_pq->boost_epoch = 0;
         /* If failed is non-zero, we need to free up everything else. */
         for (i = 0; i <= failed; i++) {
             q_destroy(new_pq->queues[i]);
@@ -66,6 +68,7 @@ void pq_destroy(PQ_p PQ) {
  *            pcb: the PCB to enqueue.
  */
 void pq_enqueue(PQ_p PQ, PCB_p pcb) {
+    pcb->boost_epoch = PQ->boost_epoch;
     q_enqueue(PQ->queues[pcb->priority], pcb);
 }
 
@@ -85,9 +88,63 @@ PCB_p pq_dequeue(PQ_p PQ) {
             break;
         }
     }
+
+    /* A boost happened while this PCB was queued, apply it now, to an inherited priority's owner too. */
+    if (ret_pcb != NULL && ret_pcb->boost_epoch != PQ->boost_epoch) {
+        PCB_assign_priority(ret_pcb, 0);
+        if (ret_pcb->base_priority != PCB_NOT_INHERITED)
+            ret_pcb->base_priority = 0;
+        ret_pcb->boost_epoch = PQ->boost_epoch;
+    }
     return ret_pcb;
 }
 
+/*
+ * Return: the priority a PCB in the queue will be dispatched at, counting a
+ *         boost it has not seen yet; its own priority if it is not queued.
+ */
+unsigned int pq_priority(PQ_p PQ, PCB_p pcb) {
+    if (pcb->state == STATE_READY && pcb->boost_epoch != PQ->boost_epoch)
+        return 0;
+    return pcb->priority;
+}
+
+/*
+ * Raises a PCB to a higher priority, moving it to the back of that bin if it
+ * is queued here. A PCB spliced into bin 0 by a boost it has not yet seen
+ * already runs at the top, so it stays where it is.
+ *
+ * Arguments: PQ: The Priority Queue it may be in.
+ *            pcb: the PCB to raise.
+ *            priority: its new priority, below its current one.
+ */
+void pq_raise(PQ_p PQ, PCB_p pcb, unsigned int priority) {
+    if (q_remove(PQ->queues[pcb->priority], pcb)) {
+        PCB_assign_priority(pcb, priority);
+        q_enqueue(PQ->queues[pcb->priority], pcb);
+    } else {
+        PCB_assign_priority(pcb, priority);
+    }
+}
+
+/*
+ * Boosts every queued PCB to priority 0 in O(NUM_PRIORITIES) time.
+ * Each lower priority bin is spliced onto the back of bin 0, in order, and the
+ * boost epoch is bumped; the priority field of a moved PCB is corrected lazily
+ * when it is next dequeued.
+ *
+ * Arguments: PQ: The Priority Queue to boost.
+ */
+void pq_boost(PQ_p PQ) {
+    int i;
+
+    /* Starts at 1, because all in queue 0 are already priority 0. */
+    for (i = 1; i < NUM_PRIORITIES; i++) {
+        q_splice(PQ->queues[0], PQ->queues[i]);
+    }
+    PQ->boost_epoch++;
+}
+
 /*
  * Peeks at the front of the priority queue.
  *
@@ -178,3 +235,35 @@ char * pq_to_string(PQ_p PQ) {
 
     return ret_str;
 }
+
+/*
+ * Writes a priority queue to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            PQ: the Priority Queue to write.
+ */
+void pq_save(ckpt_writer_p w, PQ_p PQ) {
+    int i;
+
+    ckpt_put_u32(w, PQ->boost_epoch);
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        q_save(w, PQ->queues[i]);
+    }
+}
+
+/*
+ * Reads a priority queue back from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            PQ: the Priority Queue to overwrite.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int pq_load(ckpt_reader_p r, PQ_p PQ) {
+    int i;
+
+    PQ->boost_epoch = ckpt_get_u32(r);
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        q_load(r, PQ->queues[i]);
+    }
+    return r->ok;
+}
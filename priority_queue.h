@@ -12,6 +12,8 @@
 
 typedef struct priority_queue {
     FIFOq_p     queues[NUM_PRIORITIES];
+    /* Bumped by every boost; PCBs enqueued under an older epoch are priority 0. */
+    unsigned int boost_epoch;
 } PQ_s;
 
 typedef struct priority_queue * PQ_p;
@@ -20,9 +22,10 @@ typedef struct priority_queue * PQ_p;
 /*
  * Creates a priority queue.
  *
+ * Arguments: table: the process table of the pcbs it will hold.
  * Return: A new priority queue on success, NULL on failure.
  */
-PQ_p pq_create();
+PQ_p pq_create(proc_table_p table);
 
 /*
  * Destroys the provided priority queue, freeing all contents.
@@ -46,6 +49,32 @@ void pq_enqueue(PQ_p PQ, PCB_p pcb);
  */
 PCB_p pq_dequeue(PQ_p PQ);
 
+/*
+ * Return: the priority a PCB in the queue will be dispatched at, counting a
+ *         boost it has not seen yet; its own priority if it is not queued.
+ */
+unsigned int pq_priority(PQ_p PQ, PCB_p pcb);
+
+/*
+ * Raises a PCB to a higher priority, moving it to the back of that bin if it
+ * is queued here, and only setting its priority if it is not.
+ *
+ * Arguments: PQ: The Priority Queue it may be in.
+ *            pcb: the PCB to raise.
+ *            priority: its new priority, below its current one.
+ */
+void pq_raise(PQ_p PQ, PCB_p pcb, unsigned int priority);
+
+/*
+ * Boosts every queued PCB to priority 0 in O(NUM_PRIORITIES) time.
+ * Each lower priority bin is spliced onto the back of bin 0, in order, and the
+ * boost epoch is bumped; the priority field of a moved PCB is corrected lazily
+ * when it is next dequeued.
+ *
+ * Arguments: PQ: The Priority Queue to boost.
+ */
+void pq_boost(PQ_p PQ);
+
 /*
  * Peeks at the front of the priority queue.
  *
@@ -78,4 +107,21 @@ char pq_is_empty(PQ_p PQ);
  */
 char * pq_to_string(PQ_p PQ);
 
+/*
+ * Writes a priority queue to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            PQ: the Priority Queue to write.
+ */
+void pq_save(ckpt_writer_p w, PQ_p PQ);
+
+/*
+ * Reads a priority queue back from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ *            PQ: the Priority Queue to overwrite.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int pq_load(ckpt_reader_p r, PQ_p PQ);
+
 #endif
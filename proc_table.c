@@ -0,0 +1,223 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+
+#include "proc_table.h"
+
+/*
+ * Sets up an empty table, with no grow_lock. Slots are allocated on the first insert.
+ *
+ * Arguments: table: the table to set up.
+ *            images: the allocator the images of its pcbs come from, may be NULL.
+ */
+void pt_init(/* out */ proc_table_p table, /* in */ buddy_p images) {
+    table->slots = NULL;
+    table->capacity = 0;
+    table->live = 0;
+    table->used = 0;
+    table->free_head = PT_NIL;
+    table->free_tail = PT_NIL;
+    table->images = images;
+    table->grow_lock = NULL;
+}
+
+/*
+ * Doubles the slot array. Slots are only ever referred to by index, so moving
+ * them is safe, provided threads that follow links of their own queues hold
+ * grow_lock meanwhile.
+ *
+ * Return: 1 if successful, 0 if out of memory or at PT_MAX_SLOTS.
+ */
+int pt_grow(/* in-out */ proc_table_p table) {
+    uint32_t new_capacity = table->capacity == 0 ? PT_INITIAL_SLOTS : table->capacity * 2;
+    proc_slot_s * resized;
+
+    if (table->capacity >= PT_MAX_SLOTS - 1) {
+        return 0;
+    }
+    /* The last index is reserved for PT_NO_PID. */
+    if (new_capacity > PT_MAX_SLOTS - 1) {
+        new_capacity = PT_MAX_SLOTS - 1;
+    }
+
+    if (table->grow_lock != NULL) {
+        slock_acquire(table->grow_lock);
+    }
+    resized = realloc(table->slots, sizeof(proc_slot_s) * new_capacity);
+    if (resized != NULL) {
+        table->slots = resized;
+        table->capacity = new_capacity;
+    }
+    if (table->grow_lock != NULL) {
+        slock_release(table->grow_lock);
+    }
+    return resized != NULL;
+}
+
+/*
+ * Registers a pcb, reusing the least recently freed slot first.
+ *
+ * Arguments: table: the process table.
+ *            pcb: the pcb to register.
+ * Return: the slot index, which becomes the pid, PT_NO_PID if the table is full.
+ */
+uint32_t pt_insert(/* in-out */ proc_table_p table, /* in */ PCB_p pcb) {
+    uint32_t index;
+
+    if (table->free_head != PT_NIL) {
+        index = table->free_head;
+        table->free_head = PT_SLOT(table, index).next;
+        if (table->free_head == PT_NIL) {
+            table->free_tail = PT_NIL;
+        }
+    } else {
+        if (table->used == table->capacity && !pt_grow(table)) {
+            return PT_NO_PID;
+        }
+        index = table->used++;
+        PT_SLOT(table, index).generation = 0;
+    }
+
+    PT_SLOT(table, index).pcb = pcb;
+    PT_SLOT(table, index).next = PT_NIL;
+    PT_SLOT(table, index).queued = 0;
+    table->live++;
+
+    return index;
+}
+
+/*
+ * Frees the slot of a pcb and invalidates all handles to it.
+ *
+ * Arguments: table: the process table.
+ *            pid: the slot index of the pcb.
+ */
+void pt_remove(/* in-out */ proc_table_p table, /* in */ uint32_t pid) {
+    if (pid >= table->used || PT_SLOT(table, pid).pcb == NULL) {
+        return;
+    }
+
+    PT_SLOT(table, pid).pcb = NULL;
+    PT_SLOT(table, pid).generation++;
+    PT_SLOT(table, pid).queued = 0;
+    PT_SLOT(table, pid).next = PT_NIL;
+    /* Append, so every free slot is reused before this one cycles its generation again. */
+    if (table->free_tail != PT_NIL) {
+        PT_SLOT(table, table->free_tail).next = pid;
+    } else {
+        table->free_head = pid;
+    }
+    table->free_tail = pid;
+    table->live--;
+}
+
+/*
+ * Return: the handle of a registered pcb.
+ */
+pt_handle_t pt_handle_of(/* in */ proc_table_p table, /* in */ PCB_p pcb) {
+    return ((pt_handle_t) (PT_SLOT(table, pcb->pid).generation & PT_GENERATION_MASK) << PT_INDEX_BITS) | pcb->pid;
+}
+
+/*
+ * Return: the pcb a handle refers to, NULL if the handle is stale or invalid.
+ */
+PCB_p pt_lookup(/* in */ proc_table_p table, /* in */ pt_handle_t handle) {
+    uint32_t index = PT_HANDLE_INDEX(handle);
+
+    if (index >= table->used
+        || (PT_SLOT(table, index).generation & PT_GENERATION_MASK) != (handle >> PT_INDEX_BITS)) {
+        return NULL;
+    }
+    return PT_SLOT(table, index).pcb;
+}
+
+/*
+ * Return: the live pcb with the given pid, NULL if there is none.
+ */
+PCB_p pt_lookup_pid(/* in */ proc_table_p table, /* in */ uint32_t pid) {
+    if (pid >= table->used) {
+        return NULL;
+    }
+    return PT_SLOT(table, pid).pcb;
+}
+
+/*
+ * Frees the table's storage. Any pcbs still registered are not freed.
+ *
+ * Arguments: table: the process table.
+ */
+void pt_destroy(/* in-out */ proc_table_p table) {
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->live = 0;
+    table->used = 0;
+    table->free_head = PT_NIL;
+    table->free_tail = PT_NIL;
+}
+
+/*
+ * Writes the slot array to a checkpoint: links, generations and the free list,
+ * but not the pcbs, which are saved separately.
+ *
+ * Arguments: w: the checkpoint.
+ *            table: the process table.
+ */
+void pt_save(/* in-out */ ckpt_writer_p w, /* in */ proc_table_p table) {
+    uint32_t i;
+
+    ckpt_put_u32(w, table->used);
+    ckpt_put_u32(w, table->live);
+    ckpt_put_u32(w, table->free_head);
+    ckpt_put_u32(w, table->free_tail);
+    for (i = 0; i < table->used; i++) {
+        ckpt_put_u32(w, PT_SLOT(table, i).next);
+        ckpt_put_u32(w, ((uint32_t) PT_SLOT(table, i).generation << 16) | PT_SLOT(table, i).queued);
+    }
+}
+
+/*
+ * Replaces the table's slots with ones read from a checkpoint. Every slot comes
+ * back empty until PCB_load fills it.
+ *
+ * Arguments: r: the checkpoint.
+ *            table: the process table, set up with pt_init.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int pt_load(/* in-out */ ckpt_reader_p r, /* in-out */ proc_table_p table) {
+    uint32_t used = ckpt_get_u32(r);
+    uint32_t i;
+    uint32_t packed;
+
+    if (!r->ok || used >= PT_MAX_SLOTS) {
+        r->ok = 0;
+        return 0;
+    }
+
+    pt_destroy(table);
+    table->capacity = used > PT_INITIAL_SLOTS ? used : PT_INITIAL_SLOTS;
+    table->slots = malloc(sizeof(proc_slot_s) * table->capacity);
+    if (table->slots == NULL) {
+        table->capacity = 0;
+        r->ok = 0;
+        return 0;
+    }
+    table->used = used;
+    table->live = ckpt_get_u32(r);
+    table->free_head = ckpt_get_u32(r);
+    table->free_tail = ckpt_get_u32(r);
+
+    for (i = 0; i < used; i++) {
+        PT_SLOT(table, i).pcb = NULL;
+        PT_SLOT(table, i).next = ckpt_get_u32(r);
+        packed = ckpt_get_u32(r);
+        PT_SLOT(table, i).generation = packed >> 16;
+        PT_SLOT(table, i).queued = packed & 0xFFFF;
+    }
+
+    return r->ok;
+}
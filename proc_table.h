@@ -0,0 +1,136 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef PROC_TABLE_H
+#define PROC_TABLE_H
+
+#include <stdint.h>
+
+#include "buddy.h"
+#include "checkpoint.h"
+#include "pcb.h"
+#include "sim_lock.h"
+
+/*
+ * A process handle: the low PT_INDEX_BITS are the slot index (which is also the
+ * pid), the high PT_GENERATION_BITS are the slot's generation when the handle
+ * was taken. A handle whose generation no longer matches its slot is stale.
+ * Freed slots are reused oldest first, so a stale handle is only mistaken for
+ * a live one after its slot has been reused 1 << PT_GENERATION_BITS times.
+ */
+typedef uint32_t pt_handle_t;
+
+#define PT_INDEX_BITS 20
+#define PT_INDEX_MASK ((1u << PT_INDEX_BITS) - 1)
+#define PT_MAX_SLOTS (1u << PT_INDEX_BITS) /* 1M live processes */
+#define PT_GENERATION_BITS (32 - PT_INDEX_BITS)
+#define PT_GENERATION_MASK ((1u << PT_GENERATION_BITS) - 1)
+#define PT_INITIAL_SLOTS 1024
+#define PT_NIL 0xFFFFFFFFu /* no slot / end of list */
+#define PT_NO_PID PT_INDEX_MASK /* pid of a pcb that is not in the table */
+
+#define PT_HANDLE_INDEX(handle) ((handle) & PT_INDEX_MASK)
+
+/*
+ * One process table entry, 16 bytes. While a pcb is queued, next links it to the
+ * following pcb of its queue; while the slot is free, next links the free list.
+ */
+typedef struct proc_slot {
+    PCB_p pcb;           // NULL when the slot is free
+    uint32_t next;       // index of the next slot in the same queue or free list, PT_NIL at the end
+    uint16_t generation; // bumped every time the slot is freed
+    uint16_t queued;     // 1 while the pcb is linked into a queue
+} proc_slot_s;
+
+/*
+ * A growable contiguous array of slots with a free list. Each simulation has
+ * its own table, and every queue and pcb of that simulation refers to it.
+ */
+typedef struct proc_table {
+    proc_slot_s * slots;
+    uint32_t capacity;
+    uint32_t live;      // slots in use
+    uint32_t used;      // slots ever handed out; slots past this were never used
+    uint32_t free_head; // least recently freed slot, PT_NIL if none
+    uint32_t free_tail; // most recently freed slot, PT_NIL if none
+    buddy_p images;     // memory the process images are allocated from, NULL if none
+    sim_lock_p grow_lock; // held while the slots move, NULL if only one thread follows links
+} proc_table_s;
+
+typedef proc_table_s * proc_table_p;
+
+/*
+ * Sets up an empty table, with no grow_lock. Slots are allocated on the first insert.
+ *
+ * Arguments: table: the table to set up.
+ *            images: the allocator the images of its pcbs come from, may be NULL.
+ */
+void pt_init(/* out */ proc_table_p table, /* in */ buddy_p images);
+
+/*
+ * Registers a pcb, reusing the least recently freed slot first.
+ *
+ * Arguments: table: the process table.
+ *            pcb: the pcb to register.
+ * Return: the slot index, which becomes the pid, PT_NO_PID if the table is full.
+ */
+uint32_t pt_insert(/* in-out */ proc_table_p table, /* in */ PCB_p pcb);
+
+/*
+ * Frees the slot of a pcb and invalidates all handles to it.
+ *
+ * Arguments: table: the process table.
+ *            pid: the slot index of the pcb.
+ */
+void pt_remove(/* in-out */ proc_table_p table, /* in */ uint32_t pid);
+
+/*
+ * Return: the handle of a registered pcb.
+ */
+pt_handle_t pt_handle_of(/* in */ proc_table_p table, /* in */ PCB_p pcb);
+
+/*
+ * Return: the pcb a handle refers to, NULL if the handle is stale or invalid.
+ */
+PCB_p pt_lookup(/* in */ proc_table_p table, /* in */ pt_handle_t handle);
+
+/*
+ * Return: the live pcb with the given pid, NULL if there is none.
+ */
+PCB_p pt_lookup_pid(/* in */ proc_table_p table, /* in */ uint32_t pid);
+
+/*
+ * Frees the table's storage. Any pcbs still registered are not freed.
+ *
+ * Arguments: table: the process table.
+ */
+void pt_destroy(/* in-out */ proc_table_p table);
+
+/*
+ * Writes the slot array to a checkpoint: links, generations and the free list,
+ * but not the pcbs, which are saved separately.
+ *
+ * Arguments: w: the checkpoint.
+ *            table: the process table.
+ */
+void pt_save(/* in-out */ ckpt_writer_p w, /* in */ proc_table_p table);
+
+/*
+ * Replaces the table's slots with ones read from a checkpoint. Every slot comes
+ * back empty until PCB_load fills it.
+ *
+ * Arguments: r: the checkpoint.
+ *            table: the process table, set up with pt_init.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int pt_load(/* in-out */ ckpt_reader_p r, /* in-out */ proc_table_p table);
+
+/*
+ * Direct slot access for the queue code; the index must be in the table.
+ */
+#define PT_SLOT(table, index) ((table)->slots[(index)])
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "quantum_tune.h"
+
+const char * tune_goal_names[TUNE_GOAL_COUNT] = { "off", "latency", "overhead" };
+
+/*
+ * Parses a goal.
+ *
+ * Arguments: spec: latency=<cycles> or overhead=<percent>.
+ *            goal: the goal named.
+ *            target: its target, above 0.
+ * Return: 1 on success, 0 if the spec is malformed.
+ */
+int tune_parse(/* in */ const char * spec, /* out */ enum tune_goal * goal, /* out */ double * target) {
+    const char * value = strchr(spec, '=');
+    char * end;
+    int i;
+
+    if (value == NULL)
+        return 0;
+    for (i = TUNE_LATENCY; i < TUNE_GOAL_COUNT; i++) {
+        if (strlen(tune_goal_names[i]) == (size_t) (value - spec)
+            && strncmp(spec, tune_goal_names[i], value - spec) == 0)
+            break;
+    }
+    if (i == TUNE_GOAL_COUNT)
+        return 0;
+
+    *target = strtod(value + 1, &end);
+    if (end == value + 1 || *end != '\0' || !(*target > 0.0))
+        return 0;
+    *goal = i;
+    return 1;
+}
+
+/*
+ * Starts a new interval.
+ */
+void tune_begin_interval(/* in-out */ tuner_p t, /* in */ uint32_t now,
+                         /* in */ unsigned long long busy, /* in */ unsigned long long switching) {
+    t->started = now;
+    t->bursts = 0;
+    t->expiries = 0;
+    t->ready_area = 0;
+    t->busy_mark = busy;
+    t->switch_mark = switching;
+    memset(&t->voluntary, 0, sizeof(lat_hist_s));
+}
+
+/*
+ * Starts the controller from the quanta and S in force.
+ *
+ * Arguments: t: the tuner.
+ *            quanta: the quantum of each priority.
+ *            S: the boost period.
+ *            now: the current iteration.
+ *            busy, switching: busy and switch cycles so far, over all priorities.
+ */
+void tune_init(/* out */ tuner_p t, /* in */ const unsigned int * quanta, /* in */ unsigned int S,
+               /* in */ uint32_t now, /* in */ unsigned long long busy, /* in */ unsigned long long switching) {
+    int i;
+
+    memset(t, 0, sizeof(tuner_s));
+    for (i = 0; i < NUM_PRIORITIES; i++)
+        t->shape[i] = quanta[i] > 0 ? quanta[i] : 1;
+    t->initialized = 1;
+    t->scale = 1.0;
+    t->s_multiple = (double) S / t->shape[NUM_PRIORITIES/2];
+    tune_begin_interval(t, now, busy, switching);
+}
+
+/*
+ * Notes a dispatch; the burst starts once the switch is paid for.
+ *
+ * Arguments: start: the iteration the process first runs at.
+ */
+void tune_dispatch(/* in-out */ tuner_p t, /* in */ uint32_t start) {
+    t->burst_start = start;
+    t->burst_open = 1;
+}
+
+/*
+ * Ends the open burst, if any.
+ *
+ * Arguments: now: the current iteration.
+ *            expired: 1 if it used up its quantum, 0 if the process gave up the cpu.
+ */
+void tune_release(/* in-out */ tuner_p t, /* in */ uint32_t now, /* in */ int expired) {
+    if (!t->burst_open)
+        return;
+    t->burst_open = 0;
+    t->bursts++;
+    if (expired)
+        t->expiries++;
+    else
+        lat_hist_add(&t->voluntary, now > t->burst_start ? now - t->burst_start : 0);
+}
+
+/*
+ * Return: value, clamped to low and high.
+ */
+double tune_clamp(/* in */ double value, /* in */ double low, /* in */ double high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+/*
+ * Closes an interval that has run TUNE_INTERVAL cycles and moves the quanta
+ * and S toward the goal.
+ *
+ * Arguments: t: the tuner.
+ *            goal, target: what to steer toward; an overhead target is in percent.
+ *            now: the current iteration.
+ *            busy, switching: busy and switch cycles so far, over all priorities.
+ *            quanta, S: the table to adjust.
+ * Return: 1 if an interval was closed and the table rebuilt, 0 otherwise.
+ */
+int tune_adjust(/* in-out */ tuner_p t, /* in */ enum tune_goal goal, /* in */ double target, /* in */ uint32_t now,
+                /* in */ unsigned long long busy, /* in */ unsigned long long switching,
+                /* in-out */ unsigned int * quanta, /* in-out */ unsigned int * S) {
+    tune_sample_s sample;
+    double quantum_0, quantum;
+    uint32_t point;
+    int i;
+
+    if (now - t->started < TUNE_INTERVAL)
+        return 0;
+
+    /* Little's law: the mean ready count over the mean dispatch rate. */
+    sample.ready_wait = t->bursts > 0 ? (double) t->ready_area / t->bursts : 0.0;
+    sample.switch_loss = busy > t->busy_mark ? (double) (switching - t->switch_mark) / (busy - t->busy_mark) : 0.0;
+    sample.demotion_rate = t->bursts > 0 ? (double) t->expiries / t->bursts : 0.0;
+    sample.quantum_0 = quanta[0];
+    sample.quantum_top = quanta[NUM_PRIORITIES - 1];
+    sample.S = *S;
+    t->latest = sample;
+    if (t->bursts > 0) {
+        if (t->first.quantum_0 == 0)
+            t->first = sample;
+        t->last = sample;
+    }
+
+    if (t->voluntary.total > 0) {
+        point = lat_hist_percentile(&t->voluntary, TUNE_BURST_SHARE);
+        t->burst = t->burst > 0.0 ? t->burst + TUNE_BURST_SMOOTHING * (point - t->burst) : point;
+    }
+
+    /* An idle interval says nothing about the goal. */
+    if (t->bursts > 0) {
+        if (goal == TUNE_LATENCY) {
+            if (sample.ready_wait > target && sample.switch_loss > TUNE_SWITCH_CROWDING)
+                t->scale *= 1.0 + TUNE_GAIN;
+            else if (sample.ready_wait > target)
+                t->scale *= 1.0 - TUNE_GAIN;
+            else if (sample.ready_wait < target / 2)
+                t->scale *= 1.0 + TUNE_GAIN;
+        } else if (goal == TUNE_OVERHEAD) {
+            if (sample.switch_loss > target / 100.0)
+                t->scale *= 1.0 + TUNE_GAIN;
+            else if (sample.switch_loss < target / 200.0)
+                t->scale *= 1.0 - TUNE_GAIN;
+        }
+
+        if (sample.demotion_rate > TUNE_DEMOTION_HIGH)
+            t->s_multiple *= 1.0 - TUNE_GAIN;
+        else if (sample.demotion_rate < TUNE_DEMOTION_LOW)
+            t->s_multiple *= 1.0 + TUNE_GAIN;
+    }
+    t->scale = tune_clamp(t->scale, TUNE_SCALE_MIN, TUNE_SCALE_MAX);
+    t->s_multiple = tune_clamp(t->s_multiple, TUNE_S_MULTIPLE_MIN, TUNE_S_MULTIPLE_MAX);
+
+    /* A process that blocked after more than quantum 0 did so at a lower priority; lift it to the top. */
+    quantum_0 = t->scale * t->shape[0];
+    if (quantum_0 < t->burst) {
+        quantum_0 = t->burst;
+        t->scale = quantum_0 / t->shape[0];
+    }
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        quantum = quantum_0 * t->shape[i] / t->shape[0] + 0.5;
+        quanta[i] = (unsigned int) tune_clamp(quantum, 1.0, TUNE_QUANTUM_MAX);
+    }
+    *S = (unsigned int) (t->s_multiple * quanta[NUM_PRIORITIES/2] + 0.5);
+
+    t->adjustments++;
+    tune_begin_interval(t, now, busy, switching);
+    return 1;
+}
@@ -0,0 +1,149 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef QUANTUM_TUNE_H
+#define QUANTUM_TUNE_H
+
+#include <stdint.h>
+
+#include "pcb.h"
+#include "io_sched.h"
+
+/* Controller timing and step size. */
+#define TUNE_INTERVAL 20000        // cycles between adjustments
+#define TUNE_GAIN 0.1              // share the quanta or S move by in one adjustment
+#define TUNE_BURST_SHARE 0.8       // of the bursts that end by blocking, the share quantum 0 keeps fitting
+#define TUNE_BURST_SMOOTHING 0.25  // weight of the newest interval in the burst estimate
+
+/* Latency goal: share of busy cycles lost to switching past which shorter quanta only add waiting. */
+#define TUNE_SWITCH_CROWDING 0.5
+
+/* Demotions per burst above which S is shortened, and below which it is lengthened. */
+#define TUNE_DEMOTION_HIGH 0.5
+#define TUNE_DEMOTION_LOW 0.1
+
+/* Bounds of the controller. */
+#define TUNE_SCALE_MIN 0.125
+#define TUNE_SCALE_MAX 8.0
+#define TUNE_S_MULTIPLE_MIN 2.0
+#define TUNE_S_MULTIPLE_MAX 64.0
+#define TUNE_QUANTUM_MAX 100000
+
+/* What the controller steers toward. */
+enum tune_goal {
+    TUNE_OFF,       // the quanta and S stay as built
+    TUNE_LATENCY,   // mean cycles a dispatched process waited ready, at most the target
+    TUNE_OVERHEAD,  // percent of busy cycles lost to context switches, at most the target
+    TUNE_GOAL_COUNT,
+};
+
+extern const char * tune_goal_names[TUNE_GOAL_COUNT];
+
+/* What one interval looked like. */
+typedef struct tune_sample {
+    double ready_wait;       // mean cycles waited in the ready queue per dispatch
+    double switch_loss;      // share of busy cycles spent switching
+    double demotion_rate;    // bursts that used up their quantum, per burst
+    uint32_t quantum_0;      // quanta and S in force during it
+    uint32_t quantum_top;
+    uint32_t S;
+} tune_sample_s;
+
+/*
+ * Feedback controller for the MLFQ quanta and the boost period S. The quanta
+ * are the ones it started from times a scale the goal moves, but quantum 0
+ * is never cut below most of the bursts that end by blocking, so the goal
+ * cannot turn interactive processes into demoted ones. Longer quanta always
+ * cut switching, so the overhead goal moves the
+ * scale up when too many cycles go to switching and down when there is room.
+ * Waiting can go either way: shorter quanta let waiting processes in sooner
+ * until the switches they add crowd out the work. So while processes wait
+ * too long the latency goal shortens the quanta, unless switching already
+ * takes TUNE_SWITCH_CROWDING of the cpu, when it lengthens them; with room
+ * to spare it lengthens them to save switches. The lower quanta keep the ratios of the
+ * quanta it started from. S follows the demotion rate, so processes that
+ * sink fast are boosted sooner. Plain data, so it is checkpointed as it is.
+ */
+typedef struct tuner {
+    /* The current interval. */
+    uint32_t started;                 // iteration it began at
+    unsigned long long bursts;        // dispatches that ended
+    unsigned long long expiries;      // ... by using up their quantum
+    unsigned long long ready_area;    // ready processes, summed over cycles
+    unsigned long long busy_mark;     // busy and switch cycles when it began
+    unsigned long long switch_mark;
+    lat_hist_s voluntary;             // lengths of the bursts that ended by blocking
+    /* The burst the running process is on. */
+    uint32_t burst_start;             // iteration its first instruction ran, or will
+    uint32_t burst_open;
+
+    /* The controller. */
+    uint32_t shape[NUM_PRIORITIES];   // the quanta it started from
+    uint32_t initialized;
+    double burst;                     // smoothed TUNE_BURST_SHARE point of voluntary bursts
+    double scale;                     // the quanta against shape
+    double s_multiple;                // S against the middle quantum
+    uint32_t adjustments;
+    tune_sample_s latest;             // of the interval closed last
+    tune_sample_s first;              // of the first and last intervals that were not idle
+    tune_sample_s last;
+} tuner_s;
+
+typedef tuner_s * tuner_p;
+
+/*
+ * Parses a goal.
+ *
+ * Arguments: spec: latency=<cycles> or overhead=<percent>.
+ *            goal: the goal named.
+ *            target: its target, above 0.
+ * Return: 1 on success, 0 if the spec is malformed.
+ */
+int tune_parse(/* in */ const char * spec, /* out */ enum tune_goal * goal, /* out */ double * target);
+
+/*
+ * Starts the controller from the quanta and S in force.
+ *
+ * Arguments: t: the tuner.
+ *            quanta: the quantum of each priority.
+ *            S: the boost period.
+ *            now: the current iteration.
+ *            busy, switching: busy and switch cycles so far, over all priorities.
+ */
+void tune_init(/* out */ tuner_p t, /* in */ const unsigned int * quanta, /* in */ unsigned int S,
+               /* in */ uint32_t now, /* in */ unsigned long long busy, /* in */ unsigned long long switching);
+
+/*
+ * Notes a dispatch; the burst starts once the switch is paid for.
+ *
+ * Arguments: start: the iteration the process first runs at.
+ */
+void tune_dispatch(/* in-out */ tuner_p t, /* in */ uint32_t start);
+
+/*
+ * Ends the open burst, if any.
+ *
+ * Arguments: now: the current iteration.
+ *            expired: 1 if it used up its quantum, 0 if the process gave up the cpu.
+ */
+void tune_release(/* in-out */ tuner_p t, /* in */ uint32_t now, /* in */ int expired);
+
+/*
+ * Closes an interval that has run TUNE_INTERVAL cycles and moves the quanta
+ * and S toward the goal.
+ *
+ * Arguments: t: the tuner.
+ *            goal, target: what to steer toward; an overhead target is in percent.
+ *            now: the current iteration.
+ *            busy, switching: busy and switch cycles so far, over all priorities.
+ *            quanta, S: the table to adjust.
+ * Return: 1 if an interval was closed and the table rebuilt, 0 otherwise.
+ */
+int tune_adjust(/* in-out */ tuner_p t, /* in */ enum tune_goal goal, /* in */ double target, /* in */ uint32_t now,
+                /* in */ unsigned long long busy, /* in */ unsigned long long switching,
+                /* in-out */ unsigned int * quanta, /* in-out */ unsigned int * S);
+
+#endif
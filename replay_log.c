@@ -0,0 +1,191 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "replay_log.h"
+
+/*
+ * Appends an unsigned varint: seven bits a byte, low bits first, the top bit
+ * set on every byte but the last.
+ */
+void replay_put_varint(/* in-out */ replay_writer_p w, /* in */ uint64_t value) {
+    unsigned char bytes[10];
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        bytes[len++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (unsigned char) value;
+    if (w->ok && fwrite(bytes, 1, len, w->file) != len)
+        w->ok = 0;
+}
+
+/*
+ * Reads an unsigned varint.
+ * Return: the value, 0 with ok cleared if the log ends inside it or it is too long.
+ */
+uint64_t replay_get_varint(/* in-out */ replay_reader_p r) {
+    uint64_t value = 0;
+    unsigned int shift;
+    unsigned char byte;
+
+    for (shift = 0; shift < 64 && r->pos < r->len; shift += 7) {
+        byte = r->map[r->pos++];
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    r->ok = 0;
+    return 0;
+}
+
+/*
+ * Creates a log, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ *            seed: the seed of the run being recorded.
+ * Return: a new writer, NULL on failure.
+ */
+replay_writer_p replay_writer_open(/* in */ const char * path, /* in */ uint64_t seed) {
+    replay_header_s header;
+    replay_writer_p w = malloc(sizeof(replay_writer_s));
+
+    if (w == NULL)
+        return NULL;
+    w->file = fopen(path, "wb");
+    w->last = 0;
+    w->events = 0;
+    w->ok = 1;
+
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.seed = seed;
+    if (w->file == NULL || fwrite(&header, sizeof(header), 1, w->file) != 1) {
+        if (w->file != NULL)
+            fclose(w->file);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+/*
+ * Appends an event. Events must be appended in the order they happen.
+ *
+ * Arguments: kind: what happened, not REPLAY_END.
+ *            iteration: the cpu iteration it happened at.
+ *            pid: the process whose IO completed, ignored for a timer.
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int replay_write(/* in-out */ replay_writer_p w, /* in */ enum replay_event kind,
+                 /* in */ uint64_t iteration, /* in */ uint32_t pid) {
+    replay_put_varint(w, (iteration - w->last) << 2 | kind);
+    if (kind != REPLAY_TIMER)
+        replay_put_varint(w, pid);
+    w->last = iteration;
+    w->events++;
+    return w->ok;
+}
+
+/*
+ * Ends the log and closes the file.
+ *
+ * Return: 1 if the whole log was written, 0 otherwise.
+ */
+int replay_writer_close(/* in-out */ replay_writer_p w) {
+    int ok;
+
+    replay_put_varint(w, REPLAY_END);
+    ok = fclose(w->file) == 0 && w->ok;
+    free(w);
+    return ok;
+}
+
+/*
+ * Decodes the event at the read position; REPLAY_END if the log is damaged.
+ */
+void replay_read_event(/* in-out */ replay_reader_p r) {
+    uint64_t word = replay_get_varint(r);
+
+    r->kind = word & 3;
+    r->iteration += word >> 2;
+    if (r->ok && r->kind != REPLAY_TIMER && r->kind != REPLAY_END)
+        r->pid = replay_get_varint(r);
+    if (!r->ok)
+        r->kind = REPLAY_END;
+}
+
+/*
+ * Maps a log and reads its first event.
+ *
+ * Arguments: path: the log to open.
+ * Return: a new reader, NULL if the file cannot be read or is not a log.
+ */
+replay_reader_p replay_reader_open(/* in */ const char * path) {
+    struct stat st;
+    const replay_header_s * header;
+    replay_reader_p r = malloc(sizeof(replay_reader_s));
+
+    if (r == NULL)
+        return NULL;
+
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0 || fstat(r->fd, &st) != 0 || st.st_size < (off_t) sizeof(replay_header_s)) {
+        if (r->fd >= 0)
+            close(r->fd);
+        free(r);
+        return NULL;
+    }
+
+    r->len = st.st_size;
+    r->map = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, r->fd, 0);
+    if (r->map == MAP_FAILED) {
+        close(r->fd);
+        free(r);
+        return NULL;
+    }
+    madvise((void *) r->map, r->len, MADV_SEQUENTIAL);
+
+    header = (const replay_header_s *) r->map;
+    if (header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION) {
+        replay_reader_close(r);
+        return NULL;
+    }
+    r->seed = header->seed;
+    r->pos = sizeof(replay_header_s);
+    r->events = 0;
+    r->iteration = 0;
+    r->pid = 0;
+    r->ok = 1;
+    replay_read_event(r);
+    return r;
+}
+
+/*
+ * Moves on to the next event. Past the last one, or on a damaged log, the
+ * next event is REPLAY_END.
+ */
+void replay_reader_next(/* in-out */ replay_reader_p r) {
+    if (r->kind == REPLAY_END)
+        return;
+    r->events++;
+    replay_read_event(r);
+}
+
+/*
+ * Unmaps the log and frees the reader.
+ */
+void replay_reader_close(/* in-out */ replay_reader_p r) {
+    munmap((void *) r->map, r->len);
+    close(r->fd);
+    free(r);
+}
@@ -0,0 +1,114 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define REPLAY_MAGIC 0x4C505253 /* "SRPL" */
+#define REPLAY_VERSION 1
+
+/*
+ * What the device threads of a threaded run decide for the cpu: the cycles
+ * a timer interrupt was taken at, and which processes' IO completions the
+ * cpu found in its inbox, in order. Everything else the cpu does follows
+ * from these and the seed.
+ */
+enum replay_event {
+    REPLAY_TIMER,
+    REPLAY_IO,            // taken at the start of a cycle
+    REPLAY_IO_CHECKPOINT, // taken before writing a checkpoint
+    REPLAY_END,
+};
+
+/*
+ * On-disk layout: replay_header_s, then the events in the order the cpu
+ * took them, each a varint of its iteration, as a delta from the event
+ * before, shifted left by two and or'ed with its kind, and for the IO
+ * kinds a varint pid. A lone REPLAY_END closes the log.
+ */
+typedef struct replay_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;        // of the recorded run
+} replay_header_s;
+
+/* An appending writer. Errors are sticky. */
+typedef struct replay_writer {
+    FILE * file;
+    uint64_t last;        // iteration of the last event
+    uint64_t events;
+    int ok;
+} replay_writer_s;
+
+typedef replay_writer_s * replay_writer_p;
+
+/* A reader over a mapped log, holding the next event. */
+typedef struct replay_reader {
+    int fd;
+    const unsigned char * map;
+    size_t len;
+    size_t pos;
+    uint64_t seed;
+    uint64_t events;      // handed out so far
+    enum replay_event kind; // of the next event, REPLAY_END once exhausted
+    uint64_t iteration;
+    uint32_t pid;
+    int ok;               // 0 if the log turned out to be damaged
+} replay_reader_s;
+
+typedef replay_reader_s * replay_reader_p;
+
+/*
+ * Creates a log, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ *            seed: the seed of the run being recorded.
+ * Return: a new writer, NULL on failure.
+ */
+replay_writer_p replay_writer_open(/* in */ const char * path, /* in */ uint64_t seed);
+
+/*
+ * Appends an event. Events must be appended in the order they happen.
+ *
+ * Arguments: kind: what happened, not REPLAY_END.
+ *            iteration: the cpu iteration it happened at.
+ *            pid: the process whose IO completed, ignored for a timer.
+ * Return: 1 if every write so far succeeded, 0 otherwise.
+ */
+int replay_write(/* in-out */ replay_writer_p w, /* in */ enum replay_event kind,
+                 /* in */ uint64_t iteration, /* in */ uint32_t pid);
+
+/*
+ * Ends the log and closes the file.
+ *
+ * Return: 1 if the whole log was written, 0 otherwise.
+ */
+int replay_writer_close(/* in-out */ replay_writer_p w);
+
+/*
+ * Maps a log and reads its first event.
+ *
+ * Arguments: path: the log to open.
+ * Return: a new reader, NULL if the file cannot be read or is not a log.
+ */
+replay_reader_p replay_reader_open(/* in */ const char * path);
+
+/*
+ * Moves on to the next event. Past the last one, or on a damaged log, the
+ * next event is REPLAY_END.
+ */
+void replay_reader_next(/* in-out */ replay_reader_p r);
+
+/*
+ * Unmaps the log and frees the reader.
+ */
+void replay_reader_close(/* in-out */ replay_reader_p r);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "sim_lock.h"
+
+#ifdef SIM_LOCK_CHECK
+/* Ranks of the locks the calling thread holds, one bit each. */
+__thread unsigned int slock_held;
+#endif
+
+/*
+ * Sets up an unlocked lock.
+ *
+ * Arguments: lock: the lock.
+ *            name: what the report calls it.
+ *            rank: its place in the lock order, below SLOCK_MAX_RANKS.
+ */
+void slock_init(/* out */ sim_lock_p lock, /* in */ const char * name, /* in */ unsigned int rank) {
+    pthread_mutex_init(&lock->mutex, NULL);
+    lock->name = name;
+    lock->rank = rank;
+    lock->acquisitions = 0;
+    lock->contended = 0;
+    lock->wait_ns = 0;
+    lock->max_wait_ns = 0;
+}
+
+/*
+ * Frees a lock, which must be unlocked.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_destroy(/* in-out */ sim_lock_p lock) {
+    pthread_mutex_destroy(&lock->mutex);
+}
+
+/*
+ * Takes a lock, waiting if another thread has it. Only a lock that is taken
+ * reads the clock, so the common uncontended case costs one trylock.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_acquire(/* in-out */ sim_lock_p lock) {
+    struct timespec start, end;
+    unsigned long long waited;
+
+#ifdef SIM_LOCK_CHECK
+    if (slock_held >> lock->rank != 0) {
+        fprintf(stderr, "lock order violation: %s (rank %u) taken while holding rank %u\n",
+                lock->name, lock->rank, 31 - __builtin_clz(slock_held));
+        abort();
+    }
+    slock_held |= 1u << lock->rank;
+#endif
+
+    if (pthread_mutex_trylock(&lock->mutex) == 0) {
+        lock->acquisitions++;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&lock->mutex);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    waited = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+
+    lock->acquisitions++;
+    lock->contended++;
+    lock->wait_ns += waited;
+    if (waited > lock->max_wait_ns) {
+        lock->max_wait_ns = waited;
+    }
+}
+
+/*
+ * Releases a lock the calling thread holds.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_release(/* in-out */ sim_lock_p lock) {
+#ifdef SIM_LOCK_CHECK
+    slock_held &= ~(1u << lock->rank);
+#endif
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+/*
+ * Prints one line of contention statistics per lock.
+ *
+ * Arguments: out: where to print.
+ *            locks: the locks, in lock order.
+ *            count: how many.
+ */
+void slock_report(/* in */ FILE * out, /* in */ sim_lock_p * locks, /* in */ unsigned int count) {
+    unsigned int i;
+
+    fprintf(out, "%-12s %12s %12s %9s %14s %14s\n", "lock", "acquired", "contended", "contended", "mean wait ns", "max wait ns");
+    for (i = 0; i < count; i++) {
+        fprintf(out, "%-12s %12llu %12llu %8.3f%% %14.0f %14llu\n", locks[i]->name,
+                locks[i]->acquisitions, locks[i]->contended,
+                locks[i]->acquisitions > 0 ? 100.0 * locks[i]->contended / locks[i]->acquisitions : 0.0,
+                locks[i]->contended > 0 ? (double) locks[i]->wait_ns / locks[i]->contended : 0.0,
+                locks[i]->max_wait_ns);
+    }
+}
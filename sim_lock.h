@@ -0,0 +1,76 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef SIM_LOCK_H
+#define SIM_LOCK_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+/* Ranks a lock can have; a lock's rank is its place in the lock order. */
+#define SLOCK_MAX_RANKS 32
+
+/*
+ * A mutex that counts how often it was taken, how often a thread had to wait
+ * for it and for how long. The counters are only changed while the lock is
+ * held, so they need no atomics.
+ *
+ * Each lock has a rank. A thread holding a lock may only take locks of a
+ * higher rank. Built with -DSIM_LOCK_CHECK (make debug), taking a lock out of
+ * order prints both locks and aborts.
+ */
+typedef struct sim_lock {
+    pthread_mutex_t mutex;
+    const char * name;
+    unsigned int rank;
+    unsigned long long acquisitions;
+    unsigned long long contended;    // acquisitions that found the lock taken
+    unsigned long long wait_ns;      // time spent waiting for it
+    unsigned long long max_wait_ns;
+} sim_lock_s;
+
+typedef sim_lock_s * sim_lock_p;
+
+/*
+ * Sets up an unlocked lock.
+ *
+ * Arguments: lock: the lock.
+ *            name: what the report calls it.
+ *            rank: its place in the lock order, below SLOCK_MAX_RANKS.
+ */
+void slock_init(/* out */ sim_lock_p lock, /* in */ const char * name, /* in */ unsigned int rank);
+
+/*
+ * Frees a lock, which must be unlocked.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_destroy(/* in-out */ sim_lock_p lock);
+
+/*
+ * Takes a lock, waiting if another thread has it.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_acquire(/* in-out */ sim_lock_p lock);
+
+/*
+ * Releases a lock the calling thread holds.
+ *
+ * Arguments: lock: the lock.
+ */
+void slock_release(/* in-out */ sim_lock_p lock);
+
+/*
+ * Prints one line of contention statistics per lock.
+ *
+ * Arguments: out: where to print.
+ *            locks: the locks, in lock order.
+ *            count: how many.
+ */
+void slock_report(/* in */ FILE * out, /* in */ sim_lock_p * locks, /* in */ unsigned int count);
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include "sim_profile.h"
+
+#ifdef SIM_PROFILE
+
+#include <stdio.h>
+#include <time.h>
+
+/* Threads that get counters of their own; any beyond share the last ones. */
+#define PROF_MAX_THREADS 64
+
+const char * prof_scope_names[PROF_SCOPE_COUNT] = {
+    "cpu",
+    "scheduler",
+    "dispatcher",
+    "handle_priority_reset",
+    "generate_pcbs",
+    "deadlock_monitor",
+    "printing",
+};
+
+/*
+ * Counters live here rather than in thread local storage, so they outlast
+ * their thread and the report can still read them. Slots are handed out once
+ * and never reused.
+ */
+prof_thread_s prof_threads[PROF_MAX_THREADS];
+unsigned int prof_thread_count;
+
+__thread prof_thread_p prof_current;
+
+#if !defined(__x86_64__) && !defined(__i386__)
+uint64_t prof_clock_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+/*
+ * Return: the calling thread's counters, registered on first use.
+ */
+prof_thread_p prof_thread_counters() {
+    unsigned int slot = __atomic_fetch_add(&prof_thread_count, 1, __ATOMIC_RELAXED);
+
+    /* Sharing the last slot may lose counts to races, but never crashes. */
+    if (slot >= PROF_MAX_THREADS) {
+        slot = PROF_MAX_THREADS - 1;
+    }
+    prof_current = &prof_threads[slot];
+    prof_current->countdown = 1;
+    return prof_current;
+}
+
+/*
+ * Ticks per second of PROF_NOW, measured against the monotonic clock.
+ */
+double prof_tick_rate() {
+    struct timespec start, end, pause = { 0, 20000000 };
+    uint64_t ticks;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ticks = PROF_NOW();
+    nanosleep(&pause, NULL);
+    ticks = PROF_NOW() - ticks;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ticks / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/*
+ * Prints, to stderr, estimated ticks and calls per scope summed over every thread.
+ */
+void prof_report() {
+    uint64_t calls[PROF_SCOPE_COUNT] = { 0 }, timed[PROF_SCOPE_COUNT] = { 0 };
+    double self[PROF_SCOPE_COUNT] = { 0 }, total[PROF_SCOPE_COUNT] = { 0 };
+    double all_self = 0, scale;
+    unsigned int threads = __atomic_load_n(&prof_thread_count, __ATOMIC_RELAXED);
+    unsigned int i;
+    double rate = prof_tick_rate();
+    int id;
+
+    if (threads > PROF_MAX_THREADS) {
+        threads = PROF_MAX_THREADS;
+    }
+    for (id = 0; id < PROF_SCOPE_COUNT; id++) {
+        for (i = 0; i < threads; i++) {
+            self[id] += prof_threads[i].self[id];
+            total[id] += prof_threads[i].total[id];
+            calls[id] += prof_threads[i].calls[id];
+            timed[id] += prof_threads[i].timed[id];
+        }
+        /* Scale the timed calls up to all of them. */
+        scale = timed[id] > 0 ? (double) calls[id] / timed[id] : 0.0;
+        self[id] *= scale;
+        total[id] *= scale;
+        all_self += self[id];
+    }
+
+    fprintf(stderr, "Profile over %u threads, %.2f GHz tick rate, 1 in %u outermost scopes timed; "
+            "self excludes nested scopes\n", threads, rate / 1e9, PROF_SAMPLE_PERIOD);
+    fprintf(stderr, "%-24s %12s %12s %14s %7s %14s %10s\n",
+            "scope", "calls", "timed", "self ticks", "self%", "total ticks", "ticks/call");
+    for (id = 0; id < PROF_SCOPE_COUNT; id++) {
+        fprintf(stderr, "%-24s %12llu %12llu %14.0f %6.1f%% %14.0f %10.1f\n", prof_scope_names[id],
+                (unsigned long long) calls[id], (unsigned long long) timed[id], self[id],
+                all_self > 0 ? 100.0 * self[id] / all_self : 0.0, total[id],
+                calls[id] > 0 ? total[id] / calls[id] : 0.0);
+    }
+    fprintf(stderr, "%-24s %12s %12s %14.0f %7s (%.3f s)\n", "all scopes", "", "", all_self, "", all_self / rate);
+}
+
+#endif
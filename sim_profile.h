@@ -0,0 +1,144 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef SIM_PROFILE_H
+#define SIM_PROFILE_H
+
+/*
+ * Hot path profiling. Built with -DSIM_PROFILE (make profile), PROF_SCOPE(id)
+ * times the rest of the enclosing block with the time stamp counter and
+ * charges it to id, early returns included. Each thread accumulates into its
+ * own counters, so timing takes no locks; PROF_REPORT() sums them and prints
+ * a breakdown. Without SIM_PROFILE both macros compile to nothing.
+ *
+ * Reading the counter costs about as much as a simulated cycle, so only one
+ * in PROF_SAMPLE_PERIOD outermost scopes is timed, together with everything
+ * nested in it; the others only count their calls. The report scales timed
+ * ticks up by calls over timed calls. Build with -DPROF_SAMPLE_PERIOD=1 to
+ * time every call.
+ */
+
+#ifndef PROF_SAMPLE_PERIOD
+#define PROF_SAMPLE_PERIOD 16
+#endif
+
+/* What is timed. Keep prof_scope_names in sim_profile.c in the same order. */
+enum prof_scope {
+    PROF_CPU,
+    PROF_SCHEDULER,
+    PROF_DISPATCHER,
+    PROF_PRIORITY_RESET,
+    PROF_GENERATE_PCBS,
+    PROF_DEADLOCK_MONITOR,
+    PROF_PRINT,
+    PROF_SCOPE_COUNT,
+};
+
+#ifdef SIM_PROFILE
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_NOW() __rdtsc()
+#else
+/* No time stamp counter: count nanoseconds instead. */
+uint64_t prof_clock_ns();
+#define PROF_NOW() prof_clock_ns()
+#endif
+
+/* Counters of one thread. Self time excludes nested scopes, total includes them. */
+typedef struct prof_thread {
+    uint64_t self[PROF_SCOPE_COUNT];
+    uint64_t total[PROF_SCOPE_COUNT];
+    uint64_t calls[PROF_SCOPE_COUNT];
+    uint64_t timed[PROF_SCOPE_COUNT];  // calls that were timed
+    uint64_t nested;       // ticks spent in scopes nested in the innermost open one
+    unsigned int depth;    // open scopes
+    unsigned int countdown; // outermost scopes until the next timed one
+    int sampling;          // the open outermost scope is timed
+} prof_thread_s;
+
+typedef prof_thread_s * prof_thread_p;
+
+/* An open scope, closed when it goes out of scope. */
+typedef struct prof_timer {
+    prof_thread_p thread;
+    enum prof_scope id;
+    int timed;
+    uint64_t start;
+    uint64_t outer_nested;  // the enclosing scope's nested ticks so far
+} prof_timer_s;
+
+extern __thread prof_thread_p prof_current;
+
+/*
+ * Return: the calling thread's counters, registered on first use.
+ */
+prof_thread_p prof_thread_counters();
+
+/*
+ * Opens a scope.
+ *
+ * Arguments: id: what it is charged to.
+ * Return: the open scope.
+ */
+static inline prof_timer_s prof_begin(/* in */ enum prof_scope id) {
+    prof_timer_s timer;
+
+    timer.thread = prof_current != NULL ? prof_current : prof_thread_counters();
+    timer.id = id;
+    timer.thread->calls[id]++;
+    if (timer.thread->depth++ == 0) {
+        timer.thread->sampling = --timer.thread->countdown == 0;
+        if (timer.thread->sampling) {
+            timer.thread->countdown = PROF_SAMPLE_PERIOD;
+        }
+    }
+    timer.timed = timer.thread->sampling;
+    if (timer.timed) {
+        timer.outer_nested = timer.thread->nested;
+        timer.thread->nested = 0;
+        timer.start = PROF_NOW();
+    }
+    return timer;
+}
+
+/*
+ * Closes a scope, called by the compiler when the timer leaves scope.
+ *
+ * Arguments: timer: the open scope.
+ */
+static inline void prof_end(/* in */ prof_timer_s * timer) {
+    prof_thread_p thread = timer->thread;
+    uint64_t elapsed;
+
+    thread->depth--;
+    if (timer->timed) {
+        elapsed = PROF_NOW() - timer->start;
+        thread->self[timer->id] += elapsed - thread->nested;
+        thread->total[timer->id] += elapsed;
+        thread->timed[timer->id]++;
+        thread->nested = timer->outer_nested + elapsed;
+    }
+}
+
+/*
+ * Prints, to stderr, estimated ticks and calls per scope summed over every thread.
+ */
+void prof_report();
+
+#define PROF_SCOPE(id) prof_timer_s prof_timer_ __attribute__((cleanup(prof_end))) = prof_begin(id)
+#define PROF_REPORT() prof_report()
+
+#else
+
+#define PROF_SCOPE(id) do { } while (0)
+#define PROF_REPORT() do { } while (0)
+
+#endif
+
+#endif
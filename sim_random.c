@@ -0,0 +1,74 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <math.h>
+
+#include "sim_random.h"
+
+/*
+ * Seeds a generator. Any seed, including 0, is valid.
+ *
+ * Arguments: rng: the generator to seed.
+ *            seed: the seed.
+ */
+void rng_seed(/* out */ sim_rng_p rng, /* in */ uint64_t seed) {
+    /* One splitmix64 step spreads similar seeds apart and never yields 0 for xorshift. */
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    rng->state = z != 0 ? z : 0x9E3779B97F4A7C15ULL;
+}
+
+/*
+ * Return: the next 32 random bits.
+ */
+uint32_t rng_next(/* in-out */ sim_rng_p rng) {
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/*
+ * Return: a uniform double in the open interval (0, 1).
+ */
+double rng_uniform(/* in-out */ sim_rng_p rng) {
+    return ((double) rng_next(rng) + 0.5) / 4294967296.0;
+}
+
+/*
+ * Return: a uniform integer in [0, bound), 0 if bound is 0.
+ */
+unsigned int rng_below(/* in-out */ sim_rng_p rng, /* in */ unsigned int bound) {
+    /* Multiply-shift instead of modulo; the bias is below 2^-32 * bound. */
+    return (unsigned int) (((uint64_t) rng_next(rng) * bound) >> 32);
+}
+
+/*
+ * Return: an exponentially distributed value with the given rate (mean 1/rate).
+ */
+double rng_exponential(/* in-out */ sim_rng_p rng, /* in */ double rate) {
+    return -log(rng_uniform(rng)) / rate;
+}
+
+/*
+ * Return: a Pareto distributed value with shape alpha and minimum xm.
+ */
+double rng_pareto(/* in-out */ sim_rng_p rng, /* in */ double alpha, /* in */ double xm) {
+    return xm / pow(rng_uniform(rng), 1.0 / alpha);
+}
+
+/*
+ * Return: a lognormally distributed value whose log has mean mu and deviation sigma.
+ */
+double rng_lognormal(/* in-out */ sim_rng_p rng, /* in */ double mu, /* in */ double sigma) {
+    /* Box-Muller; the second normal is discarded to keep the state a single word. */
+    double normal = sqrt(-2.0 * log(rng_uniform(rng))) * cos(2.0 * M_PI * rng_uniform(rng));
+    return exp(mu + sigma * normal);
+}
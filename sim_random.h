@@ -0,0 +1,60 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef SIM_RANDOM_H
+#define SIM_RANDOM_H
+
+#include <stdint.h>
+
+/*
+ * A small seedable random number generator (xorshift64*).
+ * Unlike rand(), its whole state is one word, so it can be saved and restored.
+ */
+typedef struct sim_rng {
+    uint64_t state;
+} sim_rng_s;
+
+typedef sim_rng_s * sim_rng_p;
+
+/*
+ * Seeds a generator. Any seed, including 0, is valid.
+ *
+ * Arguments: rng: the generator to seed.
+ *            seed: the seed.
+ */
+void rng_seed(/* out */ sim_rng_p rng, /* in */ uint64_t seed);
+
+/*
+ * Return: the next 32 random bits.
+ */
+uint32_t rng_next(/* in-out */ sim_rng_p rng);
+
+/*
+ * Return: a uniform double in the open interval (0, 1).
+ */
+double rng_uniform(/* in-out */ sim_rng_p rng);
+
+/*
+ * Return: a uniform integer in [0, bound), 0 if bound is 0.
+ */
+unsigned int rng_below(/* in-out */ sim_rng_p rng, /* in */ unsigned int bound);
+
+/*
+ * Return: an exponentially distributed value with the given rate (mean 1/rate).
+ */
+double rng_exponential(/* in-out */ sim_rng_p rng, /* in */ double rate);
+
+/*
+ * Return: a Pareto distributed value with shape alpha and minimum xm.
+ */
+double rng_pareto(/* in-out */ sim_rng_p rng, /* in */ double alpha, /* in */ double xm);
+
+/*
+ * Return: a lognormally distributed value whose log has mean mu and deviation sigma.
+ */
+double rng_lognormal(/* in-out */ sim_rng_p rng, /* in */ double mu, /* in */ double sigma);
+
+#endif
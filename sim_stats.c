@@ -0,0 +1,163 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sim_stats.h"
+
+/* Attempts before a reader gives up on a page that keeps changing. */
+#define STATS_READ_RETRIES 1000
+
+/*
+ * Writes the shared memory object name for a user given name, which
+ * shm_open wants with exactly one leading slash.
+ */
+void stats_object_name(/* in */ const char * name, /* out */ char * object, /* in */ size_t len) {
+    snprintf(object, len, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+/*
+ * Creates, or takes over, a shared memory object and maps a zeroed page in it.
+ *
+ * Arguments: name: the object name, with or without the leading slash.
+ * Return: the mapped page, NULL on failure.
+ */
+stats_page_p stats_create(/* in */ const char * name) {
+    char object[NAME_MAX];
+    stats_page_p page;
+    int fd;
+
+    stats_object_name(name, object, sizeof(object));
+    fd = shm_open(object, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(stats_page_s)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(stats_page_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        return NULL;
+    }
+
+    /* Odd while the header is written, so a reader of a reused object waits. */
+    __atomic_store_n(&page->seq, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset((char *) page + offsetof(stats_page_s, host_pid), 0, sizeof(stats_page_s) - offsetof(stats_page_s, host_pid));
+    page->version = STATS_VERSION;
+    page->size = sizeof(stats_page_s);
+    page->host_pid = getpid();
+    page->magic = STATS_MAGIC;
+    __atomic_store_n(&page->seq, 2, __ATOMIC_RELEASE);
+
+    return page;
+}
+
+/*
+ * Maps an existing page read-only.
+ *
+ * Arguments: name: the object name, with or without the leading slash.
+ * Return: the mapped page, NULL if it does not exist or is not a stats page.
+ */
+const stats_page_s * stats_attach(/* in */ const char * name) {
+    char object[NAME_MAX];
+    struct stat st;
+    stats_page_p page;
+    int fd;
+
+    stats_object_name(name, object, sizeof(object));
+    fd = shm_open(object, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(stats_page_s)) {
+        close(fd);
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(stats_page_s), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        return NULL;
+    }
+    if (page->magic != STATS_MAGIC || page->version != STATS_VERSION || page->size != sizeof(stats_page_s)) {
+        munmap(page, sizeof(stats_page_s));
+        return NULL;
+    }
+
+    return page;
+}
+
+/*
+ * Marks the start of an update: the page's seq becomes odd.
+ *
+ * Arguments: page: the page.
+ */
+void stats_write_begin(/* in-out */ stats_page_p page) {
+    /* Only one writer, so a plain increment; the fence keeps the data stores after it. */
+    __atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ * Marks the end of an update: the page's seq becomes even again.
+ *
+ * Arguments: page: the page.
+ */
+void stats_write_end(/* in-out */ stats_page_p page) {
+    __atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copies a consistent snapshot of the page, retrying while the writer is busy.
+ *
+ * Arguments: page: the page.
+ *            snapshot: where to copy it.
+ * Return: 1 if a consistent copy was taken, 0 if the writer kept it busy.
+ */
+int stats_read(/* in */ const stats_page_s * page, /* out */ stats_page_p snapshot) {
+    uint32_t before, after;
+    int attempt;
+
+    for (attempt = 0; attempt < STATS_READ_RETRIES; attempt++) {
+        before = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, page, sizeof(stats_page_s));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&page->seq, __ATOMIC_RELAXED);
+        if (before == after) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Unmaps a page, and removes the object if the name is given.
+ *
+ * Arguments: page: the page.
+ *            name: the object name to unlink, NULL to leave it.
+ */
+void stats_close(/* in */ const stats_page_s * page, /* in */ const char * name) {
+    char object[NAME_MAX];
+
+    munmap((void *) page, sizeof(stats_page_s));
+    if (name != NULL) {
+        stats_object_name(name, object, sizeof(object));
+        shm_unlink(object);
+    }
+}
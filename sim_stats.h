@@ -0,0 +1,111 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef SIM_STATS_H
+#define SIM_STATS_H
+
+#include <stdint.h>
+
+#include "pcb.h"
+
+#define STATS_MAGIC 0x54415453 /* "STAT" */
+#define STATS_VERSION 1
+#define STATS_MAX_IO_DEVICES 8
+
+/*
+ * Live statistics of a running simulation, published in POSIX shared memory.
+ * The layout is fixed and holds no pointers. The writer bumps seq to an odd
+ * value before it changes anything and to the next even value after, so a
+ * reader copies the page and retries if seq was odd or moved meanwhile; the
+ * writer never waits for readers.
+ */
+typedef struct stats_page {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;               // sizeof(stats_page_s)
+    uint32_t seq;                // odd while an update is in progress
+
+    uint32_t host_pid;           // process running the simulation
+    uint32_t finished;           // 1 once the run is over
+    uint64_t iteration;
+    uint64_t context_switches;
+    uint64_t page_faults;
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+
+    uint32_t running_pid;        // PT_NO_PID when the cpu is idle
+    uint32_t running_priority;
+    int32_t deadlock;            // 1 once a deadlock has been detected
+    uint32_t num_io_devices;
+
+    uint32_t ready_depth[NUM_PRIORITIES];
+    uint32_t io_depth[STATS_MAX_IO_DEVICES];
+    uint32_t new_depth;
+    uint32_t paging_depth;
+    uint32_t zombie_depth;
+
+    /* Processes alive now, by kind; prod/cons counts pairs. */
+    uint32_t io_procs;
+    uint32_t intensive_procs;
+    uint32_t mutex_procs;
+    uint32_t prod_cons_pairs;
+    uint32_t created;
+    uint32_t terminated;
+
+    uint64_t free_bytes;
+    uint64_t arena_bytes;
+} stats_page_s;
+
+typedef stats_page_s * stats_page_p;
+
+/*
+ * Creates, or takes over, a shared memory object and maps a zeroed page in it.
+ *
+ * Arguments: name: the object name, with or without the leading slash.
+ * Return: the mapped page, NULL on failure.
+ */
+stats_page_p stats_create(/* in */ const char * name);
+
+/*
+ * Maps an existing page read-only.
+ *
+ * Arguments: name: the object name, with or without the leading slash.
+ * Return: the mapped page, NULL if it does not exist or is not a stats page.
+ */
+const stats_page_s * stats_attach(/* in */ const char * name);
+
+/*
+ * Marks the start of an update: the page's seq becomes odd.
+ *
+ * Arguments: page: the page.
+ */
+void stats_write_begin(/* in-out */ stats_page_p page);
+
+/*
+ * Marks the end of an update: the page's seq becomes even again.
+ *
+ * Arguments: page: the page.
+ */
+void stats_write_end(/* in-out */ stats_page_p page);
+
+/*
+ * Copies a consistent snapshot of the page, retrying while the writer is busy.
+ *
+ * Arguments: page: the page.
+ *            snapshot: where to copy it.
+ * Return: 1 if a consistent copy was taken, 0 if the writer kept it busy.
+ */
+int stats_read(/* in */ const stats_page_s * page, /* out */ stats_page_p snapshot);
+
+/*
+ * Unmaps a page, and removes the object if the name is given.
+ *
+ * Arguments: page: the page.
+ *            name: the object name to unlink, NULL to leave it.
+ */
+void stats_close(/* in */ const stats_page_s * page, /* in */ const char * name);
+
+#endif
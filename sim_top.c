@@ -0,0 +1,129 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+/*
+ * Shows the live statistics a simulation publishes with -p, refreshed like top.
+ * Polling only reads the shared page, so it costs the simulation nothing.
+ *
+ * Usage: sim_top [-i interval-ms] [-n updates] stats-name
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim_stats.h"
+#include "proc_table.h"
+
+#define DEFAULT_INTERVAL_MS 500
+
+/*
+ * Prints one snapshot.
+ *
+ * Arguments: stats: the snapshot.
+ *            rate: cycles per second since the previous one, negative if unknown.
+ *            clear: clear the terminal first.
+ */
+void show(/* in */ stats_page_p stats, /* in */ double rate, /* in */ int clear) {
+    unsigned int i;
+
+    if (clear) {
+        printf("\033[H\033[2J");
+    }
+    printf("simulation %u - iteration %llu", stats->host_pid, (unsigned long long) stats->iteration);
+    if (rate >= 0) {
+        printf(" - %.0f cycles/s", rate);
+    }
+    printf("%s\n", stats->finished ? " - finished" : "");
+
+    if (stats->running_pid != PT_NO_PID) {
+        printf("running: PID %u, priority %u\n", stats->running_pid, stats->running_priority);
+    } else {
+        printf("running: idle\n");
+    }
+    printf("context switches: %llu   page faults: %llu   TLB hit rate: %.2f%%   deadlock: %s\n",
+           (unsigned long long) stats->context_switches, (unsigned long long) stats->page_faults,
+           100.0 * stats->tlb_hits / (stats->tlb_hits + stats->tlb_misses + 1), stats->deadlock ? "yes" : "no");
+    printf("processes: %u IO, %u intensive, %u mutex, %u prod/cons pairs; %u created, %u terminated\n",
+           stats->io_procs, stats->intensive_procs, stats->mutex_procs, stats->prod_cons_pairs,
+           stats->created, stats->terminated);
+    printf("memory: %llu KB free of %llu KB\n",
+           (unsigned long long) stats->free_bytes / 1024, (unsigned long long) stats->arena_bytes / 1024);
+
+    printf("ready:");
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        printf(" %u", stats->ready_depth[i]);
+    }
+    printf("\nio:");
+    for (i = 0; i < stats->num_io_devices && i < STATS_MAX_IO_DEVICES; i++) {
+        printf(" %u", stats->io_depth[i]);
+    }
+    printf("   new: %u   paging: %u   zombie: %u\n", stats->new_depth, stats->paging_depth, stats->zombie_depth);
+    fflush(stdout);
+}
+
+int main(int argc, char * argv[]) {
+    const stats_page_s * page;
+    stats_page_s stats;
+    unsigned long long last_iteration = 0;
+    struct timespec now, last = { 0 }, pause;
+    long interval_ms = DEFAULT_INTERVAL_MS;
+    long updates = -1; // forever
+    double rate;
+    int opt;
+    int clear = isatty(STDOUT_FILENO);
+
+    while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+        switch (opt) {
+        case 'i':
+            interval_ms = strtol(optarg, NULL, 10);
+            break;
+        case 'n':
+            updates = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-i interval-ms] [-n updates] stats-name\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || interval_ms <= 0) {
+        fprintf(stderr, "usage: %s [-i interval-ms] [-n updates] stats-name\n", argv[0]);
+        return 1;
+    }
+
+    page = stats_attach(argv[optind]);
+    if (page == NULL) {
+        fprintf(stderr, "no simulation statistics published as %s\n", argv[optind]);
+        return 1;
+    }
+
+    pause.tv_sec = interval_ms / 1000;
+    pause.tv_nsec = interval_ms % 1000 * 1000000;
+    while (updates != 0) {
+        if (stats_read(page, &stats)) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            rate = -1;
+            if (last.tv_sec != 0 || last.tv_nsec != 0) {
+                rate = (stats.iteration - last_iteration)
+                       / ((now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9);
+            }
+            show(&stats, rate, clear);
+            last = now;
+            last_iteration = stats.iteration;
+            if (stats.finished) {
+                break;
+            }
+        }
+        if (updates > 0) {
+            updates--;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    stats_close(page, NULL);
+    return 0;
+}
@@ -0,0 +1,357 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sync_prims.h"
+
+const char * rw_mode_names[RW_MODE_COUNT] = { "readers", "writers", "exclusive" };
+
+/*
+ * Parses a reader-writer mode name.
+ *
+ * Arguments: name: readers, writers or exclusive.
+ *            mode: where to store it.
+ * Return: 1 if successful, 0 if the name is unknown.
+ */
+int rw_mode_parse(/* in */ const char * name, /* out */ enum rw_mode * mode) {
+    int i;
+
+    for (i = 0; i < RW_MODE_COUNT; i++) {
+        if (strcmp(name, rw_mode_names[i]) == 0) {
+            *mode = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Creates an unheld reader-writer lock.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            mode: who it lets in first.
+ * Return: the lock, NULL if out of memory.
+ */
+rw_lock_p rw_lock_create(/* in */ proc_table_p table, /* in */ enum rw_mode mode) {
+    rw_lock_p rw = calloc(1, sizeof(rw_lock_s));
+
+    if (rw == NULL)
+        return NULL;
+    rw->mode = mode;
+    rw->waiting_readers = q_create(table);
+    rw->waiting_writers = q_create(table);
+    if (rw->waiting_readers == NULL || rw->waiting_writers == NULL) {
+        rw_lock_destroy(rw);
+        return NULL;
+    }
+    return rw;
+}
+
+/*
+ * Frees a reader-writer lock.
+ */
+void rw_lock_destroy(/* in-out */ rw_lock_p rw) {
+    if (rw->waiting_readers != NULL)
+        q_destroy(rw->waiting_readers);
+    if (rw->waiting_writers != NULL)
+        q_destroy(rw->waiting_writers);
+    free(rw);
+}
+
+/*
+ * Takes the lock to read, or queues the process if it must wait. Readers
+ * share it unless a writer holds it, the mode prefers a writer that is
+ * waiting, or the mode is exclusive.
+ *
+ * Return: 0 if it holds the lock, 1 if it was queued.
+ */
+int rw_read_lock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb) {
+    if (rw->writer != NULL
+        || (rw->mode == RW_EXCLUSIVE && rw->readers > 0)
+        || (rw->mode == RW_PREFER_WRITERS && !q_is_empty(rw->waiting_writers))) {
+        rw->read_blocks++;
+        q_enqueue(rw->waiting_readers, pcb);
+        return 1;
+    }
+
+    if (rw->readers > 0)
+        rw->shared_reads++;
+    rw->readers++;
+    rw->reads++;
+    if (rw->readers > rw->max_readers)
+        rw->max_readers = rw->readers;
+    return 0;
+}
+
+/*
+ * Takes the lock to write, or queues the process if it must wait.
+ *
+ * Return: 0 if it holds the lock, 1 if it was queued.
+ */
+int rw_write_lock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb) {
+    if (rw->writer != NULL || rw->readers > 0) {
+        rw->write_blocks++;
+        q_enqueue(rw->waiting_writers, pcb);
+        return 1;
+    }
+
+    rw->writer = pcb;
+    rw->writes++;
+    return 0;
+}
+
+/*
+ * Releases the lock pcb holds, to read or to write. Once it is free, a writer
+ * is woken unless readers are preferred and some wait; otherwise the readers.
+ *
+ * Return: who the caller should wake.
+ */
+enum rw_wake rw_unlock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb) {
+    if (rw->writer == pcb)
+        rw->writer = NULL;
+    else if (rw->readers > 0)
+        rw->readers--;
+
+    if (rw->writer != NULL || rw->readers > 0)
+        return RW_WAKE_NONE;
+    if (!q_is_empty(rw->waiting_writers) && (rw->mode != RW_PREFER_READERS || q_is_empty(rw->waiting_readers)))
+        return RW_WAKE_WRITER;
+    if (!q_is_empty(rw->waiting_readers))
+        return RW_WAKE_READERS;
+    return RW_WAKE_NONE;
+}
+
+/*
+ * Creates a semaphore.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            count: the units it starts with.
+ * Return: the semaphore, NULL if out of memory.
+ */
+semaphore_p semaphore_create(/* in */ proc_table_p table, /* in */ unsigned int count) {
+    semaphore_p sem = calloc(1, sizeof(semaphore_s));
+
+    if (sem == NULL)
+        return NULL;
+    sem->count = count;
+    sem->initial = count;
+    sem->waiting = q_create(table);
+    if (sem->waiting == NULL) {
+        free(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+/*
+ * Frees a semaphore.
+ */
+void semaphore_destroy(/* in-out */ semaphore_p sem) {
+    q_destroy(sem->waiting);
+    free(sem);
+}
+
+/*
+ * Takes a unit, or queues the process if none is left.
+ *
+ * Return: 0 if it took one, 1 if it was queued.
+ */
+int semaphore_wait(/* in-out */ semaphore_p sem, /* in */ PCB_p pcb) {
+    if (sem->count == 0) {
+        sem->blocks++;
+        q_enqueue(sem->waiting, pcb);
+        return 1;
+    }
+    sem->count--;
+    sem->waits++;
+    return 0;
+}
+
+/*
+ * Gives a unit back.
+ *
+ * Return: 1 if the caller should wake the oldest waiter, 0 if none waits.
+ */
+int semaphore_post(/* in-out */ semaphore_p sem) {
+    sem->count++;
+    return !q_is_empty(sem->waiting);
+}
+
+/*
+ * Creates an open barrier.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            parties: how many arrivals open it.
+ * Return: the barrier, NULL if out of memory.
+ */
+barrier_p barrier_create(/* in */ proc_table_p table, /* in */ unsigned int parties) {
+    barrier_p barrier = calloc(1, sizeof(barrier_s));
+
+    if (barrier == NULL)
+        return NULL;
+    barrier->parties = parties;
+    barrier->waiting = q_create(table);
+    if (barrier->waiting == NULL) {
+        free(barrier);
+        return NULL;
+    }
+    return barrier;
+}
+
+/*
+ * Frees a barrier.
+ */
+void barrier_destroy(/* in-out */ barrier_p barrier) {
+    q_destroy(barrier->waiting);
+    free(barrier);
+}
+
+/*
+ * Counts an arrival. The last party of a generation opens the barrier and
+ * passes; the others are queued.
+ *
+ * Return: 1 if the barrier opened and the caller should wake every waiter,
+ *         0 if the process was queued.
+ */
+int barrier_arrive(/* in-out */ barrier_p barrier, /* in */ PCB_p pcb) {
+    if (++barrier->arrived < barrier->parties) {
+        q_enqueue(barrier->waiting, pcb);
+        return 0;
+    }
+    barrier->arrived = 0;
+    barrier->generations++;
+    return 1;
+}
+
+/*
+ * Parks the critical sections of a READER, WRITER or SEM pcb that would not
+ * end by its max_pc, so it never wraps around to acquire again while holding.
+ *
+ * Arguments: pcb: the pcb to modify, max_pc must be set.
+ */
+void sync_fit_traps(/* in-out */ PCB_p pcb) {
+    sync_payload_s * sync = PCB_SYNC(pcb);
+    int i;
+
+    if (pcb->proc_type == BARRIER)
+        return;
+    for (i = 0; i < NUM_LOCKS; i++) {
+        if (sync->release[i] > pcb->max_pc) {
+            sync->acquire[i] = (unsigned int) -1;
+            sync->release[i] = (unsigned int) -1;
+        }
+    }
+}
+
+/*
+ * Write a reader-writer lock to a checkpoint.
+ */
+void rw_lock_save(/* in-out */ ckpt_writer_p w, /* in */ rw_lock_p rw) {
+    ckpt_put_u32(w, rw->readers);
+    ckpt_put_u32(w, rw->writer != NULL ? rw->writer->pid : PT_NO_PID);
+    q_save(w, rw->waiting_readers);
+    q_save(w, rw->waiting_writers);
+    ckpt_put(w, &rw->reads, sizeof(rw->reads));
+    ckpt_put(w, &rw->shared_reads, sizeof(rw->shared_reads));
+    ckpt_put(w, &rw->writes, sizeof(rw->writes));
+    ckpt_put(w, &rw->read_blocks, sizeof(rw->read_blocks));
+    ckpt_put(w, &rw->write_blocks, sizeof(rw->write_blocks));
+    ckpt_put_u32(w, rw->max_readers);
+}
+
+/*
+ * Read a reader-writer lock back from a checkpoint. The mode is not part of
+ * it, so a restored run can try another.
+ * Return: the lock, NULL if the record is damaged or out of memory.
+ */
+rw_lock_p rw_lock_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table, /* in */ enum rw_mode mode) {
+    rw_lock_p rw = rw_lock_create(table, mode);
+    uint32_t writer;
+
+    if (rw == NULL)
+        return NULL;
+    rw->readers = ckpt_get_u32(r);
+    writer = ckpt_get_u32(r);
+    rw->writer = writer == PT_NO_PID ? NULL : pt_lookup_pid(table, writer);
+    q_load(r, rw->waiting_readers);
+    q_load(r, rw->waiting_writers);
+    ckpt_read(r, &rw->reads, sizeof(rw->reads));
+    ckpt_read(r, &rw->shared_reads, sizeof(rw->shared_reads));
+    ckpt_read(r, &rw->writes, sizeof(rw->writes));
+    ckpt_read(r, &rw->read_blocks, sizeof(rw->read_blocks));
+    ckpt_read(r, &rw->write_blocks, sizeof(rw->write_blocks));
+    rw->max_readers = ckpt_get_u32(r);
+
+    if (!r->ok || (writer != PT_NO_PID && rw->writer == NULL)) {
+        rw_lock_destroy(rw);
+        return NULL;
+    }
+    return rw;
+}
+
+/*
+ * Write a semaphore to a checkpoint.
+ */
+void semaphore_save(/* in-out */ ckpt_writer_p w, /* in */ semaphore_p sem) {
+    ckpt_put_u32(w, sem->initial);
+    ckpt_put_u32(w, sem->count);
+    q_save(w, sem->waiting);
+    ckpt_put(w, &sem->waits, sizeof(sem->waits));
+    ckpt_put(w, &sem->blocks, sizeof(sem->blocks));
+}
+
+/*
+ * Read a semaphore back from a checkpoint.
+ * Return: the semaphore, NULL if the record is damaged or out of memory.
+ */
+semaphore_p semaphore_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table) {
+    semaphore_p sem = semaphore_create(table, ckpt_get_u32(r));
+
+    if (sem == NULL)
+        return NULL;
+    sem->count = ckpt_get_u32(r);
+    q_load(r, sem->waiting);
+    ckpt_read(r, &sem->waits, sizeof(sem->waits));
+    ckpt_read(r, &sem->blocks, sizeof(sem->blocks));
+
+    if (!r->ok) {
+        semaphore_destroy(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+/*
+ * Write a barrier to a checkpoint.
+ */
+void barrier_save(/* in-out */ ckpt_writer_p w, /* in */ barrier_p barrier) {
+    ckpt_put_u32(w, barrier->parties);
+    ckpt_put_u32(w, barrier->arrived);
+    q_save(w, barrier->waiting);
+    ckpt_put(w, &barrier->generations, sizeof(barrier->generations));
+}
+
+/*
+ * Read a barrier back from a checkpoint.
+ * Return: the barrier, NULL if the record is damaged or out of memory.
+ */
+barrier_p barrier_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table) {
+    barrier_p barrier = barrier_create(table, ckpt_get_u32(r));
+
+    if (barrier == NULL)
+        return NULL;
+    barrier->arrived = ckpt_get_u32(r);
+    q_load(r, barrier->waiting);
+    ckpt_read(r, &barrier->generations, sizeof(barrier->generations));
+
+    if (!r->ok || barrier->parties == 0 || barrier->arrived >= barrier->parties) {
+        barrier_destroy(barrier);
+        return NULL;
+    }
+    return barrier;
+}
@@ -0,0 +1,197 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef SYNC_PRIMS_H
+#define SYNC_PRIMS_H
+
+#include "checkpoint.h"
+#include "fifo_queue.h"
+#include "pcb.h"
+
+/*
+ * Reader-writer locks, counting semaphores and barriers for READER, WRITER,
+ * SEM and BARRIER processes. Like Lock_s, they only keep the waiting
+ * processes in their queues: the caller blocks a process that is queued and
+ * makes ready the ones a release says to wake. A woken reader, writer or
+ * semaphore waiter runs its trap again and may find it taken once more; a
+ * woken barrier party carries on past the barrier.
+ */
+
+/* Who a reader-writer lock lets in first when both are waiting. */
+enum rw_mode {
+    RW_PREFER_READERS, // readers join readers holding it, even with writers waiting
+    RW_PREFER_WRITERS, // a waiting writer holds off new readers
+    RW_EXCLUSIVE,      // readers take it alone, as a plain mutex would
+    RW_MODE_COUNT,
+};
+
+extern const char * rw_mode_names[RW_MODE_COUNT];
+
+/* What an unlock asks the caller to wake. */
+enum rw_wake {
+    RW_WAKE_NONE,
+    RW_WAKE_WRITER,  // the oldest waiting writer
+    RW_WAKE_READERS, // every waiting reader
+};
+
+typedef struct rw_lock {
+    enum rw_mode mode;
+    unsigned int readers;      // processes holding it to read
+    PCB_p writer;              // the process holding it to write, NULL if none
+    FIFOq_p waiting_readers;
+    FIFOq_p waiting_writers;
+
+    unsigned long long reads;        // read acquisitions
+    unsigned long long shared_reads; // ... made while other readers held it
+    unsigned long long writes;
+    unsigned long long read_blocks;
+    unsigned long long write_blocks;
+    unsigned int max_readers;
+} rw_lock_s;
+
+typedef rw_lock_s * rw_lock_p;
+
+typedef struct semaphore {
+    unsigned int count;        // units left
+    unsigned int initial;
+    FIFOq_p waiting;
+
+    unsigned long long waits;  // units taken
+    unsigned long long blocks;
+} semaphore_s;
+
+typedef semaphore_s * semaphore_p;
+
+typedef struct barrier {
+    unsigned int parties;      // arrivals that open it
+    unsigned int arrived;      // so far in this generation
+    FIFOq_p waiting;
+
+    unsigned long long generations; // times it opened
+} barrier_s;
+
+typedef barrier_s * barrier_p;
+
+/*
+ * Parses a reader-writer mode name.
+ *
+ * Arguments: name: readers, writers or exclusive.
+ *            mode: where to store it.
+ * Return: 1 if successful, 0 if the name is unknown.
+ */
+int rw_mode_parse(/* in */ const char * name, /* out */ enum rw_mode * mode);
+
+/*
+ * Creates an unheld reader-writer lock.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            mode: who it lets in first.
+ * Return: the lock, NULL if out of memory.
+ */
+rw_lock_p rw_lock_create(/* in */ proc_table_p table, /* in */ enum rw_mode mode);
+
+/*
+ * Frees a reader-writer lock.
+ */
+void rw_lock_destroy(/* in-out */ rw_lock_p rw);
+
+/*
+ * Takes the lock to read, or queues the process if it must wait.
+ *
+ * Return: 0 if it holds the lock, 1 if it was queued.
+ */
+int rw_read_lock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb);
+
+/*
+ * Takes the lock to write, or queues the process if it must wait.
+ *
+ * Return: 0 if it holds the lock, 1 if it was queued.
+ */
+int rw_write_lock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb);
+
+/*
+ * Releases the lock pcb holds, to read or to write.
+ *
+ * Return: who the caller should wake.
+ */
+enum rw_wake rw_unlock(/* in-out */ rw_lock_p rw, /* in */ PCB_p pcb);
+
+/*
+ * Creates a semaphore.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            count: the units it starts with.
+ * Return: the semaphore, NULL if out of memory.
+ */
+semaphore_p semaphore_create(/* in */ proc_table_p table, /* in */ unsigned int count);
+
+/*
+ * Frees a semaphore.
+ */
+void semaphore_destroy(/* in-out */ semaphore_p sem);
+
+/*
+ * Takes a unit, or queues the process if none is left.
+ *
+ * Return: 0 if it took one, 1 if it was queued.
+ */
+int semaphore_wait(/* in-out */ semaphore_p sem, /* in */ PCB_p pcb);
+
+/*
+ * Gives a unit back.
+ *
+ * Return: 1 if the caller should wake the oldest waiter, 0 if none waits.
+ */
+int semaphore_post(/* in-out */ semaphore_p sem);
+
+/*
+ * Creates an open barrier.
+ *
+ * Arguments: table: the process table of the processes that will wait on it.
+ *            parties: how many arrivals open it.
+ * Return: the barrier, NULL if out of memory.
+ */
+barrier_p barrier_create(/* in */ proc_table_p table, /* in */ unsigned int parties);
+
+/*
+ * Frees a barrier.
+ */
+void barrier_destroy(/* in-out */ barrier_p barrier);
+
+/*
+ * Counts an arrival. The last party of a generation opens the barrier and
+ * passes; the others are queued.
+ *
+ * Return: 1 if the barrier opened and the caller should wake every waiter,
+ *         0 if the process was queued.
+ */
+int barrier_arrive(/* in-out */ barrier_p barrier, /* in */ PCB_p pcb);
+
+/*
+ * Parks the critical sections of a READER, WRITER or SEM pcb that would not
+ * end by its max_pc, so it never wraps around to acquire again while holding.
+ *
+ * Arguments: pcb: the pcb to modify, max_pc must be set.
+ */
+void sync_fit_traps(/* in-out */ PCB_p pcb);
+
+/*
+ * Write a primitive, holder and queues included, to a checkpoint.
+ */
+void rw_lock_save(/* in-out */ ckpt_writer_p w, /* in */ rw_lock_p rw);
+void semaphore_save(/* in-out */ ckpt_writer_p w, /* in */ semaphore_p sem);
+void barrier_save(/* in-out */ ckpt_writer_p w, /* in */ barrier_p barrier);
+
+/*
+ * Read a primitive back from a checkpoint, once the pcbs are restored. A
+ * reader-writer lock takes the mode it is given, which is not checkpointed.
+ * Return: the primitive, NULL if the record is damaged or out of memory.
+ */
+rw_lock_p rw_lock_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table, /* in */ enum rw_mode mode);
+semaphore_p semaphore_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table);
+barrier_p barrier_load(/* in-out */ ckpt_reader_p r, /* in */ proc_table_p table);
+
+#endif
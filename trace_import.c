@@ -0,0 +1,344 @@
+/*
+ * TCSS 422 Scheduler Simulation - ftrace importer
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ *
+ * Converts a Linux sched_switch/sched_wakeup text trace (as printed by
+ * /sys/kernel/tracing/trace or `trace-cmd report`) into a workload trace.
+ *
+ * Each traced pid becomes one record:
+ *   arrival    - first time the pid is seen, relative to the start of the trace
+ *   max_pc     - total time the pid spent on a cpu
+ *   io traps   - cumulative run time at each point the pid blocked; blocking in
+ *                D state (uninterruptible, usually IO) traps to device 0, blocking
+ *                in S state traps to device 1
+ *   type       - IO if the pid ever blocked, INTENSIVE otherwise
+ * Times are converted to cpu iterations with the -c option.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "workload_trace.h"
+
+#define DEFAULT_CYCLES_PER_USEC 1.0
+#define MIN_IMPORTED_MAX_PC 1
+
+/* What we know about a single traced pid. */
+typedef struct traced_proc {
+    char seen;
+    char running;
+    double first_seen;
+    double running_since;
+    double run_time;
+    unsigned int io_1_count;
+    unsigned int io_2_count;
+    trace_record_s rec;
+} traced_proc_s;
+
+typedef traced_proc_s * traced_proc_p;
+
+/* Table of procs indexed by pid, grown as larger pids are seen. */
+traced_proc_p procs = NULL;
+unsigned int procs_capacity = 0;
+
+double cycles_per_usec = DEFAULT_CYCLES_PER_USEC;
+double trace_start = -1;
+double trace_end = -1;   // timestamp of the last event read
+
+/*
+ * Finds the entry for a pid, growing the table if needed.
+ *
+ * Arguments: pid: the pid to look up.
+ * Return: the entry, NULL if the table could not grow.
+ */
+traced_proc_p proc_for_pid(unsigned int pid) {
+    unsigned int new_capacity;
+    traced_proc_p resized;
+
+    if (pid >= procs_capacity) {
+        new_capacity = procs_capacity == 0 ? 1024 : procs_capacity;
+        while (new_capacity <= pid) {
+            new_capacity *= 2;
+        }
+        resized = realloc(procs, sizeof(traced_proc_s) * new_capacity);
+        if (resized == NULL) {
+            return NULL;
+        }
+        memset(resized + procs_capacity, 0, sizeof(traced_proc_s) * (new_capacity - procs_capacity));
+        procs = resized;
+        procs_capacity = new_capacity;
+    }
+
+    return &procs[pid];
+}
+
+/*
+ * Converts a duration in seconds to cpu iterations.
+ */
+uint64_t to_cycles(double seconds) {
+    return (uint64_t) (seconds * 1000000.0 * cycles_per_usec + 0.5);
+}
+
+/*
+ * Marks a pid as seen at the given time.
+ */
+traced_proc_p touch_pid(unsigned int pid, double ts) {
+    traced_proc_p proc;
+
+    /* The idle task is not a process we want to replay. */
+    if (pid == 0) {
+        return NULL;
+    }
+
+    proc = proc_for_pid(pid);
+    if (proc != NULL && !proc->seen) {
+        proc->seen = 1;
+        proc->first_seen = ts;
+    }
+    return proc;
+}
+
+/*
+ * Reads an unsigned integer field such as "prev_pid=123" from a line.
+ * Return: 1 if the field was found, 0 otherwise.
+ */
+int read_field_uint(const char * line, const char * field, unsigned int * out) {
+    const char * pos = strstr(line, field);
+    if (pos == NULL) {
+        return 0;
+    }
+    *out = (unsigned int) strtoul(pos + strlen(field), NULL, 10);
+    return 1;
+}
+
+/*
+ * Reads the timestamp that precedes the event name, e.g. "1234.567890: sched_switch:".
+ * Return: 1 if a timestamp was found, 0 otherwise.
+ */
+int read_timestamp(const char * line, const char * event, double * ts) {
+    const char * end = event;
+    const char * start;
+
+    /* event points at ": sched_..."; the timestamp ends right before it. */
+    start = end;
+    while (start > line && start[-1] != ' ') {
+        start--;
+    }
+    if (start == end) {
+        return 0;
+    }
+    *ts = strtod(start, NULL);
+    return 1;
+}
+
+/*
+ * Records a switch of a pid off the cpu.
+ */
+void switch_out(unsigned int pid, char prev_state, double ts) {
+    traced_proc_p proc = touch_pid(pid, ts);
+    uint32_t pc;
+
+    if (proc == NULL || !proc->running) {
+        return;
+    }
+
+    proc->running = 0;
+    proc->run_time += ts - proc->running_since;
+    pc = (uint32_t) to_cycles(proc->run_time);
+
+    /* Only blocking switches become IO points, preemption (R) does not. */
+    if (prev_state == 'D' && proc->io_1_count < NUM_IO_TRAPS) {
+        proc->rec.io_1_traps[proc->io_1_count++] = pc;
+    } else if (prev_state == 'S' && proc->io_2_count < NUM_IO_TRAPS) {
+        proc->rec.io_2_traps[proc->io_2_count++] = pc;
+    }
+}
+
+/*
+ * Records a switch of a pid onto the cpu.
+ */
+void switch_in(unsigned int pid, double ts) {
+    traced_proc_p proc = touch_pid(pid, ts);
+
+    if (proc != NULL) {
+        proc->running = 1;
+        proc->running_since = ts;
+    }
+}
+
+/*
+ * Parses one line of trace text.
+ */
+void parse_line(const char * line) {
+    const char * event;
+    char prev_state = 'R';
+    const char * state_pos;
+    unsigned int prev_pid, next_pid, pid;
+    double ts;
+
+    if ((event = strstr(line, ": sched_switch:")) != NULL) {
+        if (!read_timestamp(line, event, &ts)
+            || !read_field_uint(line, "prev_pid=", &prev_pid)
+            || !read_field_uint(line, "next_pid=", &next_pid)) {
+            return;
+        }
+        if (trace_start < 0) {
+            trace_start = ts;
+        }
+        trace_end = ts;
+        state_pos = strstr(line, "prev_state=");
+        if (state_pos != NULL) {
+            prev_state = state_pos[strlen("prev_state=")];
+        }
+        switch_out(prev_pid, prev_state, ts);
+        switch_in(next_pid, ts);
+    } else if ((event = strstr(line, ": sched_wakeup:")) != NULL
+               || (event = strstr(line, ": sched_wakeup_new:")) != NULL) {
+        if (!read_timestamp(line, event, &ts) || !read_field_uint(line, " pid=", &pid)) {
+            return;
+        }
+        if (trace_start < 0) {
+            trace_start = ts;
+        }
+        trace_end = ts;
+        touch_pid(pid, ts);
+    }
+}
+
+/*
+ * Ends the bursts still running when the trace stops, at its last event.
+ * The end of the trace is not a blocking switch, so it adds no IO point.
+ */
+void switch_out_running(double ts) {
+    unsigned int pid;
+
+    for (pid = 0; pid < procs_capacity; pid++) {
+        if (procs[pid].running) {
+            switch_out(pid, 'R', ts);
+        }
+    }
+}
+
+/*
+ * Orders records by arrival for qsort.
+ */
+int compare_arrival(const void * a, const void * b) {
+    const trace_record_s * left = *(const trace_record_s * const *) a;
+    const trace_record_s * right = *(const trace_record_s * const *) b;
+
+    if (left->arrival < right->arrival) return -1;
+    if (left->arrival > right->arrival) return 1;
+    return 0;
+}
+
+/*
+ * Converts every seen pid into a record and writes them in arrival order.
+ * Return: the number of records written, -1 on failure.
+ */
+long write_records(const char * path) {
+    unsigned int pid, count = 0, i;
+    trace_record_s ** sorted;
+    trace_writer_p writer;
+    traced_proc_p proc;
+
+    sorted = malloc(sizeof(trace_record_s *) * (procs_capacity + 1));
+    if (sorted == NULL) {
+        return -1;
+    }
+
+    for (pid = 0; pid < procs_capacity; pid++) {
+        proc = &procs[pid];
+        if (!proc->seen) {
+            continue;
+        }
+        proc->rec.arrival = to_cycles(proc->first_seen - trace_start);
+        proc->rec.max_pc = (uint32_t) to_cycles(proc->run_time);
+        if (proc->rec.max_pc < MIN_IMPORTED_MAX_PC) {
+            proc->rec.max_pc = MIN_IMPORTED_MAX_PC;
+        }
+        proc->rec.terminate = 1;
+        proc->rec.priority = 0;
+        proc->rec.type = (proc->io_1_count + proc->io_2_count) > 0 ? IO : INTENSIVE;
+        /* Unused trap slots must never match, park them past max_pc. */
+        for (i = proc->io_1_count; i < NUM_IO_TRAPS; i++) {
+            proc->rec.io_1_traps[i] = proc->rec.max_pc + 1;
+        }
+        for (i = proc->io_2_count; i < NUM_IO_TRAPS; i++) {
+            proc->rec.io_2_traps[i] = proc->rec.max_pc + 1;
+        }
+        sorted[count++] = &proc->rec;
+    }
+
+    qsort(sorted, count, sizeof(trace_record_s *), compare_arrival);
+
+    writer = trace_writer_open(path);
+    if (writer == NULL) {
+        free(sorted);
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (!trace_writer_append(writer, sorted[i])) {
+            break;
+        }
+    }
+    free(sorted);
+
+    if (!trace_writer_close(writer) || i != count) {
+        return -1;
+    }
+    return count;
+}
+
+int main(int argc, char * argv[]) {
+    FILE * in = stdin;
+    char * line = NULL;
+    size_t line_cap = 0;
+    long written;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        switch (opt) {
+        case 'c':
+            cycles_per_usec = strtod(optarg, NULL);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c cycles_per_usec] output.trace [input.txt]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || cycles_per_usec <= 0) {
+        fprintf(stderr, "usage: %s [-c cycles_per_usec] output.trace [input.txt]\n", argv[0]);
+        return 1;
+    }
+
+    if (optind + 1 < argc) {
+        in = fopen(argv[optind + 1], "r");
+        if (in == NULL) {
+            perror(argv[optind + 1]);
+            return 1;
+        }
+    }
+
+    /* Stream the text; only per-pid summaries are kept in memory. */
+    while (getline(&line, &line_cap, in) != -1) {
+        parse_line(line);
+    }
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    switch_out_running(trace_end);
+    written = write_records(argv[optind]);
+    free(procs);
+    if (written < 0) {
+        fprintf(stderr, "failed to write %s\n", argv[optind]);
+        return 1;
+    }
+
+    printf("Imported %ld processes into %s\n", written, argv[optind]);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "workload_trace.h"
+
+/* Malformed records written between the two good ones. */
+#define NUM_BAD_RECORDS 8
+
+int failures = 0;
+
+/*
+ * Reports a failed check.
+ *
+ * Arguments: ok: the outcome of the check.
+ *            what: what was checked.
+ */
+void check(/* in */ int ok, /* in */ const char * what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/*
+ * Fills in a record that passes trace_record_valid.
+ *
+ * Arguments: rec: the record to fill.
+ *            arrival: its arrival cycle.
+ */
+void good_record(/* out */ trace_record_s * rec, /* in */ uint64_t arrival) {
+    int i;
+
+    memset(rec, 0, sizeof(trace_record_s));
+    rec->arrival = arrival;
+    rec->max_pc = 1000;
+    rec->terminate = 3;
+    rec->type = MUTEX;
+    rec->flags = TRACE_FLAG_LOCK_POINTS;
+    for (i = 0; i < NUM_IO_TRAPS; i++) {
+        rec->io_1_traps[i] = 100 * i + 10;
+        rec->io_2_traps[i] = rec->max_pc + 1;
+    }
+    for (i = 0; i < NUM_LOCKS; i++) {
+        rec->lock_points[i] = 200 * i + 1;
+        rec->unlock_points[i] = 200 * i + 3;
+    }
+}
+
+/*
+ * Writes a trace with one malformed record of every kind between two good
+ * ones, then replays it and checks that only the good records come out.
+ */
+int main(void) {
+    char path[] = "/tmp/trace_test.XXXXXX";
+    trace_record_s rec, bad[NUM_BAD_RECORDS];
+    const trace_record_s * out;
+    trace_writer_p writer;
+    trace_reader_p reader;
+    int fd, i, seen = 0;
+
+    for (i = 0; i < NUM_BAD_RECORDS; i++)
+        good_record(&bad[i], 1);
+    bad[0].type = PROC_TYPE_COUNT;          // no such process type
+    bad[1].max_pc = 0;                      // empty burst
+    bad[2].io_1_traps[3] = 1002;            // IO trap past the parked slot
+    bad[3].lock_points[0] = 0;              // lock at pc 0
+    bad[4].lock_points[1] = 202;            // lock 2 would be taken after unlock 2
+    bad[5].unlock_points[3] = 1001;         // unlock past the burst
+    bad[6].unlock_points[2] = 0;            // unlock - 1 would wrap
+    bad[7].lock_points[2] = UINT32_MAX;     // lock + 1 would wrap
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        printf("FAIL: could not create %s\n", path);
+        return 1;
+    }
+    close(fd);
+
+    writer = trace_writer_open(path);
+    check(writer != NULL, "trace_writer_open");
+    if (writer == NULL) {
+        unlink(path);
+        return 1;
+    }
+    good_record(&rec, 0);
+    check(trace_record_valid(&rec), "good record is valid");
+    trace_writer_append(writer, &rec);
+    for (i = 0; i < NUM_BAD_RECORDS; i++) {
+        check(!trace_record_valid(&bad[i]), "malformed record is invalid");
+        trace_writer_append(writer, &bad[i]);
+    }
+    good_record(&rec, 2);
+    trace_writer_append(writer, &rec);
+    check(trace_writer_close(writer), "trace_writer_close");
+
+    reader = trace_reader_open(path);
+    check(reader != NULL, "trace_reader_open");
+    if (reader != NULL) {
+        while ((out = trace_reader_next(reader, UINT64_MAX)) != NULL) {
+            check(out->arrival == 0 || out->arrival == 2, "only good records are handed out");
+            seen++;
+        }
+        check(seen == 2, "both good records are handed out");
+        check(reader->rejected == NUM_BAD_RECORDS, "every malformed record is counted");
+        check(trace_reader_done(reader), "reader is exhausted");
+        trace_reader_close(reader);
+    }
+    unlink(path);
+
+    printf("%s\n", failures == 0 ? "trace_test: all checks passed" : "trace_test: failed");
+    return failures == 0 ? 0 : 1;
+}
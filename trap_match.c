@@ -0,0 +1,85 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include "trap_match.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+trap_match_fn trap_match = trap_match_scalar;
+const char * trap_match_isa = "scalar";
+
+/*
+ * Portable kernel: every slot is compared, without early exit, so the time
+ * does not depend on where, or whether, the pc is found.
+ */
+unsigned int trap_match_scalar(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc) {
+    unsigned int mask = 0;
+    unsigned int group, slot;
+
+    for (group = 0; group < groups; group++) {
+        for (slot = 0; slot < TRAP_GROUP_SIZE; slot++) {
+            mask |= (traps[group * TRAP_GROUP_SIZE + slot] == pc) << group;
+        }
+    }
+    return mask;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* One group per 128 bit compare. */
+__attribute__((target("sse2")))
+unsigned int trap_match_sse2(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc) {
+    __m128i needle = _mm_set1_epi32(pc);
+    unsigned int mask = 0;
+    unsigned int group;
+    __m128i hits;
+
+    for (group = 0; group < groups; group++) {
+        hits = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (traps + group * TRAP_GROUP_SIZE)), needle);
+        mask |= (_mm_movemask_epi8(hits) != 0) << group;
+    }
+    return mask;
+}
+
+/* Two groups per 256 bit compare, and an odd last group with SSE2. */
+__attribute__((target("avx2")))
+unsigned int trap_match_avx2(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc) {
+    __m256i needle = _mm256_set1_epi32(pc);
+    unsigned int mask = 0;
+    unsigned int group;
+    int lanes;
+
+    for (group = 0; group + 1 < groups; group += 2) {
+        lanes = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (traps + group * TRAP_GROUP_SIZE)), needle)));
+        mask |= ((lanes & 0xF) != 0) << group;
+        mask |= ((lanes >> 4) != 0) << (group + 1);
+    }
+    if (group < groups) {
+        lanes = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (traps + group * TRAP_GROUP_SIZE)),
+                            _mm256_castsi256_si128(needle))));
+        mask |= (lanes != 0) << group;
+    }
+    return mask;
+}
+
+/* Picks the widest kernel the cpu supports before main runs. */
+__attribute__((constructor))
+void trap_match_select() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        trap_match = trap_match_avx2;
+        trap_match_isa = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        trap_match = trap_match_sse2;
+        trap_match_isa = "sse2";
+    }
+}
+
+#endif
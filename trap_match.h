@@ -0,0 +1,45 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef TRAP_MATCH_H
+#define TRAP_MATCH_H
+
+/*
+ * Trap pcs are packed in groups of TRAP_GROUP_SIZE, one group per action, in
+ * one array. A match compares the pc against every slot at once and returns
+ * one bit per group, set if any pc of that group is the given one.
+ */
+#define TRAP_GROUP_SIZE 4
+#define TRAP_MAX_GROUPS 8
+#define TRAP_VECTOR_ALIGN 32 // a whole AVX2 register
+
+/* Bit of a group in a match mask. */
+#define TRAP_BIT(group) (1u << (group))
+
+/*
+ * Matches a pc against packed trap groups.
+ *
+ * Arguments: traps: groups * TRAP_GROUP_SIZE pcs.
+ *            groups: how many groups, at most TRAP_MAX_GROUPS.
+ *            pc: the pc to look for.
+ * Return: bit g set if group g holds pc.
+ */
+typedef unsigned int (*trap_match_fn)(const unsigned int * traps, unsigned int groups, unsigned int pc);
+
+/* The kernel for this cpu, chosen when the program starts. */
+extern trap_match_fn trap_match;
+
+/* Name of the kernel in trap_match, for reports. */
+extern const char * trap_match_isa;
+
+unsigned int trap_match_scalar(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc);
+
+#if defined(__x86_64__) || defined(__i386__)
+unsigned int trap_match_sse2(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc);
+unsigned int trap_match_avx2(/* in */ const unsigned int * traps, /* in */ unsigned int groups, /* in */ unsigned int pc);
+#endif
+
+#endif
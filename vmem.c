@@ -0,0 +1,718 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vmem.h"
+
+#define VM_TLB_INDEX(vm, pid, vpn) (((vpn) ^ ((pid) * 0x9E3779B1u)) & (vm)->tlb_mask)
+#define VM_TABLE(pool, ref) ((pool)->tables + (size_t) ((ref) - 1) * (pool)->width)
+#define VM_WORDS(frames) (((frames) + 63) / 64)
+#define VM_LINK(vm, ref) ((vm_rmap_s *) VM_TABLE(&(vm)->links, ref))
+#define VM_LEAF_INDEX(vpn) ((vpn) & (VM_LEAF_ENTRIES - 1))
+
+/*
+ * Hands out a zeroed table, reusing freed ones first.
+ *
+ * Return: a reference to the table, 0 if out of memory.
+ */
+uint32_t vm_pool_alloc(/* in-out */ vm_pool_s * pool) {
+    uint32_t ref;
+    uint32_t * resized;
+    uint32_t new_capacity;
+
+    if (pool->free_head != 0) {
+        ref = pool->free_head;
+        pool->free_head = VM_TABLE(pool, ref)[0];
+    } else {
+        if (pool->used == pool->capacity) {
+            new_capacity = pool->capacity == 0 ? 16 : pool->capacity * 2;
+            resized = realloc(pool->tables, (size_t) new_capacity * pool->width * sizeof(uint32_t));
+            if (resized == NULL) {
+                return 0;
+            }
+            pool->tables = resized;
+            pool->capacity = new_capacity;
+        }
+        ref = ++pool->used;
+    }
+
+    memset(VM_TABLE(pool, ref), 0, pool->width * sizeof(uint32_t));
+    return ref;
+}
+
+/*
+ * Returns a table to its pool.
+ */
+void vm_pool_free(/* in-out */ vm_pool_s * pool, /* in */ uint32_t ref) {
+    VM_TABLE(pool, ref)[0] = pool->free_head;
+    pool->free_head = ref;
+}
+
+/*
+ * Creates a virtual memory system.
+ *
+ * Arguments: num_frames: number of physical frames.
+ *            tlb_entries: TLB size, rounded down to a power of two.
+ *            policy: the page replacement policy.
+ *            aging_interval: cycles between aging ticks, VM_AGING only.
+ * Return: the new system, NULL if out of memory.
+ */
+vmem_p vm_create(/* in */ uint32_t num_frames, /* in */ uint32_t tlb_entries,
+                 /* in */ enum vm_policy policy, /* in */ unsigned int aging_interval) {
+    vmem_p vm = calloc(1, sizeof(vmem_s));
+    uint32_t words = VM_WORDS(num_frames);
+    uint32_t i;
+
+    if (vm == NULL) {
+        return NULL;
+    }
+
+    while (tlb_entries & (tlb_entries - 1)) {
+        tlb_entries &= tlb_entries - 1;
+    }
+    if (tlb_entries == 0) {
+        tlb_entries = 1;
+    }
+
+    vm->policy = policy;
+    vm->num_frames = num_frames;
+    vm->free_frames = num_frames;
+    vm->aging_interval = aging_interval > 0 ? aging_interval : 1;
+    vm->roots.width = VM_ROOT_ENTRIES;
+    vm->leaves.width = VM_LEAF_ENTRIES;
+    vm->links.width = sizeof(vm_rmap_s) / sizeof(uint32_t);
+    vm->tlb_mask = tlb_entries - 1;
+
+    vm->free_map = malloc(words * sizeof(uint64_t));
+    vm->ref_map = calloc(words, sizeof(uint64_t));
+    vm->rmap = malloc(num_frames * sizeof(vm_rmap_s));
+    vm->refs = calloc(num_frames, sizeof(uint32_t));
+    vm->ages = calloc(num_frames, 1);
+    vm->tlb = malloc(tlb_entries * sizeof(vm_tlb_entry_s));
+    if (vm->free_map == NULL || vm->ref_map == NULL || vm->rmap == NULL || vm->refs == NULL
+        || vm->ages == NULL || vm->tlb == NULL) {
+        vm_destroy(vm);
+        return NULL;
+    }
+
+    /* Every frame starts free; bits past the last frame stay clear. */
+    memset(vm->free_map, 0xFF, words * sizeof(uint64_t));
+    if (num_frames % 64) {
+        vm->free_map[words - 1] = (1ULL << (num_frames % 64)) - 1;
+    }
+    for (i = 0; i < num_frames; i++) {
+        vm->rmap[i].pid = VM_NO_PID;
+        vm->rmap[i].next = 0;
+    }
+    for (i = 0; i < tlb_entries; i++) {
+        vm->tlb[i].pid = VM_NO_PID;
+    }
+
+    return vm;
+}
+
+/*
+ * Frees a virtual memory system. Page tables of live processes go with it.
+ *
+ * Arguments: vm: the system to free.
+ */
+void vm_destroy(/* in-out */ vmem_p vm) {
+    free(vm->free_map);
+    free(vm->ref_map);
+    free(vm->rmap);
+    free(vm->refs);
+    free(vm->ages);
+    free(vm->tlb);
+    free(vm->roots.tables);
+    free(vm->leaves.tables);
+    free(vm->links.tables);
+    free(vm);
+}
+
+/*
+ * Looks up the page table entry of a page.
+ *
+ * Return: the entry, see VM_PTE_COW, NULL if there is no leaf.
+ */
+uint32_t * vm_walk(/* in */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn) {
+    uint32_t leaf;
+
+    if (pcb->page_table == 0) {
+        return NULL;
+    }
+    leaf = VM_TABLE(&vm->roots, pcb->page_table)[vpn >> VM_LEAF_BITS];
+    if (leaf == 0) {
+        return NULL;
+    }
+    return VM_TABLE(&vm->leaves, leaf) + VM_LEAF_INDEX(vpn);
+}
+
+/*
+ * Translates an access by a process, going through the TLB and then the page table.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the accessing process.
+ *            vpn: the virtual page number.
+ *            write: 1 if the access stores to the page.
+ * Return: where the translation was found, VM_FAULT if the page is not
+ *         resident, VM_COW_FAULT if it is a write to a shared page.
+ */
+enum vm_result vm_access(/* in-out */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn, /* in */ int write) {
+    vm_tlb_entry_s * entry;
+    uint32_t * pte;
+
+    vpn &= VM_MAX_PAGES - 1;
+    entry = &vm->tlb[VM_TLB_INDEX(vm, pcb->pid, vpn)];
+
+    if (entry->pid == pcb->pid && entry->vpn == vpn) {
+        vm->stats.tlb_hits++;
+        vm->ref_map[entry->frame >> 6] |= 1ULL << (entry->frame & 63);
+        return write && entry->cow ? VM_COW_FAULT : VM_TLB_HIT;
+    }
+    vm->stats.tlb_misses++;
+
+    pte = vm_walk(vm, pcb, vpn);
+    if (pte == NULL || *pte == 0) {
+        vm->stats.faults++;
+        return VM_FAULT;
+    }
+
+    entry->pid = pcb->pid;
+    entry->vpn = vpn;
+    entry->frame = VM_PTE_FRAME(*pte);
+    entry->cow = (*pte & VM_PTE_COW) != 0;
+    vm->ref_map[entry->frame >> 6] |= 1ULL << (entry->frame & 63);
+    return write && entry->cow ? VM_COW_FAULT : VM_WALK_HIT;
+}
+
+/*
+ * Finds a free frame, scanning the free bitmap a word at a time.
+ *
+ * Return: the frame, VM_NO_FRAME if none is free.
+ */
+uint32_t vm_take_free_frame(/* in-out */ vmem_p vm) {
+    uint32_t words = VM_WORDS(vm->num_frames);
+    uint32_t w = vm->free_hint;
+    uint32_t n;
+    uint32_t bit;
+
+    if (vm->free_frames == 0) {
+        return VM_NO_FRAME;
+    }
+
+    for (n = 0; n < words; n++, w = (w + 1 == words) ? 0 : w + 1) {
+        if (vm->free_map[w] != 0) {
+            bit = __builtin_ctzll(vm->free_map[w]);
+            vm->free_map[w] &= ~(1ULL << bit);
+            vm->free_frames--;
+            vm->free_hint = w;
+            return w * 64 + bit;
+        }
+    }
+    return VM_NO_FRAME;
+}
+
+/*
+ * Second chance: starting at the hand, skips (and clears) referenced frames a
+ * word at a time and stops at the first unreferenced one.
+ */
+uint32_t vm_clock_victim(/* in-out */ vmem_p vm) {
+    uint32_t w;
+    uint32_t b;
+    uint32_t skip;
+    uint64_t clear;
+    uint32_t victim;
+
+    for (;;) {
+        w = vm->hand >> 6;
+        b = vm->hand & 63;
+        clear = ~(vm->ref_map[w] >> b);
+        if (b != 0) {
+            clear &= ~0ULL >> b;
+        }
+
+        if (clear == 0) {
+            /* Everything from the hand to the end of the word gets its second chance. */
+            vm->ref_map[w] &= (1ULL << b) - 1;
+            vm->hand = (w + 1) * 64;
+        } else {
+            skip = __builtin_ctzll(clear);
+            victim = vm->hand + skip;
+            if (skip != 0) {
+                vm->ref_map[w] &= ~(((1ULL << skip) - 1) << b);
+            }
+            if (victim < vm->num_frames) {
+                vm->hand = victim + 1;
+                if (vm->hand >= vm->num_frames) {
+                    vm->hand = 0;
+                }
+                return victim;
+            }
+            vm->hand = vm->num_frames;
+        }
+
+        if (vm->hand >= vm->num_frames) {
+            vm->hand = 0;
+        }
+    }
+}
+
+/*
+ * Aging: the first frame from the hand that is no older than the oldest frame
+ * at the last tick and has not been referenced since, else the oldest frame.
+ */
+uint32_t vm_aging_victim(/* in-out */ vmem_p vm) {
+    uint32_t n;
+    uint32_t f = vm->hand;
+    uint32_t best = vm->hand;
+
+    for (n = 0; n < vm->num_frames; n++) {
+        if (vm->ages[f] <= vm->min_age && !(vm->ref_map[f >> 6] & (1ULL << (f & 63)))) {
+            best = f;
+            break;
+        }
+        if (vm->ages[f] < vm->ages[best]) {
+            best = f;
+        }
+        f = (f + 1 == vm->num_frames) ? 0 : f + 1;
+    }
+
+    vm->hand = (best + 1 == vm->num_frames) ? 0 : best + 1;
+    return best;
+}
+
+/*
+ * Drops the cached translation of a page, if the TLB holds it.
+ */
+void vm_tlb_drop(/* in-out */ vmem_p vm, /* in */ uint32_t pid, /* in */ uint32_t vpn) {
+    vm_tlb_entry_s * entry = &vm->tlb[VM_TLB_INDEX(vm, pid, vpn)];
+
+    if (entry->pid == pid && entry->vpn == vpn) {
+        entry->pid = VM_NO_PID;
+    }
+}
+
+/*
+ * Unmaps the page held by a frame through the reverse map, from every
+ * process that shares it.
+ */
+void vm_evict(/* in-out */ vmem_p vm, /* in */ uint32_t frame) {
+    vm_rmap_s * owner = &vm->rmap[frame];
+    vm_rmap_s * other;
+    uint32_t link;
+    uint32_t next;
+
+    VM_TABLE(&vm->leaves, owner->leaf)[VM_LEAF_INDEX(owner->vpn)] = 0;
+    vm_tlb_drop(vm, owner->pid, owner->vpn);
+    for (link = owner->next; link != 0; link = next) {
+        other = VM_LINK(vm, link);
+        next = other->next;
+        VM_TABLE(&vm->leaves, other->leaf)[VM_LEAF_INDEX(other->vpn)] = 0;
+        vm_tlb_drop(vm, other->pid, other->vpn);
+        vm_pool_free(&vm->links, link);
+    }
+    owner->pid = VM_NO_PID;
+    owner->next = 0;
+    vm->refs[frame] = 0;
+    vm->stats.evictions++;
+}
+
+/*
+ * Takes a free frame, or evicts the replacement policy's victim for one.
+ */
+uint32_t vm_take_frame(/* in-out */ vmem_p vm) {
+    uint32_t frame = vm_take_free_frame(vm);
+
+    if (frame == VM_NO_FRAME) {
+        frame = vm->policy == VM_CLOCK ? vm_clock_victim(vm) : vm_aging_victim(vm);
+        vm_evict(vm, frame);
+    }
+    return frame;
+}
+
+/*
+ * Maps a frame as a page of a process's own and caches the translation.
+ *
+ * Arguments: leaf: the leaf table holding the page's entry, as a pool reference.
+ */
+void vm_map(/* in-out */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn,
+            /* in */ uint32_t leaf, /* in */ uint32_t frame) {
+    vm_tlb_entry_s * entry = &vm->tlb[VM_TLB_INDEX(vm, pcb->pid, vpn)];
+
+    VM_TABLE(&vm->leaves, leaf)[VM_LEAF_INDEX(vpn)] = frame + 1;
+    vm->rmap[frame].pid = pcb->pid;
+    vm->rmap[frame].vpn = vpn;
+    vm->rmap[frame].leaf = leaf;
+    vm->rmap[frame].next = 0;
+    vm->refs[frame] = 1;
+    vm->ref_map[frame >> 6] |= 1ULL << (frame & 63);
+    vm->ages[frame] = 0;
+
+    entry->pid = pcb->pid;
+    entry->vpn = vpn;
+    entry->frame = frame;
+    entry->cow = 0;
+}
+
+/*
+ * Removes one mapping of a shared frame, the one whose entry is in leaf,
+ * from the frame's reverse map chain.
+ * Pre: more than one process maps the frame.
+ */
+void vm_unlink(/* in-out */ vmem_p vm, /* in */ uint32_t frame, /* in */ uint32_t leaf) {
+    vm_rmap_s * head = &vm->rmap[frame];
+    uint32_t * prev;
+    uint32_t link;
+
+    if (head->leaf == leaf) {
+        /* The next mapping takes the frame's own entry. */
+        link = head->next;
+        *head = *VM_LINK(vm, link);
+    } else {
+        prev = &head->next;
+        while (VM_LINK(vm, *prev)->leaf != leaf) {
+            prev = &VM_LINK(vm, *prev)->next;
+        }
+        link = *prev;
+        *prev = VM_LINK(vm, link)->next;
+    }
+    vm_pool_free(&vm->links, link);
+    vm->refs[frame]--;
+}
+
+/*
+ * Makes a page resident, evicting another page if no frame is free.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the faulting process.
+ *            vpn: the virtual page number.
+ * Return: the frame the page now occupies, VM_NO_FRAME if page tables could not be allocated.
+ */
+uint32_t vm_fault_in(/* in-out */ vmem_p vm, /* in-out */ PCB_p pcb, /* in */ uint32_t vpn) {
+    uint32_t * root_entry;
+    uint32_t leaf;
+    uint32_t frame;
+
+    vpn &= VM_MAX_PAGES - 1;
+
+    if (pcb->page_table == 0) {
+        pcb->page_table = vm_pool_alloc(&vm->roots);
+        if (pcb->page_table == 0) {
+            return VM_NO_FRAME;
+        }
+    }
+    root_entry = VM_TABLE(&vm->roots, pcb->page_table) + (vpn >> VM_LEAF_BITS);
+    if (*root_entry == 0) {
+        leaf = vm_pool_alloc(&vm->leaves);
+        if (leaf == 0) {
+            return VM_NO_FRAME;
+        }
+        *root_entry = leaf;
+    }
+    leaf = *root_entry;
+
+    frame = vm_take_frame(vm);
+    vm_map(vm, pcb, vpn, leaf, frame);
+    return frame;
+}
+
+/*
+ * Gives a process its own copy of a page it shares copy-on-write, or, if no
+ * other process maps the page any more, just lets it write.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the writing process.
+ *            vpn: the virtual page number, which must be mapped copy-on-write.
+ * Return: 1 if the page was copied, 0 if it was not.
+ */
+int vm_cow_fault(/* in-out */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn) {
+    vm_tlb_entry_s * entry;
+    uint32_t * pte;
+    uint32_t leaf;
+    uint32_t frame;
+
+    vpn &= VM_MAX_PAGES - 1;
+    leaf = VM_TABLE(&vm->roots, pcb->page_table)[vpn >> VM_LEAF_BITS];
+    pte = VM_TABLE(&vm->leaves, leaf) + VM_LEAF_INDEX(vpn);
+    frame = VM_PTE_FRAME(*pte);
+
+    if (vm->refs[frame] == 1) {
+        /* The others have copied it or gone. */
+        *pte &= ~VM_PTE_COW;
+        entry = &vm->tlb[VM_TLB_INDEX(vm, pcb->pid, vpn)];
+        entry->pid = pcb->pid;
+        entry->vpn = vpn;
+        entry->frame = frame;
+        entry->cow = 0;
+        vm->stats.cow_reuses++;
+        return 0;
+    }
+
+    /* Unshare first, so the copy may even evict the frame it copies. */
+    vm_unlink(vm, frame, leaf);
+    *pte = 0;
+    vm_map(vm, pcb, vpn, leaf, vm_take_frame(vm));
+    vm->stats.cow_copies++;
+    return 1;
+}
+
+/*
+ * Gives a new process a copy of another's page table. Every resident page
+ * ends up shared between them copy-on-write; the pages are not touched, so
+ * the cost is in the page table entries.
+ *
+ * Arguments: vm: the system.
+ *            parent: the process to copy.
+ *            child: the new process, registered under its own pid and with no page table.
+ * Return: the pages now shared, VM_NO_FRAME if page tables could not be
+ *         allocated, in which case the child must be released.
+ */
+uint32_t vm_fork(/* in-out */ vmem_p vm, /* in-out */ PCB_p parent, /* in-out */ PCB_p child) {
+    vm_rmap_s * link_entry;
+    uint32_t * pte;
+    uint32_t shared = 0;
+    uint32_t leaf;
+    uint32_t link;
+    uint32_t frame;
+    uint32_t i;
+    uint32_t j;
+
+    if (parent->page_table == 0) {
+        return 0;
+    }
+    child->page_table = vm_pool_alloc(&vm->roots);
+    if (child->page_table == 0) {
+        return VM_NO_FRAME;
+    }
+
+    for (i = 0; i < VM_ROOT_ENTRIES; i++) {
+        if (VM_TABLE(&vm->roots, parent->page_table)[i] == 0) {
+            continue;
+        }
+        leaf = vm_pool_alloc(&vm->leaves);
+        if (leaf == 0) {
+            return VM_NO_FRAME;
+        }
+        VM_TABLE(&vm->roots, child->page_table)[i] = leaf;
+
+        /* Growing the links pool leaves the leaves where they are. */
+        pte = VM_TABLE(&vm->leaves, VM_TABLE(&vm->roots, parent->page_table)[i]);
+        for (j = 0; j < VM_LEAF_ENTRIES; j++) {
+            if (pte[j] == 0) {
+                continue;
+            }
+            link = vm_pool_alloc(&vm->links);
+            if (link == 0) {
+                return VM_NO_FRAME;
+            }
+            pte[j] |= VM_PTE_COW;
+            VM_TABLE(&vm->leaves, leaf)[j] = pte[j];
+
+            frame = VM_PTE_FRAME(pte[j]);
+            link_entry = VM_LINK(vm, link);
+            link_entry->pid = child->pid;
+            link_entry->vpn = (i << VM_LEAF_BITS) | j;
+            link_entry->leaf = leaf;
+            link_entry->next = vm->rmap[frame].next;
+            vm->rmap[frame].next = link;
+            vm->refs[frame]++;
+            shared++;
+        }
+    }
+
+    /* The parent's cached translations must fault on a write as well. */
+    for (i = 0; i <= vm->tlb_mask; i++) {
+        if (vm->tlb[i].pid == parent->pid) {
+            vm->tlb[i].cow = 1;
+        }
+    }
+    return shared;
+}
+
+/*
+ * Advances the replacement policy by one cycle.
+ *
+ * Arguments: vm: the system.
+ */
+void vm_tick(/* in-out */ vmem_p vm) {
+    uint32_t f;
+    unsigned char min_age = 0xFF;
+
+    if (vm->policy != VM_AGING || ++vm->ticks < vm->aging_interval) {
+        return;
+    }
+    vm->ticks = 0;
+
+    /* Shift each frame's referenced bit into the top of its age. */
+    for (f = 0; f < vm->num_frames; f++) {
+        vm->ages[f] = (vm->ages[f] >> 1) | (((vm->ref_map[f >> 6] >> (f & 63)) & 1) << 7);
+        if (vm->ages[f] < min_age && vm->rmap[f].pid != VM_NO_PID) {
+            min_age = vm->ages[f];
+        }
+    }
+    memset(vm->ref_map, 0, VM_WORDS(vm->num_frames) * sizeof(uint64_t));
+    vm->min_age = min_age;
+}
+
+/*
+ * Frees every frame and page table of a process and drops its TLB entries.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the process, normally on its way to PCB_destroy.
+ */
+void vm_release(/* in-out */ vmem_p vm, /* in-out */ PCB_p pcb) {
+    uint32_t * root;
+    uint32_t * leaf;
+    uint32_t frame;
+    uint32_t i;
+    uint32_t j;
+
+    if (pcb->page_table == 0) {
+        return;
+    }
+
+    root = VM_TABLE(&vm->roots, pcb->page_table);
+    for (i = 0; i < VM_ROOT_ENTRIES; i++) {
+        if (root[i] == 0) {
+            continue;
+        }
+        leaf = VM_TABLE(&vm->leaves, root[i]);
+        for (j = 0; j < VM_LEAF_ENTRIES; j++) {
+            if (leaf[j] != 0) {
+                frame = VM_PTE_FRAME(leaf[j]);
+                /* A frame still shared with other processes stays theirs. */
+                if (vm->refs[frame] > 1) {
+                    vm_unlink(vm, frame, root[i]);
+                    continue;
+                }
+                vm->free_map[frame >> 6] |= 1ULL << (frame & 63);
+                vm->ref_map[frame >> 6] &= ~(1ULL << (frame & 63));
+                vm->rmap[frame].pid = VM_NO_PID;
+                vm->rmap[frame].next = 0;
+                vm->refs[frame] = 0;
+                vm->free_frames++;
+            }
+        }
+        vm_pool_free(&vm->leaves, root[i]);
+    }
+    vm_pool_free(&vm->roots, pcb->page_table);
+    pcb->page_table = 0;
+
+    /* The pid will be reused, so none of its translations may survive. */
+    for (i = 0; i <= vm->tlb_mask; i++) {
+        if (vm->tlb[i].pid == pcb->pid) {
+            vm->tlb[i].pid = VM_NO_PID;
+        }
+    }
+}
+
+/*
+ * Return: the number of frames currently holding a page.
+ */
+uint32_t vm_frames_in_use(/* in */ vmem_p vm) {
+    return vm->num_frames - vm->free_frames;
+}
+
+/*
+ * Writes the tables of a pool that have ever been handed out.
+ */
+void vm_pool_save(/* in-out */ ckpt_writer_p w, /* in */ vm_pool_s * pool) {
+    ckpt_put_u32(w, pool->used);
+    ckpt_put_u32(w, pool->free_head);
+    ckpt_put(w, pool->tables, (size_t) pool->used * pool->width * sizeof(uint32_t));
+}
+
+/*
+ * Reads a pool back; its width must already be set.
+ */
+int vm_pool_load(/* in-out */ ckpt_reader_p r, /* out */ vm_pool_s * pool) {
+    pool->used = ckpt_get_u32(r);
+    pool->free_head = ckpt_get_u32(r);
+    pool->capacity = pool->used;
+    if (!r->ok || pool->used == 0) {
+        return r->ok;
+    }
+    pool->tables = malloc((size_t) pool->used * pool->width * sizeof(uint32_t));
+    if (pool->tables == NULL) {
+        pool->capacity = 0;
+        r->ok = 0;
+        return 0;
+    }
+    return ckpt_read(r, pool->tables, (size_t) pool->used * pool->width * sizeof(uint32_t));
+}
+
+/*
+ * Writes the whole virtual memory state to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            vm: the system.
+ */
+void vm_save(/* in-out */ ckpt_writer_p w, /* in */ vmem_p vm) {
+    ckpt_put_u32(w, vm->policy);
+    ckpt_put_u32(w, vm->num_frames);
+    ckpt_put_u32(w, vm->tlb_mask + 1);
+    ckpt_put_u32(w, vm->aging_interval);
+    ckpt_put_u32(w, vm->free_frames);
+    ckpt_put_u32(w, vm->free_hint);
+    ckpt_put_u32(w, vm->hand);
+    ckpt_put_u32(w, vm->ticks);
+    ckpt_put_u32(w, vm->min_age);
+
+    ckpt_put(w, vm->free_map, VM_WORDS(vm->num_frames) * sizeof(uint64_t));
+    ckpt_put(w, vm->ref_map, VM_WORDS(vm->num_frames) * sizeof(uint64_t));
+    ckpt_put(w, vm->rmap, vm->num_frames * sizeof(vm_rmap_s));
+    ckpt_put(w, vm->refs, vm->num_frames * sizeof(uint32_t));
+    ckpt_put(w, vm->ages, vm->num_frames);
+    ckpt_put(w, vm->tlb, (vm->tlb_mask + 1) * sizeof(vm_tlb_entry_s));
+    vm_pool_save(w, &vm->roots);
+    vm_pool_save(w, &vm->leaves);
+    vm_pool_save(w, &vm->links);
+    ckpt_put(w, &vm->stats, sizeof(vm->stats));
+}
+
+/*
+ * Creates a virtual memory system from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ * Return: the new system, NULL if the checkpoint is damaged or out of memory.
+ */
+vmem_p vm_load(/* in-out */ ckpt_reader_p r) {
+    enum vm_policy policy = ckpt_get_u32(r);
+    uint32_t num_frames = ckpt_get_u32(r);
+    uint32_t tlb_entries = ckpt_get_u32(r);
+    unsigned int aging_interval = ckpt_get_u32(r);
+    vmem_p vm;
+
+    if (!r->ok || (vm = vm_create(num_frames, tlb_entries, policy, aging_interval)) == NULL) {
+        r->ok = 0;
+        return NULL;
+    }
+
+    vm->free_frames = ckpt_get_u32(r);
+    vm->free_hint = ckpt_get_u32(r);
+    vm->hand = ckpt_get_u32(r);
+    vm->ticks = ckpt_get_u32(r);
+    vm->min_age = ckpt_get_u32(r);
+
+    ckpt_read(r, vm->free_map, VM_WORDS(num_frames) * sizeof(uint64_t));
+    ckpt_read(r, vm->ref_map, VM_WORDS(num_frames) * sizeof(uint64_t));
+    ckpt_read(r, vm->rmap, num_frames * sizeof(vm_rmap_s));
+    ckpt_read(r, vm->refs, num_frames * sizeof(uint32_t));
+    ckpt_read(r, vm->ages, num_frames);
+    ckpt_read(r, vm->tlb, (vm->tlb_mask + 1) * sizeof(vm_tlb_entry_s));
+    vm_pool_load(r, &vm->roots);
+    vm_pool_load(r, &vm->leaves);
+    vm_pool_load(r, &vm->links);
+    ckpt_read(r, &vm->stats, sizeof(vm->stats));
+
+    if (!r->ok) {
+        vm_destroy(vm);
+        return NULL;
+    }
+    return vm;
+}
@@ -0,0 +1,226 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef VMEM_H
+#define VMEM_H
+
+#include <stdint.h>
+
+#include "checkpoint.h"
+#include "pcb.h"
+
+/*
+ * Virtual page numbers are split into a root index and a leaf index, so each
+ * process has a two level radix page table: a root of VM_ROOT_ENTRIES leaf
+ * references and leaves of VM_LEAF_ENTRIES page table entries. Leaves are only
+ * allocated for the parts of the address space a process touches.
+ */
+#define VM_ROOT_BITS 8
+#define VM_LEAF_BITS 10
+#define VM_ROOT_ENTRIES (1u << VM_ROOT_BITS)
+#define VM_LEAF_ENTRIES (1u << VM_LEAF_BITS)
+#define VM_MAX_PAGES (1u << (VM_ROOT_BITS + VM_LEAF_BITS)) /* pages per process, larger vpns alias */
+
+#define VM_NO_FRAME 0xFFFFFFFFu
+#define VM_NO_PID 0xFFFFFFFFu
+
+/*
+ * A page table entry is frame + 1 if the page is resident, 0 if not. The top
+ * bit marks a page shared copy-on-write since a fork: reads go to the shared
+ * frame, a write must copy it first.
+ */
+#define VM_PTE_COW 0x80000000u
+#define VM_PTE_FRAME(pte) (((pte) & ~VM_PTE_COW) - 1)
+
+/* Page replacement policies. */
+enum vm_policy {
+    /* Second chance: sweep the referenced bits, evict the first clear one. */
+    VM_CLOCK,
+    /* Aging: an 8 bit history of the referenced bit per frame, evict the oldest. */
+    VM_AGING,
+};
+
+/* Result of a memory access. */
+enum vm_result {
+    VM_TLB_HIT,
+    VM_WALK_HIT, // TLB miss, page resident
+    VM_FAULT,    // page not resident, the caller must fault it in
+    VM_COW_FAULT, // write to a page shared copy-on-write, the caller must copy it
+};
+
+/*
+ * Pool of fixed width tables, e.g. all the leaves of every process. Tables are
+ * referred to by index + 1 so 0 can mean "none"; free tables are chained
+ * through their first entry.
+ */
+typedef struct vm_pool {
+    uint32_t * tables;
+    uint32_t width;    // entries per table
+    uint32_t capacity; // tables allocated
+    uint32_t used;     // tables ever handed out
+    uint32_t free_head;
+} vm_pool_s;
+
+/* A TLB entry, tagged with the pid so a context switch does not flush it. */
+typedef struct vm_tlb_entry {
+    uint32_t pid;
+    uint32_t vpn;
+    uint32_t frame;
+    uint32_t cow;  // 1 if a write through it must fault
+} vm_tlb_entry_s;
+
+/*
+ * Reverse map entry: who maps a frame and where its page table entry is. A
+ * frame shared after a fork has one entry per process mapping it, chained
+ * from its own through next; the others live in the links pool.
+ */
+typedef struct vm_rmap {
+    uint32_t pid;
+    uint32_t vpn;
+    uint32_t leaf; // leaf table holding the entry, as a pool reference
+    uint32_t next; // next mapping of the frame, as a links pool reference, 0 if none
+} vm_rmap_s;
+
+typedef struct vm_stats {
+    unsigned long long tlb_hits;
+    unsigned long long tlb_misses;
+    unsigned long long faults;
+    unsigned long long evictions;
+    unsigned long long cow_copies; // copy-on-write faults that copied the page
+    unsigned long long cow_reuses; // ... that found the process the last one mapping it
+} vm_stats_s;
+
+typedef struct vmem {
+    enum vm_policy policy;
+
+    /* Frame pool. Bitmaps hold one bit per frame, 64 frames per word. */
+    uint32_t num_frames;
+    uint32_t free_frames;
+    uint32_t free_hint;   // word to start the next free frame search at
+    uint64_t * free_map;  // 1 = free
+    uint64_t * ref_map;   // 1 = referenced since the last sweep or aging tick
+    vm_rmap_s * rmap;
+    uint32_t * refs;      // page table entries mapping each frame, 0 if free
+    unsigned char * ages; // VM_AGING only
+    uint32_t hand;        // replacement scan position
+    unsigned int aging_interval;
+    unsigned int ticks;
+    unsigned char min_age; // lowest age at the last aging tick
+
+    vm_pool_s roots;
+    vm_pool_s leaves;
+    vm_pool_s links;      // rmap entries of the further mappings of shared frames
+
+    /* Direct mapped TLB, tlb_mask + 1 entries. */
+    vm_tlb_entry_s * tlb;
+    uint32_t tlb_mask;
+
+    vm_stats_s stats;
+} vmem_s;
+
+typedef vmem_s * vmem_p;
+
+/*
+ * Creates a virtual memory system.
+ *
+ * Arguments: num_frames: number of physical frames.
+ *            tlb_entries: TLB size, rounded down to a power of two.
+ *            policy: the page replacement policy.
+ *            aging_interval: cycles between aging ticks, VM_AGING only.
+ * Return: the new system, NULL if out of memory.
+ */
+vmem_p vm_create(/* in */ uint32_t num_frames, /* in */ uint32_t tlb_entries,
+                 /* in */ enum vm_policy policy, /* in */ unsigned int aging_interval);
+
+/*
+ * Frees a virtual memory system. Page tables of live processes go with it.
+ *
+ * Arguments: vm: the system to free.
+ */
+void vm_destroy(/* in-out */ vmem_p vm);
+
+/*
+ * Translates an access by a process, going through the TLB and then the page table.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the accessing process.
+ *            vpn: the virtual page number.
+ *            write: 1 if the access stores to the page.
+ * Return: where the translation was found, VM_FAULT if the page is not
+ *         resident, VM_COW_FAULT if it is a write to a shared page.
+ */
+enum vm_result vm_access(/* in-out */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn, /* in */ int write);
+
+/*
+ * Makes a page resident, evicting another page if no frame is free.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the faulting process.
+ *            vpn: the virtual page number.
+ * Return: the frame the page now occupies, VM_NO_FRAME if page tables could not be allocated.
+ */
+uint32_t vm_fault_in(/* in-out */ vmem_p vm, /* in-out */ PCB_p pcb, /* in */ uint32_t vpn);
+
+/*
+ * Gives a process its own copy of a page it shares copy-on-write, or, if no
+ * other process maps the page any more, just lets it write.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the writing process.
+ *            vpn: the virtual page number, which must be mapped copy-on-write.
+ * Return: 1 if the page was copied, 0 if it was not.
+ */
+int vm_cow_fault(/* in-out */ vmem_p vm, /* in */ PCB_p pcb, /* in */ uint32_t vpn);
+
+/*
+ * Gives a new process a copy of another's page table. Every resident page
+ * ends up shared between them copy-on-write.
+ *
+ * Arguments: vm: the system.
+ *            parent: the process to copy.
+ *            child: the new process, registered under its own pid and with no page table.
+ * Return: the pages now shared, VM_NO_FRAME if page tables could not be
+ *         allocated, in which case the child must be released.
+ */
+uint32_t vm_fork(/* in-out */ vmem_p vm, /* in-out */ PCB_p parent, /* in-out */ PCB_p child);
+
+/*
+ * Advances the replacement policy by one cycle.
+ *
+ * Arguments: vm: the system.
+ */
+void vm_tick(/* in-out */ vmem_p vm);
+
+/*
+ * Frees every frame and page table of a process and drops its TLB entries.
+ *
+ * Arguments: vm: the system.
+ *            pcb: the process, normally on its way to PCB_destroy.
+ */
+void vm_release(/* in-out */ vmem_p vm, /* in-out */ PCB_p pcb);
+
+/*
+ * Return: the number of frames currently holding a page.
+ */
+uint32_t vm_frames_in_use(/* in */ vmem_p vm);
+
+/*
+ * Writes the whole virtual memory state to a checkpoint.
+ *
+ * Arguments: w: the checkpoint.
+ *            vm: the system.
+ */
+void vm_save(/* in-out */ ckpt_writer_p w, /* in */ vmem_p vm);
+
+/*
+ * Creates a virtual memory system from a checkpoint.
+ *
+ * Arguments: r: the checkpoint.
+ * Return: the new system, NULL if the checkpoint is damaged or out of memory.
+ */
+vmem_p vm_load(/* in-out */ ckpt_reader_p r);
+
+#endif
@@ -0,0 +1,397 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload_gen.h"
+
+/* Lock regions per pcb: at most lock/unlock and trylock/try_unlock, NUM_LOCKS each. */
+#define MAX_FORBIDDEN_RANGES (2 * NUM_LOCKS)
+
+/* A closed range of pcs that IO traps may not land in. */
+typedef struct pc_range {
+    unsigned int base;
+    unsigned int bound;
+} pc_range_s;
+
+/*
+ * Fills a config with the defaults, which reproduce the original generator.
+ *
+ * Arguments: config: the config to fill.
+ */
+void workload_gen_defaults(/* out */ workload_gen_config_s * config) {
+    int i;
+
+    config->arrival = ARRIVAL_LEGACY;
+    config->rate = GEN_DEFAULT_RATE;
+    config->burst_on = GEN_DEFAULT_BURST_ON;
+    config->burst_off = GEN_DEFAULT_BURST_OFF;
+
+    config->burst = BURST_UNIFORM;
+    config->pareto_alpha = GEN_DEFAULT_PARETO_ALPHA;
+    config->lognormal_mu = GEN_DEFAULT_LOGNORMAL_MU;
+    config->lognormal_sigma = GEN_DEFAULT_LOGNORMAL_SIGMA;
+    config->min_max_pc = GEN_DEFAULT_MIN_MAX_PC;
+    config->max_pc_modulo = GEN_DEFAULT_MAX_PC_MODULO;
+    config->max_pc_cap = GEN_DEFAULT_MAX_PC_CAP;
+
+    for (i = 0; i < PROC_TYPE_COUNT; i++) {
+        config->io_ratio[i] = GEN_IO_RATIO_ALL_SLOTS;
+    }
+    config->async_share = 0.0;
+    config->sync_share = 0.0;
+    config->fork_share = 0.0;
+    config->ipc_share = 0.0;
+    config->ipc_batch = 1;
+
+    config->size = BURST_UNIFORM;
+    config->size_min = GEN_DEFAULT_SIZE_MIN;
+    config->size_max = GEN_DEFAULT_SIZE_MAX;
+    config->size_alpha = GEN_DEFAULT_SIZE_ALPHA;
+    config->size_mu = GEN_DEFAULT_SIZE_MU;
+    config->size_sigma = GEN_DEFAULT_SIZE_SIGMA;
+}
+
+/*
+ * Applies a comma separated key=value spec to a config, e.g.
+ * "arrival=poisson,rate=0.02,burst=pareto,alpha=1.2,io_io=3,io_intensive=0,size=pareto".
+ *
+ * Arguments: config: the config to modify.
+ *            spec: the spec to parse.
+ * Return: 1 if every key was understood, 0 otherwise.
+ */
+int workload_gen_parse(/* in-out */ workload_gen_config_s * config, /* in */ const char * spec) {
+    char * copy = strdup(spec);
+    char * save = NULL;
+    char * item;
+    char * value;
+    int ok = 1;
+
+    if (copy == NULL) {
+        return 0;
+    }
+
+    for (item = strtok_r(copy, ",", &save); item != NULL && ok; item = strtok_r(NULL, ",", &save)) {
+        value = strchr(item, '=');
+        if (value == NULL) {
+            ok = 0;
+            break;
+        }
+        *value++ = '\0';
+
+        if (strcmp(item, "arrival") == 0) {
+            if (strcmp(value, "legacy") == 0) config->arrival = ARRIVAL_LEGACY;
+            else if (strcmp(value, "poisson") == 0) config->arrival = ARRIVAL_POISSON;
+            else if (strcmp(value, "bursty") == 0) config->arrival = ARRIVAL_BURSTY;
+            else ok = 0;
+        } else if (strcmp(item, "burst") == 0) {
+            if (strcmp(value, "uniform") == 0) config->burst = BURST_UNIFORM;
+            else if (strcmp(value, "pareto") == 0) config->burst = BURST_PARETO;
+            else if (strcmp(value, "lognormal") == 0) config->burst = BURST_LOGNORMAL;
+            else ok = 0;
+        } else if (strcmp(item, "size") == 0) {
+            if (strcmp(value, "uniform") == 0) config->size = BURST_UNIFORM;
+            else if (strcmp(value, "pareto") == 0) config->size = BURST_PARETO;
+            else if (strcmp(value, "lognormal") == 0) config->size = BURST_LOGNORMAL;
+            else ok = 0;
+        } else if (strcmp(item, "size_min") == 0) {
+            config->size_min = strtoul(value, NULL, 10);
+            ok = config->size_min > 0;
+        } else if (strcmp(item, "size_max") == 0) {
+            config->size_max = strtoul(value, NULL, 10);
+        } else if (strcmp(item, "size_alpha") == 0) {
+            config->size_alpha = strtod(value, NULL);
+            ok = config->size_alpha > 0;
+        } else if (strcmp(item, "size_mu") == 0) {
+            config->size_mu = strtod(value, NULL);
+        } else if (strcmp(item, "size_sigma") == 0) {
+            config->size_sigma = strtod(value, NULL);
+        } else if (strcmp(item, "rate") == 0) {
+            config->rate = strtod(value, NULL);
+            ok = config->rate > 0;
+        } else if (strcmp(item, "on") == 0) {
+            config->burst_on = strtod(value, NULL);
+            ok = config->burst_on > 0;
+        } else if (strcmp(item, "off") == 0) {
+            config->burst_off = strtod(value, NULL);
+            ok = config->burst_off > 0;
+        } else if (strcmp(item, "alpha") == 0) {
+            config->pareto_alpha = strtod(value, NULL);
+            ok = config->pareto_alpha > 0;
+        } else if (strcmp(item, "mu") == 0) {
+            config->lognormal_mu = strtod(value, NULL);
+        } else if (strcmp(item, "sigma") == 0) {
+            config->lognormal_sigma = strtod(value, NULL);
+        } else if (strcmp(item, "min_pc") == 0) {
+            config->min_max_pc = strtoul(value, NULL, 10);
+        } else if (strcmp(item, "pc_modulo") == 0) {
+            config->max_pc_modulo = strtoul(value, NULL, 10);
+            ok = config->max_pc_modulo > 0;
+        } else if (strcmp(item, "max_pc") == 0) {
+            config->max_pc_cap = strtoul(value, NULL, 10);
+        } else if (strcmp(item, "io_io") == 0) {
+            config->io_ratio[IO] = strtod(value, NULL);
+        } else if (strcmp(item, "io_intensive") == 0) {
+            config->io_ratio[INTENSIVE] = strtod(value, NULL);
+        } else if (strcmp(item, "io_mutex") == 0) {
+            config->io_ratio[MUTEX] = strtod(value, NULL);
+        } else if (strcmp(item, "io_prod") == 0) {
+            config->io_ratio[PROD] = strtod(value, NULL);
+        } else if (strcmp(item, "io_cons") == 0) {
+            config->io_ratio[CONS] = strtod(value, NULL);
+        } else if (strcmp(item, "async") == 0) {
+            config->async_share = strtod(value, NULL);
+            ok = config->async_share >= 0.0 && config->async_share <= 100.0;
+        } else if (strcmp(item, "sync") == 0) {
+            config->sync_share = strtod(value, NULL);
+            ok = config->sync_share >= 0.0 && config->sync_share <= 100.0;
+        } else if (strcmp(item, "fork") == 0) {
+            config->fork_share = strtod(value, NULL);
+            ok = config->fork_share >= 0.0 && config->fork_share <= 100.0;
+        } else if (strcmp(item, "ipc") == 0) {
+            config->ipc_share = strtod(value, NULL);
+            ok = config->ipc_share >= 0.0 && config->ipc_share <= 100.0;
+        } else if (strcmp(item, "ipc_batch") == 0) {
+            config->ipc_batch = strtoul(value, NULL, 10);
+            ok = config->ipc_batch > 0;
+        } else {
+            ok = 0;
+        }
+    }
+
+    free(copy);
+    return ok;
+}
+
+/*
+ * Seeds a generator and schedules its first arrival.
+ *
+ * Arguments: gen: the generator to start, its config must already be set.
+ *            seed: the rng seed.
+ */
+void workload_gen_start(/* in-out */ workload_gen_p gen, /* in */ uint64_t seed) {
+    rng_seed(&gen->rng, seed);
+    gen->phase_end = rng_exponential(&gen->rng, 1.0 / gen->config.burst_on);
+    gen->next_arrival = rng_exponential(&gen->rng, gen->config.rate);
+}
+
+/*
+ * Counts the arrivals that are due by the given cycle and schedules the next one.
+ * Always 0 for ARRIVAL_LEGACY.
+ *
+ * Arguments: gen: the generator.
+ *            now: the current cpu iteration.
+ * Return: the number of processes to create now.
+ */
+unsigned int workload_gen_arrivals(/* in-out */ workload_gen_p gen, /* in */ unsigned long long now) {
+    unsigned int count = 0;
+    double on_start;
+
+    if (gen->config.arrival == ARRIVAL_LEGACY || (double) now < gen->next_arrival) {
+        return 0;
+    }
+
+    while (gen->next_arrival <= (double) now) {
+        if (gen->config.arrival == ARRIVAL_BURSTY && gen->next_arrival >= gen->phase_end) {
+            /* The on period ended before this arrival: skip the off period and start over. */
+            on_start = gen->phase_end + rng_exponential(&gen->rng, 1.0 / gen->config.burst_off);
+            gen->phase_end = on_start + rng_exponential(&gen->rng, 1.0 / gen->config.burst_on);
+            gen->next_arrival = on_start + rng_exponential(&gen->rng, gen->config.rate);
+            continue;
+        }
+        count++;
+        gen->next_arrival += rng_exponential(&gen->rng, gen->config.rate);
+    }
+
+    return count;
+}
+
+/*
+ * Draws a CPU burst length for a new process.
+ *
+ * Arguments: gen: the generator.
+ * Return: the max_pc to use.
+ */
+unsigned int workload_gen_max_pc(/* in-out */ workload_gen_p gen) {
+    workload_gen_config_s * config = &gen->config;
+    double value;
+
+    switch (config->burst) {
+    case BURST_PARETO:
+        value = rng_pareto(&gen->rng, config->pareto_alpha, config->min_max_pc > 0 ? config->min_max_pc : 1);
+        break;
+    case BURST_LOGNORMAL:
+        value = config->min_max_pc + rng_lognormal(&gen->rng, config->lognormal_mu, config->lognormal_sigma);
+        break;
+    case BURST_UNIFORM:
+    default:
+        return config->min_max_pc + rng_below(&gen->rng, config->max_pc_modulo);
+    }
+
+    if (value > config->max_pc_cap) {
+        value = config->max_pc_cap;
+    }
+    return (unsigned int) value;
+}
+
+/*
+ * Draws the image size of a new process.
+ *
+ * Arguments: gen: the generator.
+ * Return: the size in bytes, between size_min and size_max.
+ */
+unsigned int workload_gen_size(/* in-out */ workload_gen_p gen) {
+    workload_gen_config_s * config = &gen->config;
+    double value;
+
+    if (config->size_max <= config->size_min) {
+        return config->size_min;
+    }
+
+    switch (config->size) {
+    case BURST_PARETO:
+        value = rng_pareto(&gen->rng, config->size_alpha, config->size_min);
+        break;
+    case BURST_LOGNORMAL:
+        value = rng_lognormal(&gen->rng, config->size_mu, config->size_sigma);
+        break;
+    case BURST_UNIFORM:
+    default:
+        return config->size_min + rng_below(&gen->rng, config->size_max - config->size_min + 1);
+    }
+
+    if (value < config->size_min) {
+        value = config->size_min;
+    } else if (value > config->size_max) {
+        value = config->size_max;
+    }
+    return (unsigned int) value;
+}
+
+/*
+ * Collects the lock regions of the pcb's type, clipped to [0, max_pc], sorted and merged.
+ * Return: the number of ranges written.
+ */
+int collect_forbidden_ranges(/* in */ PCB_p pcb, /* out */ pc_range_s ranges[MAX_FORBIDDEN_RANGES]) {
+    pc_range_s candidate[MAX_FORBIDDEN_RANGES];
+    pc_range_s tmp;
+    unsigned int lock_pc;
+    int count = 0, merged = 0;
+    int i, j;
+
+    for (i = 0; i < NUM_LOCKS; i++) {
+        if (pcb->proc_type == MUTEX) {
+            candidate[count].base = PCB_MUTEX(pcb)->lock_1[i];
+            candidate[count++].bound = PCB_MUTEX(pcb)->unlock_1[i];
+            candidate[count].base = PCB_MUTEX(pcb)->trylock_1[i];
+            candidate[count++].bound = PCB_MUTEX(pcb)->try_unlock_1[i];
+        } else if (pcb->proc_type == PROD || pcb->proc_type == CONS) {
+            lock_pc = PCB_PROD_CONS(pcb)->prod_cons_lock[i];
+            candidate[count].base = lock_pc > 0 ? lock_pc - 1 : 0;
+            candidate[count++].bound = lock_pc + 1;
+        }
+    }
+
+    /* Insertion sort, there are only a dozen ranges. */
+    for (i = 1; i < count; i++) {
+        tmp = candidate[i];
+        for (j = i; j > 0 && candidate[j - 1].base > tmp.base; j--) {
+            candidate[j] = candidate[j - 1];
+        }
+        candidate[j] = tmp;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (candidate[i].base > pcb->max_pc || candidate[i].bound < candidate[i].base) {
+            continue;
+        }
+        if (candidate[i].bound > pcb->max_pc) {
+            candidate[i].bound = pcb->max_pc;
+        }
+        if (merged > 0 && candidate[i].base <= ranges[merged - 1].bound + 1) {
+            if (candidate[i].bound > ranges[merged - 1].bound) {
+                ranges[merged - 1].bound = candidate[i].bound;
+            }
+        } else {
+            ranges[merged++] = candidate[i];
+        }
+    }
+
+    return merged;
+}
+
+/*
+ * Places the IO traps of a pcb. Trap pcs are drawn directly in sorted order
+ * from the pcs outside the pcb's lock regions, without rejection, and split
+ * between the two devices. Unused slots are parked past max_pc so they never fire.
+ *
+ * Arguments: gen: the generator.
+ *            pcb: the pcb to modify, max_pc and proc_type must be set.
+ */
+void workload_gen_place_traps(/* in-out */ workload_gen_p gen, /* in-out */ PCB_p pcb) {
+    pc_range_s ranges[MAX_FORBIDDEN_RANGES];
+    unsigned int points[GEN_IO_SLOTS];
+    unsigned int allowed, wanted, j, t, pc, tmp;
+    int num_ranges, i, k, count = 0;
+    double ratio = GEN_IO_RATIO_ALL_SLOTS;
+
+    /* Only these types carry IO traps. */
+    if (pcb->proc_type != IO && pcb->proc_type != PROD && pcb->proc_type != CONS) {
+        return;
+    }
+
+    num_ranges = collect_forbidden_ranges(pcb, ranges);
+    allowed = pcb->max_pc + 1;
+    for (i = 0; i < num_ranges; i++) {
+        allowed -= ranges[i].bound - ranges[i].base + 1;
+    }
+
+    if (pcb->proc_type < PROC_TYPE_COUNT) {
+        ratio = gen->config.io_ratio[pcb->proc_type];
+    }
+    if (ratio < 0) {
+        wanted = GEN_IO_SLOTS;
+    } else {
+        wanted = (unsigned int) (ratio * pcb->max_pc / 100.0 + 0.5);
+        if (wanted > GEN_IO_SLOTS) {
+            wanted = GEN_IO_SLOTS;
+        }
+    }
+    if (wanted > allowed) {
+        wanted = allowed;
+    }
+
+    /* Floyd's algorithm: a uniform subset of ranks in [0, allowed), no retries. */
+    for (j = allowed - wanted; j < allowed; j++) {
+        t = rng_below(&gen->rng, j + 1);
+        for (k = 0; k < count && points[k] != t; k++);
+        points[count] = (k < count) ? j : t;
+        count++;
+    }
+
+    /* Sort the ranks, then skip over the lock regions to turn each rank into a pc. */
+    for (i = 1; i < count; i++) {
+        tmp = points[i];
+        for (k = i; k > 0 && points[k - 1] > tmp; k--) {
+            points[k] = points[k - 1];
+        }
+        points[k] = tmp;
+    }
+    for (k = 0; k < count; k++) {
+        pc = points[k];
+        for (i = 0; i < num_ranges && pc >= ranges[i].base; i++) {
+            pc += ranges[i].bound - ranges[i].base + 1;
+        }
+        points[k] = pc;
+    }
+
+    /* Deal alternately so both devices get an ascending share. */
+    for (i = 0; i < NUM_IO_TRAPS; i++) {
+        PCB_IO_TRAPS(pcb)->io_1_traps[i] = (2 * i < count) ? points[2 * i] : pcb->max_pc + 1;
+        PCB_IO_TRAPS(pcb)->io_2_traps[i] = (2 * i + 1 < count) ? points[2 * i + 1] : pcb->max_pc + 1;
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef WORKLOAD_GEN_H
+#define WORKLOAD_GEN_H
+
+#include "pcb.h"
+#include "sim_random.h"
+
+/* Defaults, matching the original generate_pcbs()/make_pcb() behavior. */
+#define GEN_DEFAULT_RATE 0.01          /* arrivals per cycle */
+#define GEN_DEFAULT_BURST_ON 2000.0    /* mean cycles in a bursty on period */
+#define GEN_DEFAULT_BURST_OFF 8000.0   /* mean cycles in a bursty off period */
+#define GEN_DEFAULT_PARETO_ALPHA 1.5
+#define GEN_DEFAULT_LOGNORMAL_MU 4.5
+#define GEN_DEFAULT_LOGNORMAL_SIGMA 1.0
+#define GEN_DEFAULT_MIN_MAX_PC 20      /* Faster than a quantum! */
+#define GEN_DEFAULT_MAX_PC_MODULO 400  /* But can be much longer than a quantum! */
+#define GEN_DEFAULT_MAX_PC_CAP 100000  /* heavy tails are truncated here */
+#define GEN_IO_RATIO_ALL_SLOTS -1.0    /* use every IO trap slot, as make_pcb() always did */
+#define GEN_DEFAULT_SIZE_MIN (16 * 1024)   /* process image bytes */
+#define GEN_DEFAULT_SIZE_MAX (512 * 1024)  /* also the cap for heavy tailed sizes */
+#define GEN_DEFAULT_SIZE_ALPHA 1.2
+#define GEN_DEFAULT_SIZE_MU 11.0           /* e^11 is about 60 KB */
+#define GEN_DEFAULT_SIZE_SIGMA 1.0
+
+/* Number of IO trap slots over both devices. */
+#define GEN_IO_SLOTS (2 * NUM_IO_TRAPS)
+
+/* When new processes arrive. */
+enum arrival_kind {
+    /* rand() % NUM_PROCESSES at every priority reset. */
+    ARRIVAL_LEGACY,
+    /* Poisson process with the configured rate. */
+    ARRIVAL_POISSON,
+    /* Poisson while "on", nothing while "off"; on/off lengths are exponential. */
+    ARRIVAL_BURSTY,
+};
+
+/* How long each CPU burst (max_pc) is, and how large each process image is. */
+enum burst_kind {
+    BURST_UNIFORM,
+    BURST_PARETO,
+    BURST_LOGNORMAL,
+};
+
+typedef struct workload_gen_config {
+    enum arrival_kind arrival;
+    double rate;
+    double burst_on;
+    double burst_off;
+
+    enum burst_kind burst;
+    double pareto_alpha;
+    double lognormal_mu;
+    double lognormal_sigma;
+    unsigned int min_max_pc;
+    unsigned int max_pc_modulo;
+    unsigned int max_pc_cap;
+
+    /* IO requests per 100 instructions for each process type, GEN_IO_RATIO_ALL_SLOTS for all. */
+    double io_ratio[PROC_TYPE_COUNT];
+    /* Percent of IO processes that use asynchronous IO rings instead of blocking traps; lockstep runs only. */
+    double async_share;
+    /* Percent of generated arrivals that are reader-writer, semaphore or barrier groups, in equal shares. */
+    double sync_share;
+    /* Percent of IO and intensive processes that fork FORK_GENERATIONS times, their children too. */
+    double fork_share;
+    /* Percent of generated arrivals that are pipe or mailbox groups, in equal shares. */
+    double ipc_share;
+    /* Messages a SENDER or RECEIVER moves in one transfer at most. */
+    unsigned int ipc_batch;
+
+    /* Process image sizes in bytes. */
+    enum burst_kind size;
+    unsigned int size_min;
+    unsigned int size_max;
+    double size_alpha;
+    double size_mu;
+    double size_sigma;
+} workload_gen_config_s;
+
+typedef struct workload_gen {
+    workload_gen_config_s config;
+    sim_rng_s rng;
+    double next_arrival; // cycle of the next arrival
+    double phase_end;    // bursty: cycle at which the current on period ends
+} workload_gen_s;
+
+typedef workload_gen_s * workload_gen_p;
+
+/*
+ * Fills a config with the defaults, which reproduce the original generator.
+ *
+ * Arguments: config: the config to fill.
+ */
+void workload_gen_defaults(/* out */ workload_gen_config_s * config);
+
+/*
+ * Applies a comma separated key=value spec to a config, e.g.
+ * "arrival=poisson,rate=0.02,burst=pareto,alpha=1.2,io_io=3,io_intensive=0,size=pareto".
+ *
+ * Arguments: config: the config to modify.
+ *            spec: the spec to parse.
+ * Return: 1 if every key was understood, 0 otherwise.
+ */
+int workload_gen_parse(/* in-out */ workload_gen_config_s * config, /* in */ const char * spec);
+
+/*
+ * Seeds a generator and schedules its first arrival.
+ *
+ * Arguments: gen: the generator to start, its config must already be set.
+ *            seed: the rng seed.
+ */
+void workload_gen_start(/* in-out */ workload_gen_p gen, /* in */ uint64_t seed);
+
+/*
+ * Counts the arrivals that are due by the given cycle and schedules the next one.
+ * Always 0 for ARRIVAL_LEGACY.
+ *
+ * Arguments: gen: the generator.
+ *            now: the current cpu iteration.
+ * Return: the number of processes to create now.
+ */
+unsigned int workload_gen_arrivals(/* in-out */ workload_gen_p gen, /* in */ unsigned long long now);
+
+/*
+ * Draws a CPU burst length for a new process.
+ *
+ * Arguments: gen: the generator.
+ * Return: the max_pc to use.
+ */
+unsigned int workload_gen_max_pc(/* in-out */ workload_gen_p gen);
+
+/*
+ * Draws the image size of a new process.
+ *
+ * Arguments: gen: the generator.
+ * Return: the size in bytes, between size_min and size_max.
+ */
+unsigned int workload_gen_size(/* in-out */ workload_gen_p gen);
+
+/*
+ * Places the IO traps of a pcb. Trap pcs are drawn directly in sorted order
+ * from the pcs outside the pcb's lock regions, without rejection, and split
+ * between the two devices. Unused slots are parked past max_pc so they never fire.
+ *
+ * Arguments: gen: the generator.
+ *            pcb: the pcb to modify, max_pc and proc_type must be set. Types
+ *                 without IO traps are left untouched.
+ */
+void workload_gen_place_traps(/* in-out */ workload_gen_p gen, /* in-out */ PCB_p pcb);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "workload_trace.h"
+
+/* Consumed bytes are handed back to the kernel in chunks of this size. */
+#define TRACE_RELEASE_WINDOW (16 * 1024 * 1024)
+
+/*
+ * Maps a trace file for sequential replay.
+ *
+ * Arguments: path: the trace file to open.
+ * Return: a new reader, NULL if the file could not be mapped or is not a trace.
+ */
+trace_reader_p trace_reader_open(/* in */ const char * path) {
+    struct stat st;
+    const trace_header_s * header;
+    trace_reader_p reader = malloc(sizeof(trace_reader_s));
+
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0 || fstat(reader->fd, &st) != 0 || st.st_size < (off_t) sizeof(trace_header_s)) {
+        if (reader->fd >= 0) {
+            close(reader->fd);
+        }
+        free(reader);
+        return NULL;
+    }
+
+    reader->map_len = st.st_size;
+    reader->map = mmap(NULL, reader->map_len, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        close(reader->fd);
+        free(reader);
+        return NULL;
+    }
+    madvise(reader->map, reader->map_len, MADV_SEQUENTIAL);
+
+    header = (const trace_header_s *) reader->map;
+    reader->records = (const trace_record_s *) (reader->map + sizeof(trace_header_s));
+    reader->count = header->record_count;
+    reader->next = 0;
+    reader->rejected = 0;
+    reader->released = 0;
+
+    /* Reject foreign files and truncated traces. */
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION
+        || reader->count > (reader->map_len - sizeof(trace_header_s)) / sizeof(trace_record_s)) {
+        trace_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+/*
+ * Returns the next record if it has arrived by the given cycle. Pages behind
+ * the read position are released as the reader advances, so the resident size
+ * of a replay stays bounded whatever the length of the trace. Records that
+ * fail trace_record_valid are skipped and counted in rejected.
+ *
+ * Arguments: reader: the reader to advance.
+ *            now: the current cpu iteration.
+ * Return: the next record, NULL if the trace is exhausted or the next record
+ * has not arrived yet.
+ */
+const trace_record_s * trace_reader_next(/* in-out */ trace_reader_p reader, /* in */ uint64_t now) {
+    const trace_record_s * rec;
+    size_t consumed;
+
+    for (;;) {
+        if (reader->next >= reader->count || reader->records[reader->next].arrival > now) {
+            return NULL;
+        }
+        rec = &reader->records[reader->next];
+        reader->next++;
+        if (trace_record_valid(rec)) {
+            break;
+        }
+        reader->rejected++;
+    }
+
+    /* Drop everything before the current window; the record returned stays mapped. */
+    consumed = (const unsigned char *) rec - reader->map;
+    if (consumed - reader->released >= 2 * TRACE_RELEASE_WINDOW) {
+        madvise(reader->map + reader->released, TRACE_RELEASE_WINDOW, MADV_DONTNEED);
+        reader->released += TRACE_RELEASE_WINDOW;
+    }
+
+    return rec;
+}
+
+/*
+ * Checks whether every record has been handed out.
+ *
+ * Arguments: reader: the reader to test.
+ * Return: 1 if exhausted, 0 otherwise.
+ */
+char trace_reader_done(/* in */ trace_reader_p reader) {
+    return reader->next >= reader->count;
+}
+
+/*
+ * Unmaps the trace and frees the reader.
+ *
+ * Arguments: reader: the reader to close.
+ */
+void trace_reader_close(/* in-out */ trace_reader_p reader) {
+    munmap(reader->map, reader->map_len);
+    close(reader->fd);
+    free(reader);
+}
+
+/*
+ * Creates a trace file, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ * Return: a new writer, NULL on failure.
+ */
+trace_writer_p trace_writer_open(/* in */ const char * path) {
+    trace_header_s header;
+    trace_writer_p writer = malloc(sizeof(trace_writer_s));
+
+    if (writer != NULL) {
+        writer->file = fopen(path, "wb");
+        writer->count = 0;
+
+        header.magic = TRACE_MAGIC;
+        header.version = TRACE_VERSION;
+        header.record_count = 0;
+        if (writer->file == NULL || fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+            if (writer->file != NULL) {
+                fclose(writer->file);
+            }
+            free(writer);
+            writer = NULL;
+        }
+    }
+
+    return writer;
+}
+
+/*
+ * Appends a record. Records must be appended in arrival order.
+ *
+ * Arguments: writer: the writer to append to.
+ *            rec: the record to write.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int trace_writer_append(/* in-out */ trace_writer_p writer, /* in */ const trace_record_s * rec) {
+    if (fwrite(rec, sizeof(trace_record_s), 1, writer->file) != 1) {
+        return 0;
+    }
+    writer->count++;
+    return 1;
+}
+
+/*
+ * Writes the final record count to the header and closes the file.
+ *
+ * Arguments: writer: the writer to close.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int trace_writer_close(/* in-out */ trace_writer_p writer) {
+    trace_header_s header;
+    int ok;
+
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.record_count = writer->count;
+
+    ok = fseek(writer->file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    ok = (fclose(writer->file) == 0) && ok;
+    free(writer);
+
+    return ok;
+}
+
+/*
+ * Checks a record before it is applied: the type must exist, the burst must
+ * be at least one instruction, every IO trap must lie within the burst or be
+ * parked at max_pc + 1, and with TRACE_FLAG_LOCK_POINTS every lock region
+ * must satisfy 0 < lock < unlock - 1 < max_pc.
+ *
+ * Arguments: rec: the record to check.
+ * Return: 1 if the record can be applied, 0 otherwise.
+ */
+int trace_record_valid(/* in */ const trace_record_s * rec) {
+    int i;
+
+    if (rec->type >= PROC_TYPE_COUNT || rec->max_pc == 0 || rec->max_pc == UINT32_MAX) {
+        return 0;
+    }
+
+    /* The generator and trace_import park unused trap slots one past the burst. */
+    for (i = 0; i < NUM_IO_TRAPS; i++) {
+        if (rec->io_1_traps[i] > rec->max_pc + 1 || rec->io_2_traps[i] > rec->max_pc + 1) {
+            return 0;
+        }
+    }
+
+    /* Unlock points below 2 are refused first so unlock - 1 cannot wrap. */
+    if (rec->flags & TRACE_FLAG_LOCK_POINTS) {
+        for (i = 0; i < NUM_LOCKS; i++) {
+            if (rec->unlock_points[i] < 2 || rec->unlock_points[i] > rec->max_pc
+                || rec->lock_points[i] == 0 || rec->lock_points[i] >= rec->unlock_points[i] - 1) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Overwrites the randomly generated fields of a PCB with a trace record.
+ *
+ * Arguments: rec: the record to apply.
+ *            pcb: the pcb to modify, its proc_type must be set.
+ */
+void trace_record_apply(/* in */ const trace_record_s * rec, /* in-out */ PCB_p pcb) {
+    int i;
+
+    pcb->max_pc = rec->max_pc;
+    pcb->terminate = (rec->flags & TRACE_FLAG_NO_TERMINATE) ? 0 : rec->terminate;
+    PCB_assign_priority(pcb, rec->priority);
+
+    /* Only IO, PROD and CONS have IO traps, only MUTEX, the sync and the ipc types have lock points. */
+    if (pcb->proc_type == IO || pcb->proc_type == PROD || pcb->proc_type == CONS) {
+        for (i = 0; i < NUM_IO_TRAPS; i++) {
+            PCB_IO_TRAPS(pcb)->io_1_traps[i] = rec->io_1_traps[i];
+            PCB_IO_TRAPS(pcb)->io_2_traps[i] = rec->io_2_traps[i];
+        }
+    }
+
+    if (pcb->proc_type == MUTEX && (rec->flags & TRACE_FLAG_LOCK_POINTS)) {
+        for (i = 0; i < NUM_LOCKS; i++) {
+            PCB_MUTEX(pcb)->lock_1[i] = rec->lock_points[i];
+            PCB_MUTEX(pcb)->lock_2[i] = rec->lock_points[i] + 1;
+            PCB_MUTEX(pcb)->unlock_2[i] = rec->unlock_points[i] - 1;
+            PCB_MUTEX(pcb)->unlock_1[i] = rec->unlock_points[i];
+        }
+    }
+
+    if (pcb->proc_type >= READER && pcb->proc_type <= BARRIER && (rec->flags & TRACE_FLAG_LOCK_POINTS)) {
+        for (i = 0; i < NUM_LOCKS; i++) {
+            PCB_SYNC(pcb)->acquire[i] = rec->lock_points[i];
+            if (pcb->proc_type != BARRIER)
+                PCB_SYNC(pcb)->release[i] = rec->unlock_points[i];
+        }
+    }
+
+    /* SENDER and RECEIVER transfer at the lock points. */
+    if ((pcb->proc_type == SENDER || pcb->proc_type == RECEIVER) && (rec->flags & TRACE_FLAG_LOCK_POINTS)) {
+        for (i = 0; i < NUM_LOCKS; i++)
+            PCB_IPC(pcb)->transfer[i] = rec->lock_points[i];
+    }
+}
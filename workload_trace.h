@@ -0,0 +1,148 @@
+/*
+ *
+ * Dakota Crane, Dino Hadzic, Tyler Stinson
+ * TCSS 422.
+ */
+
+#ifndef WORKLOAD_TRACE_H
+#define WORKLOAD_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pcb.h"
+
+#define TRACE_MAGIC 0x4B525457 /* "WTRK" */
+#define TRACE_VERSION 1
+
+/* Record flags. */
+#define TRACE_FLAG_NO_TERMINATE 0x1 /* Process never terminates, terminate field ignored. */
+#define TRACE_FLAG_LOCK_POINTS 0x2  /* lock_points/unlock_points replace the default lock layout. */
+
+/*
+ * On-disk workload trace layout (little endian, no padding):
+ *   trace_header_s, then record_count trace_record_s sorted by arrival.
+ * Records are fixed size so a mapped file can be walked without parsing.
+ */
+typedef struct trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t record_count;
+} trace_header_s;
+
+typedef struct trace_record {
+    uint64_t arrival;    // cpu iteration at which the process arrives
+    uint32_t max_pc;     // burst length: instructions before the pc wraps
+    uint32_t terminate;  // number of bursts until the process terminates
+    uint8_t type;        // enum proc_type; MUTEX and PROD records create a pair
+    uint8_t priority;    // starting priority
+    uint16_t flags;
+    uint32_t io_1_traps[NUM_IO_TRAPS]; // pcs that trap to IO device 0
+    uint32_t io_2_traps[NUM_IO_TRAPS]; // pcs that trap to IO device 1
+    uint32_t lock_points[NUM_LOCKS];   // pcs that take lock 1 (lock 2 is taken one pc later)
+    uint32_t unlock_points[NUM_LOCKS]; // pcs that release lock 1 (lock 2 is released one pc earlier)
+} __attribute__((packed)) trace_record_s;
+
+/* A streaming reader over a mapped trace file. */
+typedef struct trace_reader {
+    int fd;
+    unsigned char * map;
+    size_t map_len;
+    const trace_record_s * records;
+    uint64_t count;
+    uint64_t next;     // index of the next record to hand out
+    uint64_t rejected; // malformed records skipped so far
+    size_t released;   // bytes at the front of the map already dropped from memory
+} trace_reader_s;
+
+typedef trace_reader_s * trace_reader_p;
+
+/* An appending writer for trace files. */
+typedef struct trace_writer {
+    FILE * file;
+    uint64_t count;
+} trace_writer_s;
+
+typedef trace_writer_s * trace_writer_p;
+
+/*
+ * Maps a trace file for sequential replay.
+ *
+ * Arguments: path: the trace file to open.
+ * Return: a new reader, NULL if the file could not be mapped or is not a trace.
+ */
+trace_reader_p trace_reader_open(/* in */ const char * path);
+
+/*
+ * Returns the next record if it has arrived by the given cycle. Pages behind
+ * the read position are released as the reader advances, so the resident size
+ * of a replay stays bounded whatever the length of the trace. Records that
+ * fail trace_record_valid are skipped and counted in rejected.
+ *
+ * Arguments: reader: the reader to advance.
+ *            now: the current cpu iteration.
+ * Return: the next record, NULL if the trace is exhausted or the next record
+ * has not arrived yet.
+ */
+const trace_record_s * trace_reader_next(/* in-out */ trace_reader_p reader, /* in */ uint64_t now);
+
+/*
+ * Checks whether every record has been handed out.
+ *
+ * Arguments: reader: the reader to test.
+ * Return: 1 if exhausted, 0 otherwise.
+ */
+char trace_reader_done(/* in */ trace_reader_p reader);
+
+/*
+ * Unmaps the trace and frees the reader.
+ *
+ * Arguments: reader: the reader to close.
+ */
+void trace_reader_close(/* in-out */ trace_reader_p reader);
+
+/*
+ * Creates a trace file, truncating any existing file.
+ *
+ * Arguments: path: the file to write.
+ * Return: a new writer, NULL on failure.
+ */
+trace_writer_p trace_writer_open(/* in */ const char * path);
+
+/*
+ * Appends a record. Records must be appended in arrival order.
+ *
+ * Arguments: writer: the writer to append to.
+ *            rec: the record to write.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int trace_writer_append(/* in-out */ trace_writer_p writer, /* in */ const trace_record_s * rec);
+
+/*
+ * Writes the final record count to the header and closes the file.
+ *
+ * Arguments: writer: the writer to close.
+ * Return: 1 if successful, 0 otherwise.
+ */
+int trace_writer_close(/* in-out */ trace_writer_p writer);
+
+/*
+ * Checks a record before it is applied: the type must exist, the burst must
+ * be at least one instruction, every IO trap must lie within the burst or be
+ * parked at max_pc + 1, and with TRACE_FLAG_LOCK_POINTS every lock region
+ * must satisfy 0 < lock < unlock - 1 < max_pc.
+ *
+ * Arguments: rec: the record to check.
+ * Return: 1 if the record can be applied, 0 otherwise.
+ */
+int trace_record_valid(/* in */ const trace_record_s * rec);
+
+/*
+ * Overwrites the randomly generated fields of a PCB with a trace record.
+ *
+ * Arguments: rec: the record to apply.
+ *            pcb: the pcb to modify, its proc_type must be set.
+ */
+void trace_record_apply(/* in */ const trace_record_s * rec, /* in-out */ PCB_p pcb);
+
+#endif